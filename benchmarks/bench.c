@@ -0,0 +1,426 @@
+/*
+ * Microbenchmarks of the TKJHAT SDK hot paths.
+ *
+ * Every benchmark calls one function in a loop and reports the time per
+ * call: on the device from the 1 MHz timer, converted to clk_sys cycles; on
+ * the host from clock_gettime(), with the drivers on the HAL mock
+ * (tkjhat/hal_mock.h), where the sensors and the display are register
+ * devices and the bus takes virtual time only.
+ *
+ * One JSON object per line, so the results can be picked out of the
+ * device's serial output and compared between builds; on the host stdout
+ * has only these lines (what the drivers print goes to stderr):
+ *
+ *   {"bench":"icm42670_read","target":"device","calls":200,"ns":419620.0,
+ *    "cycles":52452,"i2c_bytes":15.0}
+ *
+ *   ns         wall time per call (device: bus transfers included)
+ *   cycles     device only, ns at clk_sys
+ *   i2c_bytes  bytes on the bus per call (hal_stats_t)
+ *   bus_us     host only, virtual bus time per call at the configured baud
+ *              rate; unlike ns it does not depend on the machine
+ *
+ * Device: flash tkjhat_bench, open the serial port; the suite runs on start
+ * and again on every received character.
+ *
+ * Host:   tkjhat_bench [-n scale] [-b baseline.jsonl] [-t percent]
+ *         tkjhat_bench --compare baseline.jsonl results.jsonl [-t percent]
+ *   -n  multiply the call counts (default 10); the host takes the best
+ *       of HOST_ROUNDS rounds, the device measures one
+ *   -b  compare this run to an earlier one (e.g. the output redirected
+ *       to a file)
+ *   -t  allowed slowdown in percent (default 10)
+ * Exit status is 1 if a benchmark got slower than allowed or moves more
+ * bytes on the bus, 2 on a usage error or if the mock's alarms do not keep
+ * time. --compare also works on captured device output.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tkjhat/sdk.h"
+#include "tkjhat/hal.h"
+#include "tkjhat/ssd1306.h"
+#include "OpenPDMFilter.h"
+#include "morse.h"
+
+#if TKJHAT_HAL_MOCK
+#include <time.h>
+#include <unistd.h>
+#include "tkjhat/hal_mock.h"
+#else
+#include "pico/stdlib.h"
+#include "pico/stdio_usb.h"
+#include "hardware/clocks.h"
+#endif
+
+#define MAX_RESULTS         32
+#define HOST_ROUNDS         5
+#define DEFAULT_THRESHOLD   10.0
+
+/* ---- time ---- */
+
+#if TKJHAT_HAL_MOCK
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+#else
+static uint64_t now_ns(void) {
+    return time_us_64() * 1000u;
+}
+#endif
+
+/* ---- benchmarked calls ---- */
+
+static ssd1306_t disp;
+static TPDMFilter_InitStruct pdm_filter;
+static uint8_t pdm_in[MEMS_SAMPLING_FREQUENCY / 1000 * 64 / 8];     // 1 ms at decimation 64
+static uint16_t pcm_out[MEMS_SAMPLING_FREQUENCY / 1000];
+static volatile float sink;                                         // keeps the results alive
+
+static void bench_icm42670_read(void) {
+    float ax, ay, az, gx, gy, gz, t;
+    ICM42670_read_sensor_data(&ax, &ay, &az, &gx, &gy, &gz, &t);
+    sink = ax + gz + t;
+}
+
+static void bench_veml6030_read(void) {
+    sink = (float)veml6030_read_light();
+}
+
+static void bench_hdc2021_read(void) {
+    sink = hdc2021_read_temperature();
+}
+
+static void bench_ssd1306_show(void) {
+    ssd1306_show(&disp);
+}
+
+static void bench_ssd1306_draw_string(void) {
+    ssd1306_clear(&disp);
+    ssd1306_draw_string(&disp, 0, 0, 1, "HELLO WORLD .- -...");
+}
+
+static void bench_pdm_filter_64(void) {
+    Open_PDM_Filter_64(pdm_in, pcm_out, pdm_filter.MaxVolume, &pdm_filter);
+}
+
+static void bench_pdm_filter_64_words(void) {
+    Open_PDM_Filter_64_Words((const uint32_t *)pdm_in, pcm_out, pdm_filter.MaxVolume, &pdm_filter);
+}
+
+static void bench_decode_morse(void) {
+    // decode_morse_message() tokenizes its input, the copy is part of the call
+    static const char message[] = ".... . .-.. .-.. ---  .-- --- .-. .-.. -..";
+    char in[sizeof(message)];
+    char out[64];
+    memcpy(in, message, sizeof(message));
+    decode_morse_message(in, out, sizeof(out));
+    sink = out[0];
+}
+
+typedef struct {
+    const char *name;
+    void (*fn)(void);
+    uint32_t calls;         // about 100 ms each on the device
+} bench_t;
+
+static const bench_t benches[] = {
+    { "icm42670_read",          bench_icm42670_read,        200 },
+    { "veml6030_read_light",    bench_veml6030_read,        500 },
+    { "hdc2021_read_temp",      bench_hdc2021_read,         500 },
+    { "ssd1306_show",           bench_ssd1306_show,         5 },
+    { "ssd1306_draw_string",    bench_ssd1306_draw_string,  1000 },
+    { "pdm_filter_64",          bench_pdm_filter_64,        2000 },
+    { "pdm_filter_64_words",    bench_pdm_filter_64_words,  2000 },
+    { "decode_morse_message",   bench_decode_morse,         2000 },
+};
+#define BENCH_COUNT (sizeof(benches) / sizeof(benches[0]))
+
+/* ---- setup ---- */
+
+#if TKJHAT_HAL_MOCK
+static hal_mock_regs_t imu, light, climate;
+
+// Register devices in place of the HAT's sensors; the display acknowledges
+// everything
+static void attach_devices(void) {
+    hal_mock_reset();
+    imu.regs[ICM42670_REG_WHO_AM_I] = ICM42670_WHO_AM_I_RESPONSE;
+    for (int i = 0; i < 14; i++) imu.regs[ICM42670_SENSOR_DATA_START_REG + i] = (uint8_t)(0x11 * i);
+    light.regs[VEML6030_ALS_REG] = 0x40;
+    climate.regs[HDC2021_TEMP_LOW] = 0x00;
+    climate.regs[HDC2021_TEMP_LOW + 1] = 0x68;
+    hal_mock_i2c_attach_regs(ICM42670_I2C_ADDRESS, &imu);
+    hal_mock_i2c_attach_regs(VEML6030_I2C_ADDR, &light);
+    hal_mock_i2c_attach_regs(HDC2021_I2C_ADDRESS, &climate);
+    hal_mock_i2c_attach(SSD1306_I2C_ADDRESS, NULL, NULL, NULL);
+}
+
+#define GRID_PERIOD_US      1000
+#define GRID_CALLS          5
+
+static uint64_t grid_at[GRID_CALLS];
+static int grid_calls;
+
+// Takes time like a real callback would; a negative return must still keep
+// to the target grid, as on the SDK
+static int64_t grid_alarm_cb(hal_alarm_t id, void *user_data) {
+    (void)id;
+    (void)user_data;
+    grid_at[grid_calls++] = hal_time_us();
+    hal_sleep_us(30);
+    return grid_calls < GRID_CALLS ? -GRID_PERIOD_US : 0;
+}
+
+// The bus_us figures rely on the mock's virtual time: check its alarms first
+static bool check_mock(void) {
+    hal_mock_reset();
+    grid_calls = 0;
+    hal_alarm_in_us(GRID_PERIOD_US, grid_alarm_cb, NULL);
+    hal_mock_advance_us(GRID_PERIOD_US * (GRID_CALLS + 1));
+    bool ok = grid_calls == GRID_CALLS;
+    for (int i = 0; ok && i < GRID_CALLS; i++) ok = grid_at[i] == (uint64_t)GRID_PERIOD_US * (i + 1);
+    if (!ok) {
+        fprintf(stderr, "hal_mock: alarm returning -%d us did not fire every %d us:", GRID_PERIOD_US, GRID_PERIOD_US);
+        for (int i = 0; i < grid_calls; i++) fprintf(stderr, " %llu", (unsigned long long)grid_at[i]);
+        fprintf(stderr, "\n");
+    }
+    return ok;
+}
+#endif
+
+static void setup(void) {
+#if TKJHAT_HAL_MOCK
+    attach_devices();
+#endif
+    init_hat_sdk();
+    hal_sleep_ms(300);
+    init_ICM42670();
+    ICM42670_start_with_default_values();
+    init_veml6030();
+    init_hdc2021_();
+    ssd1306_init(&disp, 128, 64, SSD1306_I2C_ADDRESS, i2c_default);
+
+    // Driver defaults, see pdm_microphone_init(); a fixed pseudo-random
+    // bitstream so that every run filters the same data
+    memset(&pdm_filter, 0, sizeof(pdm_filter));
+    pdm_filter.Fs = MEMS_SAMPLING_FREQUENCY;
+    pdm_filter.LP_HZ = MEMS_SAMPLING_FREQUENCY / 2;
+    pdm_filter.HP_HZ = 10;
+    pdm_filter.In_MicChannels = 1;
+    pdm_filter.Out_MicChannels = 1;
+    pdm_filter.Decimation = 64;
+    pdm_filter.MaxVolume = 64;
+    pdm_filter.Gain = 16;
+    Open_PDM_Filter_Init(&pdm_filter);
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < sizeof(pdm_in); i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        pdm_in[i] = (uint8_t)x;
+    }
+}
+
+/* ---- running ---- */
+
+typedef struct {
+    char name[32];
+    double ns;
+    double cycles;          // < 0: not measured
+    double i2c_bytes;
+} result_t;
+
+static result_t results[MAX_RESULTS];
+static size_t result_count;
+
+static void run(const bench_t *b, uint32_t scale) {
+    uint32_t calls = b->calls * scale;
+    hal_stats_t before, after, d;
+
+    b->fn();    // warm-up: caches, first-call setup
+    hal_stats_get(&before);
+#if TKJHAT_HAL_MOCK
+    // Best round: the least disturbed by the rest of the machine
+    uint64_t bus0 = hal_time_us();
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < HOST_ROUNDS; round++) {
+        uint64_t t0 = now_ns();
+        for (uint32_t i = 0; i < calls; i++) b->fn();
+        uint64_t t = now_ns() - t0;
+        if (t < best) best = t;
+    }
+    calls *= HOST_ROUNDS;   // for the counters and the bus time
+#else
+    uint64_t t0 = now_ns();
+    for (uint32_t i = 0; i < calls; i++) b->fn();
+    uint64_t best = now_ns() - t0;
+#endif
+    hal_stats_get(&after);
+    hal_stats_diff(&before, &after, &d);
+
+    result_t *r = &results[result_count < MAX_RESULTS ? result_count++ : MAX_RESULTS - 1];
+    snprintf(r->name, sizeof(r->name), "%s", b->name);
+    r->i2c_bytes = (double)d.i2c_bytes / calls;
+
+#if TKJHAT_HAL_MOCK
+    r->ns = (double)best * HOST_ROUNDS / calls;
+    r->cycles = -1;
+    printf("{\"bench\":\"%s\",\"target\":\"host\",\"calls\":%lu,\"ns\":%.1f,\"i2c_bytes\":%.1f,\"bus_us\":%.1f}\n",
+           b->name, (unsigned long)(calls / HOST_ROUNDS), r->ns, r->i2c_bytes, (double)(hal_time_us() - bus0) / calls);
+#else
+    r->ns = (double)best / calls;
+    r->cycles = r->ns * clock_get_hz(clk_sys) / 1e9;
+    printf("{\"bench\":\"%s\",\"target\":\"device\",\"calls\":%lu,\"ns\":%.1f,\"cycles\":%.0f,\"i2c_bytes\":%.1f}\n",
+           b->name, (unsigned long)calls, r->ns, r->cycles, r->i2c_bytes);
+#endif
+}
+
+static void run_all(uint32_t scale) {
+    result_count = 0;
+    for (size_t i = 0; i < BENCH_COUNT; i++) run(&benches[i], scale);
+    fflush(stdout);
+}
+
+#if TKJHAT_HAL_MOCK
+/* ---- comparison (host) ---- */
+
+static bool json_num(const char *line, const char *key, double *out) {
+    char pattern[40];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    if (p == NULL) return false;
+    *out = strtod(p + strlen(pattern), NULL);
+    return true;
+}
+
+// Result lines of a file; other lines (e.g. the rest of the device output)
+// are skipped
+static size_t load_results(const char *path, result_t *out, size_t max) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        exit(2);
+    }
+    char line[512];
+    size_t n = 0;
+    while (n < max && fgets(line, sizeof(line), f)) {
+        const char *p = strstr(line, "{\"bench\":\"");
+        if (p == NULL) continue;
+        p += strlen("{\"bench\":\"");
+        size_t len = strcspn(p, "\"");
+        if (len >= sizeof(out[n].name)) continue;
+        memcpy(out[n].name, p, len);
+        out[n].name[len] = '\0';
+        if (!json_num(p, "ns", &out[n].ns)) continue;
+        if (!json_num(p, "cycles", &out[n].cycles)) out[n].cycles = -1;
+        if (!json_num(p, "i2c_bytes", &out[n].i2c_bytes)) out[n].i2c_bytes = 0;
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+// Cycles when both have them (device), otherwise time. Returns the number
+// of regressions.
+static int compare(const result_t *base, size_t nbase, const result_t *cur, size_t ncur, double threshold) {
+    int regressions = 0;
+    fprintf(stderr, "%-24s %12s %12s %8s\n", "bench", "baseline", "now", "change");
+    for (size_t i = 0; i < ncur; i++) {
+        const result_t *b = NULL;
+        for (size_t j = 0; j < nbase && b == NULL; j++) {
+            if (strcmp(base[j].name, cur[i].name) == 0) b = &base[j];
+        }
+        if (b == NULL) {
+            fprintf(stderr, "%-24s %12s %12.1f\n", cur[i].name, "-", cur[i].ns);
+            continue;
+        }
+        bool cyc = b->cycles >= 0 && cur[i].cycles >= 0;
+        double was = cyc ? b->cycles : b->ns;
+        double now = cyc ? cur[i].cycles : cur[i].ns;
+        double change = was > 0 ? (now - was) * 100.0 / was : 0;
+        bool slower = change > threshold;
+        bool more_bus = cur[i].i2c_bytes > b->i2c_bytes;
+        fprintf(stderr, "%-24s %12.1f %12.1f %+7.1f%% %s%s%s\n", cur[i].name, was, now, change,
+                cyc ? "cycles" : "ns", slower ? "  SLOWER" : "", more_bus ? "  MORE I2C" : "");
+        if (slower || more_bus) regressions++;
+    }
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    uint32_t scale = 10;
+    double threshold = DEFAULT_THRESHOLD;
+    const char *baseline = NULL;
+    const char *compare_a = NULL, *compare_b = NULL;
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-n") == 0 && a + 1 < argc) {
+            scale = (uint32_t)strtoul(argv[++a], NULL, 10);
+            if (scale == 0) scale = 1;
+        } else if (strcmp(argv[a], "-b") == 0 && a + 1 < argc) {
+            baseline = argv[++a];
+        } else if (strcmp(argv[a], "-t") == 0 && a + 1 < argc) {
+            threshold = atof(argv[++a]);
+        } else if (strcmp(argv[a], "--compare") == 0 && a + 2 < argc) {
+            compare_a = argv[++a];
+            compare_b = argv[++a];
+        } else {
+            fprintf(stderr, "usage: %s [-n scale] [-b baseline.jsonl] [-t percent]\n"
+                            "       %s --compare baseline.jsonl results.jsonl [-t percent]\n",
+                    argv[0], argv[0]);
+            return 2;
+        }
+    }
+
+    static result_t base[MAX_RESULTS];
+    if (compare_a != NULL) {
+        static result_t cur[MAX_RESULTS];
+        size_t nbase = load_results(compare_a, base, MAX_RESULTS);
+        size_t ncur = load_results(compare_b, cur, MAX_RESULTS);
+        return compare(base, nbase, cur, ncur, threshold) ? 1 : 0;
+    }
+
+    if (!check_mock()) return 2;
+
+    // The drivers print while they start (e.g. the IMU address): to stderr,
+    // so that stdout has nothing but result lines
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    setup();
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    run_all(scale);
+
+    if (baseline != NULL) {
+        size_t nbase = load_results(baseline, base, MAX_RESULTS);
+        return compare(base, nbase, results, result_count, threshold) ? 1 : 0;
+    }
+    return 0;
+}
+
+#else
+
+int main(void) {
+    stdio_init_all();
+
+    // Results are lost if nobody listens: wait for the serial port a while
+    for (int i = 0; i < 50 && !stdio_usb_connected(); i++) sleep_ms(100);
+
+    setup();
+    printf("tkjhat_bench: clk_sys %lu Hz\n", (unsigned long)clock_get_hz(clk_sys));
+    for (;;) {
+        run_all(1);
+        printf("tkjhat_bench: done, any key runs again\n");
+        getchar();
+    }
+}
+
+#endif
@@ -42,12 +42,18 @@
 
 /* Scheduler Related */
 #define configUSE_PREEMPTION                    1
+#ifndef configUSE_TICKLESS_IDLE
 #define configUSE_TICKLESS_IDLE                 0
+#endif
+#ifndef configUSE_IDLE_HOOK
 #define configUSE_IDLE_HOOK                     0
+#endif
 #define configUSE_TICK_HOOK                     0
 #define configTICK_RATE_HZ                      ( ( TickType_t ) 1000 )
 #define configMAX_PRIORITIES                    32
-#define configMINIMAL_STACK_SIZE                ( configSTACK_DEPTH_TYPE ) 512 
+#ifndef configMINIMAL_STACK_SIZE
+#define configMINIMAL_STACK_SIZE                ( configSTACK_DEPTH_TYPE ) 512
+#endif
 #define configUSE_16_BIT_TICKS                  0
 
 #define configIDLE_SHOULD_YIELD                 1
@@ -69,6 +75,16 @@
 #define configSTACK_DEPTH_TYPE                  uint32_t
 #define configMESSAGE_BUFFER_LENGTH_TYPE        size_t
 
+/* Tickless idle (LOW_POWER, root CMakeLists.txt): the tick is stopped while
+   every task is blocked. The application counts the wakeups (src/power.c). */
+#if configUSE_TICKLESS_IDLE
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP   2
+#ifndef __ASSEMBLER__
+void power_note_wakeup(void);
+#endif
+#define configPOST_SLEEP_PROCESSING( x )        power_note_wakeup()
+#endif
+
 /* Memory allocation related definitions. */
 #ifndef configSUPPORT_STATIC_ALLOCATION
 #define configSUPPORT_STATIC_ALLOCATION         0
@@ -76,18 +92,40 @@
 #ifndef configSUPPORT_DYNAMIC_ALLOCATION
 #define configSUPPORT_DYNAMIC_ALLOCATION        1
 #endif
+#ifndef configTOTAL_HEAP_SIZE
 #define configTOTAL_HEAP_SIZE                   (128*1024)
+#endif
 #define configAPPLICATION_ALLOCATED_HEAP        0
+#if configSUPPORT_STATIC_ALLOCATION && !defined(configKERNEL_PROVIDED_STATIC_MEMORY)
+/* Idle and timer task stacks are static arrays inside the kernel, so the
+   application does not have to provide vApplicationGet*TaskMemory(). */
+#define configKERNEL_PROVIDED_STATIC_MEMORY     1
+#endif
 
 /* Hook function related definitions. */
+#ifndef configCHECK_FOR_STACK_OVERFLOW
 #define configCHECK_FOR_STACK_OVERFLOW          0
+#endif
 #define configUSE_MALLOC_FAILED_HOOK            0
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS           0
+#ifndef configGENERATE_RUN_TIME_STATS
+#define configGENERATE_RUN_TIME_STATS           1
+#endif
 #define configUSE_TRACE_FACILITY                1
-#define configUSE_STATS_FORMATTING_FUNCTIONS    0
+#define configUSE_STATS_FORMATTING_FUNCTIONS    1
+
+#if configGENERATE_RUN_TIME_STATS
+/* Run time is counted with the free running 1 MHz timer of the RP2040.
+   64 bits so the counters do not wrap (32 bits would after 71 minutes). */
+#define configRUN_TIME_COUNTER_TYPE             uint64_t
+#ifndef __ASSEMBLER__
+#include "hardware/timer.h"
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()        time_us_64()
+#endif
 
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES                   0
@@ -97,7 +135,9 @@
 #define configUSE_TIMERS                        1
 #define configTIMER_TASK_PRIORITY               ( configMAX_PRIORITIES - 1 )
 #define configTIMER_QUEUE_LENGTH                10
+#ifndef configTIMER_TASK_STACK_DEPTH
 #define configTIMER_TASK_STACK_DEPTH            1024
+#endif
 
 /* Interrupt nesting behaviour configuration. */
 /*
@@ -156,6 +196,11 @@ to exclude the API function. */
 #endif
 
 /* A header file that defines trace macro can be included here. */
+/* Event trace (EVENT_TRACE, root CMakeLists.txt): task switches, queue and
+   notification operations into the buffers of tkjhat/event_trace.h. */
+#if defined(EVENT_TRACE) && EVENT_TRACE && !defined(__ASSEMBLER__)
+#include "event_trace_hooks.h"
+#endif
 
 #endif /* FREERTOS_CONFIG_H */
 
@@ -0,0 +1,48 @@
+/*
+ * FreeRTOS trace hooks of the event trace (EVENT_TRACE, root CMakeLists.txt).
+ * Included at the end of FreeRTOSConfig.h; the macros expand inside the
+ * kernel sources, where the TCB and queue structures are visible. The
+ * events go into the per-core buffers of tkjhat/event_trace.h.
+ *
+ * The hooks take variadic arguments because the kernel versions differ in
+ * what they pass (e.g. the notification index). pxCurrentTCB is the task
+ * of the calling core also in the SMP kernel.
+ */
+
+#ifndef EVENT_TRACE_HOOKS_H
+#define EVENT_TRACE_HOOKS_H
+
+#include "tkjhat/event_trace.h"
+
+#define traceTASK_CREATE( pxNewTCB ) \
+    event_trace_name( EVENT_TRACE_NAME_TASK, ( uint32_t ) ( uintptr_t ) ( pxNewTCB ), ( pxNewTCB )->pcTaskName )
+
+#define traceTASK_DELETE( pxTCB ) \
+    event_trace_forget( EVENT_TRACE_NAME_TASK, ( uint32_t ) ( uintptr_t ) ( pxTCB ) )
+
+#define traceTASK_SWITCHED_IN() \
+    event_trace_emit( EVENT_TRACE_EV_TASK_IN, 0, ( uint32_t ) ( uintptr_t ) pxCurrentTCB )
+
+#define traceQUEUE_REGISTRY_ADD( xQueue, pcQueueName ) \
+    event_trace_name( EVENT_TRACE_NAME_QUEUE, ( uint32_t ) ( uintptr_t ) ( xQueue ), ( pcQueueName ) )
+
+#define traceQUEUE_SEND( pxQueue ) \
+    event_trace_emit( EVENT_TRACE_EV_QUEUE_SEND, ( uint16_t ) ( pxQueue )->uxMessagesWaiting, ( uint32_t ) ( uintptr_t ) ( pxQueue ) )
+#define traceQUEUE_SEND_FROM_ISR( pxQueue )         traceQUEUE_SEND( pxQueue )
+
+#define traceQUEUE_RECEIVE( pxQueue ) \
+    event_trace_emit( EVENT_TRACE_EV_QUEUE_RECEIVE, ( uint16_t ) ( pxQueue )->uxMessagesWaiting, ( uint32_t ) ( uintptr_t ) ( pxQueue ) )
+#define traceQUEUE_RECEIVE_FROM_ISR( pxQueue )      traceQUEUE_RECEIVE( pxQueue )
+
+#define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue ) \
+    event_trace_emit( EVENT_TRACE_EV_QUEUE_BLOCK, 0, ( uint32_t ) ( uintptr_t ) ( pxQueue ) )
+#define traceBLOCKING_ON_QUEUE_SEND( pxQueue ) \
+    event_trace_emit( EVENT_TRACE_EV_QUEUE_BLOCK, 1, ( uint32_t ) ( uintptr_t ) ( pxQueue ) )
+
+/* The application signals its tasks mostly with notifications */
+#define traceTASK_NOTIFY( ... ) \
+    event_trace_emit( EVENT_TRACE_EV_NOTIFY, 0, ( uint32_t ) ( uintptr_t ) pxTCB )
+#define traceTASK_NOTIFY_FROM_ISR( ... )            traceTASK_NOTIFY()
+#define traceTASK_NOTIFY_GIVE_FROM_ISR( ... )       traceTASK_NOTIFY()
+
+#endif /* EVENT_TRACE_HOOKS_H */
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <pico/stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <tusb.h>
+#include "usbSerialDebug/helper.h"
+
+// CDC throughput benchmark.
+// As soon as the host opens CDC1, a known pattern is streamed on it as fast
+// as USB takes it: consecutive 32-bit little-endian counters starting at 0.
+// Once per second CDC0 gets the sustained rate and the stalls (time the TX
+// buffer stayed full). Verify the data and measure on the host side with
+// tools/cdc_throughput:
+//   ./build-cdc/cdc_throughput /dev/ttyACM1
+// Buffer sizes and the flush policy are CMake options of usb-serial-debug.
+
+#define CHUNK_WORDS         64      // pattern generated 256 bytes at a time
+#define STALL_MS            5       // TX buffer full at least this long = stall
+#define REPORT_PERIOD_MS    1000
+#define BUFFER_SIZE         128
+
+#if CFG_TUSB_OS != OPT_OS_FREERTOS
+#error "This should be using FREERTOS but the CFG_TUSB_OS is not OPT_OS_FREERTOS"
+#endif
+
+// ---- Task streaming the pattern on CDC1 ----
+static void benchTask(void *arg) {
+    (void)arg;
+    uint32_t chunk[CHUNK_WORDS];
+    char buf[BUFFER_SIZE];
+
+    while (1) {
+        while (!tud_mounted() || !tud_cdc_n_connected(1)) {
+            vTaskDelay(pdMS_TO_TICKS(50));
+        }
+
+        // New session: pattern restarts from 0 so the host can check it
+        uint32_t counter = 0;
+        size_t off = sizeof(chunk);
+        uint64_t total = 0;
+        uint32_t period_bytes = 0, stalls = 0, max_stall_ms = 0;
+        uint32_t start = to_ms_since_boot(get_absolute_time());
+        uint32_t last_report = start;
+        uint32_t full_since = 0;
+        bool full = false, stalled = false;
+
+        snprintf(buf, BUFFER_SIZE, "bench: tx_buf=%d rx_buf=%d flush_each=%d\n",
+                 CFG_TUD_CDC_TX_BUFSIZE, CFG_TUD_CDC_RX_BUFSIZE, USB_SERIAL_DATA_FLUSH_EACH);
+        usb_serial_print(buf);
+
+        while (tud_cdc_n_connected(1)) {
+            if (off == sizeof(chunk)) {
+                for (int i = 0; i < CHUNK_WORDS; i++) {
+                    // Stored little-endian, which is the RP2040 byte order
+                    chunk[i] = counter++;
+                }
+                off = 0;
+            }
+
+            size_t n = usb_serial_data_send((const uint8_t *)chunk + off, sizeof(chunk) - off);
+            uint32_t now = to_ms_since_boot(get_absolute_time());
+            if (n > 0) {
+                off += n;
+                total += n;
+                period_bytes += n;
+                if (full && now - full_since > max_stall_ms) max_stall_ms = now - full_since;
+                full = stalled = false;
+            } else {
+                if (!full) {
+                    full = true;
+                    full_since = now;
+                } else if (!stalled && now - full_since >= STALL_MS) {
+                    stalled = true;
+                    stalls++;
+                }
+                // Let the USB task (same core or other) empty the buffer
+                taskYIELD();
+            }
+
+            if (now - last_report >= REPORT_PERIOD_MS) {
+                uint32_t rate = (uint32_t)((uint64_t)period_bytes * 1000u / (now - last_report));
+                snprintf(buf, BUFFER_SIZE, "rate:%lu B/s total:%llu stalls:%lu max_stall:%lu ms avg:%lu B/s\n",
+                         (unsigned long)rate, (unsigned long long)total,
+                         (unsigned long)stalls, (unsigned long)max_stall_ms,
+                         (unsigned long)(total * 1000u / (now - start)));
+                usb_serial_print(buf);
+                period_bytes = 0;
+                last_report = now;
+            }
+        }
+        usb_serial_print("bench: CDC1 closed\n");
+    }
+}
+
+// ---- Task running USB stack ----
+static void usbTask(void *arg) {
+    (void)arg;
+    while (1) {
+        // Also flushes CDC1 when USB_SERIAL_DATA_FLUSH_EACH is 0
+        tud_task_ext(USB_SERIAL_DRAIN_MS, false);
+        usb_serial_drain();
+    }
+}
+
+int main(void) {
+    TaskHandle_t hUsb = NULL, hBench = NULL;
+    xTaskCreate(usbTask, "usb", 1024, NULL, 3, &hUsb);
+    xTaskCreate(benchTask, "bench", 1024, NULL, 1, &hBench);
+
+    #if (configNUMBER_OF_CORES > 1)
+        // Producer and USB stack on different cores: the measured rate is
+        // then limited by USB, not by sharing one CPU
+        vTaskCoreAffinitySet(hUsb, 1u << 0);
+        vTaskCoreAffinitySet(hBench, 1u << 1);
+    #endif
+
+    // VERY IMPORTANT, THIS SHOULD GO JUST BEFORE vTaskStartSheduler
+    // WITHOUT ANY DELAYS. OTHERWISE, THE TinyUSB stack wont recognize
+    // the device.
+    tusb_init();
+    usb_serial_init();
+    vTaskStartScheduler();
+}
+
+// Input of the serial ports is not used
+void tud_cdc_rx_cb(uint8_t itf) {
+    usb_serial_rx_cb(itf);
+}
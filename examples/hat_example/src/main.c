@@ -9,6 +9,7 @@
 #include <task.h>
 
 #include <tkjhat/sdk.h>
+#include <tkjhat/dlog.h>
 #include <pico/binary_info.h>
 
 #if CFG_TUSB_OS != OPT_OS_FREERTOS
@@ -90,7 +91,7 @@ void light_sensor_task(void *pvParameters) {
 
     while (1) {
         uint16_t light = veml6030_read_light();
-        printf("Light level: %d\n", light);
+        DLOG("Light level: %d\n", light);
         vTaskDelay(1000);
     }
 }
@@ -101,7 +102,7 @@ void ths_task(void *pvParameters) {
     while (1) {
         float temp = hdc2021_read_temperature();
         float humid = hdc2021_read_humidity();
-        printf("Temperature: %.2f°C, Humidity: %.2f%%\n", temp, humid);
+        DLOG("Temperature: %.2f°C, Humidity: %.2f%%\n", temp, humid);
         vTaskDelay(1000);
     }
 }
@@ -116,11 +117,12 @@ void imu_task(void *pvParameters) {
     {
         if (ICM42670_read_sensor_data(&ax, &ay, &az, &gx, &gy, &gz, &t) == 0) {
             float temp_c = (float)t / 128.0f;
-            printf("Accel: X=%d, Y=%d, Z=%d | Gyro: X=%d, Y=%d, Z=%d | Temp: %.2f°C\n", ax, ay, az, gx, gy, gz, temp_c);
+            DLOG("Accel: X=%.3f, Y=%.3f, Z=%.3f | Gyro: X=%.2f, Y=%.2f, Z=%.2f | Temp: %.2f°C\n", ax, ay, az, gx, gy, gz, temp_c);
 
         } else {
-            printf("Failed to read imu data\n");
+            DLOG("Failed to read imu data\n");
         }
+        dlog_drain();
         vTaskDelay(pdMS_TO_TICKS(60));
     }
 
@@ -354,11 +356,12 @@ int main() {
 
         if (ICM42670_read_sensor_data(&ax, &ay, &az, &gx, &gy, &gz, &t) == 0) {
             
-            printf("Accel: X=%f, Y=%f, Z=%f | Gyro: X=%f, Y=%f, Z=%f| Temp: %2.2f°C\n", ax, ay, az, gx, gy, gz, t);
+            DLOG("Accel: X=%f, Y=%f, Z=%f | Gyro: X=%f, Y=%f, Z=%f| Temp: %2.2f°C\n", ax, ay, az, gx, gy, gz, t);
 
         } else {
-            printf("Failed to read imu data\n");
+            DLOG("Failed to read imu data\n");
         }
+        dlog_drain();
         sleep_ms(1000);
         
 
@@ -10,13 +10,22 @@
 
 #include <tusb.h>
 #include "usbSerialDebug/helper.h"
+#include "usbSerialDebug/telemetry.h"
+#include <tkjhat/command.h>
 
-#define BUFFER_SIZE     30
+#define BUFFER_SIZE     48
 #define TEMP_MIN        0
 #define TEMP_MAX        40
 #define LUX_MIN         100
 #define LUX_MAX         1500
 #define CDC_ITF_TX      1
+#define SAMPLE_PERIOD_MS    100
+#define FLUSH_PERIOD_MS     1000
+#define RX_BUFFER_SIZE      256
+
+// Changed with commands sent to CDC1 (see cmdTask)
+static volatile bool streaming = true;
+static volatile uint32_t sample_period_ms = SAMPLE_PERIOD_MS;
 
 
 /*#if   CFG_TUSB_OS == OPT_OS_FREERTOS
@@ -46,39 +55,97 @@ static void sensorTask (void *arg){
     if (usb_serial_connected()) {
         usb_serial_print("=== Dual CDC Example Started ===\n");
         usb_serial_print("CDC0: Debug output (this interface)\n");
-        usb_serial_print("CDC1: Sending serial data\n");
+        usb_serial_print("CDC1: Binary telemetry out, text commands in (type help)\n");
     }
     usb_serial_flush();
 
+    // Samples go to CDC1 as binary frames (decode with tools/telemetry_decode)
+    static telemetry_t tm;
+    telemetry_init(&tm, usb_serial_data_write, NULL);
+    uint32_t last_flush = 0;
+
     while (1) {
         //Generated random numbers
         int temp = rand_in_range(TEMP_MIN, TEMP_MAX);
         int lux  = rand_in_range(LUX_MIN,  LUX_MAX);
-        
-        if(tud_cdc_n_connected(CDC_ITF_TX)){
-            //Send them using tucdc_n_write to the ACM1
-            snprintf(buf, BUFFER_SIZE,"%d, %d\n", temp, lux);
-            tud_cdc_n_write(CDC_ITF_TX,buf,strlen(buf));
-            tud_cdc_n_write_flush(CDC_ITF_TX);
-            
+        uint32_t now = to_ms_since_boot(get_absolute_time());
+
+        // Several records are batched per frame; a frame goes out when it
+        // is full or at the latest after FLUSH_PERIOD_MS
+        if (streaming) {
+            telemetry_add_env(&tm, now, (float)temp, 45.0f);
+            telemetry_add_light(&tm, now, (uint32_t)lux);
         }
-        //Send also the debug log to the ACM0
-        if (usb_serial_connected()) {
-            snprintf(buf, BUFFER_SIZE,"temp:%d, light:%d\n", temp, lux);
-            usb_serial_print(buf);
-            usb_serial_flush();
+        if (now - last_flush >= FLUSH_PERIOD_MS) {
+            telemetry_flush(&tm);
+            last_flush = now;
+
+            //Send also the debug log to the ACM0
+            if (usb_serial_connected()) {
+                snprintf(buf, BUFFER_SIZE,"temp:%d, light:%d\n", temp, lux);
+                usb_serial_print(buf);
+                snprintf(buf, BUFFER_SIZE,"frames:%lu lost:%lu\n",
+                         (unsigned long)tm.frames_sent, (unsigned long)tm.frames_dropped);
+                usb_serial_print(buf);
+            }
         }
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        vTaskDelay(pdMS_TO_TICKS(sample_period_ms));
     }
 
 }
 
+// ---- Commands received on CDC1 ----
+static void cmd_reply(const char *text, void *ctx) {
+    (void)ctx;
+    usb_serial_print(text);     // replies go to the debug port, CDC1 stays binary
+}
+
+static int cmd_stream(int argc, char **argv, void *ctx) {
+    (void)ctx;
+    if (argc != 2) return COMMAND_USAGE;
+    if (strcmp(argv[1], "on") == 0)       streaming = true;
+    else if (strcmp(argv[1], "off") == 0) streaming = false;
+    else return COMMAND_USAGE;
+    return COMMAND_OK;
+}
+
+static int cmd_rate(int argc, char **argv, void *ctx) {
+    (void)ctx;
+    if (argc != 2) return COMMAND_USAGE;
+    int ms = atoi(argv[1]);
+    if (ms < 1 || ms > 10000) return COMMAND_USAGE;
+    sample_period_ms = (uint32_t)ms;
+    return COMMAND_OK;
+}
+
+static const command_t commands[] = {
+    { "stream", cmd_stream, "stream on|off   start/stop telemetry" },
+    { "rate",   cmd_rate,   "rate <ms>       sample period (1-10000)" },
+};
+
+static void cmdTask(void *arg) {
+    (void)arg;
+    static command_parser_t parser;
+    command_parser_init(&parser, commands, sizeof(commands) / sizeof(commands[0]), NULL, NULL);
+    command_parser_set_output(&parser, cmd_reply);
+
+    char buf[64];
+    while (1) {
+        // Blocks until the USB task has moved a packet into the stream buffer
+        size_t n = usb_serial_rx_read(CDC_ITF_TX, buf, sizeof(buf), 1000);
+        command_parser_feed(&parser, buf, n);
+    }
+}
+
 // ---- Task running USB stack ----
 static void usbTask(void *arg) {
     (void)arg;
     while (1) {
-        tud_task();              // With FreeRTOS wait for events
-                                 // Do not add vTaskDelay. 
+        // With FreeRTOS wait for events, but wake up at least every
+        // USB_SERIAL_DRAIN_MS to move queued log text to CDC0.
+        // Do not add vTaskDelay.
+        tud_task_ext(USB_SERIAL_DRAIN_MS, false);
+        usb_serial_drain();
     }
 }
 
@@ -90,6 +157,7 @@ int main (void) {
     TaskHandle_t hUsb   = NULL;
     xTaskCreate(usbTask, "usb", 1024, NULL, 3, &hUsb);
     xTaskCreate(sensorTask, "app", 1024, NULL, 2, NULL);
+    xTaskCreate(cmdTask, "cmd", 1024, NULL, 2, NULL);
 
     #if (configNUMBER_OF_CORES > 1)
         vTaskCoreAffinitySet(hUsb, 1u << 0);
@@ -102,34 +170,16 @@ int main (void) {
     tusb_init();
     //Initialize helper library to write in CDC0)
     usb_serial_init();
+    //Commands are read from CDC1
+    usb_serial_rx_init(CDC_ITF_TX, RX_BUFFER_SIZE);
     vTaskStartScheduler();
 
 }
 
 // callback when data is received on a CDC interface
-void tud_cdc_rx_cb(uint8_t itf){   
-    // allocate buffer for the data in the stack
-    uint8_t buf[CFG_TUD_CDC_RX_BUFSIZE+1];
-
-    //printf("RX CDC %d\n", itf);
-
-    // read the available data 
-    // | IMPORTANT: also do this for CDC0 because otherwise
-    // | you won't be able to print anymore to CDC0
-    // | next time this function is called
-    uint32_t count = tud_cdc_n_read(itf, buf, sizeof(buf));
-
-    // check if the data was received on the second cdc interface
-    if (itf == 1) {
-        // process the received data
-        buf[count] = '\n'; 
-        buf[count+1] = 0;// null-terminate the string
-        // now echo data back to the console on CDC 0
-        usb_serial_print("\nReceived on CDC 1:");
-        usb_serial_print(buf);
-
-        // and echo back OK on CDC 1
-        tud_cdc_n_write(itf, (uint8_t const *) "OK\n", 3);
-        tud_cdc_n_write_flush(itf);
-        }
-}
\ No newline at end of file
+void tud_cdc_rx_cb(uint8_t itf){
+    // Whole packets go to the stream buffer of the interface (cmdTask
+    // reads CDC1). CDC0 has no buffer: its input is read and dropped,
+    // otherwise you won't be able to print anymore to CDC0.
+    usb_serial_rx_cb(itf);
+}
@@ -1,10 +1,8 @@
 #include <stdio.h>
-#include <string.h>
 #include <hardware/gpio.h>
 #include <pico/stdlib.h>
 #include <tkjhat/sdk.h>
 #include <pico/binary_info.h>
-#include <hardware/sync.h>
 
 static inline void _blink(int n){
     for (int i=0;i<n;i++){ 
@@ -19,16 +17,9 @@ static inline void _blink(int n){
     /*============================
     /   MICROPHONE CONFIGURATION
     /=============================*/
-    //Internal sample buffer for sound samples
-    int16_t sample_buffer[MEMS_BUFFER_SIZE];
-    int16_t temp_sample_buffer[MEMS_BUFFER_SIZE];//use to have two different buffers.
-    volatile int samples_read = 0;    
-
-    void on_sound_buffer_ready(){
-        // callback from library when all the samples in the library
-        // internal sample buffer are ready for reading 
-        samples_read = get_microphone_samples(sample_buffer, MEMS_BUFFER_SIZE);
-    }
+    // Samples are not copied out of the library: the main loop borrows each
+    // filtered block with acquire_microphone_samples(), sends it directly and
+    // gives it back with release_microphone_samples().
 
     int main() {
         stdio_init_all();
@@ -48,14 +39,13 @@ static inline void _blink(int n){
         }
         else 
             printf("Initializing the microphone");
-        pdm_microphone_set_callback(on_sound_buffer_ready);
         pdm_microphone_set_filter_max_volume(64); // keep default
         pdm_microphone_set_filter_gain(8);        // safer base gain than 16
         pdm_microphone_set_filter_volume(56);     // was 64 ⇒ lower hiss; raise if still too quiet
         //Each iteration are 5 seconds. 
         while(true){
             //We are going to send 5 seconds. Each sample is two bytes and sampling rate 8Khz. 
-            uint32_t target_bytes = MEMS_SAMPLING_FREQUENCY * 2u * 5u;
+            uint32_t target_bytes = get_microphone_sample_rate() * 2u * 5u;
             uint32_t sent_bytes = 0;
             _blink (5);
             if (is_mic_init >=0) {
@@ -74,29 +64,24 @@ static inline void _blink(int n){
                         set_red_led_status(false);
                         break;
                     }
-                    if (samples_read == 0){
+                    size_t sample_count;
+                    int16_t *block = acquire_microphone_samples(&sample_count);
+                    if (block == NULL){
                         tight_loop_contents(); // yields without sleeping long
                         continue;
                     } 
-                    //Collect samples in a temporary buffer.          
-                    uint32_t irq = save_and_disable_interrupts();
-                    // store and clear the samples read from the callback
-                    int sample_count = samples_read;  
-                    memcpy(temp_sample_buffer, sample_buffer, (size_t)sample_count * sizeof(sample_buffer[0]));
-                    samples_read = 0;// restart the samples read
-                    restore_interrupts(irq);
 
                     // loop through any new collected samples
                     // OPTION 1 using fwrite
-                    // First we create a temporary buffer, so i can send data even if I receive another irq. 
-                    int sample_sent = fwrite(temp_sample_buffer,sizeof(temp_sample_buffer[0]),sample_count,stdout);
-                    sent_bytes += sizeof(temp_sample_buffer[0]) * sample_sent;
+                    // The block stays ours until it is released, new samples go to the other blocks.
+                    int sample_sent = fwrite(block,sizeof(block[0]),sample_count,stdout);
+                    sent_bytes += sizeof(block[0]) * sample_sent;
                     
                     //stdio_flush();
 
                     //OPTION 2 using putchar
                     /*for (int i = 0; i < sample_count; i++) {
-                        int16_t s = temp_sample_buffer[i];
+                        int16_t s = block[i];
                         putchar_raw((int8_t)(s & 0xFF));       // LSB
                         ++sent_bytes;
                         putchar_raw((int8_t)(s >> 8));         // MSB
@@ -106,10 +91,12 @@ static inline void _blink(int n){
 
                     //OPTION 3: using printf. Only for showing in graph (e.g. in Arduino Uno plotter)
                     /*for (int i = 0; i < sample_count; i++) {
-                        printf("%d\n", temp_sample_buffer[i]);
-                        sent_bytes += sizeof(temp_sample_buffer[0]);
+                        printf("%d\n", block[i]);
+                        sent_bytes += sizeof(block[0]);
                     }
                     stdio_flush();*/
+
+                    release_microphone_samples(block);
                 }
                 set_red_led_status(false);
                 end_microphone_sampling();
@@ -0,0 +1,118 @@
+#include <stdio.h>
+
+#include <pico/stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <tusb.h>
+#include "usbSerialDebug/helper.h"
+#include "usbSerialDebug/usb_audio.h"
+#include <tkjhat/sdk.h>
+
+// The PDM microphone shows up on the host as a normal USB microphone
+// ("TKJHAT Microphone"), next to the two serial ports. Record it with any
+// program, e.g. Audacity or on Linux:
+//   arecord -D hw:TKJHAT -f S16_LE -c 1 -r 16000 test.wav
+// Statistics are printed to CDC0 once per second. The red LED is on while
+// the host is recording.
+
+#define STATS_PERIOD_MS     1000
+#define BUFFER_SIZE         80
+
+#if CFG_TUSB_OS != OPT_OS_FREERTOS
+#error "This should be using FREERTOS but the CFG_TUSB_OS is not OPT_OS_FREERTOS"
+#endif
+
+static TaskHandle_t hMicTask = NULL;
+
+// DMA interrupt: a new PCM block is ready
+static void on_sound_buffer_ready(void) {
+    BaseType_t woken = pdFALSE;
+    if (hMicTask != NULL) {
+        vTaskNotifyGiveFromISR(hMicTask, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+// ---- Task moving microphone blocks to the audio endpoint ----
+static void micTask(void *arg) {
+    (void)arg;
+    char buf[BUFFER_SIZE];
+    uint32_t sent = 0;
+    uint32_t last_stats = 0;
+
+    if (init_microphone_sampling() < 0) {
+        usb_serial_print("Cannot start sampling the microphone\n");
+        vTaskDelete(NULL);
+    }
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STATS_PERIOD_MS));
+
+        // Blocks go to USB as they are: no copy besides the endpoint FIFO
+        size_t count;
+        int16_t *block;
+        while ((block = acquire_microphone_samples(&count)) != NULL) {
+            sent += usb_audio_mic_write(block, count);
+            release_microphone_samples(block);
+        }
+        set_red_led_status(usb_audio_mic_streaming());
+
+        uint32_t now = to_ms_since_boot(get_absolute_time());
+        if (now - last_stats >= STATS_PERIOD_MS && usb_serial_connected()) {
+            snprintf(buf, BUFFER_SIZE, "streaming:%d samples:%lu usb_dropped:%lu mic_overruns:%lu\n",
+                     usb_audio_mic_streaming(), (unsigned long)sent,
+                     (unsigned long)usb_audio_mic_dropped(),
+                     (unsigned long)get_microphone_overruns());
+            usb_serial_print(buf);
+            last_stats = now;
+        }
+    }
+}
+
+// ---- Task running USB stack ----
+static void usbTask(void *arg) {
+    (void)arg;
+    while (1) {
+        // Isochronous packets are queued by TinyUSB itself, this only runs
+        // the control requests and drains the CDC0 log.
+        tud_task_ext(USB_SERIAL_DRAIN_MS, false);
+        usb_serial_drain();
+    }
+}
+
+int main(void) {
+    init_hat_sdk();
+    init_red_led();
+    set_red_led_status(false);
+
+    // 16 kHz: the full rate of the microphone, still only 32 bytes per USB frame
+    if (init_pdm_microphone() < 0 || set_microphone_profile(MIC_PROFILE_16K_DEC64) < 0) {
+        blink_red_led(10);
+    }
+    pdm_microphone_set_filter_gain(8);
+    pdm_microphone_set_callback(on_sound_buffer_ready);
+    // The host reads the rate while enumerating, so before tusb_init()
+    usb_audio_mic_init(get_microphone_sample_rate());
+
+    TaskHandle_t hUsb = NULL;
+    xTaskCreate(usbTask, "usb", 1024, NULL, 3, &hUsb);
+    xTaskCreate(micTask, "mic", 1024, NULL, 2, &hMicTask);
+
+    #if (configNUMBER_OF_CORES > 1)
+        vTaskCoreAffinitySet(hUsb, 1u << 0);
+    #endif
+
+    // VERY IMPORTANT, THIS SHOULD GO JUST BEFORE vTaskStartSheduler
+    // WITHOUT ANY DELAYS. OTHERWISE, THE TinyUSB stack wont recognize
+    // the device.
+    tusb_init();
+    usb_serial_init();
+    vTaskStartScheduler();
+}
+
+// Input of the serial ports is not used
+void tud_cdc_rx_cb(uint8_t itf) {
+    usb_serial_rx_cb(itf);
+}
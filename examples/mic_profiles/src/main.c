@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <pico/stdlib.h>
+#include <tkjhat/sdk.h>
+
+// Measures every microphone profile in turn and prints one CSV line per
+// profile: filter time per block, measured in acquire_microphone_samples()
+// where the consumer converts the block (the DMA interrupt only hands over
+// the raw PDM data), the resulting CPU load of the consuming task, and the
+// RAM used by the driver buffers.
+//
+// While measuring, the main loop only borrows and returns the blocks, so the
+// figures are the cost of the PDM -> PCM conversion alone.
+
+#define MEASURE_MS  3000
+
+static const char *profile_names[MIC_PROFILE_COUNT] = {
+    [MIC_PROFILE_8K_DEC64]   = "8k_dec64",
+    [MIC_PROFILE_16K_DEC64]  = "16k_dec64",
+    [MIC_PROFILE_16K_DEC128] = "16k_dec128",
+};
+
+static void measure_profile(mic_profile_t profile) {
+    if (set_microphone_profile(profile) < 0) {
+        printf("# %s: cannot select profile\n", profile_names[profile]);
+        return;
+    }
+    if (init_microphone_sampling() < 0) {
+        printf("# %s: cannot start sampling\n", profile_names[profile]);
+        return;
+    }
+
+    uint32_t blocks = 0;
+    absolute_time_t end = make_timeout_time_ms(MEASURE_MS);
+    while (!time_reached(end)) {
+        size_t count;
+        int16_t *block = acquire_microphone_samples(&count);
+        if (block == NULL) {
+            tight_loop_contents();
+            continue;
+        }
+        blocks++;
+        release_microphone_samples(block);
+    }
+
+    end_microphone_sampling();
+
+    struct pdm_microphone_stats st;
+    get_microphone_stats(&st);
+
+    // Consumer CPU load in 0.1 % units, from the average and the worst block
+    uint32_t cpu_avg = st.block_period_us ? st.filter_us_avg * 1000u / st.block_period_us : 0;
+    uint32_t cpu_max = st.block_period_us ? st.filter_us_max * 1000u / st.block_period_us : 0;
+
+    printf("%s,%u,%u,%u,%lu,%lu,%lu,%lu.%lu,%lu.%lu,%u,%lu,%lu\n",
+           profile_names[profile], st.sample_rate, st.decimation, st.sample_buffer_size,
+           (unsigned long)st.block_period_us,
+           (unsigned long)st.filter_us_avg, (unsigned long)st.filter_us_max,
+           (unsigned long)(cpu_avg / 10), (unsigned long)(cpu_avg % 10),
+           (unsigned long)(cpu_max / 10), (unsigned long)(cpu_max % 10),
+           st.buffer_bytes, (unsigned long)blocks, (unsigned long)st.overruns);
+}
+
+int main() {
+    stdio_init_all();
+    init_hat_sdk();
+
+    while (!stdio_usb_connected()) {
+        sleep_ms(100);
+    }
+
+    if (init_pdm_microphone() < 0) {
+        printf("PDM microphone initialization failed!\n");
+        return 0;
+    }
+
+    while (true) {
+        printf("profile,sample_rate,decimation,block_samples,block_us,filter_avg_us,filter_max_us,"
+               "cpu_avg_pct,cpu_max_pct,buffer_bytes,blocks,overruns\n");
+        for (int p = 0; p < MIC_PROFILE_COUNT; p++) {
+            measure_profile((mic_profile_t)p);
+        }
+        printf("\n");
+        sleep_ms(5000);
+    }
+    return 0;
+}
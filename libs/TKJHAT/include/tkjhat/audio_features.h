@@ -0,0 +1,104 @@
+/**
+ * @file audio_features.h
+ * @brief Compact per-block features of the microphone PCM stream.
+ *
+ * Turns blocks of int16 PCM (e.g. from ::acquire_microphone_samples()) into a
+ * handful of numbers that are enough for level metering and simple voice or
+ * tone detection: RMS, peak, zero-crossing rate and the RMS level in a few
+ * frequency bands. Sending these instead of raw PCM cuts the USB bandwidth
+ * from 16 KB/s (8 kHz) to a few hundred bytes per second.
+ *
+ * All per-sample work is integer. Bands are separated with second-order
+ * low-pass, band-pass and high-pass sections whose Q14 coefficients are
+ * computed once in ::audio_features_init(). Features can be taken per block or accumulated
+ * over several blocks before calling ::audio_features_finish().
+ *
+ * The module does not depend on the Pico SDK.
+ */
+
+#ifndef TKJHAT_AUDIO_FEATURES_H
+#define TKJHAT_AUDIO_FEATURES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Number of frequency bands (band edges = bands - 1). */
+#define AUDIO_FEATURE_BANDS     4
+
+/** Default band edges in Hz: <300, 300-1000, 1000-2500, >2500. */
+#define AUDIO_FEATURE_EDGE0_HZ  300
+#define AUDIO_FEATURE_EDGE1_HZ  1000
+#define AUDIO_FEATURE_EDGE2_HZ  2500
+
+/**
+ * @brief Features of one accumulation period.
+ */
+typedef struct {
+    uint32_t samples;                       ///< Samples accumulated.
+    uint16_t rms;                           ///< RMS of the signal (PCM units).
+    uint16_t peak;                          ///< Largest absolute sample.
+    uint16_t zcr_hz;                        ///< Zero crossings per second / 2 (≈ dominant frequency for a tone).
+    uint16_t band_rms[AUDIO_FEATURE_BANDS]; ///< RMS per band, lowest band first.
+} audio_features_t;
+
+/**
+ * @brief Second-order section, Q14 coefficients. Part of the state below.
+ */
+typedef struct {
+    int32_t b0, b1, b2, a1, a2;
+    int32_t x1, x2, y1, y2;
+} audio_features_biquad_t;
+
+/**
+ * @brief Filter and accumulator state. Treat as opaque.
+ */
+typedef struct {
+    uint32_t sample_rate;
+    audio_features_biquad_t band[AUDIO_FEATURE_BANDS];
+    int16_t last_sample;
+
+    uint32_t count;
+    uint64_t sum_sq;
+    uint64_t band_sum_sq[AUDIO_FEATURE_BANDS];
+    uint32_t crossings;
+    uint16_t peak;
+} audio_features_state_t;
+
+/**
+ * @brief Initialize the feature extractor.
+ *
+ * @param st          State to initialize.
+ * @param sample_rate PCM sample rate in Hz.
+ * @param edges_hz    AUDIO_FEATURE_BANDS - 1 ascending band edges in Hz, or
+ *                    NULL for the defaults (300, 1000, 2500 Hz).
+ */
+void audio_features_init(audio_features_state_t *st, uint32_t sample_rate, const uint16_t *edges_hz);
+
+/**
+ * @brief Accumulate one block of samples.
+ *
+ * Filters keep their state across calls, so blocks may have any length.
+ */
+void audio_features_update(audio_features_state_t *st, const int16_t *samples, size_t count);
+
+/**
+ * @brief Produce the features of everything accumulated since the last call
+ *        and start a new accumulation period.
+ */
+void audio_features_finish(audio_features_state_t *st, audio_features_t *out);
+
+/**
+ * @brief Convenience: features of a single block (update + finish).
+ */
+void audio_features_block(audio_features_state_t *st, const int16_t *samples, size_t count,
+                          audio_features_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
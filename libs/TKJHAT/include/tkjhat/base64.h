@@ -0,0 +1,38 @@
+/**
+ * @file base64.h
+ * @brief Standard base64 (RFC 4648, '+' '/' and '=' padding) for the text
+ *        lines of the binary logs: DLOG, sensor and event traces.
+ *
+ * Plain C with no HAL or SDK dependency, so the host tools build
+ * src/base64.c on its own.
+ */
+
+#ifndef TKJHAT_BASE64_H
+#define TKJHAT_BASE64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Characters ::base64_encode() writes for @p n bytes. */
+#define BASE64_ENCODED_LEN(n)   (((n) + 2) / 3 * 4)
+
+/** @brief Encode @p n bytes; writes ::BASE64_ENCODED_LEN(n) characters, no terminator. */
+size_t base64_encode(const uint8_t *in, size_t n, char *out);
+
+/**
+ * @brief Decode until the first character outside the alphabet (e.g. the
+ *        line end) or the padding.
+ * @return Bytes written (at most @p max), or -1 on a malformed group or if
+ *         @p max is too small.
+ */
+int base64_decode(const char *in, uint8_t *out, size_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
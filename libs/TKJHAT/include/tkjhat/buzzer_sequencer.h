@@ -0,0 +1,98 @@
+/**
+ * @file buzzer_sequencer.h
+ * @brief Timer-driven note queue for the buzzer.
+ *
+ * Callers enqueue notes (frequency, duration, gap) or a whole Morse string
+ * and return immediately; a hardware alarm steps through the queue with
+ * microsecond timing. Each enqueue has a priority: a higher-priority request
+ * cuts the current sound and drops queued lower-priority notes, while a
+ * lower-priority request is refused while something more important plays.
+ * Requests of equal priority are appended.
+ *
+ * The sequencer drives the buzzer through ::buzzer_start_tone() and
+ * ::buzzer_turn_off(); do not mix it with ::buzzer_play_tone_async() while
+ * a sequence is playing. ::init_buzzer() also initializes the sequencer.
+ */
+
+#ifndef TKJHAT_BUZZER_SEQUENCER_H
+#define TKJHAT_BUZZER_SEQUENCER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Queue capacity in notes. Can be overridden at compile time. */
+#ifndef BUZZER_SEQ_QUEUE_LEN
+#define BUZZER_SEQ_QUEUE_LEN    64
+#endif
+
+/**
+ * @brief One step of a sequence.
+ *
+ * The tone sounds for @c duration_us, then the buzzer is silent for
+ * @c gap_us before the next note. A frequency of 0 is a rest.
+ */
+typedef struct {
+    uint16_t frequency;     ///< Hz, 0 = rest
+    uint32_t duration_us;   ///< Tone length
+    uint32_t gap_us;        ///< Silence after the tone
+} buzzer_note_t;
+
+/**
+ * @brief Request priorities, lowest first.
+ */
+typedef enum {
+    BUZZER_PRIO_FEEDBACK = 0,   ///< Key clicks and gesture feedback
+    BUZZER_PRIO_NORMAL,         ///< Notifications, Morse playback
+    BUZZER_PRIO_ALERT           ///< Must be heard, preempts everything
+} buzzer_priority_t;
+
+/**
+ * @brief Initialize the sequencer lock. Called by ::init_buzzer().
+ */
+void buzzer_seq_init(void);
+
+/**
+ * @brief Queue a sequence of notes.
+ *
+ * All notes are queued or none.
+ *
+ * @return true if queued, false if the queue is full or a higher-priority
+ *         sequence is playing.
+ */
+bool buzzer_seq_play(const buzzer_note_t *notes, size_t count, buzzer_priority_t prio);
+
+/**
+ * @brief Queue a single tone.
+ */
+bool buzzer_seq_tone(uint16_t frequency, uint32_t duration_ms, uint32_t gap_ms, buzzer_priority_t prio);
+
+/**
+ * @brief Queue a Morse string ('.', '-', ' ' between letters, '/' between words).
+ *
+ * Timing follows the PARIS standard: dot = 1200 / @p wpm ms, dash = 3 dots,
+ * 1 dot between symbols, 3 between letters and 7 between words.
+ *
+ * @return true if the whole string was queued.
+ */
+bool buzzer_seq_play_morse(const char *morse, uint16_t frequency, uint32_t wpm, buzzer_priority_t prio);
+
+/**
+ * @brief Stop playback and clear the queue.
+ */
+void buzzer_seq_stop(void);
+
+/**
+ * @brief Whether a sequence is playing or queued.
+ */
+bool buzzer_seq_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,112 @@
+/**
+ * @file command.h
+ * @brief Line-based command parser for serial input.
+ *
+ * Bytes are fed in whatever chunks the transport delivers (a USB packet,
+ * a stream buffer read...). Each complete line is split into words in
+ * place, without copying, and the first word is looked up in a command
+ * table. Lines that do not start with a known command go to a fallback
+ * handler, e.g. to treat them as message data.
+ *
+ * The parser does not depend on the Pico SDK or FreeRTOS; the caller owns
+ * the transport and the task that runs it.
+ *
+ * @code
+ * static int cmd_wpm(int argc, char **argv, void *ctx) {
+ *     if (argc != 2) return COMMAND_USAGE;
+ *     set_wpm(atoi(argv[1]));
+ *     return COMMAND_OK;
+ * }
+ * static const command_t commands[] = {
+ *     { "wpm", cmd_wpm, "wpm <n>  set receiver speed" },
+ * };
+ * command_parser_init(&parser, commands, 1, NULL, NULL);
+ * // in the RX task:
+ * command_parser_feed(&parser, buf, n);
+ * @endcode
+ */
+
+#ifndef TKJHAT_COMMAND_H
+#define TKJHAT_COMMAND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest line; longer input is delivered in pieces of this size. */
+#ifndef COMMAND_LINE_MAX
+#define COMMAND_LINE_MAX    256
+#endif
+
+/** Most words in one command line (command name included). */
+#define COMMAND_MAX_ARGS    8
+
+/** Handler results. Any other negative value is reported as an error. */
+#define COMMAND_OK          0
+#define COMMAND_ERROR       (-1)
+#define COMMAND_USAGE       (-2)    ///< wrong arguments, help text is shown
+#define COMMAND_NOT_FOUND   (-3)
+
+/** Handler for one command. argv[0] is the command name; argv is writable. */
+typedef int (*command_handler_t)(int argc, char **argv, void *ctx);
+
+/** Called with lines that are not commands (the whole line, writable). */
+typedef void (*command_fallback_t)(char *line, void *ctx);
+
+/** Called with text replies (results, errors, help). */
+typedef void (*command_output_t)(const char *text, void *ctx);
+
+/** Command table entry. */
+typedef struct {
+    const char *name;
+    command_handler_t handler;
+    const char *help;           ///< one line, shown by "help" and on COMMAND_USAGE
+} command_t;
+
+typedef struct {
+    const command_t *table;
+    size_t count;
+    command_fallback_t fallback;
+    command_output_t output;
+    void *ctx;                  ///< passed to handlers, fallback and output
+
+    char line[COMMAND_LINE_MAX];
+    size_t len;
+} command_parser_t;
+
+/**
+ * @brief Prepare a parser. A "help" command listing the table is built in
+ *        unless the table has its own.
+ *
+ * @param fallback Lines without a known command, or NULL to reply with an error.
+ */
+void command_parser_init(command_parser_t *p, const command_t *table, size_t count,
+                         command_fallback_t fallback, void *ctx);
+
+/** Where replies go (default: nowhere). */
+void command_parser_set_output(command_parser_t *p, command_output_t output);
+
+/**
+ * @brief Feed received bytes. Runs a command (or the fallback) for every
+ *        line completed by this chunk. CR and CRLF line ends are accepted.
+ */
+void command_parser_feed(command_parser_t *p, const char *data, size_t n);
+
+/**
+ * @brief Run one line directly. The line is modified (split into words).
+ *
+ * @return The handler result, or ::COMMAND_NOT_FOUND if the fallback got it.
+ */
+int command_execute(command_parser_t *p, char *line);
+
+/** Split @p line into words in place. Returns the number of words (max @p max). */
+int command_tokenize(char *line, char **argv, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+/**
+ * @file dlog.h
+ * @brief Deferred logging: printf-style calls that are formatted on the host.
+ *
+ * `DLOG(fmt, ...)` takes the same arguments as printf, but with
+ * ::DLOG_DEFERRED enabled it does not format anything on the device. It
+ * records the address of the format string, a timestamp and the raw
+ * argument values (a few word copies) into a RAM buffer, which works from
+ * tasks on both cores and from ISRs. ::dlog_drain() later writes each
+ * record to stdout as one short text line:
+ *
+ *   0x1E 'D' base64(record) '\n'
+ *
+ * The host tool tools/dlog_format reads the serial port, looks the format
+ * strings up in the firmware ELF and prints the text printf would have
+ * printed. All other output passes through unchanged, so DLOG can be mixed
+ * with normal printf.
+ *
+ * Arguments: integers up to 32 bits, @c float / @c double (sent as float),
+ * strings (`%s`, up to ::DLOG_MAX_STR characters are copied) and pointers.
+ * At most 8 arguments. Use `%d`-family conversions without @c ll and no
+ * `*` width or precision.
+ *
+ * With ::DLOG_DEFERRED set to 0 (default), DLOG is plain printf.
+ */
+
+#ifndef TKJHAT_DLOG_H
+#define TKJHAT_DLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** 1 = record and format on the host, 0 = DLOG() is printf(). Set per target. */
+#ifndef DLOG_DEFERRED
+#define DLOG_DEFERRED       0
+#endif
+
+/** Size of the record buffer in bytes (power of two). */
+#ifndef DLOG_BUFFER_SIZE
+#define DLOG_BUFFER_SIZE    2048
+#endif
+
+/** Longest record: header + arguments + copied strings. */
+#define DLOG_MAX_RECORD     72
+
+/** Longest string copied for a `%s` argument. */
+#define DLOG_MAX_STR        32
+
+/** First bytes of a deferred log line on the wire. */
+#define DLOG_LINE_MARK      "\x1e" "D"
+
+/**
+ * @brief Write buffered records to stdout (one line each).
+ *
+ * Call periodically from a low-priority task. Also reports records that
+ * were dropped because the buffer was full.
+ *
+ * @return Number of records written.
+ */
+unsigned dlog_drain(void);
+
+/** Records dropped because the buffer was full. */
+uint32_t dlog_dropped(void);
+
+/* ---- implementation of the DLOG macro ---- */
+
+typedef struct {
+    uint8_t buf[DLOG_MAX_RECORD];
+    size_t len;
+} dlog_writer_t;
+
+void dlog_begin(dlog_writer_t *w, const char *fmt);
+void dlog_put_i(dlog_writer_t *w, int32_t v);
+void dlog_put_f(dlog_writer_t *w, double v);
+void dlog_put_s(dlog_writer_t *w, const char *s);
+void dlog_put_p(dlog_writer_t *w, const void *p);
+void dlog_commit(dlog_writer_t *w);
+
+#define DLOG_PUT(w, x) _Generic((x),                \
+        float: dlog_put_f, double: dlog_put_f,      \
+        char *: dlog_put_s, const char *: dlog_put_s, \
+        void *: dlog_put_p, const void *: dlog_put_p, \
+        default: dlog_put_i)(w, x)
+
+#define DLOG_CAT_(a, b)     a##b
+#define DLOG_CAT(a, b)      DLOG_CAT_(a, b)
+#define DLOG_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, N, ...) N
+#define DLOG_NARGS(...)     DLOG_NARGS_(__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+#define DLOG_1(w, fmt)      dlog_begin(w, fmt);
+#define DLOG_2(w, fmt, a1) \
+        DLOG_1(w, fmt) DLOG_PUT(w, a1);
+#define DLOG_3(w, fmt, a1, a2) \
+        DLOG_2(w, fmt, a1) DLOG_PUT(w, a2);
+#define DLOG_4(w, fmt, a1, a2, a3) \
+        DLOG_3(w, fmt, a1, a2) DLOG_PUT(w, a3);
+#define DLOG_5(w, fmt, a1, a2, a3, a4) \
+        DLOG_4(w, fmt, a1, a2, a3) DLOG_PUT(w, a4);
+#define DLOG_6(w, fmt, a1, a2, a3, a4, a5) \
+        DLOG_5(w, fmt, a1, a2, a3, a4) DLOG_PUT(w, a5);
+#define DLOG_7(w, fmt, a1, a2, a3, a4, a5, a6) \
+        DLOG_6(w, fmt, a1, a2, a3, a4, a5) DLOG_PUT(w, a6);
+#define DLOG_8(w, fmt, a1, a2, a3, a4, a5, a6, a7) \
+        DLOG_7(w, fmt, a1, a2, a3, a4, a5, a6) DLOG_PUT(w, a7);
+#define DLOG_9(w, fmt, a1, a2, a3, a4, a5, a6, a7, a8) \
+        DLOG_8(w, fmt, a1, a2, a3, a4, a5, a6, a7) DLOG_PUT(w, a8);
+
+#if DLOG_DEFERRED
+#define DLOG(...) do {                                                  \
+        dlog_writer_t dlog_w_;                                          \
+        DLOG_CAT(DLOG_, DLOG_NARGS(__VA_ARGS__))(&dlog_w_, __VA_ARGS__) \
+        dlog_commit(&dlog_w_);                                          \
+    } while (0)
+#else
+#define DLOG(...)   printf(__VA_ARGS__)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
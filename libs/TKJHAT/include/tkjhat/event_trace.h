@@ -0,0 +1,151 @@
+/**
+ * @file event_trace.h
+ * @brief Timeline of task switches, interrupts, queue operations and driver
+ *        spans, for viewing in Perfetto or chrome://tracing.
+ *
+ * With ::EVENT_TRACE set (cmake -DEVENT_TRACE=ON), FreeRTOS reports task
+ * switches, queue and notification operations through the trace hooks in
+ * config/event_trace_hooks.h, and the drivers mark their slow operations
+ * with ::EVENT_TRACE_BEGIN / ::EVENT_TRACE_END (I2C transfers, display
+ * flush, PDM filter block) and their interrupt handlers with
+ * ::EVENT_TRACE_ISR_ENTER / ::EVENT_TRACE_ISR_EXIT. Without it the macros
+ * are empty and the kernel has no hooks.
+ *
+ * Each core writes into its own ring of ::EVENT_TRACE_EVENTS events, so the
+ * cores never wait for each other; on the core itself interrupts are held
+ * off for the few instructions that fill one slot. The newest events are
+ * kept. Stop the recording before dumping it:
+ *
+ *   event_trace_start();
+ *   ...
+ *   event_trace_stop();
+ *   event_trace_dump(sink, ctx);     // 0x1E 'E' base64(chunk) lines
+ *
+ * tools/event_trace turns the dump into a Chrome trace JSON file: one track
+ * per core with the running task and the interrupts, one track per task
+ * with its driver spans and queue operations.
+ */
+
+#ifndef TKJHAT_EVENT_TRACE_H
+#define TKJHAT_EVENT_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** 1 = record events (kernel hooks and driver marks), 0 = no-ops. */
+#ifndef EVENT_TRACE
+#define EVENT_TRACE             0
+#endif
+
+/** Events kept per core (power of two), 12 bytes each. */
+#ifndef EVENT_TRACE_EVENTS
+#define EVENT_TRACE_EVENTS      512
+#endif
+
+#define EVENT_TRACE_CORES       2
+#define EVENT_TRACE_VERSION     1
+
+/** Task, queue and span names kept for the dump. */
+#define EVENT_TRACE_NAMES       32
+
+/** Longest name kept, with the terminator (configMAX_TASK_NAME_LEN by default). */
+#ifndef EVENT_TRACE_NAME_LEN
+#define EVENT_TRACE_NAME_LEN    16
+#endif
+
+/** First bytes of a dump line on the wire. */
+#define EVENT_TRACE_LINE_MARK   "\x1e" "E"
+
+typedef enum {
+    EVENT_TRACE_EV_TASK_IN = 1,     ///< id = task (TCB) now running on this core
+    EVENT_TRACE_EV_ISR_ENTER,       ///< arg = IRQ number
+    EVENT_TRACE_EV_ISR_EXIT,        ///< arg = IRQ number
+    EVENT_TRACE_EV_QUEUE_SEND,      ///< id = queue, arg = messages waiting before
+    EVENT_TRACE_EV_QUEUE_RECEIVE,   ///< id = queue, arg = messages waiting before
+    EVENT_TRACE_EV_QUEUE_BLOCK,     ///< id = queue, arg = 0 receive, 1 send
+    EVENT_TRACE_EV_NOTIFY,          ///< id = task notified
+    EVENT_TRACE_EV_SPAN_BEGIN,      ///< arg = span
+    EVENT_TRACE_EV_SPAN_END,        ///< arg = span
+} event_trace_type_t;
+
+/** Driver spans; applications number their own from ::EVENT_TRACE_SPAN_USER. */
+typedef enum {
+    EVENT_TRACE_SPAN_I2C_WRITE = 0,
+    EVENT_TRACE_SPAN_I2C_READ,
+    EVENT_TRACE_SPAN_DISPLAY,       ///< ssd1306_show()
+    EVENT_TRACE_SPAN_FILTER,        ///< one PDM block through the filter
+    EVENT_TRACE_SPAN_USER = 16
+} event_trace_span_t;
+
+/** Categories of ::event_trace_name(). */
+typedef enum {
+    EVENT_TRACE_NAME_TASK = 0,
+    EVENT_TRACE_NAME_QUEUE,
+    EVENT_TRACE_NAME_SPAN,
+    EVENT_TRACE_NAME_IRQ
+} event_trace_name_t;
+
+/** One event as stored and dumped (little-endian). */
+typedef struct {
+    uint32_t t_us;                  ///< low 32 bits of the 1 MHz timer
+    uint8_t type;                   ///< event_trace_type_t
+    uint8_t reserved;
+    uint16_t arg;
+    uint32_t id;
+} event_trace_event_t;
+
+/** Receives one dump line (no newline). */
+typedef void (*event_trace_sink_t)(const char *line, void *ctx);
+
+/** @brief Clear the buffers and start recording. */
+void event_trace_start(void);
+
+/** @brief Stop recording; the events stay for ::event_trace_dump(). */
+void event_trace_stop(void);
+
+bool event_trace_running(void);
+
+/**
+ * @brief Pass the recording to @p sink: a header, the names, then the
+ *        events of each core, oldest first. Call after ::event_trace_stop().
+ * @return Number of lines passed.
+ */
+unsigned event_trace_dump(event_trace_sink_t sink, void *ctx);
+
+/**
+ * @brief Name an id for the dump (task, queue, span or IRQ). The name is
+ *        copied (up to ::EVENT_TRACE_NAME_LEN - 1 characters); naming an id
+ *        again replaces the name.
+ */
+void event_trace_name(event_trace_name_t category, uint32_t id, const char *name);
+
+/**
+ * @brief The object behind @p id was deleted. Its name stays for the events
+ *        already recorded until the slot is needed for a new name.
+ */
+void event_trace_forget(event_trace_name_t category, uint32_t id);
+
+/** @brief Record one event on the calling core (any context). */
+void event_trace_emit(event_trace_type_t type, uint16_t arg, uint32_t id);
+
+#if EVENT_TRACE
+#define EVENT_TRACE_BEGIN(span)     event_trace_emit(EVENT_TRACE_EV_SPAN_BEGIN, (span), 0)
+#define EVENT_TRACE_END(span)       event_trace_emit(EVENT_TRACE_EV_SPAN_END, (span), 0)
+#define EVENT_TRACE_ISR_ENTER(irq)  event_trace_emit(EVENT_TRACE_EV_ISR_ENTER, (irq), 0)
+#define EVENT_TRACE_ISR_EXIT(irq)   event_trace_emit(EVENT_TRACE_EV_ISR_EXIT, (irq), 0)
+#else
+#define EVENT_TRACE_BEGIN(span)     ((void)0)
+#define EVENT_TRACE_END(span)       ((void)0)
+#define EVENT_TRACE_ISR_ENTER(irq)  ((void)0)
+#define EVENT_TRACE_ISR_EXIT(irq)   ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
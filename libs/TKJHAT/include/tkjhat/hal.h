@@ -0,0 +1,205 @@
+/**
+ * @file hal.h
+ * @brief Hardware abstraction layer of the TKJHAT drivers.
+ *
+ * The drivers (sdk.c, ssd1306.c, buzzer_sequencer.c, led_effects.c) reach
+ * the hardware only through these functions: the HAT's I2C bus, GPIO, PWM,
+ * time and alarms, and short critical sections. Two back ends implement
+ * them and exactly one is linked:
+ *
+ *   - src/hal_pico.c: the Pico SDK (the normal build).
+ *   - src/hal_mock.c: a host mock with a virtual clock, scriptable I2C
+ *     devices and a transfer log (see hal_mock.h). Selected with
+ *     TKJHAT_HAL_MOCK=1, e.g. by building libs/TKJHAT with the host compiler.
+ *
+ * Both count the transactions (::hal_stats_t), so the cost of a driver
+ * operation in bus transfers, bytes and sleeps can be measured on the board
+ * and off-target alike.
+ *
+ * PWM functions take a pin; pins that share a PWM slice share its divider,
+ * TOP and polarity. The PDM microphone (PIO + DMA) is not behind the HAL:
+ * its driver is inherently tied to those peripherals, and off-target builds
+ * replace the whole driver (the mock build leaves it out).
+ */
+
+#ifndef TKJHAT_HAL_H
+#define TKJHAT_HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef TKJHAT_HAL_MOCK
+#define TKJHAT_HAL_MOCK         0
+#endif
+
+#if TKJHAT_HAL_MOCK
+/* SDK types that appear in the public TKJHAT headers; opaque off-target */
+typedef unsigned int uint;
+typedef struct i2c_inst i2c_inst_t;
+typedef struct pio_hw pio_hw_t;
+typedef pio_hw_t *PIO;
+#define i2c_default             ((i2c_inst_t *)0)
+#define PICO_ERROR_GENERIC      (-1)
+#define PICO_ERROR_TIMEOUT      (-2)
+#else
+#include "pico/types.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* =========================
+ *  STATISTICS
+ * ========================= */
+
+/** Transactions since the last ::hal_stats_reset(). */
+typedef struct {
+    uint32_t i2c_writes;        ///< write transfers
+    uint32_t i2c_reads;         ///< read transfers
+    uint32_t i2c_bytes;         ///< bytes in both directions
+    uint32_t i2c_errors;        ///< transfers not acknowledged or timed out
+    uint32_t gpio_writes;
+    uint32_t gpio_reads;
+    uint32_t pwm_writes;        ///< level and period changes
+    uint32_t alarms;            ///< alarms and repeating timers started
+    uint64_t sleep_us;          ///< sleep time requested by the drivers
+} hal_stats_t;
+
+/** @brief Copy the counters. */
+void hal_stats_get(hal_stats_t *out);
+
+/** @brief Zero the counters. */
+void hal_stats_reset(void);
+
+/** @brief Counters of @p after minus @p before, e.g. around one driver call. */
+void hal_stats_diff(const hal_stats_t *before, const hal_stats_t *after, hal_stats_t *out);
+
+/* =========================
+ *  I2C BUS (i2c_default)
+ * ========================= */
+
+/** @brief Initialize the bus and its pins (pull-ups on). */
+void hal_i2c_init(uint32_t baudrate, uint sda_pin, uint scl_pin);
+
+/**
+ * @brief Write @p len bytes to the device at @p addr.
+ * @param nostop true keeps the bus for a following read (repeated start).
+ * @return Bytes written, or a negative PICO_ERROR_* code.
+ */
+int hal_i2c_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+
+/** @brief Read @p len bytes; returns bytes read or a negative code. */
+int hal_i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+/* =========================
+ *  GPIO
+ * ========================= */
+
+typedef enum {
+    HAL_GPIO_INPUT = 0,     ///< software controlled input
+    HAL_GPIO_OUTPUT,        ///< software controlled output, initially low
+    HAL_GPIO_OFF            ///< released (no function)
+} hal_gpio_mode_t;
+
+void hal_gpio_mode(uint pin, hal_gpio_mode_t mode);
+void hal_gpio_pulls(uint pin, bool up, bool down);
+void hal_gpio_put(uint pin, bool value);
+bool hal_gpio_get(uint pin);
+
+/* =========================
+ *  PWM
+ * ========================= */
+
+/** @brief Input clock of the PWM counters in Hz. */
+uint32_t hal_pwm_clock_hz(void);
+
+/**
+ * @brief Route @p pin to its PWM slice and configure the slice.
+ * @param div16  clock divider in 8.4 fixed point (16 = 1.0)
+ * @param top    counter wraps after TOP, period = TOP + 1 counts
+ * @param invert invert both outputs of the slice
+ * @param start  start the counter
+ */
+void hal_pwm_init(uint pin, uint32_t div16, uint16_t top, bool invert, bool start);
+
+/** @brief Change divider and TOP of the pin's slice (e.g. a new tone). */
+void hal_pwm_set_period(uint pin, uint32_t div16, uint16_t top);
+
+/** @brief Compare level of the pin's channel. */
+void hal_pwm_set_level(uint pin, uint16_t level);
+
+/** @brief Both channels of the pin's slice in one register write. */
+void hal_pwm_set_levels(uint pin, uint16_t level_a, uint16_t level_b);
+
+/** @brief Start or stop the slices of all pins in @p pin_mask at once. */
+void hal_pwm_enable(uint32_t pin_mask, bool enabled);
+
+bool hal_pwm_running(uint pin);
+uint16_t hal_pwm_counter(uint pin);
+
+/* =========================
+ *  TIME
+ * ========================= */
+
+/** @brief Microseconds since boot. */
+uint64_t hal_time_us(void);
+
+/** @brief Sleep; blocks only the calling task under FreeRTOS. */
+void hal_sleep_us(uint64_t us);
+void hal_sleep_ms(uint32_t ms);
+
+/** Alarm id: > 0 valid, 0 none, < 0 no free slot. */
+typedef int32_t hal_alarm_t;
+
+/**
+ * @brief Alarm callback, runs in interrupt context.
+ * @return 0 = done, < 0 = again that many us after the previous target
+ *         (a fixed grid, no drift), > 0 = again that many us from now.
+ *         Same as the Pico SDK's alarm_callback_t.
+ */
+typedef int64_t (*hal_alarm_cb_t)(hal_alarm_t id, void *user_data);
+
+hal_alarm_t hal_alarm_in_us(uint64_t us, hal_alarm_cb_t cb, void *user_data);
+bool hal_alarm_cancel(hal_alarm_t id);
+
+/** Repeating timer callback (interrupt context); return false to stop. */
+typedef bool (*hal_timer_cb_t)(void *user_data);
+
+/** Number of repeating timers that can run at the same time. */
+#define HAL_TIMERS      4
+
+/**
+ * @brief Call @p cb every @p period_us, measured between callback starts.
+ * @return Timer id (> 0) or -1 if all ::HAL_TIMERS are in use.
+ */
+int hal_timer_start_us(uint64_t period_us, hal_timer_cb_t cb, void *user_data);
+void hal_timer_stop(int id);
+
+/* =========================
+ *  CRITICAL SECTIONS
+ * ========================= */
+
+/** Short critical section: keeps out interrupts and the other core. */
+typedef struct {
+    uintptr_t impl[2];
+} hal_lock_t;
+
+void hal_lock_init(hal_lock_t *lock);
+bool hal_lock_ready(const hal_lock_t *lock);
+void hal_lock_enter(hal_lock_t *lock);
+void hal_lock_exit(hal_lock_t *lock);
+
+/** @brief Disable interrupts on this core; returns the state to restore. */
+uint32_t hal_irq_save(void);
+void hal_irq_restore(uint32_t state);
+
+/** @brief Core running the caller (always 0 on the mock). */
+uint hal_core_num(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @file hal_mock.h
+ * @brief Host back end of the HAL (src/hal_mock.c, TKJHAT_HAL_MOCK=1).
+ *
+ * Nothing runs in the background: time is virtual and only moves when the
+ * drivers sleep, transfer on the bus or the test calls
+ * ::hal_mock_advance_us(). Due alarms and repeating timers are called from
+ * there, in time order, so a run is repeatable to the microsecond.
+ *
+ * I2C devices are attached per address; a transfer to an address with no
+ * device is not acknowledged, like on the real bus. Every transfer takes
+ * its bus time at the configured baud rate (9 bit times per byte, address
+ * byte included) and is recorded in the transfer log.
+ */
+
+#ifndef TKJHAT_HAL_MOCK_H
+#define TKJHAT_HAL_MOCK_H
+
+#include "hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** System clock of the mock, the PWM input clock (Hz). */
+#define HAL_MOCK_CLK_HZ         125000000u
+
+/** Alarms pending at the same time. */
+#define HAL_MOCK_ALARMS         16
+
+/** Transfers kept in the log; older ones are overwritten. */
+#define HAL_MOCK_XFER_LOG       256
+
+/** Bytes of each transfer kept in the log. */
+#define HAL_MOCK_XFER_DATA      8
+
+/**
+ * @brief Back to power-on: time 0, devices detached, pins released, alarms
+ *        and timers cancelled, log and ::hal_stats_t counters zeroed.
+ */
+void hal_mock_reset(void);
+
+/** @brief Move time forward, running the alarms and timers that fall due. */
+void hal_mock_advance_us(uint64_t us);
+
+/* =========================
+ *  I2C DEVICES
+ * ========================= */
+
+/**
+ * @brief Device write: bytes from the driver.
+ * @return Bytes accepted; fewer than @p len (or negative) is a NACK.
+ */
+typedef int (*hal_mock_i2c_write_fn)(void *ctx, const uint8_t *src, size_t len, bool nostop);
+
+/** @brief Device read: fill @p dst; returns bytes read or negative. */
+typedef int (*hal_mock_i2c_read_fn)(void *ctx, uint8_t *dst, size_t len, bool nostop);
+
+/**
+ * @brief Attach a device at @p addr (7-bit). NULL functions acknowledge
+ *        writes and read zeros. Attaching over an address replaces it.
+ */
+void hal_mock_i2c_attach(uint8_t addr, hal_mock_i2c_write_fn write, hal_mock_i2c_read_fn read, void *ctx);
+
+/** @brief Remove the device at @p addr; its transfers are NACKed again. */
+void hal_mock_i2c_detach(uint8_t addr);
+
+/**
+ * Register file of a typical sensor: the first byte of a write selects the
+ * register, the rest are written from there; reads continue from the
+ * selected register. The pointer auto-increments and wraps at 256.
+ */
+typedef struct {
+    uint8_t regs[256];
+    uint8_t ptr;
+} hal_mock_regs_t;
+
+/** @brief Attach @p dev as a register-file device at @p addr. */
+void hal_mock_i2c_attach_regs(uint8_t addr, hal_mock_regs_t *dev);
+
+/** One bus transfer. */
+typedef struct {
+    uint64_t us;                            ///< start time
+    uint8_t addr;
+    bool read;
+    bool acked;
+    uint16_t len;                           ///< bytes requested
+    uint8_t data[HAL_MOCK_XFER_DATA];       ///< first bytes on the bus
+} hal_mock_xfer_t;
+
+/** @brief Transfers since the reset (also the ones no longer in the log). */
+size_t hal_mock_xfer_count(void);
+
+/**
+ * @brief Transfer number @p n (0 = first after the reset).
+ * @return false if @p n has not happened or was overwritten.
+ */
+bool hal_mock_xfer_get(size_t n, hal_mock_xfer_t *out);
+
+/* =========================
+ *  PINS
+ * ========================= */
+
+/** @brief Level seen by the driver on an input pin (e.g. a pressed button). */
+void hal_mock_gpio_input(uint pin, bool level);
+
+/** @brief Level the driver has written to @p pin. */
+bool hal_mock_gpio_output(uint pin);
+
+/** @brief Compare level of the pin's PWM channel as written (before the polarity). */
+uint16_t hal_mock_pwm_level(uint pin);
+
+/** @brief Output frequency of the pin's PWM slice; 0 if it is stopped. */
+uint32_t hal_mock_pwm_hz(uint pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
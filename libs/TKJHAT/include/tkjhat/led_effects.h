@@ -0,0 +1,117 @@
+/**
+ * @file led_effects.h
+ * @brief Non-blocking LED effects for the red LED and the RGB LED.
+ *
+ * Effects are started from a task (or anywhere else) and return at once. A
+ * repeating hardware timer updates the LEDs every ::LED_EFFECT_TICK_MS while
+ * an effect is running and stops itself when all effects have finished, so
+ * an idle engine costs nothing.
+ *
+ * Red LED effects drive GPIO 14 from its PWM slice; when the effect ends the
+ * pin is returned to a plain output, turned off, so ::set_red_led_status()
+ * and ::toggle_red_led() work as before. RGB effects use ::rgb_led_write(),
+ * call ::init_rgb_led() first.
+ *
+ * Levels are intensities: 0 = off, 255 = full brightness.
+ */
+
+#ifndef TKJHAT_LED_EFFECTS_H
+#define TKJHAT_LED_EFFECTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Update period of the effect engine in milliseconds. */
+#ifndef LED_EFFECT_TICK_MS
+#define LED_EFFECT_TICK_MS      10
+#endif
+
+/** Maximum number of colors in an RGB sequence. */
+#define LED_EFFECT_MAX_COLORS   8
+
+/** LEDs the engine can drive. */
+typedef enum {
+    LED_EFFECT_RED = 0,
+    LED_EFFECT_RGB,
+    LED_EFFECT_TARGETS
+} led_effect_target_t;
+
+/** An RGB color, 0-255 per channel. */
+typedef struct {
+    uint8_t r, g, b;
+} led_color_t;
+
+/**
+ * @brief Blink @p count times (0 = until stopped).
+ *
+ * For ::LED_EFFECT_RGB the LED blinks with the color of the last
+ * ::led_effect_rgb_set() / fade (white if none).
+ */
+void led_effect_blink(led_effect_target_t led, uint16_t on_ms, uint16_t off_ms, uint16_t count);
+
+/**
+ * @brief Play a bit pattern, most significant of @p bits first.
+ *
+ * Each bit lasts @p step_ms: 1 = on, 0 = off. E.g. a heartbeat is
+ * 0b1010000000 with 10 bits and 100 ms steps.
+ *
+ * @param repeat Number of times to play the pattern (0 = until stopped).
+ */
+void led_effect_pattern(led_effect_target_t led, uint32_t pattern, uint8_t bits,
+                        uint16_t step_ms, uint16_t repeat);
+
+/**
+ * @brief Fade the red LED from @p from to @p to over @p duration_ms.
+ */
+void led_effect_fade(uint8_t from, uint8_t to, uint32_t duration_ms);
+
+/**
+ * @brief Smoothly pulse an LED up and down.
+ *
+ * @param period_ms One full off-on-off cycle.
+ * @param count     Number of cycles (0 = until stopped).
+ */
+void led_effect_breathe(led_effect_target_t led, uint32_t period_ms, uint16_t count);
+
+/**
+ * @brief Set the RGB LED to a color at once (stops a running RGB effect).
+ */
+void led_effect_rgb_set(led_color_t color);
+
+/**
+ * @brief Fade the RGB LED from its current color to @p to.
+ */
+void led_effect_rgb_fade(led_color_t to, uint32_t duration_ms);
+
+/**
+ * @brief Step through a list of colors.
+ *
+ * @param colors  Up to ::LED_EFFECT_MAX_COLORS colors (copied).
+ * @param count   Number of colors.
+ * @param step_ms Time per color.
+ * @param fade    true: cross-fade between colors, false: hard switch.
+ * @param repeat  Number of passes through the list (0 = until stopped).
+ */
+void led_effect_rgb_sequence(const led_color_t *colors, size_t count, uint32_t step_ms,
+                             bool fade, uint16_t repeat);
+
+/**
+ * @brief Stop the effect on @p led and turn it off.
+ */
+void led_effect_stop(led_effect_target_t led);
+
+/**
+ * @brief Whether an effect is running on @p led.
+ */
+bool led_effect_busy(led_effect_target_t led);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
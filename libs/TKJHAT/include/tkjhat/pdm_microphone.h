@@ -11,7 +11,10 @@
 #ifndef _PICO_PDM_MICROPHONE_H_
 #define _PICO_PDM_MICROPHONE_H_
 
+#include "tkjhat/hal.h"
+#if !TKJHAT_HAL_MOCK
 #include "hardware/pio.h"
+#endif
 
 typedef void (*pdm_samples_ready_handler_t)(void);
 
@@ -22,6 +25,22 @@ struct pdm_microphone_config {
     uint pio_sm;
     uint sample_rate;
     uint sample_buffer_size;
+    uint decimation;            // 64 or 128, 0 selects 64
+};
+
+// Cost of the current profile. RAM counts the driver's raw and PCM buffers;
+// the filter tables are static and the same for every profile.
+struct pdm_microphone_stats {
+    uint sample_rate;
+    uint decimation;
+    uint sample_buffer_size;
+    uint buffer_bytes;
+    uint32_t block_period_us;
+    uint32_t filter_us_last;
+    uint32_t filter_us_max;
+    uint32_t filter_us_avg;
+    uint32_t filter_blocks;
+    uint32_t overruns;
 };
 
 int pdm_microphone_init(const struct pdm_microphone_config* config);
@@ -30,6 +49,13 @@ void pdm_microphone_deinit();
 int pdm_microphone_start();
 void pdm_microphone_stop();
 
+// Change sample rate, decimation and block size while stopped. Reallocates
+// the buffers and reprograms the PIO clock divider; the filter tables are
+// rebuilt on the next start. Returns -1 if running, on invalid values or
+// when the new buffers cannot be allocated; the previous profile then stays.
+int pdm_microphone_set_profile(uint sample_rate, uint decimation, uint sample_buffer_size);
+void pdm_microphone_get_stats(struct pdm_microphone_stats* stats);
+
 void pdm_microphone_set_samples_ready_handler(pdm_samples_ready_handler_t handler);
 void pdm_microphone_set_filter_max_volume(uint8_t max_volume);
 void pdm_microphone_set_filter_gain(uint8_t gain);
@@ -37,4 +63,14 @@ void pdm_microphone_set_filter_volume(uint16_t volume);
 
 int pdm_microphone_read(int16_t* buffer, size_t samples);
 
+// Zero-copy access to the driver's PCM block. acquire() filters the oldest
+// raw PDM block (the DMA handler only queues them) and lends the result to
+// the caller, who may process it in place until release(). One block can be
+// lent at a time; the DMA keeps filling the raw ring meanwhile and counts an
+// overrun when no raw slot is free. The filter runs in the caller's context,
+// so call acquire() from a task, not from the samples-ready handler.
+int16_t* pdm_microphone_acquire(size_t* samples);
+void pdm_microphone_release(int16_t* buffer);
+uint32_t pdm_microphone_get_overruns();
+
 #endif
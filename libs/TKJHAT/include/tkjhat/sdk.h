@@ -106,8 +106,11 @@ SOFTWARE.
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "hal.h"
+#if !TKJHAT_HAL_MOCK
 #include "pico/stdlib.h"
 #include <hardware/i2c.h>
+#endif
 
 #include "pdm_microphone.h"   // pdm_samples_ready_handler_t
 #include "pins.h"
@@ -142,12 +145,27 @@ SOFTWARE.
 
  #define SSD1306_I2C_ADDRESS                    0x3C
 
+ /* =========================
+ *  RGB LED
+ * ========================= */
+
+// PWM counter TOP and clock divider of the RGB slices. Override from the
+// build (target_compile_definitions) to trade resolution for frequency:
+// f = 125 MHz / (RGB_PWM_CLKDIV * (RGB_PWM_WRAP + 1)), 477 Hz by default.
+#ifndef RGB_PWM_WRAP
+#define RGB_PWM_WRAP                            65535
+#endif
+#ifndef RGB_PWM_CLKDIV
+#define RGB_PWM_CLKDIV                          4.0f
+#endif
+
  /* =========================
  *  MEMS MICROPHONE
  * ========================= */
 
 # define MEMS_SAMPLING_FREQUENCY                8000
 # define MEMS_BUFFER_SIZE                       256
+# define MEMS_DECIMATION                        64
 
 /* =========================
  *  ICM42670
@@ -208,6 +226,23 @@ SOFTWARE.
 #define ICM42670_GYRO_MODE_LN                   0x0C
 #define ICM42670_SENSOR_DATA_START_REG          0x09
 
+// Wake-on-motion (WOM). The thresholds are in MREG1, written through
+// BLK_SEL_W/MADDR_W/M_W. One threshold LSB is 1/256 g.
+#define ICM42670_WOM_CONFIG_REG                 0x27
+#define ICM42670_INT_SOURCE1_REG                0x2C
+#define ICM42670_INT_STATUS2_REG                0x3B
+#define ICM42670_BLK_SEL_W_REG                  0x79
+#define ICM42670_MADDR_W_REG                    0x7A
+#define ICM42670_M_W_REG                        0x7B
+#define ICM42670_MREG1_ACCEL_WOM_X_THR          0x4B
+#define ICM42670_MREG1_ACCEL_WOM_Y_THR          0x4C
+#define ICM42670_MREG1_ACCEL_WOM_Z_THR          0x4D
+#define ICM42670_WOM_XYZ_INT1_EN                0x07    // INT_SOURCE1 bits 2:0
+#define ICM42670_WOM_MODE_PREVIOUS              0x02    // compare to the previous sample
+#define ICM42670_WOM_EN                         0x01
+#define ICM42670_WOM_ODR_HZ                     50
+#define ICM42670_WOM_THRESHOLD_DEFAULT_MG       50
+
 /* =========================
  *  Public function prototypes
  * ========================= */
@@ -327,6 +362,8 @@ void set_red_led_status(bool status);
  *
  * Toggles the onboard LED on/off with a fixed delay (~120 ms) 
  * between transitions. Leaves the LED turned OFF at the end.
+ * Non-blocking: the blinking runs on the LED effect timer
+ * (see tkjhat/led_effects.h) and the call returns immediately.
  *
  * @param n Number of times to blink.
  */
@@ -337,6 +374,8 @@ void blink_led(int n);
  *
  * Toggles the red LED on/off with a fixed delay (~120 ms) 
  * between transitions. Leaves the LED turned OFF at the end.  
+ * Non-blocking: the blinking runs on the LED effect timer
+ * (see tkjhat/led_effects.h) and the call returns immediately.
  * On this board, the red LED is the same as the onboard LED.
  *
  * @param n Number of times to blink.
@@ -347,9 +386,11 @@ void blink_red_led(int n);
 /**
  * @brief Initialize the RGB LED (GPIO 18:R, 19:G, 20:B).
  *
- * Configures the RGB LED pins as PWM outputs and enables their
- * PWM slices. With the default 16-bit TOP (65535) and clkdiv = 4,
- * the PWM frequency is: 480 Hz.
+ * Configures the RGB LED pins as PWM outputs with ::RGB_PWM_WRAP and
+ * ::RGB_PWM_CLKDIV (default 16-bit TOP and clkdiv = 4, about 477 Hz).
+ * The outputs are inverted in hardware for the common-anode LED, and
+ * both slices (R/G share one, B uses the next) are started on the same
+ * clock cycle so their periods stay aligned. The LED starts off.
  *
  * @note After initialization, you can set colors using ::rgb_led_write().
  *       Call ::stop_rgb_led() to release the pins.
@@ -359,17 +400,29 @@ void init_rgb_led(void);
 /**
  * @brief Set the RGB LED color.
  *
- * Writes PWM duty cycles to the RGB LED channels to produce the
- * requested color. The LED is wired as common-anode, so inputs are
- * inverted internally (0 = full on, 255 = off). A simple gamma
- * correction is applied by squaring the 8-bit values.
+ * Maps each 8-bit intensity through a gamma table (built by the
+ * compiler for ::RGB_PWM_WRAP) and updates all three channels for the
+ * same PWM period, so a color change never shows a mix of old and new
+ * channels. Cheap enough to call from timer callbacks.
  *
- * @param r Red intensity   (0–255, 0 = full on, 255 = off)
- * @param g Green intensity (0–255, 0 = full on, 255 = off)
- * @param b Blue intensity  (0–255, 0 = full on, 255 = off)
+ * @param r Red intensity   (0–255, 0 = off, 255 = full on)
+ * @param g Green intensity (0–255, 0 = off, 255 = full on)
+ * @param b Blue intensity  (0–255, 0 = off, 255 = full on)
  */
 void rgb_led_write(uint8_t r, uint8_t g, uint8_t b);
 
+/**
+ * @brief Set the RGB LED channels with raw, linear PWM levels.
+ *
+ * Like ::rgb_led_write() without the gamma table, for callers that do
+ * their own color math at full resolution.
+ *
+ * @param r Red level   (0 = off, ::RGB_PWM_WRAP = full on)
+ * @param g Green level (0 = off, ::RGB_PWM_WRAP = full on)
+ * @param b Blue level  (0 = off, ::RGB_PWM_WRAP = full on)
+ */
+void rgb_led_write_levels(uint16_t r, uint16_t g, uint16_t b);
+
 /**
  * @brief Stop and release the RGB LED pins.
  *
@@ -387,30 +440,60 @@ void stop_rgb_led(void);
 /**
  * @brief Initialize the buzzer (GPIO 17).
  *
- * Configures the buzzer pin as a digital output.  
+ * Routes the buzzer pin to its hardware PWM slice (slice 0, channel B)
+ * and leaves it silent. Tones are generated by the PWM at 50 % duty, so
+ * the CPU is not involved while a tone plays.
  * After this call, the buzzer can be controlled with
- * ::buzzer_play_tone() or ::buzzer_turn_off().
+ * ::buzzer_play_tone(), ::buzzer_play_tone_async() or ::buzzer_turn_off().
  */
 void init_buzzer(void);
 
 /**
- * @brief Play a tone on the buzzer.
+ * @brief Play a tone on the buzzer and wait until it ends.
  *
- * Generates a square wave at the requested frequency for the
- * specified duration by toggling the buzzer pin.
+ * Starts the tone like ::buzzer_play_tone_async() and then sleeps for
+ * @p duration_ms. Inside a FreeRTOS task the sleep only blocks the calling
+ * task; the CPU is free for other work.
  *
  * @param frequency     Tone frequency in Hz.
  * @param duration_ms   Duration of the tone in milliseconds.
- *
- * @note This implementation is blocking: the CPU is kept busy
- *       toggling the pin for the entire duration.
  */
 void buzzer_play_tone(uint32_t frequency, uint32_t duration_ms);
 
+/**
+ * @brief Start a tone and return immediately.
+ *
+ * A hardware alarm stops the tone after @p duration_ms. Starting another
+ * tone replaces the current one.
+ *
+ * The PWM divider and wrap are chosen for the closest achievable frequency
+ * (error well below 0.1 % across the audible range).
+ *
+ * @param frequency     Tone frequency in Hz (0 = silence).
+ * @param duration_ms   Duration of the tone in milliseconds.
+ * @return The frequency actually produced, in Hz.
+ *
+ * @note Safe to call from tasks. The alarm callback runs in interrupt context.
+ */
+uint32_t buzzer_play_tone_async(uint32_t frequency, uint32_t duration_ms);
+
+/**
+ * @brief Start a tone that plays until ::buzzer_turn_off().
+ *
+ * @param frequency Tone frequency in Hz (0 = silence).
+ * @return The frequency actually produced, in Hz.
+ */
+uint32_t buzzer_start_tone(uint32_t frequency);
+
+/**
+ * @brief Whether a tone is currently playing.
+ */
+bool buzzer_is_playing(void);
+
 /**
  * @brief Turn the buzzer off.
  *
- * Drives the buzzer pin low, silencing any ongoing tone.
+ * Silences any ongoing tone and cancels its pending stop alarm.
  */
 void buzzer_turn_off(void);
 
@@ -443,7 +526,7 @@ void deinit_buzzer(void);
  * Default parameters:
  * - Data pin: GPIO 16
  * - Clock pin: GPIO 15
- * - Sample rate: 16 kHz
+ * - Sample rate: 8 kHz, decimation 64 (see ::set_microphone_profile())
  * - Buffer size: 256 samples
  *
  * @return 0 on success, negative value on error.
@@ -454,7 +537,7 @@ int init_pdm_microphone(void);
  * @brief Start microphone sampling.
  *
  * Begins continuous capture of PCM samples from the microphone
- * at 16 kHz with a buffer size of 256 samples.
+ * in the active profile (8 kHz by default) with a buffer size of 256 samples.
  *
  * @return 0 on success, negative value on error.
  */
@@ -487,10 +570,87 @@ void pdm_microphone_set_callback(pdm_samples_ready_handler_t handler);
  * @param samples Number of samples to read.
  * @return The number of samples actually read, or negative on error.
  *
- * @note This function is called inside the sample-ready callback. Otherwise, might not work. 
+ * @note Copies the oldest filtered block. Prefer ::acquire_microphone_samples()
+ *       when the samples can be processed in place.
  */
 int get_microphone_samples(int16_t *buffer, size_t samples);
 
+/**
+ * @brief Borrow the oldest filtered PCM block without copying it.
+ *
+ * The DMA interrupt only queues raw PDM blocks; this call runs the oldest one
+ * through the PDM filter and returns a pointer to the PCM result. The caller
+ * owns it (and may modify it in place) until ::release_microphone_samples().
+ * Only one block can be borrowed at a time. No interrupts are disabled.
+ *
+ * Call from a task: the filter runs in the caller's context, so calling this
+ * from the sample-ready callback would move it back into the interrupt.
+ *
+ * @param samples Receives the number of samples in the block (0 if none).
+ * @return Pointer to the block, or NULL if no block is ready or one is
+ *         already borrowed.
+ */
+int16_t *acquire_microphone_samples(size_t *samples);
+
+/**
+ * @brief Give a block from ::acquire_microphone_samples() back to the driver.
+ *
+ * @param buffer The pointer returned by ::acquire_microphone_samples().
+ */
+void release_microphone_samples(int16_t *buffer);
+
+/**
+ * @brief Number of blocks dropped because every PCM block was still in use.
+ *
+ * A growing value means the consumer holds blocks for longer than one
+ * buffer period.
+ *
+ * @return Dropped block count since ::init_pdm_microphone().
+ */
+uint32_t get_microphone_overruns(void);
+
+/**
+ * @brief Sample rate / decimation profiles for the PDM microphone.
+ *
+ * The PDM clock is sample rate × decimation. A higher clock and decimation
+ * give a cleaner signal but cost more filter time per sample and larger raw
+ * buffers. Every profile keeps ::MEMS_BUFFER_SIZE samples per block.
+ */
+typedef enum {
+    MIC_PROFILE_8K_DEC64 = 0,   ///< 8 kHz, 512 kHz PDM clock (default)
+    MIC_PROFILE_16K_DEC64,      ///< 16 kHz, 1.024 MHz PDM clock
+    MIC_PROFILE_16K_DEC128,     ///< 16 kHz, 2.048 MHz PDM clock
+    MIC_PROFILE_COUNT
+} mic_profile_t;
+
+/**
+ * @brief Switch the microphone to another sample rate / decimation profile.
+ *
+ * Reallocates the sample buffers, reprograms the PIO clock divider and
+ * rebuilds the filter tables on the next ::init_microphone_sampling().
+ * Must be called while sampling is stopped.
+ *
+ * @param profile One of ::mic_profile_t.
+ * @return 0 on success, negative if sampling is running or the profile is invalid.
+ */
+int set_microphone_profile(mic_profile_t profile);
+
+/**
+ * @brief Sample rate of the active microphone profile in Hz.
+ */
+uint32_t get_microphone_sample_rate(void);
+
+/**
+ * @brief CPU and RAM cost of the active microphone profile.
+ *
+ * Filter times are measured in ::acquire_microphone_samples() for every block
+ * since the profile was selected. CPU load is roughly
+ * @c filter_us_avg / @c block_period_us.
+ *
+ * @param stats Filled with the current figures.
+ */
+void get_microphone_stats(struct pdm_microphone_stats *stats);
+
 
 
 /**
@@ -901,8 +1061,12 @@ float hdc2021_read_humidity(void);
  *   (typically: ±250 dps @ 100 Hz)
  *
  * ### Modes
- * - This SDK supports **Low-Noise (LN) mode** (higher precision, higher power).
- * - Other modes (LP/ULP/hybrid) are not yet implemented in this SDK.
+ * - **Low-Noise (LN) mode** (higher precision, higher power), the default.
+ * - **Low-Power (LP) accelerometer with wake-on-motion**: gyroscope off, the
+ *   INT1 pin (@ref ICM42670_INT) pulses low when any axis changes more than
+ *   the threshold. See ::ICM42670_enable_wake_on_motion.
+ * - **Off**: ::ICM42670_power_down. Registers are kept, restart with
+ *   ::ICM42670_start_with_default_values.
  *
  * @see Datasheet: https://invensense.tdk.com/wp-content/uploads/2021/07/DS-000451-ICM-42670-P-v1.0.pdf
  * @{
@@ -950,6 +1114,52 @@ int ICM42670_startGyro(uint16_t odr_hz, uint16_t fsr_dps);
  */
 int ICM42670_enable_accel_gyro_ln_mode(void);
 
+/**
+ * @brief Accelerometer in low-power (LP) mode, gyroscope off.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_enable_ultra_low_power_mode(void);
+
+/**
+ * @brief Both accelerometer and gyroscope in low-power (LP) mode.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_enable_accel_gyro_lp_mode(void);
+
+/**
+ * @brief Switch to the low-power accelerometer and arm wake-on-motion.
+ *
+ * The accelerometer runs in LP mode at @ref ICM42670_WOM_ODR_HZ Hz with the
+ * gyroscope off. When the acceleration of any axis changes more than
+ * @p threshold_mg between two samples, INT1 (@ref ICM42670_INT) gives a
+ * short active-low pulse. Takes about 50 ms (datasheet sequence).
+ *
+ * @param threshold_mg Threshold in milli-g (4-996, e.g.
+ *                     @ref ICM42670_WOM_THRESHOLD_DEFAULT_MG).
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_enable_wake_on_motion(uint16_t threshold_mg);
+
+/**
+ * @brief Disarm wake-on-motion and clear a pending WOM interrupt.
+ *
+ * The accelerometer stays in LP mode; call
+ * ::ICM42670_start_with_default_values to return to LN mode.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_disable_wake_on_motion(void);
+
+/**
+ * @brief Turn both the accelerometer and the gyroscope off.
+ *
+ * @return 0 on success, negative value on error.
+ */
+int ICM42670_power_down(void);
+
 /**
  * @brief Start IMU with SDK default settings and enable LN mode.
  *
@@ -0,0 +1,184 @@
+/**
+ * @file sensor_trace.h
+ * @brief Recording and deterministic replay of the HAT's sensor input.
+ *
+ * While recording, the SDK read functions (ICM42670_read_sensor_data(),
+ * veml6030_read_light(), hdc2021_read_temperature(),
+ * hdc2021_read_humidity(), acquire_microphone_samples()) store the raw
+ * bytes they got from the device as timestamped records. Button edges come
+ * from the application's GPIO interrupt through ::sensor_trace_button().
+ *
+ * While replaying, the same functions take their raw bytes from a trace
+ * instead of the bus, in recorded order: the n-th IMU read gets the n-th IMU
+ * sample no matter how fast the application polls, so two builds see
+ * identical input. Microphone blocks still arrive at the microphone's own
+ * rate, with the recorded samples copied over them. A recorded button edge
+ * is delivered (from an alarm, i.e. interrupt context) to the handler set
+ * with ::sensor_trace_set_button_handler() once a replayed sensor record is
+ * at least as new as the edge, and all remaining edges once the sensor
+ * records have run out. A type whose records have run out reads its device
+ * again; the replay ends when every replayed type has run out.
+ *
+ * Two recording modes share one RAM buffer of ::SENSOR_TRACE_BUFFER_SIZE:
+ *   - ::SENSOR_TRACE_STREAM: ::sensor_trace_drain() sends the records as
+ *     they come; records that do not fit are dropped and counted.
+ *   - ::SENSOR_TRACE_RING: the newest records are kept, the oldest are
+ *     overwritten. Drain after ::sensor_trace_stop(); the records stay in
+ *     the buffer and can be replayed from there.
+ *
+ * Each record leaves as one text line, so it can share stdout with printf:
+ *
+ *   0x1E 'S' base64(record) '\n'
+ *
+ * tools/sensor_trace extracts the lines into a trace file (the records
+ * back to back), prints a file as text and sends one back to the device.
+ *
+ * Record format (little-endian):
+ * @verbatim
+ *   u8  type               sensor_trace_type_t
+ *   u16 len                payload bytes
+ *   u32 t_us               from the start of the recording
+ *   payload[len]
+ * @endverbatim
+ *
+ * Payloads are the bytes the devices sent: IMU 14 bytes from TEMP_DATA1
+ * (big-endian, converted with the FSR in use at replay), light 2 bytes,
+ * temperature and humidity 2 bytes each, microphone the PCM samples. A
+ * recording starts with a ::SENSOR_TRACE_INFO record.
+ */
+
+#ifndef TKJHAT_SENSOR_TRACE_H
+#define TKJHAT_SENSOR_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** RAM for records, bytes (power of two). Also holds a trace loaded for replay. */
+#ifndef SENSOR_TRACE_BUFFER_SIZE
+#define SENSOR_TRACE_BUFFER_SIZE    8192
+#endif
+
+#define SENSOR_TRACE_VERSION        1
+#define SENSOR_TRACE_HEADER_SIZE    7
+
+/** Largest payload: one microphone block of 256 samples. */
+#define SENSOR_TRACE_MAX_PAYLOAD    512
+
+/** First bytes of a record line on the wire. */
+#define SENSOR_TRACE_LINE_MARK      "\x1e" "S"
+
+typedef enum {
+    SENSOR_TRACE_INFO = 0,      ///< u8 version, u8 type mask of the recording
+    SENSOR_TRACE_IMU,           ///< 14 raw bytes: temp, accel xyz, gyro xyz
+    SENSOR_TRACE_LIGHT,         ///< VEML6030 ALS register, 2 bytes
+    SENSOR_TRACE_TEMP,          ///< HDC2021 temperature registers, 2 bytes
+    SENSOR_TRACE_HUMIDITY,      ///< HDC2021 humidity registers, 2 bytes
+    SENSOR_TRACE_BUTTON,        ///< u8 gpio, u8 reserved, u32 event mask
+    SENSOR_TRACE_MIC,           ///< int16 samples of one block
+    SENSOR_TRACE_TYPES
+} sensor_trace_type_t;
+
+#define SENSOR_TRACE_MASK(type)     (1u << (type))
+#define SENSOR_TRACE_ALL            (SENSOR_TRACE_MASK(SENSOR_TRACE_TYPES) - 2u)   ///< every type but INFO
+
+typedef enum {
+    SENSOR_TRACE_STREAM = 0,
+    SENSOR_TRACE_RING
+} sensor_trace_mode_t;
+
+typedef enum {
+    SENSOR_TRACE_IDLE = 0,
+    SENSOR_TRACE_RECORDING,
+    SENSOR_TRACE_REPLAYING
+} sensor_trace_state_t;
+
+typedef struct {
+    sensor_trace_state_t state;
+    uint32_t records;           ///< recorded, or replayed so far
+    uint32_t dropped;           ///< stream: buffer full; ring: overwritten
+    uint32_t buffered;          ///< bytes in the buffer
+} sensor_trace_stats_t;
+
+/** Receives one record line (no newline). */
+typedef void (*sensor_trace_sink_t)(const char *line, void *ctx);
+
+/** Receives a replayed button edge, same arguments as a GPIO interrupt. */
+typedef void (*sensor_trace_button_fn)(uint32_t gpio, uint32_t events);
+
+/* =========================
+ *  RECORDING
+ * ========================= */
+
+/**
+ * @brief Clear the buffer and start recording the types in @p type_mask
+ *        (::SENSOR_TRACE_MASK bits). Stops a replay.
+ */
+void sensor_trace_record(sensor_trace_mode_t mode, uint32_t type_mask);
+
+/** @brief Stop recording or replaying. Recorded records stay for draining. */
+void sensor_trace_stop(void);
+
+/**
+ * @brief Pass buffered records to @p sink, one line each, oldest first.
+ *
+ * Call periodically from a low-priority task while streaming, or once after
+ * a ring recording.
+ *
+ * @return Number of records passed.
+ */
+unsigned sensor_trace_drain(sensor_trace_sink_t sink, void *ctx);
+
+/** @brief Record a button edge; call from the GPIO interrupt. */
+void sensor_trace_button(uint32_t gpio, uint32_t events);
+
+/* =========================
+ *  REPLAY
+ * ========================= */
+
+/** @brief Empty the buffer (before ::sensor_trace_load()). */
+void sensor_trace_clear(void);
+
+/**
+ * @brief Append trace bytes (any split of the records) to the buffer.
+ * @return false if they do not fit.
+ */
+bool sensor_trace_load(const void *data, size_t len);
+
+/**
+ * @brief Replay the types in @p type_mask from @p trace, or from the buffer
+ *        (loaded or recorded) if @p trace is NULL. @p trace must stay valid
+ *        until the replay ends.
+ * @return Records in the trace, or -1 if the trace is malformed.
+ */
+int sensor_trace_replay(const uint8_t *trace, size_t len, uint32_t type_mask);
+
+/** @brief Handler for replayed button edges, NULL = not delivered. */
+void sensor_trace_set_button_handler(sensor_trace_button_fn fn);
+
+void sensor_trace_get_stats(sensor_trace_stats_t *out);
+
+/* =========================
+ *  DRIVER HOOKS (sdk.c)
+ * ========================= */
+
+/**
+ * @brief Replay: copy the next record of @p type into @p out (zero padded
+ *        to @p len).
+ * @return false if the type is not being replayed or its records ran out;
+ *         the caller reads the device.
+ */
+bool sensor_trace_take(sensor_trace_type_t type, void *out, size_t len);
+
+/** @brief Recording: store what the device returned. */
+void sensor_trace_put(sensor_trace_type_t type, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -30,8 +30,11 @@ SOFTWARE.
 
 #ifndef _inc_ssd1306
 #define _inc_ssd1306
+#include "hal.h"
+#if !TKJHAT_HAL_MOCK
 #include <pico/stdlib.h>
 #include <hardware/i2c.h>
+#endif
 
 /**
 *	@brief defines commands used in ssd1306
@@ -64,7 +67,7 @@ typedef struct {
     uint8_t height; 	/**< height of display */
     uint8_t pages;		/**< stores pages of display (calculated on initialization*/
     uint8_t address; 	/**< i2c address of display*/
-    i2c_inst_t *i2c_i; 	/**< i2c connection instance */
+    i2c_inst_t *i2c_i; 	/**< i2c connection instance (unused: the display is on the HAL bus) */
     bool external_vcc; 	/**< whether display uses external vcc */ 
     uint8_t *buffer;	/**< display buffer */
     size_t bufsize;		/**< buffer size */
@@ -0,0 +1,163 @@
+#include <math.h>
+#include <string.h>
+
+#include <tkjhat/audio_features.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifndef M_SQRT1_2
+#define M_SQRT1_2 0.70710678118654752440
+#endif
+
+static const uint16_t default_edges_hz[AUDIO_FEATURE_BANDS - 1] = {
+    AUDIO_FEATURE_EDGE0_HZ, AUDIO_FEATURE_EDGE1_HZ, AUDIO_FEATURE_EDGE2_HZ
+};
+
+// Integer square root, one bit per iteration
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+static uint16_t rms_of(uint64_t sum_sq, uint32_t count) {
+    if (count == 0) return 0;
+    uint32_t r = isqrt64(sum_sq / count);
+    return r > UINT16_MAX ? UINT16_MAX : (uint16_t)r;
+}
+
+static void reset_accumulators(audio_features_state_t *st) {
+    st->count = 0;
+    st->sum_sq = 0;
+    memset(st->band_sum_sq, 0, sizeof(st->band_sum_sq));
+    st->crossings = 0;
+    st->peak = 0;
+}
+
+// RBJ biquad coefficients in Q14, normalized by a0
+static void biquad_design(audio_features_biquad_t *bq, int type, double f0, double q, double fs) {
+    if (f0 > 0.45 * fs) f0 = 0.45 * fs;
+
+    double w0 = 2.0 * M_PI * f0 / fs;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    double b0, b1, b2;
+
+    if (type < 0) {             // low-pass
+        b0 = (1.0 - cw) / 2.0;
+        b1 = 1.0 - cw;
+        b2 = b0;
+    } else if (type > 0) {      // high-pass
+        b0 = (1.0 + cw) / 2.0;
+        b1 = -(1.0 + cw);
+        b2 = b0;
+    } else {                    // band-pass, 0 dB at the centre
+        b0 = alpha;
+        b1 = 0.0;
+        b2 = -alpha;
+    }
+
+    double a0 = 1.0 + alpha;
+    bq->b0 = (int32_t)lround(b0 / a0 * 16384.0);
+    bq->b1 = (int32_t)lround(b1 / a0 * 16384.0);
+    bq->b2 = (int32_t)lround(b2 / a0 * 16384.0);
+    bq->a1 = (int32_t)lround(-2.0 * cw / a0 * 16384.0);
+    bq->a2 = (int32_t)lround((1.0 - alpha) / a0 * 16384.0);
+}
+
+static inline int32_t biquad_run(audio_features_biquad_t *bq, int32_t x) {
+    int64_t acc = (int64_t)bq->b0 * x + (int64_t)bq->b1 * bq->x1 + (int64_t)bq->b2 * bq->x2
+                - (int64_t)bq->a1 * bq->y1 - (int64_t)bq->a2 * bq->y2;
+    int32_t y = (int32_t)(acc >> 14);
+
+    bq->x2 = bq->x1;
+    bq->x1 = x;
+    bq->y2 = bq->y1;
+    bq->y1 = y;
+    return y;
+}
+
+void audio_features_init(audio_features_state_t *st, uint32_t sample_rate, const uint16_t *edges_hz) {
+    memset(st, 0, sizeof(*st));
+    st->sample_rate = sample_rate;
+
+    if (edges_hz == NULL) edges_hz = default_edges_hz;
+
+    // Lowest band low-pass, middle bands band-pass between adjacent edges
+    // (centre at the geometric mean), top band high-pass. All second order.
+    const double fs = (double)sample_rate;
+    biquad_design(&st->band[0], -1, edges_hz[0], M_SQRT1_2, fs);
+    for (int i = 1; i < AUDIO_FEATURE_BANDS - 1; i++) {
+        double lo = edges_hz[i - 1], hi = edges_hz[i];
+        double fc = sqrt(lo * hi);
+        biquad_design(&st->band[i], 0, fc, fc / (hi - lo), fs);
+    }
+    biquad_design(&st->band[AUDIO_FEATURE_BANDS - 1], 1, edges_hz[AUDIO_FEATURE_BANDS - 2], M_SQRT1_2, fs);
+
+    reset_accumulators(st);
+}
+
+void audio_features_update(audio_features_state_t *st, const int16_t *samples, size_t count) {
+    int16_t last = st->last_sample;
+    uint16_t peak = st->peak;
+    uint32_t crossings = st->crossings;
+    uint64_t sum_sq = st->sum_sq;
+
+    for (size_t n = 0; n < count; n++) {
+        int32_t x = samples[n];
+
+        uint32_t mag = (uint32_t)(x < 0 ? -x : x);
+        if (mag > peak) peak = mag > UINT16_MAX ? UINT16_MAX : (uint16_t)mag;
+
+        if ((x < 0) != (last < 0)) crossings++;
+        last = (int16_t)x;
+
+        sum_sq += (uint32_t)(x * x);
+
+        for (int i = 0; i < AUDIO_FEATURE_BANDS; i++) {
+            int32_t y = biquad_run(&st->band[i], x);
+            st->band_sum_sq[i] += (uint64_t)((int64_t)y * y);
+        }
+    }
+
+    st->last_sample = last;
+    st->peak = peak;
+    st->crossings = crossings;
+    st->sum_sq = sum_sq;
+    st->count += (uint32_t)count;
+}
+
+void audio_features_finish(audio_features_state_t *st, audio_features_t *out) {
+    out->samples = st->count;
+    out->rms = rms_of(st->sum_sq, st->count);
+    out->peak = st->peak;
+
+    // Two crossings per period
+    uint64_t zcr = st->count ? (uint64_t)st->crossings * st->sample_rate / (2u * st->count) : 0;
+    out->zcr_hz = zcr > UINT16_MAX ? UINT16_MAX : (uint16_t)zcr;
+
+    for (int i = 0; i < AUDIO_FEATURE_BANDS; i++) {
+        out->band_rms[i] = rms_of(st->band_sum_sq[i], st->count);
+    }
+
+    reset_accumulators(st);
+}
+
+void audio_features_block(audio_features_state_t *st, const int16_t *samples, size_t count,
+                          audio_features_t *out) {
+    audio_features_update(st, samples, count);
+    audio_features_finish(st, out);
+}
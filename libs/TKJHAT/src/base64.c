@@ -0,0 +1,48 @@
+#include <string.h>
+
+#include <tkjhat/base64.h>
+
+static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+size_t base64_encode(const uint8_t *in, size_t n, char *out) {
+    size_t o = 0;
+    for (size_t i = 0; i < n; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < n) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < n) v |= in[i + 2];
+        out[o++] = b64[(v >> 18) & 63];
+        out[o++] = b64[(v >> 12) & 63];
+        out[o++] = i + 1 < n ? b64[(v >> 6) & 63] : '=';
+        out[o++] = i + 2 < n ? b64[v & 63] : '=';
+    }
+    return o;
+}
+
+static int b64_value(char c) {
+    const char *p = c ? strchr(b64, c) : NULL;
+    return p ? (int)(p - b64) : -1;
+}
+
+int base64_decode(const char *in, uint8_t *out, size_t max) {
+    size_t o = 0;
+    for (;;) {
+        int v[4];
+        int n = 0;
+        while (n < 4 && (v[n] = b64_value(in[n])) >= 0) n++;
+        if (n == 0 && in[0] != '=') return (int)o;
+        if (n < 2) return -1;
+
+        uint32_t bits = ((uint32_t)v[0] << 18) | ((uint32_t)v[1] << 12) |
+                        (n > 2 ? (uint32_t)v[2] << 6 : 0) | (n > 3 ? (uint32_t)v[3] : 0);
+        for (int i = 0; i < n - 1; i++) {
+            if (o == max) return -1;
+            out[o++] = (uint8_t)(bits >> (16 - 8 * i));
+        }
+        if (n < 4) {
+            // Padding ends the data
+            while (n < 4 && in[n] == '=') n++;
+            return n == 4 ? (int)o : -1;
+        }
+        in += 4;
+    }
+}
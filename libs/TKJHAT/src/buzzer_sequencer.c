@@ -0,0 +1,213 @@
+#include <string.h>
+
+#include <tkjhat/hal.h>
+#include <tkjhat/sdk.h>
+#include <tkjhat/buzzer_sequencer.h>
+
+// Queue and engine state. The queue only ever holds notes of one priority:
+// a higher-priority request drops the rest, a lower one is refused.
+static struct {
+    buzzer_note_t queue[BUZZER_SEQ_QUEUE_LEN];
+    uint head;
+    uint tail;
+    uint count;
+    buzzer_priority_t prio;
+
+    buzzer_note_t current;
+    bool active;            // an alarm is pending for the engine
+    bool in_gap;
+    hal_alarm_t alarm;
+    uint32_t generation;    // bumped on stop/preempt so stale alarms do nothing
+
+    hal_lock_t lock;
+} seq;
+
+void buzzer_seq_init(void) {
+    if (!hal_lock_ready(&seq.lock)) {
+        hal_lock_init(&seq.lock);
+    }
+}
+
+// Advances the engine by one event. Returns the time in us until the next
+// event, or 0 when the queue is empty and the engine stops. Lock held.
+static uint32_t seq_step_locked(void) {
+    if (!seq.in_gap && seq.current.gap_us > 0) {
+        buzzer_turn_off();
+        seq.in_gap = true;
+        return seq.current.gap_us;
+    }
+
+    while (seq.count > 0) {
+        seq.current = seq.queue[seq.tail];
+        seq.tail = (seq.tail + 1) % BUZZER_SEQ_QUEUE_LEN;
+        seq.count--;
+        seq.in_gap = false;
+
+        if (seq.current.duration_us == 0 && seq.current.gap_us == 0) continue;
+
+        if (seq.current.frequency && seq.current.duration_us) buzzer_start_tone(seq.current.frequency);
+        else                                                  buzzer_turn_off();
+
+        if (seq.current.duration_us > 0) return seq.current.duration_us;
+
+        seq.in_gap = true;
+        return seq.current.gap_us;
+    }
+
+    buzzer_turn_off();
+    seq.active = false;
+    memset(&seq.current, 0, sizeof(seq.current));
+    return 0;
+}
+
+static int64_t seq_alarm_cb(hal_alarm_t id, void *user_data) {
+    (void)id;
+    int64_t next = 0;
+
+    hal_lock_enter(&seq.lock);
+    if ((uint32_t)(uintptr_t)user_data == seq.generation && seq.active) {
+        uint32_t delay = seq_step_locked();
+        if (delay == 0) {
+            seq.alarm = 0;
+        } else {
+            // Negative: relative to the previous target time, so no drift
+            next = -(int64_t)delay;
+        }
+    }
+    hal_lock_exit(&seq.lock);
+
+    return next;
+}
+
+// Starts the engine if it is idle. Lock NOT held.
+static void seq_kick(void) {
+    hal_lock_enter(&seq.lock);
+    if (seq.active || seq.count == 0) {
+        hal_lock_exit(&seq.lock);
+        return;
+    }
+    seq.active = true;
+    seq.in_gap = true;                  // nothing playing, take the first note
+    memset(&seq.current, 0, sizeof(seq.current));
+    uint32_t delay = seq_step_locked();
+    uint32_t gen = seq.generation;
+    hal_lock_exit(&seq.lock);
+
+    if (delay == 0) return;
+
+    // The alarm pool takes its own lock, so arm outside ours
+    hal_alarm_t id = hal_alarm_in_us(delay, seq_alarm_cb, (void *)(uintptr_t)gen);
+
+    hal_lock_enter(&seq.lock);
+    if (gen != seq.generation) {
+        // Stopped or preempted meanwhile: this alarm is stale anyway
+        hal_lock_exit(&seq.lock);
+        if (id > 0) hal_alarm_cancel(id);
+        return;
+    }
+    if (id > 0) {
+        seq.alarm = id;
+    } else if (id < 0) {
+        // No free alarm: give up rather than leave a tone on
+        seq.active = false;
+        seq.count = 0;
+        seq.head = seq.tail = 0;
+        buzzer_turn_off();
+    }
+    hal_lock_exit(&seq.lock);
+}
+
+// Drops everything and bumps the generation. Returns the alarm to cancel.
+static hal_alarm_t seq_flush_locked(void) {
+    hal_alarm_t old = seq.alarm;
+    seq.alarm = 0;
+    seq.generation++;
+    seq.active = false;
+    seq.in_gap = false;
+    seq.count = 0;
+    seq.head = seq.tail = 0;
+    memset(&seq.current, 0, sizeof(seq.current));
+    buzzer_turn_off();
+    return old;
+}
+
+bool buzzer_seq_play(const buzzer_note_t *notes, size_t count, buzzer_priority_t prio) {
+    if (notes == NULL || count == 0) return false;
+
+    hal_alarm_t cancel = 0;
+    bool busy;
+
+    hal_lock_enter(&seq.lock);
+    busy = seq.active || seq.count > 0;
+
+    if (busy && prio < seq.prio) {
+        hal_lock_exit(&seq.lock);
+        return false;
+    }
+    if (busy && prio > seq.prio) {
+        cancel = seq_flush_locked();
+    }
+    if (count > BUZZER_SEQ_QUEUE_LEN - seq.count) {
+        hal_lock_exit(&seq.lock);
+        if (cancel > 0) hal_alarm_cancel(cancel);
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        seq.queue[seq.head] = notes[i];
+        seq.head = (seq.head + 1) % BUZZER_SEQ_QUEUE_LEN;
+    }
+    seq.count += count;
+    seq.prio = prio;
+    hal_lock_exit(&seq.lock);
+
+    if (cancel > 0) hal_alarm_cancel(cancel);
+    seq_kick();
+    return true;
+}
+
+bool buzzer_seq_tone(uint16_t frequency, uint32_t duration_ms, uint32_t gap_ms, buzzer_priority_t prio) {
+    buzzer_note_t note = { frequency, duration_ms * 1000u, gap_ms * 1000u };
+    return buzzer_seq_play(&note, 1, prio);
+}
+
+bool buzzer_seq_play_morse(const char *morse, uint16_t frequency, uint32_t wpm, buzzer_priority_t prio) {
+    if (morse == NULL || wpm == 0) return false;
+
+    buzzer_note_t notes[BUZZER_SEQ_QUEUE_LEN];
+    size_t n = 0;
+    uint32_t unit = 1200000u / wpm;
+    uint32_t pending_gap = 0;       // silence owed before the next mark
+
+    for (const char *p = morse; *p; p++) {
+        if (*p == '.' || *p == '-') {
+            if (n > 0 && pending_gap > notes[n - 1].gap_us) {
+                notes[n - 1].gap_us = pending_gap;
+            }
+            if (n == BUZZER_SEQ_QUEUE_LEN) return false;
+            notes[n].frequency = frequency;
+            notes[n].duration_us = (*p == '.') ? unit : 3 * unit;
+            notes[n].gap_us = unit;
+            n++;
+            pending_gap = 0;
+        } else if (*p == ' ') {
+            if (pending_gap < 3 * unit) pending_gap = 3 * unit;
+        } else if (*p == '/') {
+            pending_gap = 7 * unit;
+        }
+    }
+
+    return buzzer_seq_play(notes, n, prio);
+}
+
+void buzzer_seq_stop(void) {
+    hal_lock_enter(&seq.lock);
+    hal_alarm_t cancel = seq_flush_locked();
+    hal_lock_exit(&seq.lock);
+
+    if (cancel > 0) hal_alarm_cancel(cancel);
+}
+
+bool buzzer_seq_busy(void) {
+    return seq.active || seq.count > 0;
+}
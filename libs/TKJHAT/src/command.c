@@ -0,0 +1,107 @@
+#include <string.h>
+
+#include <tkjhat/command.h>
+
+static void reply(command_parser_t *p, const char *text) {
+    if (p->output) p->output(text, p->ctx);
+}
+
+static void show_help(command_parser_t *p) {
+    for (size_t i = 0; i < p->count; i++) {
+        reply(p, p->table[i].help ? p->table[i].help : p->table[i].name);
+        reply(p, "\n");
+    }
+}
+
+void command_parser_init(command_parser_t *p, const command_t *table, size_t count,
+                         command_fallback_t fallback, void *ctx) {
+    memset(p, 0, sizeof(*p));
+    p->table = table;
+    p->count = count;
+    p->fallback = fallback;
+    p->ctx = ctx;
+}
+
+void command_parser_set_output(command_parser_t *p, command_output_t output) {
+    p->output = output;
+}
+
+int command_tokenize(char *line, char **argv, int max) {
+    int argc = 0;
+    char *s = line;
+
+    while (*s && argc < max) {
+        while (*s == ' ' || *s == '\t') s++;
+        if (!*s) break;
+        argv[argc++] = s;
+        while (*s && *s != ' ' && *s != '\t') s++;
+        if (*s) *s++ = '\0';
+    }
+    return argc;
+}
+
+int command_execute(command_parser_t *p, char *line) {
+    // The fallback gets the line untouched, so look at the first word first
+    const char *s = line;
+    while (*s == ' ' || *s == '\t') s++;
+    size_t name_len = strcspn(s, " \t");
+
+    const command_t *cmd = NULL;
+    for (size_t i = 0; i < p->count; i++) {
+        if (strlen(p->table[i].name) == name_len && strncmp(p->table[i].name, s, name_len) == 0) {
+            cmd = &p->table[i];
+            break;
+        }
+    }
+
+    if (!cmd) {
+        if (name_len == 4 && strncmp(s, "help", 4) == 0) {
+            show_help(p);
+            return COMMAND_OK;
+        }
+        if (p->fallback) {
+            p->fallback(line, p->ctx);
+        } else if (name_len) {
+            reply(p, "ERR unknown command\n");
+        }
+        return COMMAND_NOT_FOUND;
+    }
+
+    char *argv[COMMAND_MAX_ARGS];
+    int argc = command_tokenize(line, argv, COMMAND_MAX_ARGS);
+    int res = cmd->handler(argc, argv, p->ctx);
+
+    if (res == COMMAND_OK) {
+        reply(p, "OK\n");
+    } else if (res == COMMAND_USAGE) {
+        reply(p, "ERR usage: ");
+        reply(p, cmd->help ? cmd->help : cmd->name);
+        reply(p, "\n");
+    } else {
+        reply(p, "ERR\n");
+    }
+    return res;
+}
+
+void command_parser_feed(command_parser_t *p, const char *data, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        char c = data[i];
+
+        if (c == '\r' || c == '\n') {
+            // CRLF gives an empty second line, which is skipped
+            if (p->len == 0) continue;
+            p->line[p->len] = '\0';
+            p->len = 0;
+            command_execute(p, p->line);
+            continue;
+        }
+
+        p->line[p->len++] = c;
+        if (p->len == COMMAND_LINE_MAX - 1) {
+            // Too long: hand over what we have and continue with a new line
+            p->line[p->len] = '\0';
+            p->len = 0;
+            command_execute(p, p->line);
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+
+#include <tkjhat/base64.h>
+#include <tkjhat/dlog.h>
+
+#define DLOG_MASK (DLOG_BUFFER_SIZE - 1u)
+
+#if (DLOG_BUFFER_SIZE & DLOG_MASK) != 0
+#error "DLOG_BUFFER_SIZE must be a power of two"
+#endif
+
+// Records in the buffer: u8 length, then the record
+//   u32 format string address
+//   u32 time_us_32() at the call
+//   arguments: 4 bytes each, strings as u8 length + characters
+static uint8_t buf[DLOG_BUFFER_SIZE];
+static uint32_t head, tail;             // free-running byte positions
+static uint32_t dropped, dropped_reported;
+static critical_section_t lock;
+
+static void lock_init(void) {
+    if (!critical_section_is_initialized(&lock)) {
+        critical_section_init(&lock);
+    }
+}
+
+static void put_u32(dlog_writer_t *w, uint32_t v) {
+    if (w->len + 4 > DLOG_MAX_RECORD) {
+        w->len = DLOG_MAX_RECORD + 1;   // too long, dropped at commit
+        return;
+    }
+    memcpy(&w->buf[w->len], &v, 4);     // little-endian on both ends
+    w->len += 4;
+}
+
+void dlog_begin(dlog_writer_t *w, const char *fmt) {
+    w->len = 0;
+    put_u32(w, (uint32_t)(uintptr_t)fmt);
+    put_u32(w, time_us_32());
+}
+
+void dlog_put_i(dlog_writer_t *w, int32_t v) {
+    put_u32(w, (uint32_t)v);
+}
+
+void dlog_put_f(dlog_writer_t *w, double v) {
+    float f = (float)v;
+    uint32_t bits;
+    memcpy(&bits, &f, 4);
+    put_u32(w, bits);
+}
+
+void dlog_put_p(dlog_writer_t *w, const void *p) {
+    put_u32(w, (uint32_t)(uintptr_t)p);
+}
+
+void dlog_put_s(dlog_writer_t *w, const char *s) {
+    if (!s) s = "(null)";
+    size_t n = 0;
+    while (n < DLOG_MAX_STR && s[n]) n++;
+    if (w->len + 1 + n > DLOG_MAX_RECORD) {
+        w->len = DLOG_MAX_RECORD + 1;
+        return;
+    }
+    w->buf[w->len++] = (uint8_t)n;
+    memcpy(&w->buf[w->len], s, n);
+    w->len += n;
+}
+
+void dlog_commit(dlog_writer_t *w) {
+    lock_init();
+
+    critical_section_enter_blocking(&lock);
+    if (w->len > DLOG_MAX_RECORD || DLOG_BUFFER_SIZE - (head - tail) < w->len + 1) {
+        dropped++;
+    } else {
+        buf[head++ & DLOG_MASK] = (uint8_t)w->len;
+        for (size_t i = 0; i < w->len; i++) {
+            buf[head++ & DLOG_MASK] = w->buf[i];
+        }
+    }
+    critical_section_exit(&lock);
+}
+
+uint32_t dlog_dropped(void) {
+    return dropped;
+}
+
+unsigned dlog_drain(void) {
+    uint8_t rec[DLOG_MAX_RECORD];
+    char line[sizeof(DLOG_LINE_MARK) + (DLOG_MAX_RECORD + 2) / 3 * 4 + 1];
+    unsigned count = 0;
+
+    lock_init();
+    for (;;) {
+        // Take one record out, format it without holding the lock
+        critical_section_enter_blocking(&lock);
+        if (head == tail) {
+            critical_section_exit(&lock);
+            break;
+        }
+        size_t n = buf[tail++ & DLOG_MASK];
+        for (size_t i = 0; i < n; i++) {
+            rec[i] = buf[tail++ & DLOG_MASK];
+        }
+        critical_section_exit(&lock);
+
+        size_t o = sizeof(DLOG_LINE_MARK) - 1;
+        memcpy(line, DLOG_LINE_MARK, o);
+        o += base64_encode(rec, n, &line[o]);
+        line[o] = '\0';
+
+        // One stdio write per line, newline added and no CRLF translation
+        puts_raw(line);
+        count++;
+    }
+
+    uint32_t d = dropped;
+    if (d != dropped_reported) {
+        printf("[dlog] %lu records dropped\n", (unsigned long)(d - dropped_reported));
+        dropped_reported = d;
+    }
+    return count;
+}
@@ -0,0 +1,195 @@
+#include <string.h>
+
+#include <tkjhat/base64.h>
+#include <tkjhat/hal.h>
+#include <tkjhat/event_trace.h>
+
+#define EVENT_MASK  (EVENT_TRACE_EVENTS - 1u)
+
+#if (EVENT_TRACE_EVENTS & EVENT_MASK) != 0
+#error "EVENT_TRACE_EVENTS must be a power of two"
+#endif
+
+// Dump chunks (first byte)
+#define CHUNK_INFO      0       // version, cores, u32 overwritten per core
+#define CHUNK_NAME      1       // category, u32 id, name
+#define CHUNK_EVENTS    2       // core, count, reserved, events
+
+#define EVENTS_PER_LINE 16
+#define NAME_MAX        (EVENT_TRACE_NAME_LEN - 1)
+#define CHUNK_MAX       (4 + EVENTS_PER_LINE * sizeof(event_trace_event_t))
+
+_Static_assert(sizeof(event_trace_event_t) == 12, "event_trace_event_t is dumped as is");
+
+// One writer per ring: the core itself (tasks and interrupts alike)
+static struct {
+    event_trace_event_t ev[EVENT_TRACE_EVENTS];
+    uint32_t head;                          // free-running
+} rings[EVENT_TRACE_CORES];
+
+static volatile bool running;
+
+// Copies: a task name lives in its TCB, which is freed when the task is deleted
+static struct {
+    uint8_t category;
+    bool deleted;                           // slot may be reused, name kept until then
+    uint32_t id;
+    char name[EVENT_TRACE_NAME_LEN];
+} names[EVENT_TRACE_NAMES];
+static unsigned name_count;
+static hal_lock_t names_lock;
+
+static const char *const span_names[] = {
+    [EVENT_TRACE_SPAN_I2C_WRITE] = "i2c write",
+    [EVENT_TRACE_SPAN_I2C_READ] = "i2c read",
+    [EVENT_TRACE_SPAN_DISPLAY] = "display flush",
+    [EVENT_TRACE_SPAN_FILTER] = "pdm filter",
+};
+
+void event_trace_emit(event_trace_type_t type, uint16_t arg, uint32_t id) {
+    if (!running) return;
+
+    uint32_t irq = hal_irq_save();
+    uint core = hal_core_num();
+    if (core < EVENT_TRACE_CORES) {
+        event_trace_event_t *e = &rings[core].ev[rings[core].head++ & EVENT_MASK];
+        e->t_us = (uint32_t)hal_time_us();
+        e->type = (uint8_t)type;
+        e->reserved = 0;
+        e->arg = arg;
+        e->id = id;
+    }
+    hal_irq_restore(irq);
+}
+
+void event_trace_start(void) {
+    running = false;
+    for (int c = 0; c < EVENT_TRACE_CORES; c++) rings[c].head = 0;
+    running = true;
+}
+
+void event_trace_stop(void) {
+    running = false;
+}
+
+bool event_trace_running(void) {
+    return running;
+}
+
+static void names_lock_init(void) {
+    if (!hal_lock_ready(&names_lock)) {
+        hal_lock_init(&names_lock);
+    }
+}
+
+static unsigned find_name_locked(event_trace_name_t category, uint32_t id) {
+    unsigned i = 0;
+    while (i < name_count && !(names[i].category == category && names[i].id == id)) i++;
+    return i;
+}
+
+// Tasks are named from the kernel's create hook, usually before the
+// scheduler starts, but creating tasks on both cores at once is allowed
+void event_trace_name(event_trace_name_t category, uint32_t id, const char *name) {
+    names_lock_init();
+    hal_lock_enter(&names_lock);
+    unsigned i = find_name_locked(category, id);
+    if (i == EVENT_TRACE_NAMES) {
+        // Table full: take the slot of a deleted object
+        i = 0;
+        while (i < name_count && !names[i].deleted) i++;
+    }
+    if (i < EVENT_TRACE_NAMES) {
+        names[i].category = (uint8_t)category;
+        names[i].deleted = false;
+        names[i].id = id;
+        strncpy(names[i].name, name, sizeof(names[i].name) - 1);
+        names[i].name[sizeof(names[i].name) - 1] = '\0';
+        if (i == name_count) name_count++;
+    }
+    hal_lock_exit(&names_lock);
+}
+
+void event_trace_forget(event_trace_name_t category, uint32_t id) {
+    names_lock_init();
+    hal_lock_enter(&names_lock);
+    unsigned i = find_name_locked(category, id);
+    if (i < name_count) names[i].deleted = true;
+    hal_lock_exit(&names_lock);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void send(const uint8_t *chunk, size_t n, event_trace_sink_t sink, void *ctx) {
+    // One consumer: static instead of ~350 bytes of stack
+    static char line[sizeof(EVENT_TRACE_LINE_MARK) + (CHUNK_MAX + 2) / 3 * 4];
+    size_t o = sizeof(EVENT_TRACE_LINE_MARK) - 1;
+    memcpy(line, EVENT_TRACE_LINE_MARK, o);
+    o += base64_encode(chunk, n, &line[o]);
+    line[o] = '\0';
+    sink(line, ctx);
+}
+
+static size_t name_chunk(uint8_t *chunk, uint8_t category, uint32_t id, const char *name) {
+    size_t len = strlen(name);
+    if (len > NAME_MAX) len = NAME_MAX;
+    chunk[0] = CHUNK_NAME;
+    chunk[1] = category;
+    put_u32(&chunk[2], id);
+    memcpy(&chunk[6], name, len);
+    return 6 + len;
+}
+
+unsigned event_trace_dump(event_trace_sink_t sink, void *ctx) {
+    static uint8_t chunk[CHUNK_MAX];
+    unsigned lines = 0;
+
+    chunk[0] = CHUNK_INFO;
+    chunk[1] = EVENT_TRACE_VERSION;
+    chunk[2] = EVENT_TRACE_CORES;
+    chunk[3] = 0;
+    for (int c = 0; c < EVENT_TRACE_CORES; c++) {
+        uint32_t head = rings[c].head;
+        put_u32(&chunk[4 + 4 * c], head > EVENT_TRACE_EVENTS ? head - EVENT_TRACE_EVENTS : 0);
+    }
+    send(chunk, 4 + 4 * EVENT_TRACE_CORES, sink, ctx);
+    lines++;
+
+    for (unsigned i = 0; i < sizeof(span_names) / sizeof(span_names[0]); i++, lines++) {
+        send(chunk, name_chunk(chunk, EVENT_TRACE_NAME_SPAN, i, span_names[i]), sink, ctx);
+    }
+    names_lock_init();
+    for (unsigned i = 0; ; i++, lines++) {
+        // Copied out under the lock, a task may be created meanwhile
+        hal_lock_enter(&names_lock);
+        size_t n = i < name_count ? name_chunk(chunk, names[i].category, names[i].id, names[i].name) : 0;
+        hal_lock_exit(&names_lock);
+        if (n == 0) break;
+        send(chunk, n, sink, ctx);
+    }
+
+    for (int c = 0; c < EVENT_TRACE_CORES; c++) {
+        uint32_t head = rings[c].head;
+        uint32_t pos = head > EVENT_TRACE_EVENTS ? head - EVENT_TRACE_EVENTS : 0;
+        while (pos != head) {
+            uint32_t n = head - pos < EVENTS_PER_LINE ? head - pos : EVENTS_PER_LINE;
+            chunk[0] = CHUNK_EVENTS;
+            chunk[1] = (uint8_t)c;
+            chunk[2] = (uint8_t)n;
+            chunk[3] = 0;
+            for (uint32_t i = 0; i < n; i++) {
+                memcpy(&chunk[4 + i * sizeof(event_trace_event_t)], &rings[c].ev[(pos + i) & EVENT_MASK],
+                       sizeof(event_trace_event_t));
+            }
+            send(chunk, 4 + n * sizeof(event_trace_event_t), sink, ctx);
+            pos += n;
+            lines++;
+        }
+    }
+    return lines;
+}
@@ -0,0 +1,25 @@
+#include <string.h>
+
+#include "hal_internal.h"
+
+hal_stats_t hal_counters;
+
+void hal_stats_get(hal_stats_t *out) {
+    *out = hal_counters;
+}
+
+void hal_stats_reset(void) {
+    memset(&hal_counters, 0, sizeof(hal_counters));
+}
+
+void hal_stats_diff(const hal_stats_t *before, const hal_stats_t *after, hal_stats_t *out) {
+    out->i2c_writes = after->i2c_writes - before->i2c_writes;
+    out->i2c_reads = after->i2c_reads - before->i2c_reads;
+    out->i2c_bytes = after->i2c_bytes - before->i2c_bytes;
+    out->i2c_errors = after->i2c_errors - before->i2c_errors;
+    out->gpio_writes = after->gpio_writes - before->gpio_writes;
+    out->gpio_reads = after->gpio_reads - before->gpio_reads;
+    out->pwm_writes = after->pwm_writes - before->pwm_writes;
+    out->alarms = after->alarms - before->alarms;
+    out->sleep_us = after->sleep_us - before->sleep_us;
+}
@@ -0,0 +1,13 @@
+#ifndef TKJHAT_HAL_INTERNAL_H
+#define TKJHAT_HAL_INTERNAL_H
+
+#include <tkjhat/hal.h>
+
+// Counters shared by the back ends (hal.c). Plain increments: an update
+// lost to the other core only makes a statistic one short.
+extern hal_stats_t hal_counters;
+
+#define HAL_COUNT(field)        (hal_counters.field++)
+#define HAL_COUNT_N(field, n)   (hal_counters.field += (n))
+
+#endif
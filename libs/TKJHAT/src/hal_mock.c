@@ -0,0 +1,382 @@
+// HAL back end for host builds: virtual time and simulated peripherals
+// (see tkjhat/hal_mock.h)
+
+#include <string.h>
+
+#include <tkjhat/hal_mock.h>
+
+#include "hal_internal.h"
+
+#define NUM_PINS        30
+#define NUM_SLICES      8
+
+static uint64_t now_us;
+
+/* ---- I2C ---- */
+
+typedef struct {
+    bool attached;
+    hal_mock_i2c_write_fn write;
+    hal_mock_i2c_read_fn read;
+    void *ctx;
+} i2c_device_t;
+
+static i2c_device_t devices[128];
+static uint32_t i2c_baud = 100000;
+static hal_mock_xfer_t xfer_log[HAL_MOCK_XFER_LOG];
+static size_t xfer_total;
+
+/* ---- pins ---- */
+
+static struct {
+    hal_gpio_mode_t mode;
+    bool out;
+    bool in;
+} pins[NUM_PINS];
+
+static struct {
+    uint32_t div16;
+    uint16_t top;
+    bool enabled;
+    uint16_t level[2];
+} slices[NUM_SLICES];
+
+/* ---- alarms and timers ---- */
+
+typedef struct {
+    bool used;
+    uint64_t at;
+    hal_alarm_t id;
+    hal_alarm_cb_t alarm_cb;        // NULL for a repeating timer
+    hal_timer_cb_t timer_cb;
+    uint64_t period_us;
+    void *user_data;
+} event_t;
+
+static event_t alarms[HAL_MOCK_ALARMS];
+static event_t timers[HAL_TIMERS];
+static hal_alarm_t next_alarm_id = 1;
+static bool in_callback;            // "interrupt context": callbacks do not nest
+
+void hal_mock_reset(void) {
+    now_us = 0;
+    memset(devices, 0, sizeof(devices));
+    i2c_baud = 100000;
+    memset(xfer_log, 0, sizeof(xfer_log));
+    xfer_total = 0;
+    memset(pins, 0, sizeof(pins));
+    for (int i = 0; i < NUM_PINS; i++) pins[i].mode = HAL_GPIO_OFF;
+    memset(slices, 0, sizeof(slices));
+    memset(alarms, 0, sizeof(alarms));
+    memset(timers, 0, sizeof(timers));
+    next_alarm_id = 1;
+    in_callback = false;
+    hal_stats_reset();
+}
+
+// Earliest pending alarm or timer at or before @p until, NULL if none
+static event_t *next_due(uint64_t until) {
+    event_t *first = NULL;
+    for (int i = 0; i < HAL_MOCK_ALARMS; i++) {
+        if (alarms[i].used && alarms[i].at <= until && (first == NULL || alarms[i].at < first->at)) first = &alarms[i];
+    }
+    for (int i = 0; i < HAL_TIMERS; i++) {
+        if (timers[i].used && timers[i].at <= until && (first == NULL || timers[i].at < first->at)) first = &timers[i];
+    }
+    return first;
+}
+
+void hal_mock_advance_us(uint64_t us) {
+    uint64_t until = now_us + us;
+    event_t *e;
+    while (!in_callback && (e = next_due(until)) != NULL) {
+        if (e->at > now_us) now_us = e->at;
+        in_callback = true;
+        if (e->alarm_cb != NULL) {
+            int64_t again = e->alarm_cb(e->id, e->user_data);
+            in_callback = false;
+            if (!e->used) continue;         // cancelled by the callback
+            if (again == 0) e->used = false;
+            else if (again < 0) e->at += (uint64_t)(-again);
+            else e->at = now_us + (uint64_t)again;
+        } else {
+            // Like a negative delay on the SDK: from this start to the next
+            uint64_t start = e->at;
+            bool again = e->timer_cb(e->user_data);
+            in_callback = false;
+            if (!again) e->used = false;
+            else if (e->used) e->at = start + e->period_us;
+        }
+    }
+    now_us = until;
+}
+
+/* ---- I2C ---- */
+
+void hal_mock_i2c_attach(uint8_t addr, hal_mock_i2c_write_fn write, hal_mock_i2c_read_fn read, void *ctx) {
+    devices[addr & 0x7f] = (i2c_device_t){ true, write, read, ctx };
+}
+
+void hal_mock_i2c_detach(uint8_t addr) {
+    devices[addr & 0x7f].attached = false;
+}
+
+static int regs_write(void *ctx, const uint8_t *src, size_t len, bool nostop) {
+    (void)nostop;
+    hal_mock_regs_t *dev = ctx;
+    if (len == 0) return 0;
+    dev->ptr = src[0];
+    for (size_t i = 1; i < len; i++) dev->regs[dev->ptr++] = src[i];
+    return (int)len;
+}
+
+static int regs_read(void *ctx, uint8_t *dst, size_t len, bool nostop) {
+    (void)nostop;
+    hal_mock_regs_t *dev = ctx;
+    for (size_t i = 0; i < len; i++) dst[i] = dev->regs[dev->ptr++];
+    return (int)len;
+}
+
+void hal_mock_i2c_attach_regs(uint8_t addr, hal_mock_regs_t *dev) {
+    hal_mock_i2c_attach(addr, regs_write, regs_read, dev);
+}
+
+size_t hal_mock_xfer_count(void) {
+    return xfer_total;
+}
+
+bool hal_mock_xfer_get(size_t n, hal_mock_xfer_t *out) {
+    if (n >= xfer_total || xfer_total - n > HAL_MOCK_XFER_LOG) return false;
+    *out = xfer_log[n % HAL_MOCK_XFER_LOG];
+    return true;
+}
+
+// Logs the transfer and lets its bus time pass. A NACKed transfer stops
+// after the address byte.
+static void bus_transfer(uint8_t addr, bool read, const uint8_t *data, size_t len, int rc) {
+    hal_mock_xfer_t *x = &xfer_log[xfer_total++ % HAL_MOCK_XFER_LOG];
+    x->us = now_us;
+    x->addr = addr;
+    x->read = read;
+    x->acked = rc >= 0;
+    x->len = (uint16_t)len;
+    memset(x->data, 0, sizeof(x->data));
+    if (rc > 0) memcpy(x->data, data, (size_t)rc < sizeof(x->data) ? (size_t)rc : sizeof(x->data));
+
+    uint64_t bits = 9u * (1u + (rc > 0 ? (uint64_t)rc : 0u));
+    hal_mock_advance_us((bits * 1000000u + i2c_baud - 1) / i2c_baud);
+}
+
+void hal_i2c_init(uint32_t baudrate, uint sda_pin, uint scl_pin) {
+    (void)sda_pin;
+    (void)scl_pin;
+    i2c_baud = baudrate ? baudrate : 100000;
+}
+
+int hal_i2c_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    i2c_device_t *dev = &devices[addr & 0x7f];
+    int rc = -1;        // PICO_ERROR_GENERIC: address not acknowledged
+    if (dev->attached) {
+        rc = dev->write ? dev->write(dev->ctx, src, len, nostop) : (int)len;
+        if (rc < (int)len) rc = -1;
+    }
+    HAL_COUNT(i2c_writes);
+    if (rc > 0) HAL_COUNT_N(i2c_bytes, (uint32_t)rc);
+    if (rc < 0) HAL_COUNT(i2c_errors);
+    bus_transfer(addr, false, src, len, rc);
+    return rc;
+}
+
+int hal_i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    i2c_device_t *dev = &devices[addr & 0x7f];
+    int rc = -1;
+    if (dev->attached) {
+        if (dev->read) {
+            rc = dev->read(dev->ctx, dst, len, nostop);
+        } else {
+            memset(dst, 0, len);
+            rc = (int)len;
+        }
+        if (rc < (int)len) rc = -1;
+    }
+    HAL_COUNT(i2c_reads);
+    if (rc > 0) HAL_COUNT_N(i2c_bytes, (uint32_t)rc);
+    if (rc < 0) HAL_COUNT(i2c_errors);
+    bus_transfer(addr, true, dst, len, rc);
+    return rc;
+}
+
+/* ---- GPIO ---- */
+
+void hal_gpio_mode(uint pin, hal_gpio_mode_t mode) {
+    if (pin >= NUM_PINS) return;
+    pins[pin].mode = mode;
+    pins[pin].out = false;
+}
+
+void hal_gpio_pulls(uint pin, bool up, bool down) {
+    (void)down;
+    // An unconnected input follows its pull
+    if (pin < NUM_PINS) pins[pin].in = up;
+}
+
+void hal_gpio_put(uint pin, bool value) {
+    HAL_COUNT(gpio_writes);
+    if (pin < NUM_PINS) pins[pin].out = value;
+}
+
+bool hal_gpio_get(uint pin) {
+    HAL_COUNT(gpio_reads);
+    if (pin >= NUM_PINS) return false;
+    return pins[pin].mode == HAL_GPIO_OUTPUT ? pins[pin].out : pins[pin].in;
+}
+
+void hal_mock_gpio_input(uint pin, bool level) {
+    if (pin < NUM_PINS) pins[pin].in = level;
+}
+
+bool hal_mock_gpio_output(uint pin) {
+    return pin < NUM_PINS && pins[pin].out;
+}
+
+/* ---- PWM ---- */
+
+#define SLICE(pin)      (((pin) >> 1) & (NUM_SLICES - 1))
+#define CHANNEL(pin)    ((pin) & 1)
+
+uint32_t hal_pwm_clock_hz(void) {
+    return HAL_MOCK_CLK_HZ;
+}
+
+void hal_pwm_init(uint pin, uint32_t div16, uint16_t top, bool invert, bool start) {
+    (void)invert;
+    slices[SLICE(pin)].div16 = div16;
+    slices[SLICE(pin)].top = top;
+    slices[SLICE(pin)].enabled = start;
+}
+
+void hal_pwm_set_period(uint pin, uint32_t div16, uint16_t top) {
+    HAL_COUNT(pwm_writes);
+    slices[SLICE(pin)].div16 = div16;
+    slices[SLICE(pin)].top = top;
+}
+
+void hal_pwm_set_level(uint pin, uint16_t level) {
+    HAL_COUNT(pwm_writes);
+    slices[SLICE(pin)].level[CHANNEL(pin)] = level;
+}
+
+void hal_pwm_set_levels(uint pin, uint16_t level_a, uint16_t level_b) {
+    HAL_COUNT(pwm_writes);
+    slices[SLICE(pin)].level[0] = level_a;
+    slices[SLICE(pin)].level[1] = level_b;
+}
+
+void hal_pwm_enable(uint32_t pin_mask, bool enabled) {
+    for (uint pin = 0; pin < NUM_PINS; pin++) {
+        if (pin_mask & (1u << pin)) slices[SLICE(pin)].enabled = enabled;
+    }
+}
+
+bool hal_pwm_running(uint pin) {
+    return slices[SLICE(pin)].enabled;
+}
+
+// Not counting: the mock has no sub-period timing, and a counter stuck at
+// 0 never makes a driver wait for the wrap
+uint16_t hal_pwm_counter(uint pin) {
+    (void)pin;
+    return 0;
+}
+
+uint16_t hal_mock_pwm_level(uint pin) {
+    return slices[SLICE(pin)].level[CHANNEL(pin)];
+}
+
+uint32_t hal_mock_pwm_hz(uint pin) {
+    const uint32_t s = SLICE(pin);
+    if (!slices[s].enabled || slices[s].div16 == 0) return 0;
+    return (uint32_t)((uint64_t)HAL_MOCK_CLK_HZ * 16u / ((uint64_t)slices[s].div16 * (slices[s].top + 1u)));
+}
+
+/* ---- time ---- */
+
+uint64_t hal_time_us(void) {
+    return now_us;
+}
+
+void hal_sleep_us(uint64_t us) {
+    HAL_COUNT_N(sleep_us, us);
+    hal_mock_advance_us(us);
+}
+
+void hal_sleep_ms(uint32_t ms) {
+    hal_sleep_us((uint64_t)ms * 1000u);
+}
+
+hal_alarm_t hal_alarm_in_us(uint64_t us, hal_alarm_cb_t cb, void *user_data) {
+    HAL_COUNT(alarms);
+    for (int i = 0; i < HAL_MOCK_ALARMS; i++) {
+        if (alarms[i].used) continue;
+        hal_alarm_t id = next_alarm_id++;
+        if (next_alarm_id <= 0) next_alarm_id = 1;
+        alarms[i] = (event_t){ .used = true, .at = now_us + us, .id = id, .alarm_cb = cb, .user_data = user_data };
+        return id;
+    }
+    return -1;
+}
+
+bool hal_alarm_cancel(hal_alarm_t id) {
+    for (int i = 0; id > 0 && i < HAL_MOCK_ALARMS; i++) {
+        if (alarms[i].used && alarms[i].id == id) {
+            alarms[i].used = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+int hal_timer_start_us(uint64_t period_us, hal_timer_cb_t cb, void *user_data) {
+    HAL_COUNT(alarms);
+    for (int i = 0; i < HAL_TIMERS; i++) {
+        if (timers[i].used) continue;
+        timers[i] = (event_t){ .used = true, .at = now_us + period_us, .timer_cb = cb,
+                               .period_us = period_us, .user_data = user_data };
+        return i + 1;
+    }
+    return -1;
+}
+
+void hal_timer_stop(int id) {
+    if (id >= 1 && id <= HAL_TIMERS) timers[id - 1].used = false;
+}
+
+/* ---- critical sections: one thread, nothing to keep out ---- */
+
+void hal_lock_init(hal_lock_t *lock) {
+    lock->impl[0] = 1;
+}
+
+bool hal_lock_ready(const hal_lock_t *lock) {
+    return lock->impl[0] != 0;
+}
+
+void hal_lock_enter(hal_lock_t *lock) {
+    (void)lock;
+}
+
+void hal_lock_exit(hal_lock_t *lock) {
+    (void)lock;
+}
+
+uint32_t hal_irq_save(void) {
+    return 0;
+}
+
+void hal_irq_restore(uint32_t state) {
+    (void)state;
+}
+
+uint hal_core_num(void) {
+    return 0;
+}
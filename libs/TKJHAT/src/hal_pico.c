@@ -0,0 +1,228 @@
+// HAL back end on the Pico SDK (see tkjhat/hal.h)
+
+#include "pico/stdlib.h"
+#include "pico/sync.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/pwm.h"
+#include "hardware/sync.h"
+
+#include "hal_internal.h"
+#include "tkjhat/event_trace.h"
+
+_Static_assert(sizeof(critical_section_t) <= sizeof(hal_lock_t), "hal_lock_t too small");
+
+/* ---- I2C ---- */
+
+void hal_i2c_init(uint32_t baudrate, uint sda_pin, uint scl_pin) {
+    i2c_init(i2c_default, baudrate);
+    gpio_set_function(sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(scl_pin, GPIO_FUNC_I2C);
+    gpio_pull_up(sda_pin);
+    gpio_pull_up(scl_pin);
+}
+
+int hal_i2c_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    EVENT_TRACE_BEGIN(EVENT_TRACE_SPAN_I2C_WRITE);
+    int rc = i2c_write_blocking(i2c_default, addr, src, len, nostop);
+    EVENT_TRACE_END(EVENT_TRACE_SPAN_I2C_WRITE);
+    HAL_COUNT(i2c_writes);
+    if (rc > 0) HAL_COUNT_N(i2c_bytes, (uint32_t)rc);
+    if (rc < 0) HAL_COUNT(i2c_errors);
+    return rc;
+}
+
+int hal_i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    EVENT_TRACE_BEGIN(EVENT_TRACE_SPAN_I2C_READ);
+    int rc = i2c_read_blocking(i2c_default, addr, dst, len, nostop);
+    EVENT_TRACE_END(EVENT_TRACE_SPAN_I2C_READ);
+    HAL_COUNT(i2c_reads);
+    if (rc > 0) HAL_COUNT_N(i2c_bytes, (uint32_t)rc);
+    if (rc < 0) HAL_COUNT(i2c_errors);
+    return rc;
+}
+
+/* ---- GPIO ---- */
+
+void hal_gpio_mode(uint pin, hal_gpio_mode_t mode) {
+    switch (mode) {
+    case HAL_GPIO_INPUT:
+    case HAL_GPIO_OUTPUT:
+        gpio_init(pin);
+        gpio_set_dir(pin, mode == HAL_GPIO_OUTPUT);
+        break;
+    case HAL_GPIO_OFF:
+        gpio_deinit(pin);
+        break;
+    }
+}
+
+void hal_gpio_pulls(uint pin, bool up, bool down) {
+    gpio_set_pulls(pin, up, down);
+}
+
+void hal_gpio_put(uint pin, bool value) {
+    gpio_put(pin, value);
+    HAL_COUNT(gpio_writes);
+}
+
+bool hal_gpio_get(uint pin) {
+    HAL_COUNT(gpio_reads);
+#if defined(PICO_RP2350)
+    // RP2350 errata E9 (input leakage): the input buffer is enabled only
+    // for the read
+    hw_set_bits(&pads_bank0_hw->io[pin], PADS_BANK0_GPIO0_IE_BITS);
+    __asm volatile("nop; nop; nop; nop;");     // short settle
+    bool v = gpio_get(pin);
+    hw_clear_bits(&pads_bank0_hw->io[pin], PADS_BANK0_GPIO0_IE_BITS);
+    return v;
+#else
+    return gpio_get(pin);
+#endif
+}
+
+/* ---- PWM ---- */
+
+uint32_t hal_pwm_clock_hz(void) {
+    return clock_get_hz(clk_sys);
+}
+
+void hal_pwm_init(uint pin, uint32_t div16, uint16_t top, bool invert, bool start) {
+    gpio_set_function(pin, GPIO_FUNC_PWM);
+    pwm_config cfg = pwm_get_default_config();
+    pwm_config_set_clkdiv_int_frac(&cfg, (uint8_t)(div16 >> 4), (uint8_t)(div16 & 0xF));
+    pwm_config_set_wrap(&cfg, top);
+    pwm_config_set_output_polarity(&cfg, invert, invert);
+    pwm_init(pwm_gpio_to_slice_num(pin), &cfg, start);
+}
+
+void hal_pwm_set_period(uint pin, uint32_t div16, uint16_t top) {
+    uint slice = pwm_gpio_to_slice_num(pin);
+    pwm_set_clkdiv_int_frac(slice, (uint8_t)(div16 >> 4), (uint8_t)(div16 & 0xF));
+    pwm_set_wrap(slice, top);
+    HAL_COUNT(pwm_writes);
+}
+
+void hal_pwm_set_level(uint pin, uint16_t level) {
+    pwm_set_gpio_level(pin, level);
+    HAL_COUNT(pwm_writes);
+}
+
+void hal_pwm_set_levels(uint pin, uint16_t level_a, uint16_t level_b) {
+    pwm_set_both_levels(pwm_gpio_to_slice_num(pin), level_a, level_b);
+    HAL_COUNT(pwm_writes);
+}
+
+void hal_pwm_enable(uint32_t pin_mask, bool enabled) {
+    uint32_t slices = 0;
+    for (uint pin = 0; pin < NUM_BANK0_GPIOS; pin++) {
+        if (pin_mask & (1u << pin)) slices |= 1u << pwm_gpio_to_slice_num(pin);
+    }
+    // One write: the slices start on the same cycle, the others are untouched
+    if (enabled) hw_set_bits(&pwm_hw->en, slices);
+    else hw_clear_bits(&pwm_hw->en, slices);
+}
+
+bool hal_pwm_running(uint pin) {
+    return pwm_hw->en & (1u << pwm_gpio_to_slice_num(pin));
+}
+
+uint16_t hal_pwm_counter(uint pin) {
+    return pwm_get_counter(pwm_gpio_to_slice_num(pin));
+}
+
+/* ---- time ---- */
+
+uint64_t hal_time_us(void) {
+    return time_us_64();
+}
+
+void hal_sleep_us(uint64_t us) {
+    HAL_COUNT_N(sleep_us, us);
+    sleep_us(us);
+}
+
+void hal_sleep_ms(uint32_t ms) {
+    HAL_COUNT_N(sleep_us, (uint64_t)ms * 1000u);
+    sleep_ms(ms);
+}
+
+// hal_alarm_cb_t has the same signature as alarm_callback_t (int32_t ids)
+hal_alarm_t hal_alarm_in_us(uint64_t us, hal_alarm_cb_t cb, void *user_data) {
+    HAL_COUNT(alarms);
+    return add_alarm_in_us(us, cb, user_data, true);
+}
+
+bool hal_alarm_cancel(hal_alarm_t id) {
+    return id > 0 && cancel_alarm(id);
+}
+
+static struct {
+    repeating_timer_t rt;
+    hal_timer_cb_t cb;
+    void *user_data;
+    bool used;
+} timers[HAL_TIMERS];
+
+static bool timer_trampoline(repeating_timer_t *rt) {
+    int i = (int)(uintptr_t)rt->user_data;
+    bool again = timers[i].cb(timers[i].user_data);
+    if (!again) timers[i].used = false;
+    return again;
+}
+
+int hal_timer_start_us(uint64_t period_us, hal_timer_cb_t cb, void *user_data) {
+    uint32_t irq = save_and_disable_interrupts();
+    int i = 0;
+    while (i < HAL_TIMERS && timers[i].used) i++;
+    if (i < HAL_TIMERS) timers[i].used = true;
+    restore_interrupts(irq);
+    if (i == HAL_TIMERS) return -1;
+
+    timers[i].cb = cb;
+    timers[i].user_data = user_data;
+    HAL_COUNT(alarms);
+    // Negative delay: the period is measured between callback starts
+    if (!add_repeating_timer_us(-(int64_t)period_us, timer_trampoline, (void *)(uintptr_t)i, &timers[i].rt)) {
+        timers[i].used = false;
+        return -1;
+    }
+    return i + 1;
+}
+
+void hal_timer_stop(int id) {
+    if (id < 1 || id > HAL_TIMERS) return;
+    cancel_repeating_timer(&timers[id - 1].rt);
+    timers[id - 1].used = false;
+}
+
+/* ---- critical sections ---- */
+
+void hal_lock_init(hal_lock_t *lock) {
+    critical_section_init((critical_section_t *)lock->impl);
+}
+
+bool hal_lock_ready(const hal_lock_t *lock) {
+    return critical_section_is_initialized((critical_section_t *)lock->impl);
+}
+
+void hal_lock_enter(hal_lock_t *lock) {
+    critical_section_enter_blocking((critical_section_t *)lock->impl);
+}
+
+void hal_lock_exit(hal_lock_t *lock) {
+    critical_section_exit((critical_section_t *)lock->impl);
+}
+
+uint32_t hal_irq_save(void) {
+    return save_and_disable_interrupts();
+}
+
+void hal_irq_restore(uint32_t state) {
+    restore_interrupts(state);
+}
+
+uint hal_core_num(void) {
+    return get_core_num();
+}
@@ -0,0 +1,291 @@
+#include <string.h>
+
+#include <tkjhat/hal.h>
+#include <tkjhat/sdk.h>
+#include <tkjhat/led_effects.h>
+
+typedef enum {
+    FX_NONE = 0,
+    FX_BLINK,
+    FX_PATTERN,
+    FX_FADE,
+    FX_BREATHE,
+    FX_RGB_FADE,
+    FX_SEQUENCE
+} fx_kind_t;
+
+typedef struct {
+    fx_kind_t kind;
+    uint64_t start_us;
+    uint32_t a, b;          // blink: on/off ms, pattern: bits/step ms, fade/breathe: duration/period ms
+    uint32_t pattern;
+    uint16_t count;         // 0 = forever
+    uint8_t from, to;       // red fade levels
+    led_color_t c_from, c_to;
+    led_color_t colors[LED_EFFECT_MAX_COLORS];
+    uint8_t ncolors;
+    bool fade;
+    int last;               // last output written, -1 = unknown
+} fx_t;
+
+static struct {
+    fx_t fx[LED_EFFECT_TARGETS];
+    led_color_t rgb_color;      // color shown by blink/pattern on the RGB LED
+    led_color_t rgb_current;    // what the RGB LED shows now
+    bool timer_running;
+    hal_lock_t lock;
+} eng = {
+    .rgb_color = { 255, 255, 255 },
+};
+
+static void fx_lock_init(void) {
+    if (!hal_lock_ready(&eng.lock)) {
+        hal_lock_init(&eng.lock);
+    }
+}
+
+/* ---- outputs ---- */
+
+static void red_to_pwm(void) {
+    hal_pwm_init(RED_LED_PIN, 16, 0xFFFF, false, true);
+    hal_pwm_set_level(RED_LED_PIN, 0);
+}
+
+static void red_release(void) {
+    // Back to a plain output, off, as left by blink_red_led() before
+    hal_pwm_set_level(RED_LED_PIN, 0);
+    hal_gpio_mode(RED_LED_PIN, HAL_GPIO_OUTPUT);
+    hal_gpio_put(RED_LED_PIN, false);
+}
+
+static void red_level(uint8_t v) {
+    hal_pwm_set_level(RED_LED_PIN, (uint16_t)(v * v));
+}
+
+static void rgb_show(led_color_t c) {
+    eng.rgb_current = c;
+    rgb_led_write(c.r, c.g, c.b);
+}
+
+static uint8_t lerp8(uint8_t from, uint8_t to, uint32_t num, uint32_t den) {
+    if (den == 0 || num >= den) return to;
+    return (uint8_t)((int32_t)from + ((int32_t)to - (int32_t)from) * (int32_t)num / (int32_t)den);
+}
+
+static led_color_t lerp_color(led_color_t from, led_color_t to, uint32_t num, uint32_t den) {
+    led_color_t c = {
+        lerp8(from.r, to.r, num, den),
+        lerp8(from.g, to.g, num, den),
+        lerp8(from.b, to.b, num, den),
+    };
+    return c;
+}
+
+/* ---- engine ---- */
+
+// Brightness 0-255 of an on/off or level effect at time t (ms), or -1 when
+// the effect has finished.
+static int fx_level(const fx_t *fx, uint32_t t) {
+    switch (fx->kind) {
+    case FX_BLINK: {
+        uint32_t period = fx->a + fx->b;
+        if (period == 0 || (fx->count && t / period >= fx->count)) return -1;
+        return (t % period) < fx->a ? 255 : 0;
+    }
+    case FX_PATTERN: {
+        uint32_t total = fx->a * fx->b;
+        if (total == 0 || (fx->count && t / total >= fx->count)) return -1;
+        uint32_t bit = (t % total) / fx->b;
+        return (fx->pattern >> (fx->a - 1 - bit)) & 1u ? 255 : 0;
+    }
+    case FX_FADE:
+        if (t >= fx->a) return -1;
+        return lerp8(fx->from, fx->to, t, fx->a);
+    case FX_BREATHE: {
+        if (fx->a == 0 || (fx->count && t / fx->a >= fx->count)) return -1;
+        uint32_t phase = t % fx->a, half = fx->a / 2;
+        return phase < half ? (int)(phase * 255u / half) : (int)((fx->a - phase) * 255u / (fx->a - half));
+    }
+    default:
+        return -1;
+    }
+}
+
+// Returns false when the effect has finished. Lock held.
+static bool fx_update(led_effect_target_t led, fx_t *fx, uint64_t now) {
+    uint32_t t = (uint32_t)((now - fx->start_us) / 1000u);
+
+    if (led == LED_EFFECT_RED) {
+        int level = fx_level(fx, t);
+        if (level < 0) {
+            if (fx->kind == FX_FADE) red_level(fx->to);
+            if (fx->kind != FX_FADE || fx->to == 0) red_release();
+            return false;
+        }
+        if (level != fx->last) {
+            red_level((uint8_t)level);
+            fx->last = level;
+        }
+        return true;
+    }
+
+    // RGB
+    led_color_t c;
+    bool running = true;
+
+    switch (fx->kind) {
+    case FX_RGB_FADE:
+        c = lerp_color(fx->c_from, fx->c_to, t, fx->a);
+        running = t < fx->a;
+        break;
+    case FX_SEQUENCE: {
+        uint32_t step = fx->a;
+        uint32_t n = fx->ncolors;
+        if (step == 0 || n == 0 || (fx->count && t / (step * n) >= fx->count)) {
+            // Hold the last color of the last pass
+            c = fx->colors[n ? n - 1 : 0];
+            running = false;
+            break;
+        }
+        uint32_t idx = (t / step) % n;
+        c = fx->colors[idx];
+        if (fx->fade) c = lerp_color(c, fx->colors[(idx + 1) % n], t % step, step);
+        break;
+    }
+    default: {
+        int level = fx_level(fx, t);
+        if (level < 0) {
+            led_color_t off = { 0, 0, 0 };
+            c = off;
+            running = false;
+        } else {
+            c = lerp_color((led_color_t){ 0, 0, 0 }, eng.rgb_color, (uint32_t)level, 255);
+        }
+        break;
+    }
+    }
+
+    int packed = (c.r << 16) | (c.g << 8) | c.b;
+    if (packed != fx->last || !running) {
+        rgb_show(c);
+        fx->last = packed;
+    }
+    return running;
+}
+
+static bool fx_timer_cb(void *user_data) {
+    (void)user_data;
+    bool any = false;
+    uint64_t now = hal_time_us();
+
+    hal_lock_enter(&eng.lock);
+    for (int i = 0; i < LED_EFFECT_TARGETS; i++) {
+        fx_t *fx = &eng.fx[i];
+        if (fx->kind == FX_NONE) continue;
+        if (fx_update((led_effect_target_t)i, fx, now)) any = true;
+        else fx->kind = FX_NONE;
+    }
+    if (!any) eng.timer_running = false;    // returning false ends the timer
+    hal_lock_exit(&eng.lock);
+
+    return any;
+}
+
+// Installs @p fx on @p led and makes sure the timer runs.
+static void fx_start(led_effect_target_t led, const fx_t *fx) {
+    if ((unsigned)led >= LED_EFFECT_TARGETS) return;
+    fx_lock_init();
+
+    bool start_timer = false;
+    uint64_t now = hal_time_us();
+
+    hal_lock_enter(&eng.lock);
+    bool was_idle = eng.fx[led].kind == FX_NONE;
+    eng.fx[led] = *fx;
+    eng.fx[led].start_us = now;
+    eng.fx[led].last = -1;
+    if (led == LED_EFFECT_RED && was_idle) red_to_pwm();
+    fx_update(led, &eng.fx[led], now);      // first frame right away
+    if (!eng.timer_running) {
+        eng.timer_running = true;
+        start_timer = true;
+    }
+    hal_lock_exit(&eng.lock);
+
+    // The alarm pool has its own lock, so add the timer outside ours. The
+    // period is fixed regardless of callback time.
+    if (start_timer && hal_timer_start_us(LED_EFFECT_TICK_MS * 1000u, fx_timer_cb, NULL) < 0) {
+        hal_lock_enter(&eng.lock);
+        eng.timer_running = false;
+        hal_lock_exit(&eng.lock);
+    }
+}
+
+void led_effect_blink(led_effect_target_t led, uint16_t on_ms, uint16_t off_ms, uint16_t count) {
+    fx_t fx = { .kind = FX_BLINK, .a = on_ms, .b = off_ms, .count = count };
+    fx_start(led, &fx);
+}
+
+void led_effect_pattern(led_effect_target_t led, uint32_t pattern, uint8_t bits,
+                        uint16_t step_ms, uint16_t repeat) {
+    if (bits == 0 || bits > 32) return;
+    fx_t fx = { .kind = FX_PATTERN, .a = bits, .b = step_ms, .pattern = pattern, .count = repeat };
+    fx_start(led, &fx);
+}
+
+void led_effect_fade(uint8_t from, uint8_t to, uint32_t duration_ms) {
+    fx_t fx = { .kind = FX_FADE, .a = duration_ms, .from = from, .to = to };
+    fx_start(LED_EFFECT_RED, &fx);
+}
+
+void led_effect_breathe(led_effect_target_t led, uint32_t period_ms, uint16_t count) {
+    if (period_ms < 2) return;
+    fx_t fx = { .kind = FX_BREATHE, .a = period_ms, .count = count };
+    fx_start(led, &fx);
+}
+
+void led_effect_rgb_set(led_color_t color) {
+    fx_lock_init();
+    hal_lock_enter(&eng.lock);
+    eng.fx[LED_EFFECT_RGB].kind = FX_NONE;
+    eng.rgb_color = color;
+    rgb_show(color);
+    hal_lock_exit(&eng.lock);
+}
+
+void led_effect_rgb_fade(led_color_t to, uint32_t duration_ms) {
+    fx_t fx = { .kind = FX_RGB_FADE, .a = duration_ms, .c_from = eng.rgb_current, .c_to = to };
+    eng.rgb_color = to;
+    fx_start(LED_EFFECT_RGB, &fx);
+}
+
+void led_effect_rgb_sequence(const led_color_t *colors, size_t count, uint32_t step_ms,
+                             bool fade, uint16_t repeat) {
+    if (colors == NULL || count == 0) return;
+    if (count > LED_EFFECT_MAX_COLORS) count = LED_EFFECT_MAX_COLORS;
+
+    fx_t fx = { .kind = FX_SEQUENCE, .a = step_ms, .ncolors = (uint8_t)count, .fade = fade, .count = repeat };
+    memcpy(fx.colors, colors, count * sizeof(led_color_t));
+    fx_start(LED_EFFECT_RGB, &fx);
+}
+
+void led_effect_stop(led_effect_target_t led) {
+    if ((unsigned)led >= LED_EFFECT_TARGETS) return;
+    fx_lock_init();
+
+    hal_lock_enter(&eng.lock);
+    if (eng.fx[led].kind != FX_NONE) {
+        eng.fx[led].kind = FX_NONE;
+        if (led == LED_EFFECT_RED) {
+            red_release();
+        } else {
+            led_color_t off = { 0, 0, 0 };
+            rgb_show(off);
+        }
+    }
+    hal_lock_exit(&eng.lock);
+}
+
+bool led_effect_busy(led_effect_target_t led) {
+    return (unsigned)led < LED_EFFECT_TARGETS && eng.fx[led].kind != FX_NONE;
+}
@@ -312,3 +312,118 @@ void Open_PDM_Filter_128(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDM
   Param->OldZ = OldZ;
 }
  
+ 
+/*
+ * 32-bit word input (mono only).
+ *
+ * The PIO program can push 32 PDM bits per FIFO entry, first bit in bit 31,
+ * which the DMA stores as native (little-endian) words. These variants read
+ * the bytes of each word in time order (bits 31..24 first) so the result is
+ * identical to the byte functions above fed with the same bitstream, without
+ * swapping the buffer first.
+ */
+#define WORD_BYTE(w, n)   ((uint8_t)((w)[(n) >> 2] >> (24 - 8 * ((n) & 3))))
+ 
+#ifdef USE_LUT
+static int32_t filter_table_words_64(const uint32_t *w, uint8_t sincn)
+{
+  return (int32_t)
+    lut[WORD_BYTE(w, 0)][0][sincn] +
+    lut[WORD_BYTE(w, 1)][1][sincn] +
+    lut[WORD_BYTE(w, 2)][2][sincn] +
+    lut[WORD_BYTE(w, 3)][3][sincn] +
+    lut[WORD_BYTE(w, 4)][4][sincn] +
+    lut[WORD_BYTE(w, 5)][5][sincn] +
+    lut[WORD_BYTE(w, 6)][6][sincn] +
+    lut[WORD_BYTE(w, 7)][7][sincn];
+}
+static int32_t filter_table_words_128(const uint32_t *w, uint8_t sincn)
+{
+  return (int32_t)
+    lut[WORD_BYTE(w, 0)][0][sincn] +
+    lut[WORD_BYTE(w, 1)][1][sincn] +
+    lut[WORD_BYTE(w, 2)][2][sincn] +
+    lut[WORD_BYTE(w, 3)][3][sincn] +
+    lut[WORD_BYTE(w, 4)][4][sincn] +
+    lut[WORD_BYTE(w, 5)][5][sincn] +
+    lut[WORD_BYTE(w, 6)][6][sincn] +
+    lut[WORD_BYTE(w, 7)][7][sincn] +
+    lut[WORD_BYTE(w, 8)][8][sincn] +
+    lut[WORD_BYTE(w, 9)][9][sincn] +
+    lut[WORD_BYTE(w, 10)][10][sincn] +
+    lut[WORD_BYTE(w, 11)][11][sincn] +
+    lut[WORD_BYTE(w, 12)][12][sincn] +
+    lut[WORD_BYTE(w, 13)][13][sincn] +
+    lut[WORD_BYTE(w, 14)][14][sincn] +
+    lut[WORD_BYTE(w, 15)][15][sincn];
+}
+#else
+static int32_t filter_table_words(const uint32_t *w, uint8_t sincn, TPDMFilter_InitStruct *param)
+{
+  uint8_t bytes[DECIMATION_MAX / 8];
+  uint8_t n;
+ 
+  for (n = 0; n < param->Decimation / 8; n++)
+    bytes[n] = WORD_BYTE(w, n);
+  return filter_table(bytes, sincn, param);
+}
+#endif
+ 
+static void Open_PDM_Filter_Words(const uint32_t* data, uint16_t* dataOut, uint16_t volume, TPDMFilter_InitStruct *Param)
+{
+  uint8_t i;
+  uint8_t data_inc = Param->Decimation / 32;
+  int64_t Z, Z0, Z1, Z2;
+  int64_t OldOut, OldIn, OldZ;
+ 
+  OldOut = Param->OldOut;
+  OldIn = Param->OldIn;
+  OldZ = Param->OldZ;
+ 
+  for (i = 0; i < Param->Fs / 1000; i++) {
+#ifdef USE_LUT
+    if (Param->Decimation == 128) {
+      Z0 = filter_table_words_128(data, 0);
+      Z1 = filter_table_words_128(data, 1);
+      Z2 = filter_table_words_128(data, 2);
+    } else {
+      Z0 = filter_table_words_64(data, 0);
+      Z1 = filter_table_words_64(data, 1);
+      Z2 = filter_table_words_64(data, 2);
+    }
+#else
+    Z0 = filter_table_words(data, 0, Param);
+    Z1 = filter_table_words(data, 1, Param);
+    Z2 = filter_table_words(data, 2, Param);
+#endif
+ 
+    Z = Param->Coef[1] + Z2 - sub_const;
+    Param->Coef[1] = Param->Coef[0] + Z1;
+    Param->Coef[0] = Z0;
+ 
+    OldOut = (Param->HP_ALFA * (OldOut + Z - OldIn)) >> 8;
+    OldIn = Z;
+    OldZ = ((256 - Param->LP_ALFA) * OldZ + Param->LP_ALFA * OldOut) >> 8;
+ 
+    Z = OldZ * volume;
+    Z = RoundDiv(Z, div_const);
+    Z = SaturaLH(Z, -32700, 32700);
+ 
+    dataOut[i] = Z;
+    data += data_inc;
+  }
+ 
+  Param->OldOut = OldOut;
+  Param->OldIn = OldIn;
+  Param->OldZ = OldZ;
+}
+ 
+void Open_PDM_Filter_64_Words(const uint32_t* data, uint16_t* dataOut, uint16_t volume, TPDMFilter_InitStruct *Param)
+{
+  Open_PDM_Filter_Words(data, dataOut, volume, Param);
+}
+ 
+void Open_PDM_Filter_128_Words(const uint32_t* data, uint16_t* dataOut, uint16_t volume, TPDMFilter_InitStruct *Param)
+{
+  Open_PDM_Filter_Words(data, dataOut, volume, Param);
+}
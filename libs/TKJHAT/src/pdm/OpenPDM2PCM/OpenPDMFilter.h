@@ -95,6 +95,9 @@ typedef struct {
 void Open_PDM_Filter_Init(TPDMFilter_InitStruct *init_struct);
 void Open_PDM_Filter_64(uint8_t* data, uint16_t* data_out, uint16_t mic_gain, TPDMFilter_InitStruct *init_struct);
 void Open_PDM_Filter_128(uint8_t* data, uint16_t* data_out, uint16_t mic_gain, TPDMFilter_InitStruct *init_struct);
+/* Same filters for a mono bitstream packed in 32-bit words, first bit in bit 31. */
+void Open_PDM_Filter_64_Words(const uint32_t* data, uint16_t* data_out, uint16_t mic_gain, TPDMFilter_InitStruct *init_struct);
+void Open_PDM_Filter_128_Words(const uint32_t* data, uint16_t* data_out, uint16_t mic_gain, TPDMFilter_InitStruct *init_struct);
  
 #ifdef __cplusplus
 }
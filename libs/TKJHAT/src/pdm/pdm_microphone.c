@@ -13,24 +13,75 @@
 #include "hardware/clocks.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
 
 #include "OpenPDM2PCM/OpenPDMFilter.h"
 
 #include "pdm_microphone.pio.h"
 
 #include <tkjhat/pdm_microphone.h>
+#include <tkjhat/event_trace.h>
 
-#define PDM_DECIMATION       64
-#define PDM_RAW_BUFFER_COUNT 2
+#define PDM_DECIMATION       64     // default when the config leaves it at 0
+
+// Raw PDM blocks in a ring: the DMA fills one while the others wait for the
+// consumer, which filters them in pdm_microphone_acquire(). Three give the
+// consumer a full block period of slack before a block is dropped.
+#ifndef PDM_RAW_BUFFER_COUNT
+#define PDM_RAW_BUFFER_COUNT 3
+#endif
+
+// 1: the PIO pushes 32 PDM bits per FIFO entry and the DMA moves words
+// (a quarter of the transfers of the byte path); the filter reads the words
+// directly. 0: the original one-byte-per-push path.
+#ifndef PDM_WORD_PACKING
+#define PDM_WORD_PACKING 1
+#endif
+
+#if PDM_WORD_PACKING
+#define PDM_PUSH_BITS        32
+#define PDM_DMA_SIZE         DMA_SIZE_32
+#else
+#define PDM_PUSH_BITS        8
+#define PDM_DMA_SIZE         DMA_SIZE_8
+#endif
+
+// TKJHAT_STATIC_ALLOC: the buffers are static arrays sized for the largest
+// profile instead of being malloc'd on every profile change, so they show
+// up in the .map file and the heap is never touched.
+#if TKJHAT_STATIC_ALLOC
+#ifndef PDM_STATIC_MAX_SAMPLES
+#define PDM_STATIC_MAX_SAMPLES      256     // MEMS_BUFFER_SIZE
+#endif
+#ifndef PDM_STATIC_MAX_DECIMATION
+#define PDM_STATIC_MAX_DECIMATION   128     // MIC_PROFILE_16K_DEC128
+#endif
+static uint8_t pdm_raw_storage[PDM_RAW_BUFFER_COUNT][PDM_STATIC_MAX_SAMPLES * PDM_STATIC_MAX_DECIMATION / 8]
+    __attribute__((aligned(4)));
+static int16_t pdm_pcm_storage[PDM_STATIC_MAX_SAMPLES];
+#endif
 
 static struct {
     struct pdm_microphone_config config;
     int dma_channel;
+    uint pio_sm_offset;
+    uint decimation;
+    volatile bool running;
     uint8_t* raw_buffer[PDM_RAW_BUFFER_COUNT];
-    volatile int raw_buffer_write_index;
-    volatile int raw_buffer_read_index;
+    volatile uint32_t raw_filled;       // complete raw blocks, written only by the DMA handler
+    volatile uint32_t raw_taken;        // raw blocks filtered, written only by the consumer
     uint raw_buffer_size;
+    uint dma_transfer_count;
     uint dma_irq;
+    int16_t* pcm_buffer;                // the block lent to the consumer
+    uint pcm_samples;
+    volatile bool pcm_lent;
+    volatile uint32_t pcm_overruns;
+    volatile uint32_t filter_us_last;
+    volatile uint32_t filter_us_max;
+    volatile uint64_t filter_us_total;
+    volatile uint32_t filter_blocks;
     TPDMFilter_InitStruct filter;
     uint16_t filter_volume;
     pdm_samples_ready_handler_t samples_ready_handler;
@@ -40,26 +91,34 @@ static struct {
 
 
 static void pdm_dma_handler();
+static void pdm_filter_block(const uint8_t* in, int16_t* out, uint samples);
+static void pdm_free_buffers();
+static int pdm_alloc_buffers();
+static void pdm_apply_rate();
 
 int pdm_microphone_init(const struct pdm_microphone_config* config) {
     memset(&pdm_mic, 0x00, sizeof(pdm_mic));
     memcpy(&pdm_mic.config, config, sizeof(pdm_mic.config));
+    pdm_mic.dma_channel = -1;
 
     pdm_mic.stopping = false;
 
-    if (config->sample_buffer_size % (config->sample_rate / 1000)) {
+    if (pdm_mic.config.decimation == 0) {
+        pdm_mic.config.decimation = PDM_DECIMATION;
+    }
+
+    if (config->sample_rate % 1000 ||
+        (pdm_mic.config.decimation != 64 && pdm_mic.config.decimation != 128) ||
+        config->sample_buffer_size % (config->sample_rate / 1000)) {
         return -1;
     }
 
-    pdm_mic.raw_buffer_size = config->sample_buffer_size * (PDM_DECIMATION / 8);
+    pdm_mic.decimation = pdm_mic.config.decimation;
 
-    for (int i = 0; i < PDM_RAW_BUFFER_COUNT; i++) {
-        pdm_mic.raw_buffer[i] = malloc(pdm_mic.raw_buffer_size);
-        if (pdm_mic.raw_buffer[i] == NULL) {
-            pdm_microphone_deinit();
+    if (pdm_alloc_buffers() < 0) {
+        pdm_microphone_deinit();
 
-            return -1;   
-        }
+        return -1;
     }
 
     pdm_mic.dma_channel = dma_claim_unused_channel(true);
@@ -69,22 +128,23 @@ int pdm_microphone_init(const struct pdm_microphone_config* config) {
         return -1;
     }
 
-    uint pio_sm_offset = pio_add_program(config->pio, &pdm_microphone_data_program);
+    pdm_mic.pio_sm_offset = pio_add_program(config->pio, &pdm_microphone_data_program);
 
-    float clk_div = clock_get_hz(clk_sys) / (config->sample_rate * PDM_DECIMATION * 4.0);
+    float clk_div = clock_get_hz(clk_sys) / (config->sample_rate * pdm_mic.decimation * 4.0);
 
     pdm_microphone_data_init(
         config->pio,
         config->pio_sm,
-        pio_sm_offset,
+        pdm_mic.pio_sm_offset,
         clk_div,
         config->gpio_data,
-        config->gpio_clk
+        config->gpio_clk,
+        PDM_PUSH_BITS
     );
 
     dma_channel_config dma_channel_cfg = dma_channel_get_default_config(pdm_mic.dma_channel);
 
-    channel_config_set_transfer_data_size(&dma_channel_cfg, DMA_SIZE_8);
+    channel_config_set_transfer_data_size(&dma_channel_cfg, PDM_DMA_SIZE);
     channel_config_set_read_increment(&dma_channel_cfg, false);
     channel_config_set_write_increment(&dma_channel_cfg, true);
     channel_config_set_dreq(&dma_channel_cfg, pio_get_dreq(config->pio, config->pio_sm, false));
@@ -96,16 +156,14 @@ int pdm_microphone_init(const struct pdm_microphone_config* config) {
         &dma_channel_cfg,
         pdm_mic.raw_buffer[0],
         &config->pio->rxf[config->pio_sm],
-        pdm_mic.raw_buffer_size,
+        pdm_mic.dma_transfer_count,
         false
     );
 
-    pdm_mic.filter.Fs = config->sample_rate;
-    pdm_mic.filter.LP_HZ = config->sample_rate / 2;
+    pdm_apply_rate();
     pdm_mic.filter.HP_HZ = 10; 
     pdm_mic.filter.In_MicChannels = 1;
     pdm_mic.filter.Out_MicChannels = 1;
-    pdm_mic.filter.Decimation = PDM_DECIMATION;
     pdm_mic.filter.MaxVolume = 64;
     pdm_mic.filter.Gain = 16;
 
@@ -113,15 +171,75 @@ int pdm_microphone_init(const struct pdm_microphone_config* config) {
     return 0;
 }
 
-void pdm_microphone_deinit() {
+static int pdm_alloc_buffers() {
+    // Raw buffers hold decimation bits per output sample
+    pdm_mic.raw_buffer_size = pdm_mic.config.sample_buffer_size * (pdm_mic.decimation / 8);
+    pdm_mic.dma_transfer_count = pdm_mic.raw_buffer_size / (PDM_PUSH_BITS / 8);
+
+#if TKJHAT_STATIC_ALLOC
+    if (pdm_mic.raw_buffer_size > sizeof(pdm_raw_storage[0]) ||
+        pdm_mic.config.sample_buffer_size > PDM_STATIC_MAX_SAMPLES) {
+        return -1;
+    }
+#endif
+
+    for (int i = 0; i < PDM_RAW_BUFFER_COUNT; i++) {
+#if TKJHAT_STATIC_ALLOC
+        pdm_mic.raw_buffer[i] = pdm_raw_storage[i];
+#else
+        pdm_mic.raw_buffer[i] = malloc(pdm_mic.raw_buffer_size);
+#endif
+        if (pdm_mic.raw_buffer[i] == NULL) {
+            return -1;   
+        }
+    }
+
+    // Checked by the caller to be a whole number of 1 ms filter strides
+    pdm_mic.pcm_samples = pdm_mic.config.sample_buffer_size;
+
+#if TKJHAT_STATIC_ALLOC
+    pdm_mic.pcm_buffer = pdm_pcm_storage;
+#else
+    pdm_mic.pcm_buffer = malloc(pdm_mic.pcm_samples * sizeof(int16_t));
+#endif
+    if (pdm_mic.pcm_buffer == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void pdm_free_buffers() {
     for (int i = 0; i < PDM_RAW_BUFFER_COUNT; i++) {
         if (pdm_mic.raw_buffer[i]) {
+#if !TKJHAT_STATIC_ALLOC
             free(pdm_mic.raw_buffer[i]);
+#endif
 
             pdm_mic.raw_buffer[i] = NULL;
         }
     }
 
+    if (pdm_mic.pcm_buffer) {
+#if !TKJHAT_STATIC_ALLOC
+        free(pdm_mic.pcm_buffer);
+#endif
+
+        pdm_mic.pcm_buffer = NULL;
+    }
+}
+
+// Filter parameters that follow the sample rate and decimation. The
+// coefficient tables are rebuilt by Open_PDM_Filter_Init() on start.
+static void pdm_apply_rate() {
+    pdm_mic.filter.Fs = pdm_mic.config.sample_rate;
+    pdm_mic.filter.LP_HZ = pdm_mic.config.sample_rate / 2;
+    pdm_mic.filter.Decimation = pdm_mic.decimation;
+}
+
+void pdm_microphone_deinit() {
+    pdm_free_buffers();
+
     if (pdm_mic.dma_channel > -1) {
         dma_channel_unclaim(pdm_mic.dma_channel);
 
@@ -130,7 +248,12 @@ void pdm_microphone_deinit() {
 }
 
 int pdm_microphone_start() {
+    if (pdm_mic.raw_buffer[0] == NULL || pdm_mic.pcm_buffer == NULL) {
+        return -1;
+    }
+
     pdm_mic.stopping = false;
+    pdm_mic.running = true;
 
     // Reset SM cleanly before enabling
     pio_sm_set_enabled(pdm_mic.config.pio, pdm_mic.config.pio_sm, false);
@@ -155,13 +278,14 @@ int pdm_microphone_start() {
     // Enable SM and start the first DMA transfer
     pio_sm_set_enabled(pdm_mic.config.pio, pdm_mic.config.pio_sm, true);
 
-    pdm_mic.raw_buffer_write_index = 0;
-    pdm_mic.raw_buffer_read_index  = 0;
+    pdm_mic.raw_filled = 0;
+    pdm_mic.raw_taken = 0;
+    pdm_mic.pcm_lent = false;
 
     dma_channel_transfer_to_buffer_now(
         pdm_mic.dma_channel,
         pdm_mic.raw_buffer[0],
-        pdm_mic.raw_buffer_size
+        pdm_mic.dma_transfer_count
     );
 
     return 0;
@@ -187,33 +311,140 @@ void pdm_microphone_stop() {
     // 5) stop the PIO state machine
     pio_sm_set_enabled(pdm_mic.config.pio, pdm_mic.config.pio_sm, false);
 
-    // 6) reset indices
-    pdm_mic.raw_buffer_write_index = 0;
-    pdm_mic.raw_buffer_read_index  = 0;
+    // 6) drop blocks that were not consumed
+    pdm_mic.raw_taken = pdm_mic.raw_filled;
+    pdm_mic.pcm_lent = false;
+
+    pdm_mic.running = false;
 
     // leave stopping=true; start() will clear it
 }
 
-static void pdm_dma_handler() {
+int pdm_microphone_set_profile(uint sample_rate, uint decimation, uint sample_buffer_size) {
+    if (pdm_mic.running || pdm_mic.config.pio == NULL) {
+        return -1;
+    }
+
+    if (sample_rate == 0 || sample_rate % 1000 ||
+        (decimation != 64 && decimation != 128) ||
+        sample_buffer_size == 0 || sample_buffer_size % (sample_rate / 1000)) {
+        return -1;
+    }
+
+    // Buffer sizes change with the profile, so reallocate them all. On
+    // failure the previous profile and its buffers are restored; there was
+    // room for them a moment ago.
+    struct pdm_microphone_config previous = pdm_mic.config;
+    pdm_free_buffers();
+
+    pdm_mic.config.sample_rate = sample_rate;
+    pdm_mic.config.sample_buffer_size = sample_buffer_size;
+    pdm_mic.config.decimation = decimation;
+    pdm_mic.decimation = decimation;
+
+    if (pdm_alloc_buffers() < 0) {
+        pdm_free_buffers();
+
+        pdm_mic.config = previous;
+        pdm_mic.decimation = previous.decimation;
+        if (pdm_alloc_buffers() < 0) {
+            pdm_free_buffers();     // start() refuses to run without buffers
+        }
+        return -1;
+    }
+
+    // Four PIO cycles per PDM clock period
+    float clk_div = clock_get_hz(clk_sys) / (sample_rate * decimation * 4.0);
+    pio_sm_set_clkdiv(pdm_mic.config.pio, pdm_mic.config.pio_sm, clk_div);
+
+    pdm_apply_rate();
+
+    pdm_mic.raw_filled = 0;
+    pdm_mic.raw_taken = 0;
+    pdm_mic.pcm_lent = false;
+    pdm_mic.filter_us_last = 0;
+    pdm_mic.filter_us_max = 0;
+    pdm_mic.filter_us_total = 0;
+    pdm_mic.filter_blocks = 0;
+
+    return 0;
+}
+
+void pdm_microphone_get_stats(struct pdm_microphone_stats* stats) {
+    stats->sample_rate = pdm_mic.config.sample_rate;
+    stats->decimation = pdm_mic.decimation;
+    stats->sample_buffer_size = pdm_mic.config.sample_buffer_size;
+    stats->buffer_bytes = PDM_RAW_BUFFER_COUNT * pdm_mic.raw_buffer_size +
+                          pdm_mic.pcm_samples * sizeof(int16_t);
+    stats->block_period_us = (uint32_t)((uint64_t)pdm_mic.config.sample_buffer_size * 1000000u /
+                                        pdm_mic.config.sample_rate);
+    stats->filter_us_last = pdm_mic.filter_us_last;
+    stats->filter_us_max = pdm_mic.filter_us_max;
+    stats->filter_blocks = pdm_mic.filter_blocks;
+    stats->filter_us_avg = pdm_mic.filter_blocks ?
+                           (uint32_t)(pdm_mic.filter_us_total / pdm_mic.filter_blocks) : 0;
+    stats->overruns = pdm_mic.pcm_overruns;
+}
+
+// Buffer bookkeeping only; the filter runs in pdm_microphone_acquire()
+static void pdm_dma_service(void) {
     // clear IRQ first
     if (pdm_mic.dma_irq == DMA_IRQ_0) dma_hw->ints0 = (1u << pdm_mic.dma_channel);
     else                              dma_hw->ints1 = (1u << pdm_mic.dma_channel);
 
     if (pdm_mic.stopping) return;  // don't re-arm or callback while stopping
 
-    // normal handler body
-    pdm_mic.raw_buffer_read_index  = pdm_mic.raw_buffer_write_index;
-    pdm_mic.raw_buffer_write_index = (pdm_mic.raw_buffer_write_index + 1) % PDM_RAW_BUFFER_COUNT;
+    // The block just completed joins the ready ones unless the next slot is
+    // still waiting for the consumer; then it is dropped and its slot refilled.
+    uint32_t filled = pdm_mic.raw_filled;
+    bool ready = filled + 1 - pdm_mic.raw_taken < PDM_RAW_BUFFER_COUNT;
+    if (ready) filled++;
+    else pdm_mic.pcm_overruns++;
 
     dma_channel_transfer_to_buffer_now(
         pdm_mic.dma_channel,
-        pdm_mic.raw_buffer[pdm_mic.raw_buffer_write_index],
-        pdm_mic.raw_buffer_size
+        pdm_mic.raw_buffer[filled % PDM_RAW_BUFFER_COUNT],
+        pdm_mic.dma_transfer_count
     );
+    if (!ready) return;
+
+    __dmb();    // block contents visible before the count, also to the other core
+    pdm_mic.raw_filled = filled;
 
     if (pdm_mic.samples_ready_handler) pdm_mic.samples_ready_handler();
 }
 
+static void pdm_dma_handler() {
+    EVENT_TRACE_ISR_ENTER(pdm_mic.dma_irq);
+    pdm_dma_service();
+    EVENT_TRACE_ISR_EXIT(pdm_mic.dma_irq);
+}
+
+static void pdm_filter_block(const uint8_t* in, int16_t* out, uint samples) {
+    uint filter_stride = pdm_mic.filter.Fs / 1000;
+
+    uint in_stride = filter_stride * (pdm_mic.decimation / 8);
+
+    for (uint i = 0; i < samples; i += filter_stride) {
+#if PDM_WORD_PACKING
+        if (pdm_mic.decimation == 128) {
+            Open_PDM_Filter_128_Words((const uint32_t*)in, (uint16_t*)out, pdm_mic.filter_volume, &pdm_mic.filter);
+        } else {
+            Open_PDM_Filter_64_Words((const uint32_t*)in, (uint16_t*)out, pdm_mic.filter_volume, &pdm_mic.filter);
+        }
+#else
+        if (pdm_mic.decimation == 128) {
+            Open_PDM_Filter_128((uint8_t*)in, (uint16_t*)out, pdm_mic.filter_volume, &pdm_mic.filter);
+        } else {
+            Open_PDM_Filter_64((uint8_t*)in, (uint16_t*)out, pdm_mic.filter_volume, &pdm_mic.filter);
+        }
+#endif
+
+        in += in_stride;
+        out += filter_stride;
+    }
+}
+
 
 void pdm_microphone_set_samples_ready_handler(pdm_samples_ready_handler_t handler) {
     pdm_mic.samples_ready_handler = handler;
@@ -231,35 +462,64 @@ void pdm_microphone_set_filter_volume(uint16_t volume) {
     pdm_mic.filter_volume = volume;
 }
 
-int pdm_microphone_read(int16_t* buffer, size_t samples) {
-    int filter_stride = (pdm_mic.filter.Fs / 1000);
-    samples = (samples / filter_stride) * filter_stride;
-
-    if (samples > pdm_mic.config.sample_buffer_size) {
-        samples = pdm_mic.config.sample_buffer_size;
+int16_t* pdm_microphone_acquire(size_t* samples) {
+    // Only one block may be lent at a time
+    if (pdm_mic.pcm_lent || pdm_mic.raw_taken == pdm_mic.raw_filled) {
+        if (samples) *samples = 0;
+        return NULL;
     }
 
-    if (pdm_mic.raw_buffer_write_index == pdm_mic.raw_buffer_read_index) {
-        return 0;
+    __dmb();    // pairs with the barrier in the DMA handler
+    uint32_t taken = pdm_mic.raw_taken;
+
+    // Filter here, in the consumer's context, to keep the interrupt short.
+    // The raw block stays out of the DMA's reach until raw_taken moves on.
+    uint32_t start = time_us_32();
+    EVENT_TRACE_BEGIN(EVENT_TRACE_SPAN_FILTER);
+    pdm_filter_block(pdm_mic.raw_buffer[taken % PDM_RAW_BUFFER_COUNT],
+                     pdm_mic.pcm_buffer, pdm_mic.pcm_samples);
+    EVENT_TRACE_END(EVENT_TRACE_SPAN_FILTER);
+    uint32_t elapsed = time_us_32() - start;
+
+    pdm_mic.filter_us_last = elapsed;
+    if (elapsed > pdm_mic.filter_us_max) pdm_mic.filter_us_max = elapsed;
+    pdm_mic.filter_us_total += elapsed;
+    pdm_mic.filter_blocks++;
+
+    __dmb();    // finish reading the raw block before the handler may refill it
+    pdm_mic.raw_taken = taken + 1;
+    pdm_mic.pcm_lent = true;
+
+    if (samples) *samples = pdm_mic.pcm_samples;
+    return pdm_mic.pcm_buffer;
+}
+
+void pdm_microphone_release(int16_t* buffer) {
+    if (!pdm_mic.pcm_lent || buffer != pdm_mic.pcm_buffer) {
+        return;
     }
 
-    uint8_t* in = pdm_mic.raw_buffer[pdm_mic.raw_buffer_read_index];
-    int16_t* out = buffer;
+    pdm_mic.pcm_lent = false;
+}
 
-    pdm_mic.raw_buffer_read_index++;
+uint32_t pdm_microphone_get_overruns() {
+    return pdm_mic.pcm_overruns;
+}
 
-    for (int i = 0; i < samples; i += filter_stride) {
-#if PDM_DECIMATION == 64
-        Open_PDM_Filter_64(in, out, pdm_mic.filter_volume, &pdm_mic.filter);
-#elif PDM_DECIMATION == 128
-        Open_PDM_Filter_128(in, out, pdm_mic.filter_volume, &pdm_mic.filter);
-#else
-        #error "Unsupported PDM_DECIMATION value!"
-#endif
+int pdm_microphone_read(int16_t* buffer, size_t samples) {
+    size_t available;
+    int16_t* block = pdm_microphone_acquire(&available);
 
-        in += filter_stride * (PDM_DECIMATION / 8);
-        out += filter_stride;
+    if (block == NULL) {
+        return 0;
     }
 
+    if (samples > available) {
+        samples = available;
+    }
+
+    memcpy(buffer, block, samples * sizeof(int16_t));
+    pdm_microphone_release(block);
+
     return samples;
 }
@@ -28,39 +28,21 @@ SOFTWARE.
 #include <tkjhat/sdk.h>
 
 //#include "tusb.h" //is it needed?
-#include "hardware/irq.h"
-#include "hardware/pwm.h"
+#include <tkjhat/hal.h>
 #include <tkjhat/ssd1306.h>
 #include <tkjhat/pdm_microphone.h>
+#include <tkjhat/buzzer_sequencer.h>
+#include <tkjhat/led_effects.h>
+#include <tkjhat/sensor_trace.h>
 #include <stdio.h>
 #include <math.h>
 
 
 
 
-/* ===================================
- *  UTILITIES / FIXING HARDWARE BUGS
- * =================================== */
-
-//This trick tries to solve the leakage problem in rp2350 (Errata 9)
-#if defined(PICO_RP2350)
-    #include "hardware/gpio.h"
-
-    static inline bool gpio_get_safe(uint pin) {
-        hw_set_bits(&pads_bank0_hw->io[pin], PADS_BANK0_GPIO0_IE_BITS); // enable input buffer
-        __asm volatile("nop; nop; nop; nop;"); // short settle
-        bool v = gpio_get(pin);// read
-        hw_clear_bits(&pads_bank0_hw->io[pin], PADS_BANK0_GPIO0_IE_BITS); // disable input buffer again
-        //printf("Reading 2350");
-        return v;
-    }
-
-    // Redirect any later uses of gpio_get(...) to our safe version on RP2350
-    #define gpio_get(pin) gpio_get_safe((pin))
-#endif
-
-
-
+// All hardware access goes through tkjhat/hal.h (hal_pico.c on the board,
+// hal_mock.c on the host). The RP2350 Errata 9 workaround for input reads
+// lives in hal_pico.c.
 
 /* =========================
  *  GENERAL FUNCTIONS
@@ -79,15 +61,13 @@ void init_hat_sdk(){
 
  void init_sw1() {
     // Initialize the button pin as an input with a pull-up resistor
-    gpio_init(SW1_PIN);
-    gpio_set_dir(SW1_PIN, GPIO_IN);
+    hal_gpio_mode(SW1_PIN, HAL_GPIO_INPUT);
 
 }
 
  void init_sw2() {
     // Initialize the button pin as an input with a pull-up resistor
-    gpio_init(SW2_PIN);
-    gpio_set_dir(SW2_PIN, GPIO_IN);
+    hal_gpio_mode(SW2_PIN, HAL_GPIO_INPUT);
 }
 
 void init_button1(){
@@ -103,8 +83,7 @@ void init_button2(){
  * ========================= */
  void init_red_led() {
     // Initialize the LED pin as an output
-    gpio_init(RED_LED_PIN);
-    gpio_set_dir(RED_LED_PIN, GPIO_OUT);
+    hal_gpio_mode(RED_LED_PIN, HAL_GPIO_OUTPUT);
 }
 
 void init_led(){
@@ -112,8 +91,9 @@ void init_led(){
 }
 
 void toggle_red_led() {
-    bool curr = gpio_get(RED_LED_PIN);
-    gpio_put(RED_LED_PIN, !curr);
+    led_effect_stop(LED_EFFECT_RED);
+    bool curr = hal_gpio_get(RED_LED_PIN);
+    hal_gpio_put(RED_LED_PIN, !curr);
 }
 
 void toggle_led() {
@@ -121,7 +101,8 @@ void toggle_led() {
 }
 
 void set_red_led_status(bool status){
-    gpio_put(RED_LED_PIN,status);
+    led_effect_stop(LED_EFFECT_RED);
+    hal_gpio_put(RED_LED_PIN,status);
 }
 
 void set_led_status(bool status){
@@ -129,13 +110,9 @@ void set_led_status(bool status){
 }
 
 void blink_red_led(int n){
-    for (int i=0;i<n;i++){ 
-        toggle_red_led(); 
-        sleep_ms(120); 
-        toggle_red_led(); 
-        sleep_ms(120); 
-    }
-    gpio_put(RED_LED_PIN,false);
+    // Runs in the background on the LED effect timer, returns immediately
+    if (n <= 0) return;
+    led_effect_blink(LED_EFFECT_RED, 120, 120, (uint16_t)n);
 }
 
 void blink_led(int n){
@@ -144,104 +121,193 @@ void blink_led(int n){
 
 
 // RGB related function
- void init_rgb_led() {
-    // Initialize the PWM slice for each RGB pin
-    gpio_set_function(RGB_LED_R, GPIO_FUNC_PWM);
-    gpio_set_function(RGB_LED_G, GPIO_FUNC_PWM);
-    gpio_set_function(RGB_LED_B, GPIO_FUNC_PWM);
 
-    // Get the PWM slice numbers for each GPIO pin
-    uint slice_num_r = pwm_gpio_to_slice_num(RGB_LED_R);
-    uint slice_num_g = pwm_gpio_to_slice_num(RGB_LED_G);
-    uint slice_num_b = pwm_gpio_to_slice_num(RGB_LED_B);
+// Gamma table (gamma ~2.2 as 0.8*x^2 + 0.2*x^3) evaluated by the compiler
+// for the configured wrap, so rgb_led_write() is three table lookups.
+#define RGB_GAMMA_RAW(v) \
+    (((uint64_t)(RGB_PWM_WRAP) + 1u) * (4ull * 255u * (v) * (v) + (uint64_t)(v) * (v) * (v)) \
+     / (5ull * 255u * 255u * 255u))
+#define RGB_GAMMA(v)    ((uint16_t)(RGB_GAMMA_RAW(v) > 0xFFFFu ? 0xFFFFu : RGB_GAMMA_RAW(v)))
+#define RGB_G4(n)       RGB_GAMMA(n), RGB_GAMMA(n + 1), RGB_GAMMA(n + 2), RGB_GAMMA(n + 3)
+#define RGB_G16(n)      RGB_G4(n), RGB_G4(n + 4), RGB_G4(n + 8), RGB_G4(n + 12)
+#define RGB_G64(n)      RGB_G16(n), RGB_G16(n + 16), RGB_G16(n + 32), RGB_G16(n + 48)
 
-    // Set PWM clock to a frequency suitable for LED control
-    pwm_set_clkdiv(slice_num_r, 4.0f);
-    pwm_set_clkdiv(slice_num_g, 4.0f);
-    pwm_set_clkdiv(slice_num_b, 4.0f);
+static const uint16_t rgb_gamma[256] = {
+    RGB_G64(0), RGB_G64(64), RGB_G64(128), RGB_G64(192)
+};
+
+ void init_rgb_led() {
+    // R and G share a PWM slice, B is in the next one. Channel active to
+    // low level (common anode): invert the outputs so a level is directly
+    // the on-time
+    const uint32_t div16 = (uint32_t)(RGB_PWM_CLKDIV * 16.0f);
+    hal_pwm_init(RGB_LED_R, div16, RGB_PWM_WRAP, true, false);
+    hal_pwm_init(RGB_LED_G, div16, RGB_PWM_WRAP, true, false);
+    hal_pwm_init(RGB_LED_B, div16, RGB_PWM_WRAP, true, false);
+    rgb_led_write_levels(0, 0, 0);
 
-    // Enable PWM outputs
-    pwm_set_enabled(slice_num_r, true);
-    pwm_set_enabled(slice_num_g, true);
-    pwm_set_enabled(slice_num_b, true);
+    // Start both slices on the same cycle so their counters wrap together.
+    // The other slices keep running.
+    hal_pwm_enable((1u << RGB_LED_R) | (1u << RGB_LED_B), true);
 }
 
 //RGB off
 void stop_rgb_led(){
      // Stop PWM on those slices (optional)
-    pwm_set_enabled(pwm_gpio_to_slice_num(RGB_LED_R), false);
-    pwm_set_enabled(pwm_gpio_to_slice_num(RGB_LED_G), false);
-    pwm_set_enabled(pwm_gpio_to_slice_num(RGB_LED_B), false);
+    hal_pwm_enable((1u << RGB_LED_R) | (1u << RGB_LED_G) | (1u << RGB_LED_B), false);
 
     // Return pins to GPIO input (Hi-Z)
-    gpio_set_function(RGB_LED_R, GPIO_FUNC_SIO);
-    gpio_set_dir(RGB_LED_R, GPIO_IN);
-    gpio_disable_pulls(RGB_LED_R);
+    hal_gpio_mode(RGB_LED_R, HAL_GPIO_INPUT);
+    hal_gpio_pulls(RGB_LED_R, false, false);
 
-    gpio_set_function(RGB_LED_G, GPIO_FUNC_SIO);
-    gpio_set_dir(RGB_LED_G, GPIO_IN);
-    gpio_disable_pulls(RGB_LED_G);
+    hal_gpio_mode(RGB_LED_G, HAL_GPIO_INPUT);
+    hal_gpio_pulls(RGB_LED_G, false, false);
 
-    gpio_set_function(RGB_LED_B, GPIO_FUNC_SIO);
-    gpio_set_dir(RGB_LED_B, GPIO_IN);
-    gpio_disable_pulls(RGB_LED_B);
+    hal_gpio_mode(RGB_LED_B, HAL_GPIO_INPUT);
+    hal_gpio_pulls(RGB_LED_B, false, false);
 }
 
-//Channel active to low level (common anode). We need to invert the value
- void rgb_led_write(uint8_t r, uint8_t g, uint8_t b) {
+// Counts before the wrap in which a write might straddle it: a few bus
+// writes at the PWM clock (sys clock / RGB_PWM_CLKDIV)
+#define RGB_WRAP_GUARD  16u
 
-    //Invert the values
-    r = 255-r;
-    g = 255-g;
-    b = 255-b;
-    // Get the PWM slice numbers for each GPIO pin
-    uint slice_num_r = pwm_gpio_to_slice_num(RGB_LED_R);
-    uint slice_num_g = pwm_gpio_to_slice_num(RGB_LED_G);
-    uint slice_num_b = pwm_gpio_to_slice_num(RGB_LED_B);
+// A smaller wrap would leave no window to write in (or underflow the limit)
+_Static_assert(RGB_PWM_WRAP > 2 * RGB_WRAP_GUARD, "RGB_PWM_WRAP too small for the wrap guard");
 
-    // Convert the 0-255 value to a 16-bit duty cycle (0-65535)
-    uint16_t r_value = r * r; // Mapping 0-255 to 0-65535 (linearly)
-    uint16_t g_value = g * g; // Mapping 0-255 to 0-65535 (linearly)
-    uint16_t b_value = b * b; // Mapping 0-255 to 0-65535 (linearly)
+void rgb_led_write_levels(uint16_t r, uint16_t g, uint16_t b) {
+    // The compare registers are double buffered and latch at the wrap. R and
+    // G share one register; B is in the next slice, so both writes must land
+    // in the same period. If the wrap is about to happen, wait it out.
+    uint32_t irq = hal_irq_save();
+    if (hal_pwm_running(RGB_LED_R)) {
+        while (hal_pwm_counter(RGB_LED_R) > RGB_PWM_WRAP - RGB_WRAP_GUARD) {
+        }
+    }
+    hal_pwm_set_levels(RGB_LED_R, r, g);
+    hal_pwm_set_level(RGB_LED_B, b);
+    hal_irq_restore(irq);
+}
 
-    // Set the PWM level for each color
-    pwm_set_gpio_level(RGB_LED_R, r_value);
-    pwm_set_gpio_level(RGB_LED_G, g_value);
-    pwm_set_gpio_level(RGB_LED_B, b_value);
+ void rgb_led_write(uint8_t r, uint8_t g, uint8_t b) {
+    rgb_led_write_levels(rgb_gamma[r], rgb_gamma[g], rgb_gamma[b]);
 }
 
 /* =========================
  *  BUZZER
  * ========================= */
 
+// The buzzer is driven by the PWM slice of BUZZER_PIN (GPIO 17 = slice 0,
+// channel B) at 50 % duty, and each timed tone is ended by a hardware alarm,
+// so the CPU is free while a tone plays.
+static uint16_t buzzer_top;
+static volatile hal_alarm_t buzzer_alarm = 0;
+static volatile uint32_t buzzer_generation = 0;
+static volatile bool buzzer_playing = false;
+
  void init_buzzer() {
-    // Initialize the buzzer pin as an output
-    gpio_init(BUZZER_PIN);
-    gpio_set_dir(BUZZER_PIN, GPIO_OUT);
+    hal_pwm_init(BUZZER_PIN, 16, 0xFFFF, false, true);
+    hal_pwm_set_level(BUZZER_PIN, 0);
+    buzzer_playing = false;
+
+    buzzer_seq_init();
 }
 
- void buzzer_play_tone(uint32_t frequency, uint32_t duration_ms) {
-    // Calculate the period (in microseconds) and number of cycles
-    uint32_t period_us = 1000000 / frequency;
-    uint32_t num_cycles = duration_ms * frequency / 1000;
-
-    // Generate the tone by toggling the buzzer pin at the specified frequency
-    for (uint32_t i = 0; i < num_cycles; i++) {
-        gpio_put(BUZZER_PIN, 1);
-        busy_wait_us(period_us / 2);
-        gpio_put(BUZZER_PIN, 0);
-        busy_wait_us(period_us / 2);
+// Finds the smallest 8.4 fixed-point divider that lets the counter reach
+// the frequency, then rounds TOP: f = clk_sys / (div * (TOP + 1)).
+// Returns the frequency actually produced.
+static uint32_t buzzer_set_frequency(uint32_t frequency) {
+    uint32_t sys_hz = hal_pwm_clock_hz();
+    uint64_t sys_x16 = (uint64_t)sys_hz * 16u;
+
+    uint64_t div16 = (sys_x16 + (uint64_t)frequency * 65536u - 1) / ((uint64_t)frequency * 65536u);
+    if (div16 < 16) div16 = 16;                 // divider 1.0
+    if (div16 > 0xFFF) div16 = 0xFFF;           // divider 255 + 15/16
+
+    uint64_t wrap = (sys_x16 + (div16 * frequency) / 2) / (div16 * frequency);
+    if (wrap < 2) wrap = 2;
+    if (wrap > 65536) wrap = 65536;
+
+    buzzer_top = (uint16_t)(wrap - 1);
+    hal_pwm_set_period(BUZZER_PIN, (uint32_t)div16, buzzer_top);
+
+    return (uint32_t)(sys_x16 / (div16 * wrap));
+}
+
+static int64_t buzzer_alarm_cb(hal_alarm_t id, void *user_data) {
+    (void)id;
+    // A newer tone may have been started after this alarm was armed
+    if ((uint32_t)(uintptr_t)user_data == buzzer_generation) {
+        hal_pwm_set_level(BUZZER_PIN, 0);
+        buzzer_playing = false;
+        buzzer_alarm = 0;
     }
+    return 0;
+}
+
+uint32_t buzzer_start_tone(uint32_t frequency) {
+    if (buzzer_alarm > 0) {
+        hal_alarm_cancel(buzzer_alarm);
+        buzzer_alarm = 0;
+    }
+    buzzer_generation++;
+
+    if (frequency == 0) {
+        buzzer_turn_off();
+        return 0;
+    }
+
+    uint32_t actual = buzzer_set_frequency(frequency);
+    hal_pwm_set_level(BUZZER_PIN, (buzzer_top + 1u) / 2u);
+    buzzer_playing = true;
+    return actual;
+}
+
+uint32_t buzzer_play_tone_async(uint32_t frequency, uint32_t duration_ms) {
+    uint32_t actual = buzzer_start_tone(frequency);
+    if (actual == 0 || duration_ms == 0) {
+        buzzer_turn_off();
+        return actual;
+    }
+
+    hal_alarm_t id = hal_alarm_in_us((uint64_t)duration_ms * 1000u, buzzer_alarm_cb,
+                                     (void *)(uintptr_t)buzzer_generation);
+    if (id > 0) {
+        buzzer_alarm = id;
+    } else if (id < 0) {
+        // No alarm slots: do not leave the tone on forever
+        buzzer_turn_off();
+    }
+    return actual;
+}
+
+ void buzzer_play_tone(uint32_t frequency, uint32_t duration_ms) {
+    buzzer_play_tone_async(frequency, duration_ms);
+
+    // Wait for the tone like before. With FreeRTOS pico_time interop this
+    // blocks only the calling task, the CPU is not kept busy.
+    hal_sleep_ms(duration_ms);
+}
+
+bool buzzer_is_playing() {
+    return buzzer_playing;
 }
 
  void buzzer_turn_off() {
-    // Turn off the buzzer by setting the pin to low
-    gpio_put(BUZZER_PIN, 0);
+    if (buzzer_alarm > 0) {
+        hal_alarm_cancel(buzzer_alarm);
+        buzzer_alarm = 0;
+    }
+    buzzer_generation++;
+    hal_pwm_set_level(BUZZER_PIN, 0);
+    buzzer_playing = false;
 }
 
 void deinit_buzzer() {
+    buzzer_turn_off();
+    hal_pwm_enable(1u << BUZZER_PIN, false);
+
     // Deinitialize the buzzer pin
-    gpio_deinit(BUZZER_PIN);
+    hal_gpio_mode(BUZZER_PIN, HAL_GPIO_OFF);
 }
 
 /* =========================
@@ -249,11 +315,7 @@ void deinit_buzzer() {
  * ========================= */
 // Initialize I2C peripheral
 void init_i2c(uint sda_pin, uint scl_pin) {
-    i2c_init(i2c_default, 400*1000);
-    gpio_set_function(sda_pin, GPIO_FUNC_I2C);
-    gpio_set_function(scl_pin, GPIO_FUNC_I2C);
-    gpio_pull_up(sda_pin);
-    gpio_pull_up(scl_pin);
+    hal_i2c_init(400*1000, sda_pin, scl_pin);
 }
 
 void init_i2c_default(){
@@ -262,23 +324,26 @@ void init_i2c_default(){
 
 // Generic I2C write function
 bool i2c_write(uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
-    int bytes_written = i2c_write_blocking(i2c_default, addr, src, len, nostop);
+    int bytes_written = hal_i2c_write(addr, src, len, nostop);
     return bytes_written == (int)len;
 }
 
 // Generic I2C read function
 bool i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
-    int bytes_read = i2c_read_blocking(i2c_default, addr, dst, len, nostop);
+    int bytes_read = hal_i2c_read(addr, dst, len, nostop);
     return bytes_read == (int)len;
 }
 
 /* =========================
  *  MICROPHONE
  * ========================= */
+// PIO + DMA, not behind the HAL: the host builds (TKJHAT_HAL_MOCK) leave
+// the microphone out.
+#if !TKJHAT_HAL_MOCK
 // Uses https://github.com/ArmDeveloperEcosystem/microphone-library-for-pico/tree/main
 // Uses pio to read pdm data and OpenPDM2PCM library to transform PDM to PCM
 // Microphone related functions
-// Sample rate: 16Khz
+// Default profile: 8 kHz, decimation 64. See set_microphone_profile().
 // Buffer size: 256 samples.
  int init_pdm_microphone() {
     const struct pdm_microphone_config config = {
@@ -299,6 +364,9 @@ bool i2c_read(uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
 
     // number of samples to buffer
     .sample_buffer_size = MEMS_BUFFER_SIZE,
+
+    // PDM bits per PCM sample
+    .decimation = MEMS_DECIMATION,
     };
 
     return pdm_microphone_init(&config);
@@ -321,6 +389,49 @@ int get_microphone_samples(int16_t* buffer, size_t samples) {
     return pdm_microphone_read(buffer,samples);
 }
 
+int16_t *acquire_microphone_samples(size_t *samples) {
+    int16_t *block = pdm_microphone_acquire(samples);
+    if (block != NULL && !sensor_trace_take(SENSOR_TRACE_MIC, block, *samples * sizeof(int16_t))) {
+        sensor_trace_put(SENSOR_TRACE_MIC, block, *samples * sizeof(int16_t));
+    }
+    return block;
+}
+
+void release_microphone_samples(int16_t *buffer) {
+    pdm_microphone_release(buffer);
+}
+
+uint32_t get_microphone_overruns(void) {
+    return pdm_microphone_get_overruns();
+}
+
+static const struct {
+    uint sample_rate;
+    uint decimation;
+} mic_profiles[MIC_PROFILE_COUNT] = {
+    [MIC_PROFILE_8K_DEC64]   = {  8000,  64 },
+    [MIC_PROFILE_16K_DEC64]  = { 16000,  64 },
+    [MIC_PROFILE_16K_DEC128] = { 16000, 128 },
+};
+
+int set_microphone_profile(mic_profile_t profile) {
+    if ((unsigned)profile >= MIC_PROFILE_COUNT) return -1;
+    return pdm_microphone_set_profile(mic_profiles[profile].sample_rate,
+                                      mic_profiles[profile].decimation,
+                                      MEMS_BUFFER_SIZE);
+}
+
+uint32_t get_microphone_sample_rate(void) {
+    struct pdm_microphone_stats stats;
+    pdm_microphone_get_stats(&stats);
+    return stats.sample_rate;
+}
+
+void get_microphone_stats(struct pdm_microphone_stats *stats) {
+    pdm_microphone_get_stats(stats);
+}
+
+#endif // !TKJHAT_HAL_MOCK
 
 /* =========================
  *  DISPLAY SSD1306
@@ -356,7 +467,7 @@ void write_text_xy(int16_t x0, int16_t y0, const char *text) {
     ssd1306_show(&disp);
 
     // Delay for 800 milliseconds
-    sleep_ms(800);
+    hal_sleep_ms(800);
 }
 
 void write_text(const char *text) {
@@ -370,7 +481,7 @@ void write_text(const char *text) {
     ssd1306_show(&disp);
 
     // Delay for 800 milliseconds
-    sleep_ms(800);
+    hal_sleep_ms(800);
 }
 
 /**
@@ -525,8 +636,8 @@ void init_veml6030() {
     };
     
     // Write configuration to sensor
-    i2c_write_blocking(i2c_default, VEML6030_I2C_ADDR, config, sizeof(config), false);
-    sleep_ms(10);
+    hal_i2c_write(VEML6030_I2C_ADDR, config, sizeof(config), false);
+    hal_sleep_ms(10);
 }
 
 // Read light level from VEML6030
@@ -556,8 +667,11 @@ uint32_t veml6030_read_light() {
     uint8_t txBuffer[1] = {VEML6030_ALS_REG};
     uint8_t rxBuffer[2];
 
-    i2c_write_blocking(i2c_default, VEML6030_I2C_ADDR, txBuffer, 1, true);
-    i2c_read_blocking(i2c_default, VEML6030_I2C_ADDR, rxBuffer, 2, false);
+    if (!sensor_trace_take(SENSOR_TRACE_LIGHT, rxBuffer, sizeof(rxBuffer))) {
+        hal_i2c_write(VEML6030_I2C_ADDR, txBuffer, 1, true);
+        hal_i2c_read(VEML6030_I2C_ADDR, rxBuffer, 2, false);
+        sensor_trace_put(SENSOR_TRACE_LIGHT, rxBuffer, sizeof(rxBuffer));
+    }
 
     uint16_t raw = ((uint16_t)rxBuffer[1] << 8) | rxBuffer[0];
     return raw * 0.5376;
@@ -583,9 +697,9 @@ static uint16_t _veml6030_read_register(uint8_t reg) {
     uint8_t data[2] = {0,0};
 
     // Select ALS output register
-    i2c_write_blocking(i2c_default, VEML6030_I2C_ADDR, &reg, 1, true);
+    hal_i2c_write(VEML6030_I2C_ADDR, &reg, 1, true);
     // Read two bytes (MSB first)
-    i2c_read_blocking(i2c_default, VEML6030_I2C_ADDR, data, sizeof(data), false);
+    hal_i2c_read(VEML6030_I2C_ADDR, data, sizeof(data), false);
     //data [0] contains the LSB and data[1] the MSB
     return ((uint16_t)data[0]) |((uint16_t) data[1]<<8);
 }
@@ -598,8 +712,8 @@ void veml6030_stop(){
     };
     
     // Write configuration to sensor
-    i2c_write_blocking(i2c_default, VEML6030_I2C_ADDR, config, sizeof(config), false);
-    sleep_ms(10);
+    hal_i2c_write(VEML6030_I2C_ADDR, config, sizeof(config), false);
+    hal_sleep_ms(10);
 }
 
 
@@ -627,7 +741,7 @@ void veml6030_stop(){
  static void hdc2021_reset() {
     uint8_t configContents = read_hdc2021_register(HDC2021_CONFIG);
     write_register(HDC2021_CONFIG, configContents | 0x80);
-    sleep_ms(50);
+    hal_sleep_ms(50);
 }
 
 static void hdc2021_setMeasurementMode() {
@@ -703,8 +817,11 @@ float hdc2021_read_temperature() {
     uint8_t reg = HDC2021_TEMP_LOW;
     uint8_t data[2];
     
-    i2c_write(HDC2021_I2C_ADDRESS, &reg, 1, true);
-    i2c_read(HDC2021_I2C_ADDRESS, data, 2, false);
+    if (!sensor_trace_take(SENSOR_TRACE_TEMP, data, sizeof(data))) {
+        i2c_write(HDC2021_I2C_ADDRESS, &reg, 1, true);
+        i2c_read(HDC2021_I2C_ADDRESS, data, 2, false);
+        sensor_trace_put(SENSOR_TRACE_TEMP, data, sizeof(data));
+    }
     uint16_t raw = ((uint16_t) data[1] << 8) | data[0];
     return (raw * 165.0f / 65536.0f) - 40.0f;
 }
@@ -714,8 +831,11 @@ float hdc2021_read_humidity() {
     uint8_t reg = HDC2021_HUMIDITY_LOW;
     uint8_t data[2];
     
-    i2c_write(HDC2021_I2C_ADDRESS, &reg, 1, true);
-    i2c_read(HDC2021_I2C_ADDRESS, data, 2, false);
+    if (!sensor_trace_take(SENSOR_TRACE_HUMIDITY, data, sizeof(data))) {
+        i2c_write(HDC2021_I2C_ADDRESS, &reg, 1, true);
+        i2c_read(HDC2021_I2C_ADDRESS, data, 2, false);
+        sensor_trace_put(SENSOR_TRACE_HUMIDITY, data, sizeof(data));
+    }
     
     uint16_t raw = ((uint16_t) data[1] << 8) | data[0];
     return (raw * 100.0f / 65536.0f);
@@ -746,28 +866,28 @@ float aRes, gRes;      // scale resolutions per LSB for the sensors
 
 static int icm_i2c_write_byte(uint8_t reg, uint8_t value) {
     uint8_t buf[2] = { reg, value };
-    int result = i2c_write_blocking(i2c_default, ICM42670_I2C_ADDRESS, buf, 2, false);
+    int result = hal_i2c_write(ICM42670_I2C_ADDRESS, buf, 2, false);
     return result == 2 ? 0 : -1;
 }
 
 // helper to read a byte from a register
 static int icm_i2c_read_byte(uint8_t reg, uint8_t *value) {
-    int result = i2c_write_blocking(i2c_default, ICM42670_I2C_ADDRESS, &reg, 1, true);
+    int result = hal_i2c_write(ICM42670_I2C_ADDRESS, &reg, 1, true);
     if (result != 1) return -1;
-    result = i2c_read_blocking(i2c_default, ICM42670_I2C_ADDRESS, value, 1, false);
+    result = hal_i2c_read(ICM42670_I2C_ADDRESS, value, 1, false);
     return result == 1 ? 0 : -1;
 }
 
 static int icm_i2c_read_bytes(uint8_t reg, uint8_t *buffer, uint8_t len) {
-    int result = i2c_write_blocking(i2c_default, ICM42670_I2C_ADDRESS, &reg, 1, true);
+    int result = hal_i2c_write(ICM42670_I2C_ADDRESS, &reg, 1, true);
     if (result != 1) return -1;
-    result = i2c_read_blocking(i2c_default, ICM42670_I2C_ADDRESS, buffer, len, false);
+    result = hal_i2c_read(ICM42670_I2C_ADDRESS, buffer, len, false);
     return result == len ? 0 : -2;
 }
 
 static int icm_soft_reset(void) {
     int rc = icm_i2c_write_byte(ICM42670_REG_SIGNAL_PATH_RESET, ICM42670_RESET_CONFIG_BITS);
-    sleep_us(400);   // small wait: datasheet calls for ~200 µs before other writes
+    hal_sleep_us(400);   // small wait: datasheet calls for ~200 µs before other writes
     //TODO: For making more robust. Wait till the MCKL_READY is on (clock is running again)
     return rc;
 }
@@ -780,8 +900,8 @@ static int ICM42670_autodetect_address(void) {
         int hits = 0;
         for (int t = 0; t < 4; ++t) {
             uint8_t who = 0, reg = ICM42670_REG_WHO_AM_I;
-            if (i2c_write_blocking(i2c_default, cand[i], &reg, 1, true) != 1) continue;
-            if (i2c_read_blocking(i2c_default, cand[i], &who, 1, false) != 1) continue;
+            if (hal_i2c_write(cand[i], &reg, 1, true) != 1) continue;
+            if (hal_i2c_read(cand[i], &who, 1, false) != 1) continue;
             if (who == ICM42670_WHO_AM_I_RESPONSE) ++hits;
         }
         if (hits >= 3) { return cand[i]; } // majority wins
@@ -800,6 +920,7 @@ static void calibrateGyro(float *dest2){
 }
 
 int init_ICM42670() {
+    // Non-blocking: the blinks run while the sensor is being set up
     blink_led(5);
     
     //Soft reset
@@ -826,7 +947,7 @@ int init_ICM42670() {
         return -4;
     }
     // tiny guard delay after init writes
-    sleep_us(200);
+    hal_sleep_us(200);
     
     // Step 3: Success
     return 0;
@@ -872,7 +993,7 @@ int ICM42670_startAccel(uint16_t odr_hz, uint16_t fsr_g) {
     // Combine into ACCEL_CONFIG0: [7:5] = fsr, [3:0] = odr
     uint8_t accel_config0_val = (fsr_bits << 5) | (odr_bits & 0x0F);
     int rc = icm_i2c_write_byte(ICM42670_ACCEL_CONFIG0_REG, accel_config0_val);
-    sleep_us(200); 
+    hal_sleep_us(200); 
     if (rc != 0) return -3;
     return 0; // success
 }
@@ -917,14 +1038,14 @@ int ICM42670_startGyro(uint16_t odr_hz, uint16_t fsr_dps) {
     // Write GYRO_CONFIG0
     uint8_t gyro_config0_val = (fsr_bits << 5) | (odr_bits & 0x0F);
     if (icm_i2c_write_byte(ICM42670_GYRO_CONFIG0_REG, gyro_config0_val) != 0) return -3;
-    sleep_us(200); 
+    hal_sleep_us(200); 
     return 0;
 }
 
 //put in low noise both acc and gyr
 int ICM42670_enable_accel_gyro_ln_mode() {
     int rc = icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG , 0x0F); // bits 3:2 = gyro LN, bits 1:0 = accel LN
-    sleep_us(200);
+    hal_sleep_us(200);
     return rc;
 }
 
@@ -933,7 +1054,7 @@ int ICM42670_enable_ultra_low_power_mode(void) {
     // Accel = LP (10), Gyro = OFF (00)
     // PWR_MGMT0 = 0b00000010 = 0x02
     int rc = icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG , 0x02);
-    sleep_us(200);
+    hal_sleep_us(200);
     return rc;
 }
 
@@ -942,7 +1063,55 @@ int ICM42670_enable_accel_gyro_lp_mode(void) {
     // Gyro = 10 (LP), Accel = 10 (LP)
     // 0b00001010 = 0x0A
     int rc = icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG, 0x0A);
-    sleep_us(200);
+    hal_sleep_us(200);
+    return rc;
+}
+
+// MREG1 registers are written indirectly (datasheet 14.3)
+static int icm_mreg1_write(uint8_t reg, uint8_t value) {
+    if (icm_i2c_write_byte(ICM42670_BLK_SEL_W_REG, 0x00) != 0) return -1;
+    if (icm_i2c_write_byte(ICM42670_MADDR_W_REG, reg) != 0) return -1;
+    if (icm_i2c_write_byte(ICM42670_M_W_REG, value) != 0) return -1;
+    hal_sleep_us(10);
+    return 0;
+}
+
+int ICM42670_enable_wake_on_motion(uint16_t threshold_mg) {
+    if (threshold_mg < 4 || threshold_mg > 996) return -1;
+    uint8_t thr = (uint8_t)((threshold_mg * 256u + 500u) / 1000u);
+
+    // Accel LP at 50 Hz, gyro off (datasheet 8.7: WOM programming sequence)
+    if (ICM42670_startAccel(ICM42670_WOM_ODR_HZ, ICM42670_ACCEL_FSR_DEFAULT) != 0) return -2;
+    if (ICM42670_enable_ultra_low_power_mode() != 0) return -2;
+
+    if (icm_mreg1_write(ICM42670_MREG1_ACCEL_WOM_X_THR, thr) != 0 ||
+        icm_mreg1_write(ICM42670_MREG1_ACCEL_WOM_Y_THR, thr) != 0 ||
+        icm_mreg1_write(ICM42670_MREG1_ACCEL_WOM_Z_THR, thr) != 0) {
+        return -3;
+    }
+    hal_sleep_ms(1);
+
+    if (icm_i2c_write_byte(ICM42670_INT_SOURCE1_REG, ICM42670_WOM_XYZ_INT1_EN) != 0) return -4;
+    hal_sleep_ms(50);   // let the first LP samples settle, otherwise WOM fires at once
+
+    uint8_t status;
+    icm_i2c_read_byte(ICM42670_INT_STATUS2_REG, &status);   // clear on read
+    if (icm_i2c_write_byte(ICM42670_WOM_CONFIG_REG, ICM42670_WOM_MODE_PREVIOUS | ICM42670_WOM_EN) != 0) return -5;
+    return 0;
+}
+
+int ICM42670_disable_wake_on_motion(void) {
+    int rc = icm_i2c_write_byte(ICM42670_WOM_CONFIG_REG, 0x00);
+    if (icm_i2c_write_byte(ICM42670_INT_SOURCE1_REG, 0x00) != 0) rc = -1;
+    uint8_t status;
+    if (icm_i2c_read_byte(ICM42670_INT_STATUS2_REG, &status) != 0) rc = -1;
+    return rc;
+}
+
+int ICM42670_power_down(void) {
+    // Accel = OFF (00), Gyro = OFF (00)
+    int rc = icm_i2c_write_byte(ICM42670_PWR_MGMT0_REG, 0x00);
+    hal_sleep_us(200);
     return rc;
 }
 
@@ -972,8 +1141,12 @@ int ICM42670_read_sensor_data(float *ax, float *ay, float *az,
         
         uint8_t raw[14]; // 14 bytes total from TEMP to GYRO Z
 
-        int rc = icm_i2c_read_bytes(ICM42670_SENSOR_DATA_START_REG, raw, sizeof(raw));
-        if (rc != 0) return rc;
+        // Recorded or replayed as the raw registers (tkjhat/sensor_trace.h)
+        if (!sensor_trace_take(SENSOR_TRACE_IMU, raw, sizeof(raw))) {
+            int rc = icm_i2c_read_bytes(ICM42670_SENSOR_DATA_START_REG, raw, sizeof(raw));
+            if (rc != 0) return rc;
+            sensor_trace_put(SENSOR_TRACE_IMU, raw, sizeof(raw));
+        }
 
         // Convert to signed 16-bit integers (big-endian)
         int16_t t_raw = (int16_t)((raw[0] << 8) | raw[1]);
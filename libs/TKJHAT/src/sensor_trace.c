@@ -0,0 +1,330 @@
+#include <string.h>
+
+#include <tkjhat/base64.h>
+#include <tkjhat/hal.h>
+#include <tkjhat/sensor_trace.h>
+
+#define TRACE_MASK (SENSOR_TRACE_BUFFER_SIZE - 1u)
+
+#if (SENSOR_TRACE_BUFFER_SIZE & TRACE_MASK) != 0
+#error "SENSOR_TRACE_BUFFER_SIZE must be a power of two"
+#endif
+
+#define MAX_RECORD  (SENSOR_TRACE_HEADER_SIZE + SENSOR_TRACE_MAX_PAYLOAD)
+
+// Recording: records back to back in a ring, head, tail and sent
+// free-running. Drained records are freed at once when streaming; a ring
+// recording only moves sent, so it can still be replayed after the dump.
+// Replay: the trace is linear, either the caller's or this buffer rotated
+// so that the oldest record is at the start.
+static uint8_t buf[SENSOR_TRACE_BUFFER_SIZE];
+static uint32_t head, tail, sent;
+
+static struct {
+    volatile sensor_trace_state_t state;
+    sensor_trace_mode_t mode;
+    uint32_t mask;
+    uint64_t start_us;
+    uint32_t records;
+    uint32_t dropped;
+
+    const uint8_t *trace;
+    size_t len;
+    size_t cursor[SENSOR_TRACE_TYPES];      // next record to look at, per type
+    uint32_t pending;                       // types with records left
+    sensor_trace_button_fn button_fn;
+
+    hal_lock_t lock;
+} st;
+
+static void lock_init(void) {
+    if (!hal_lock_ready(&st.lock)) {
+        hal_lock_init(&st.lock);
+    }
+}
+
+static uint16_t get_u16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t get_u32(const uint8_t *p) { return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16); }
+
+/* ---- recording ---- */
+
+static void ring_read(uint32_t pos, uint8_t *out, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = buf[(pos + i) & TRACE_MASK];
+}
+
+static void ring_write(const uint8_t *in, size_t n) {
+    for (size_t i = 0; i < n; i++) buf[head++ & TRACE_MASK] = in[i];
+}
+
+// Called with the lock held
+static void put_locked(sensor_trace_type_t type, const void *data, size_t len) {
+    const size_t need = SENSOR_TRACE_HEADER_SIZE + len;
+    if (need > SENSOR_TRACE_BUFFER_SIZE) {
+        st.dropped++;
+        return;
+    }
+    if (st.mode == SENSOR_TRACE_RING) {
+        // Make room by dropping the oldest records
+        while (SENSOR_TRACE_BUFFER_SIZE - (head - tail) < need) {
+            uint8_t hdr[SENSOR_TRACE_HEADER_SIZE];
+            ring_read(tail, hdr, sizeof(hdr));
+            tail += SENSOR_TRACE_HEADER_SIZE + get_u16(&hdr[1]);
+            if ((int32_t)(sent - tail) < 0) sent = tail;
+            st.dropped++;
+        }
+    } else if (SENSOR_TRACE_BUFFER_SIZE - (head - tail) < need) {
+        st.dropped++;
+        return;
+    }
+
+    uint32_t t = (uint32_t)(hal_time_us() - st.start_us);
+    uint8_t hdr[SENSOR_TRACE_HEADER_SIZE] = {
+        (uint8_t)type, (uint8_t)len, (uint8_t)(len >> 8),
+        (uint8_t)t, (uint8_t)(t >> 8), (uint8_t)(t >> 16), (uint8_t)(t >> 24),
+    };
+    ring_write(hdr, sizeof(hdr));
+    ring_write(data, len);
+    st.records++;
+}
+
+void sensor_trace_put(sensor_trace_type_t type, const void *data, size_t len) {
+    if (st.state != SENSOR_TRACE_RECORDING || !(st.mask & SENSOR_TRACE_MASK(type))) return;
+    if (len > SENSOR_TRACE_MAX_PAYLOAD) len = SENSOR_TRACE_MAX_PAYLOAD;
+
+    hal_lock_enter(&st.lock);
+    if (st.state == SENSOR_TRACE_RECORDING) put_locked(type, data, len);
+    hal_lock_exit(&st.lock);
+}
+
+void sensor_trace_record(sensor_trace_mode_t mode, uint32_t type_mask) {
+    lock_init();
+
+    hal_lock_enter(&st.lock);
+    head = tail = sent = 0;
+    st.mode = mode;
+    st.mask = type_mask & SENSOR_TRACE_ALL;
+    st.start_us = hal_time_us();
+    st.records = 0;
+    st.dropped = 0;
+    st.trace = NULL;
+
+    const uint8_t info[2] = { SENSOR_TRACE_VERSION, (uint8_t)st.mask };
+    put_locked(SENSOR_TRACE_INFO, info, sizeof(info));
+    st.state = SENSOR_TRACE_RECORDING;
+    hal_lock_exit(&st.lock);
+}
+
+void sensor_trace_stop(void) {
+    lock_init();
+
+    hal_lock_enter(&st.lock);
+    st.state = SENSOR_TRACE_IDLE;
+    st.trace = NULL;
+    hal_lock_exit(&st.lock);
+}
+
+void sensor_trace_button(uint32_t gpio, uint32_t events) {
+    const uint8_t b[6] = {
+        (uint8_t)gpio, 0,
+        (uint8_t)events, (uint8_t)(events >> 8), (uint8_t)(events >> 16), (uint8_t)(events >> 24),
+    };
+    sensor_trace_put(SENSOR_TRACE_BUTTON, b, sizeof(b));
+}
+
+unsigned sensor_trace_drain(sensor_trace_sink_t sink, void *ctx) {
+    // One consumer: static instead of ~1.2 kB of stack
+    static uint8_t rec[MAX_RECORD];
+    static char line[sizeof(SENSOR_TRACE_LINE_MARK) + (MAX_RECORD + 2) / 3 * 4];
+    unsigned count = 0;
+
+    lock_init();
+    for (;;) {
+        // Take one record out, encode it without holding the lock
+        hal_lock_enter(&st.lock);
+        if (head == sent || st.state == SENSOR_TRACE_REPLAYING) {
+            hal_lock_exit(&st.lock);
+            break;
+        }
+        ring_read(sent, rec, SENSOR_TRACE_HEADER_SIZE);
+        size_t n = SENSOR_TRACE_HEADER_SIZE + get_u16(&rec[1]);
+        ring_read(sent, rec, n);
+        sent += n;
+        if (st.mode == SENSOR_TRACE_STREAM) tail = sent;
+        hal_lock_exit(&st.lock);
+
+        size_t o = sizeof(SENSOR_TRACE_LINE_MARK) - 1;
+        memcpy(line, SENSOR_TRACE_LINE_MARK, o);
+        o += base64_encode(rec, n, &line[o]);
+        line[o] = '\0';
+        sink(line, ctx);
+        count++;
+    }
+    return count;
+}
+
+/* ---- replay ---- */
+
+void sensor_trace_clear(void) {
+    sensor_trace_stop();
+    hal_lock_enter(&st.lock);
+    head = tail = sent = 0;
+    st.records = 0;
+    st.dropped = 0;
+    hal_lock_exit(&st.lock);
+}
+
+bool sensor_trace_load(const void *data, size_t len) {
+    lock_init();
+
+    hal_lock_enter(&st.lock);
+    bool fits = st.state == SENSOR_TRACE_IDLE && SENSOR_TRACE_BUFFER_SIZE - (head - tail) >= len;
+    if (fits) {
+        // Loaded, not recorded: nothing to drain
+        ring_write(data, len);
+        sent = head;
+    }
+    hal_lock_exit(&st.lock);
+    return fits;
+}
+
+static void reverse(uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n / 2; i++) {
+        uint8_t t = p[i];
+        p[i] = p[n - 1 - i];
+        p[n - 1 - i] = t;
+    }
+}
+
+// Rotates the ring in place so that the oldest byte is buf[0]. Called with
+// the lock held: the drain may be reading the ring on the other core.
+static void linearize_locked(void) {
+    size_t k = tail & TRACE_MASK;
+    uint32_t used = head - tail;
+    if (k != 0) {
+        reverse(buf, k);
+        reverse(buf + k, SENSOR_TRACE_BUFFER_SIZE - k);
+        reverse(buf, SENSOR_TRACE_BUFFER_SIZE);
+    }
+    sent -= tail;
+    tail = 0;
+    head = used;
+}
+
+// Next record of @p type at or after @p pos, len if none
+static size_t find(const uint8_t *trace, size_t len, size_t pos, sensor_trace_type_t type) {
+    while (pos < len && trace[pos] != type) {
+        pos += SENSOR_TRACE_HEADER_SIZE + get_u16(&trace[pos + 1]);
+    }
+    return pos < len ? pos : len;
+}
+
+int sensor_trace_replay(const uint8_t *trace, size_t len, uint32_t type_mask) {
+    lock_init();
+    sensor_trace_stop();
+
+    if (trace == NULL) {
+        hal_lock_enter(&st.lock);
+        linearize_locked();
+        trace = buf;
+        len = head;
+        hal_lock_exit(&st.lock);
+    }
+
+    // Check the whole trace first, the hooks then trust it
+    int count = 0;
+    uint32_t present = 0;
+    for (size_t pos = 0; pos < len; count++) {
+        if (len - pos < SENSOR_TRACE_HEADER_SIZE || trace[pos] >= SENSOR_TRACE_TYPES) return -1;
+        size_t n = SENSOR_TRACE_HEADER_SIZE + get_u16(&trace[pos + 1]);
+        if (len - pos < n) return -1;
+        present |= SENSOR_TRACE_MASK(trace[pos]);
+        pos += n;
+    }
+
+    hal_lock_enter(&st.lock);
+    st.trace = trace;
+    st.len = len;
+    st.mask = type_mask & SENSOR_TRACE_ALL;
+    st.pending = present & st.mask;
+    st.records = 0;
+    for (int i = 0; i < SENSOR_TRACE_TYPES; i++) {
+        st.cursor[i] = find(trace, len, 0, (sensor_trace_type_t)i);
+    }
+    st.state = st.pending ? SENSOR_TRACE_REPLAYING : SENSOR_TRACE_IDLE;
+    hal_lock_exit(&st.lock);
+    return count;
+}
+
+void sensor_trace_set_button_handler(sensor_trace_button_fn fn) {
+    st.button_fn = fn;
+}
+
+static int64_t button_alarm_cb(hal_alarm_t id, void *user_data) {
+    (void)id;
+    uintptr_t v = (uintptr_t)user_data;
+    sensor_trace_button_fn fn = st.button_fn;
+    if (fn != NULL) fn((uint32_t)(v >> 8), (uint32_t)(v & 0xff));
+    return 0;
+}
+
+#define BUTTONS_PER_READ    4
+
+// Called with the lock held: collects the button edges up to @p t_us (at
+// most BUTTONS_PER_READ, the rest wait for the next read) into @p edges.
+static size_t take_buttons_locked(uint32_t t_us, uintptr_t *edges) {
+    size_t count = 0;
+    if (!(st.mask & SENSOR_TRACE_MASK(SENSOR_TRACE_BUTTON))) return 0;
+
+    size_t *pos = &st.cursor[SENSOR_TRACE_BUTTON];
+    while (count < BUTTONS_PER_READ && *pos < st.len && get_u32(&st.trace[*pos + 3]) <= t_us) {
+        const uint8_t *p = &st.trace[*pos + SENSOR_TRACE_HEADER_SIZE];
+        edges[count++] = ((uintptr_t)p[0] << 8) | p[2];
+        st.records++;
+        *pos = find(st.trace, st.len, *pos + SENSOR_TRACE_HEADER_SIZE + get_u16(&st.trace[*pos + 1]),
+                    SENSOR_TRACE_BUTTON);
+    }
+    if (*pos >= st.len) st.pending &= ~SENSOR_TRACE_MASK(SENSOR_TRACE_BUTTON);
+    return count;
+}
+
+bool sensor_trace_take(sensor_trace_type_t type, void *out, size_t len) {
+    if (st.state != SENSOR_TRACE_REPLAYING || !(st.mask & SENSOR_TRACE_MASK(type))) return false;
+
+    bool taken = false;
+    uintptr_t edges[BUTTONS_PER_READ];
+    size_t n_edges = 0;
+
+    hal_lock_enter(&st.lock);
+    size_t pos = st.cursor[type];
+    if (st.state == SENSOR_TRACE_REPLAYING && pos < st.len) {
+        size_t n = get_u16(&st.trace[pos + 1]);
+        size_t copy = n < len ? n : len;
+        memcpy(out, &st.trace[pos + SENSOR_TRACE_HEADER_SIZE], copy);
+        memset((uint8_t *)out + copy, 0, len - copy);
+        st.records++;
+        st.cursor[type] = find(st.trace, st.len, pos + SENSOR_TRACE_HEADER_SIZE + n, type);
+        if (st.cursor[type] >= st.len) st.pending &= ~SENSOR_TRACE_MASK(type);
+
+        // Once the sensors have run out, the remaining edges follow
+        uint32_t t_us = get_u32(&st.trace[pos + 3]);
+        if ((st.pending & ~SENSOR_TRACE_MASK(SENSOR_TRACE_BUTTON)) == 0) t_us = UINT32_MAX;
+        n_edges = take_buttons_locked(t_us, edges);
+        taken = true;
+    }
+    if (st.pending == 0) st.state = SENSOR_TRACE_IDLE;
+    hal_lock_exit(&st.lock);
+
+    // The alarm pool takes its own lock, so arm outside ours. The alarms
+    // put the edges in interrupt context like the real GPIO interrupt.
+    for (size_t i = 0; i < n_edges; i++) {
+        hal_alarm_in_us(1, button_alarm_cb, (void *)edges[i]);
+    }
+    return taken;
+}
+
+void sensor_trace_get_stats(sensor_trace_stats_t *out) {
+    out->state = st.state;
+    out->records = st.records;
+    out->dropped = st.dropped;
+    out->buffered = st.state == SENSOR_TRACE_REPLAYING ? (uint32_t)st.len : head - tail;
+}
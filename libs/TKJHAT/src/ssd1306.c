@@ -23,15 +23,23 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
-#include <pico/stdlib.h>
-#include <hardware/i2c.h>
-#include <pico/binary_info.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 
+#include <tkjhat/hal.h>
 #include <tkjhat/ssd1306.h>
 #include <tkjhat/font.h>
+#include <tkjhat/event_trace.h>
+
+#if TKJHAT_STATIC_ALLOC
+// One display, at most 128x64: static framebuffer instead of malloc.
+// The extra first byte holds the I2C data control byte.
+#ifndef SSD1306_STATIC_BUFSIZE
+#define SSD1306_STATIC_BUFSIZE (128 * 64 / 8)
+#endif
+static uint8_t ssd1306_storage[SSD1306_STATIC_BUFSIZE + 1];
+#endif
 
 inline static void swap(int32_t *a, int32_t *b) {
     int32_t *t=a;
@@ -39,8 +47,8 @@ inline static void swap(int32_t *a, int32_t *b) {
     *b=*t;
 }
 
-inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, char *name) {
-    switch(i2c_write_blocking(i2c, addr, src, len, false)) {
+inline static void fancy_write(uint8_t addr, const uint8_t *src, size_t len, char *name) {
+    switch(hal_i2c_write(addr, src, len, false)) {
     case PICO_ERROR_GENERIC:
         printf("[%s] addr not acknowledged!\n", name);
         break;
@@ -55,7 +63,7 @@ inline static void fancy_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src
 
 inline static void ssd1306_write(ssd1306_t *p, uint8_t val) {
     uint8_t d[2]= {0x00, val};
-    fancy_write(p->i2c_i, p->address, d, 2, "ssd1306_write");
+    fancy_write(p->address, d, 2, "ssd1306_write");
 }
 
 bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address, i2c_inst_t *i2c_instance) {
@@ -68,10 +76,18 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
 
 
     p->bufsize=(p->pages)*(p->width);
+#if TKJHAT_STATIC_ALLOC
+    if(p->bufsize>SSD1306_STATIC_BUFSIZE) {
+        p->bufsize=0;
+        return false;
+    }
+    p->buffer=ssd1306_storage;
+#else
     if((p->buffer=malloc(p->bufsize+1))==NULL) {
         p->bufsize=0;
         return false;
     }
+#endif
 
     ++(p->buffer);
 
@@ -116,7 +132,11 @@ bool ssd1306_init(ssd1306_t *p, uint16_t width, uint16_t height, uint8_t address
 }
 
 inline void ssd1306_deinit(ssd1306_t *p) {
+#if TKJHAT_STATIC_ALLOC
+    (void)p;
+#else
     free(p->buffer-1);
+#endif
 }
 
 inline void ssd1306_poweroff(ssd1306_t *p) {
@@ -302,5 +322,7 @@ void ssd1306_show(ssd1306_t *p) {
 
     *(p->buffer-1)=0x40;
 
-    fancy_write(p->i2c_i, p->address, p->buffer-1, p->bufsize+1, "ssd1306_show");
+    EVENT_TRACE_BEGIN(EVENT_TRACE_SPAN_DISPLAY);
+    fancy_write(p->address, p->buffer-1, p->bufsize+1, "ssd1306_show");
+    EVENT_TRACE_END(EVENT_TRACE_SPAN_DISPLAY);
 }
\ No newline at end of file
@@ -57,9 +57,16 @@ extern "C" {
 #define CFG_TUD_CDC (2)  // Enable 2 CDC interfaces instead of 1
 
 // CDC buffer sizes
-// These determine how much data can be buffered for USB communication
+// These determine how much data can be buffered for USB communication.
+// Per CDC interface; tune with the CMake options USB_SERIAL_CDC_RX_BUFSIZE
+// and USB_SERIAL_CDC_TX_BUFSIZE (examples/cdc_throughput measures them).
+// TX should hold several 64-byte packets so the stack never waits for the writer.
+#ifndef CFG_TUD_CDC_RX_BUFSIZE
 #define CFG_TUD_CDC_RX_BUFSIZE (512)   // Receive buffer size: 512 - 64 Depending size of data
-#define CFG_TUD_CDC_TX_BUFSIZE (128)  // Transmit buffer size: 512 - 64 Depending size of data
+#endif
+#ifndef CFG_TUD_CDC_TX_BUFSIZE
+#define CFG_TUD_CDC_TX_BUFSIZE (512)   // Transmit buffer size: 512 - 64 Depending size of data
+#endif
 #define CFG_TUD_CDC_EP_BUFSIZE (64)   // Size of the Endpoint Buffer. In Pico Must be 64 for full speed. 
 
 //Since Pico is Full Speed, endpoint0 size is always 64
@@ -72,10 +79,47 @@ extern "C" {
 #define CFG_TUD_MSC     0  // Mass Storage Class (USB drive functionality)
 #define CFG_TUD_HID     0  // Human Interface Device (keyboard/mouse)
 #define CFG_TUD_MIDI    0  // MIDI
-#define CFG_TUD_AUDIO   0  // Audio
 #define CFG_TUD_VIDEO   0  // Video
 #define CFG_TUD_VENDOR  0  // Vendor specific class
 
+//------------- USB AUDIO MICROPHONE -------------//
+
+// Optional UAC2 microphone next to the two CDC ports. Enabled with the
+// CMake option USB_SERIAL_AUDIO (see usbSerialDebug/usb_audio.h).
+#ifndef USB_SERIAL_AUDIO
+#define USB_SERIAL_AUDIO 0
+#endif
+
+#if USB_SERIAL_AUDIO
+#define CFG_TUD_AUDIO   1  // Audio
+
+// Highest sample rate the microphone can run at (16 kHz profiles)
+#ifndef USB_AUDIO_MAX_RATE
+#define USB_AUDIO_MAX_RATE  16000
+#endif
+
+// One mono 16-bit input, described with TinyUSB's one channel mic template
+#define CFG_TUD_AUDIO_FUNC_1_DESC_LEN               TUD_AUDIO_MIC_ONE_CH_DESC_LEN
+#define CFG_TUD_AUDIO_FUNC_1_N_AS_INT               1
+#define CFG_TUD_AUDIO_FUNC_1_CTRL_BUF_SZ            64
+#define CFG_TUD_AUDIO_ENABLE_EP_IN                  1
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX  2
+#define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX          1
+
+// Isochronous packet: one 1 ms frame of samples plus one spare sample
+#define CFG_TUD_AUDIO_EP_SZ_IN  ((USB_AUDIO_MAX_RATE / 1000 + 1) * \
+                                 CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX * \
+                                 CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX)
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX     CFG_TUD_AUDIO_EP_SZ_IN
+// The microphone delivers blocks of 256 samples (32 ms at 8 kHz), so the
+// FIFO holds three of them: one being sent, one queued, one of slack
+#define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ  (3 * 256 * CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX)
+// Send sample_rate/1000 samples per frame instead of everything queued
+#define CFG_TUD_AUDIO_EP_IN_FLOW_CONTROL      1
+#else
+#define CFG_TUD_AUDIO   0  // Audio
+#endif
+
 #ifdef __cplusplus
 }
 #endif
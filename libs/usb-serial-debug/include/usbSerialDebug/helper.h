@@ -1,5 +1,7 @@
 #pragma once
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,41 +12,88 @@ extern "C" {
  * @file helper.h
  * @brief USB logging helpers for CDC0 (TinyUSB + FreeRTOS).
  *
- * These helpers write directly to CDC interface 0 using TinyUSB.
- * They are thread-safe (use a mutex internally) and designed to avoid
- * blocking forever. Do not call them from ISRs or TinyUSB callbacks.
+ * Writers copy their text into a RAM log ring and return at once; they
+ * never block and never touch TinyUSB. The USB task moves the ring to CDC
+ * interface 0 with ::usb_serial_drain(), so many short log lines leave as
+ * full 64-byte packets instead of one USB transfer each. Writers may be
+ * tasks on either core, ISRs or TinyUSB callbacks. When the ring is full a
+ * message is dropped whole and counted (::usb_serial_dropped()).
  *
  * @note This API does not use pico_stdio_usb. Keep CDC0 free for this writer.
- * @note You must run TinyUSB in a task (e.g., a task that calls tud_task()).
+ * @note You must run TinyUSB in a task that also drains the log:
+ * @code
+ * static void usbTask(void *arg) {
+ *     while (1) {
+ *         tud_task_ext(USB_SERIAL_DRAIN_MS, false);
+ *         usb_serial_drain();
+ *     }
+ * }
+ * @endcode
  */
 
+/** Size of the log ring in bytes (power of two). */
+#ifndef USB_SERIAL_LOG_SIZE
+#define USB_SERIAL_LOG_SIZE     2048
+#endif
+
+/** Longest time queued log text waits for the USB task, in ms. */
+#ifndef USB_SERIAL_DRAIN_MS
+#define USB_SERIAL_DRAIN_MS     2
+#endif
+
+/**
+ * CDC1 flush policy. 1: every write ends with a short packet (lowest
+ * latency, one USB transfer per write). 0: only full 64-byte packets leave
+ * at once; the rest is flushed by ::usb_serial_drain() when the writer has
+ * paused for a drain period (highest throughput). Set with the CMake option
+ * @c USB_SERIAL_DATA_FLUSH_EACH.
+ */
+#ifndef USB_SERIAL_DATA_FLUSH_EACH
+#define USB_SERIAL_DATA_FLUSH_EACH  1
+#endif
+
 
 /**
  * @brief Initialize the USB serial logger (CDC0).
  *
- * Creates internal synchronization (mutex) and prepares the TinyUSB
- * writer for CDC0.
+ * Claims a hardware spinlock for the log ring. Writes made before this
+ * call are ignored.
  *
- * @pre Call after @c tusb_init() and before the first @c usb_serial_print().
- * @pre FreeRTOS kernel must be available (mutex creation).
- * @warning Does not start TinyUSB; a task must be running @c tud_task().
+ * @pre Call before the first @c usb_serial_print().
+ * @warning Does not start TinyUSB; a task must be running @c tud_task()
+ *          and ::usb_serial_drain().
  *
- * @return @c true on success, @c false if resources could not be created.
+ * @return @c true on success, @c false if no spinlock was free.
  */
 bool usb_serial_init(void);
 
 /**
  * @brief Flush pending TX data on CDC0 to the host.
  *
- * Requests TinyUSB to push any buffered data for CDC0. If the device
- * is not mounted or CDC0 is not connected, the function returns quickly.
- * It does not block indefinitely waiting for the host to read.
+ * Asks the USB task to send a short packet once the log ring is empty.
+ * The drain already does this at the end of every burst, so this is only
+ * a hint; it returns at once.
  *
- * @note Safe to call from task context; avoid calling from ISRs.
+ * @note Safe to call from any context.
  * @note For guaranteed delivery, ensure the host has opened CDC0.
  */
 void usb_serial_flush(void);
 
+/**
+ * @brief Move queued log text to CDC0. Call from the TinyUSB task only.
+ *
+ * Copies as much as fits straight from the ring into the CDC TX FIFO and
+ * flushes when the ring runs empty. If the port is closed, the queued text
+ * is discarded and counted as dropped.
+ */
+void usb_serial_drain(void);
+
+/**
+ * @brief Total number of log bytes dropped because the ring was full or
+ *        the port closed before they were sent.
+ */
+uint32_t usb_serial_dropped(void);
+
 /**
  * @brief Check whether the host has opened CDC0 (DTR set).
  * 
@@ -53,19 +102,19 @@ void usb_serial_flush(void);
 bool usb_serial_connected(void);
 
 /**
- * @brief Thread-safe print of a null-terminated string to CDC0.
+ * @brief Queue a null-terminated string for CDC0. Never blocks.
  *
- * Writes the string to USB CDC interface 0. The function will not
- * block indefinitely: it uses a mutex and a short TX-space wait inside.
+ * The string is copied into the log ring in one piece; concurrent writers
+ * never interleave inside a message.
  *
  * @param s Pointer to a null-terminated C string. Must not be @c NULL.
  *
- * @return Number of bytes written (>= 0). Returns 0 if CDC0 is not ready
- *         (device not mounted or port not opened) or if a timeout occurred.
+ * @return Number of bytes queued (>= 0). Returns 0 if CDC0 is not ready
+ *         (device not mounted or port not opened) or if the ring had no
+ *         room (the bytes are counted by ::usb_serial_dropped()).
  *         Returns -1 if @p s is @c NULL.
  *
- * @note Do not call from ISRs or TinyUSB callbacks; enqueue to a logger task instead.
- * @note If multiple tasks call this function, output is serialized by the mutex.
+ * @note Safe from tasks on both cores, ISRs and TinyUSB callbacks.
  * @note This writes to CDC0; keep CDC1 free for your application data if you use dual CDC.
  *
  * @code
@@ -78,6 +127,70 @@ bool usb_serial_connected(void);
  */
 int usb_serial_print(const char *s);
 
+/**
+ * @brief Queue @p n bytes for CDC0. Same rules as ::usb_serial_print().
+ *
+ * @return Bytes queued, 0 if not ready or dropped, -1 if @p data is @c NULL.
+ */
+int usb_serial_write(const void *data, size_t n);
+
+/**
+ * @brief Write a whole binary frame to CDC1, or nothing.
+ *
+ * Matches ::telemetry_sink_t, so it can be passed straight to
+ * @c telemetry_init(). Call from one task only.
+ *
+ * @return @c true if the frame was queued; @c false if CDC1 is not open or
+ *         its TX buffer has no room for the whole frame.
+ * @note Flushes according to ::USB_SERIAL_DATA_FLUSH_EACH.
+ */
+bool usb_serial_data_write(const uint8_t *data, size_t len, void *ctx);
+
+/**
+ * @brief Write as much of @p data to CDC1 as fits, never blocking.
+ *
+ * For raw streams where a partial write is fine; the caller sends the rest
+ * later. Flushes according to ::USB_SERIAL_DATA_FLUSH_EACH. Call from one
+ * task only.
+ *
+ * @return Bytes queued (0 if CDC1 is not open or its TX buffer is full).
+ */
+size_t usb_serial_data_send(const void *data, size_t len);
+
+/**
+ * @brief Create the receive stream buffer of a CDC interface.
+ *
+ * @param itf  CDC interface (0 or 1).
+ * @param size Buffer size in bytes; a few USB packets (e.g. 256).
+ * @return @c false if the buffer could not be allocated.
+ */
+bool usb_serial_rx_init(uint8_t itf, size_t size);
+
+/**
+ * @brief Move received USB packets into the stream buffer of @p itf.
+ *
+ * Call from the application's @c tud_cdc_rx_cb(). Whole packets are copied
+ * at once; if the buffer is full the rest stays in TinyUSB until
+ * ::usb_serial_rx_read() makes room. Interfaces without a buffer are
+ * drained and the data dropped.
+ *
+ * @code
+ * void tud_cdc_rx_cb(uint8_t itf) {
+ *     usb_serial_rx_cb(itf);
+ * }
+ * @endcode
+ */
+void usb_serial_rx_cb(uint8_t itf);
+
+/**
+ * @brief Read received bytes, blocking up to @p timeout_ms for the first one.
+ *
+ * Returns as soon as any data is available. One reader task per interface.
+ *
+ * @return Number of bytes copied to @p buf (0 on timeout).
+ */
+size_t usb_serial_rx_read(uint8_t itf, void *buf, size_t max, uint32_t timeout_ms);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,108 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file telemetry.h
+ * @brief Binary framed sensor telemetry (meant for CDC1).
+ *
+ * Sensor records are batched into frames. A frame is protected by a CRC and
+ * carries a sequence number, then COBS encoded and terminated with a 0x00
+ * byte, so a receiver can resynchronise at any zero and count lost frames
+ * from gaps in the sequence. With the default ::TELEMETRY_FRAME_MAX an
+ * encoded frame fits in one 64-byte USB full-speed packet.
+ *
+ * Frame before encoding (all fields little-endian):
+ * @verbatim
+ *   u8  version            TELEMETRY_VERSION
+ *   u16 seq                +1 per frame, wraps
+ *   u32 t_ms               time of the first record
+ *   records...             u8 type, u8 len, u16 dt_ms (from t_ms), payload[len]
+ *   u16 crc                CRC-16/CCITT-FALSE of everything above
+ * @endverbatim
+ *
+ * The encoder does not depend on the Pico SDK or TinyUSB, so the host
+ * decoder (tools/telemetry_decode) is built from the same source.
+ */
+
+#define TELEMETRY_VERSION       1
+
+/** Largest frame before COBS encoding; 61 + 1 overhead + 1 delimiter = 63 bytes on the wire. */
+#ifndef TELEMETRY_FRAME_MAX
+#define TELEMETRY_FRAME_MAX     61
+#endif
+
+#define TELEMETRY_HEADER_SIZE   7
+#define TELEMETRY_RECORD_HEADER 4
+#define TELEMETRY_CRC_SIZE      2
+
+/** Worst-case size of an encoded frame including the delimiter. */
+#define TELEMETRY_ENCODED_MAX   (TELEMETRY_FRAME_MAX + TELEMETRY_FRAME_MAX / 254 + 2)
+
+/** Record types and their payloads. */
+typedef enum {
+    TELEMETRY_IMU   = 1,    ///< i16 ax, ay, az [mg], i16 gx, gy, gz [0.1 dps], i16 temp [0.01 °C]
+    TELEMETRY_LIGHT = 2,    ///< u32 lux
+    TELEMETRY_ENV   = 3,    ///< i16 temp [0.01 °C], u16 humidity [0.01 %RH]
+    TELEMETRY_AUDIO = 4,    ///< u16 rms, u16 peak, u16 zcr_hz, u16 band_rms[4]
+} telemetry_type_t;
+
+#define TELEMETRY_IMU_SIZE      14
+#define TELEMETRY_LIGHT_SIZE    4
+#define TELEMETRY_ENV_SIZE      4
+#define TELEMETRY_AUDIO_SIZE    14
+
+/** Called with a complete encoded frame (delimiter included). Return false if it was not sent. */
+typedef bool (*telemetry_sink_t)(const uint8_t *data, size_t len, void *ctx);
+
+typedef struct {
+    telemetry_sink_t sink;
+    void *ctx;
+
+    uint8_t frame[TELEMETRY_FRAME_MAX];
+    size_t len;                 ///< bytes used in frame, 0 = no open frame
+    uint32_t t_ms;              ///< time of the open frame
+    uint16_t seq;
+
+    uint32_t frames_sent;
+    uint32_t frames_dropped;    ///< refused by the sink
+} telemetry_t;
+
+/** Prepare an encoder that hands finished frames to @p sink. */
+void telemetry_init(telemetry_t *tm, telemetry_sink_t sink, void *ctx);
+
+/**
+ * @brief Append a record. Sends the open frame first if the record does not
+ *        fit or is more than 65 s newer than the frame.
+ *
+ * @return false if @p len can never fit in a frame.
+ */
+bool telemetry_add(telemetry_t *tm, uint8_t type, uint32_t t_ms, const void *payload, uint8_t len);
+
+bool telemetry_add_imu(telemetry_t *tm, uint32_t t_ms, float ax, float ay, float az,
+                       float gx, float gy, float gz, float temp);
+bool telemetry_add_light(telemetry_t *tm, uint32_t t_ms, uint32_t lux);
+bool telemetry_add_env(telemetry_t *tm, uint32_t t_ms, float temp, float humidity);
+bool telemetry_add_audio(telemetry_t *tm, uint32_t t_ms, uint16_t rms, uint16_t peak,
+                         uint16_t zcr_hz, const uint16_t band_rms[4]);
+
+/** Send the open frame now, if it has any records. */
+void telemetry_flush(telemetry_t *tm);
+
+/** CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF). */
+uint16_t telemetry_crc16(const uint8_t *data, size_t len);
+
+/** COBS encode @p len bytes; writes at most len + len / 254 + 1 bytes, no delimiter. */
+size_t telemetry_cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+
+/** COBS decode one frame (without the delimiter). Returns the decoded length, 0 on error. */
+size_t telemetry_cobs_decode(const uint8_t *in, size_t len, uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file usb_audio.h
+ * @brief PDM microphone as a standard USB audio input (UAC2, next to CDC0/CDC1).
+ *
+ * With the CMake option @c USB_SERIAL_AUDIO the device descriptor gets a
+ * USB Audio Class 2 microphone: one mono 16-bit channel on an isochronous
+ * IN endpoint. Hosts use their built-in audio driver, so any recorder
+ * (Audacity, arecord, Windows Sound settings) captures the microphone at
+ * its full sample rate without a custom protocol on the serial ports.
+ *
+ * The application hands each PCM block from the microphone driver to
+ * ::usb_audio_mic_write() and releases it. TinyUSB then sends
+ * sample_rate / 1000 samples in every 1 ms USB frame.
+ *
+ * The host can mute the microphone and lower its volume (0 to -60 dB);
+ * both are applied here. The sample rate is fixed by the microphone
+ * profile; the host cannot change it.
+ *
+ * @code
+ * usb_audio_mic_init(get_microphone_sample_rate());
+ * ...
+ * int16_t *block = acquire_microphone_samples(&n);
+ * if (block) {
+ *     usb_audio_mic_write(block, n);
+ *     release_microphone_samples(block);
+ * }
+ * @endcode
+ *
+ * @note Only available when built with @c USB_SERIAL_AUDIO=ON.
+ */
+
+/**
+ * @brief Set the sample rate reported to the host.
+ *
+ * Call before @c tusb_init(); the host reads the rate while enumerating.
+ *
+ * @param sample_rate Microphone sample rate in Hz (up to @c USB_AUDIO_MAX_RATE).
+ */
+void usb_audio_mic_init(uint32_t sample_rate);
+
+/**
+ * @brief Whether the host is recording (audio streaming interface open).
+ */
+bool usb_audio_mic_streaming(void);
+
+/**
+ * @brief Queue a PCM block for the audio endpoint.
+ *
+ * Applies the host's volume and mute in place, then copies the block to the
+ * endpoint FIFO. The block is queued whole or not at all; if the FIFO is
+ * full it is dropped and counted (::usb_audio_mic_dropped()). When the host
+ * is not recording the block is discarded without counting.
+ *
+ * @param samples Mono 16-bit samples. Modified in place.
+ * @param count   Number of samples.
+ * @return Number of samples queued (0 or @p count).
+ */
+size_t usb_audio_mic_write(int16_t *samples, size_t count);
+
+/**
+ * @brief Blocks dropped because the endpoint FIFO was full.
+ */
+uint32_t usb_audio_mic_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,76 +1,246 @@
 #include <string.h>
 
+#include <pico/stdlib.h>
+#include <pico/sync.h>
+
 #include <FreeRTOS.h>
 #include <semphr.h>
+#include <stream_buffer.h>
 
 #include <tusb.h>
 
 #include "usbSerialDebug/helper.h"
 
-static SemaphoreHandle_t g_log_mtx;
-static const TickType_t wait = pdMS_TO_TICKS(5);
-static const TickType_t io_timeout = pdMS_TO_TICKS(10);
+#define LOG_MASK (USB_SERIAL_LOG_SIZE - 1u)
+
+#if (USB_SERIAL_LOG_SIZE & LOG_MASK) != 0
+#error "USB_SERIAL_LOG_SIZE must be a power of two"
+#endif
+
+// Log ring shared by all producers (tasks on both cores and ISRs) and the
+// USB task. Positions are free-running byte counters:
+//   tail <= commit <= reserve,  reserve - tail <= USB_SERIAL_LOG_SIZE
+// A producer reserves space under the spinlock, copies its bytes without
+// holding it, and publishes them when it is the last writer in flight. The
+// USB task only reads [tail, commit), so it never sees a half-written line.
+static uint8_t g_log_buf[USB_SERIAL_LOG_SIZE];
+static volatile uint32_t g_log_reserve;
+static volatile uint32_t g_log_commit;
+static volatile uint32_t g_log_tail;
+static volatile uint32_t g_log_writers;
+static volatile uint32_t g_log_dropped;
+static volatile bool g_flush_req;
+static spin_lock_t *g_log_lock;
+
+static void data_drain(void);
 
 static inline bool cdc0_ready(void) {
     return tud_mounted() && tud_cdc_n_connected(0);
 }
 
-static SemaphoreHandle_t g_log_mtx;
 bool usb_serial_init(void) {
-    g_log_mtx = xSemaphoreCreateMutex();
-    return g_log_mtx != NULL;
+    if (!g_log_lock) {
+        int num = spin_lock_claim_unused(false);
+        if (num < 0) return false;
+        g_log_lock = spin_lock_init((uint)num);
+    }
+    return true;
 }
 
-
 void usb_serial_flush(void) {
-    if (!cdc0_ready()) return;
-
-    // Try to take the mutex for not interfering with current writing
-    if (g_log_mtx && xSemaphoreTake(g_log_mtx, 0) == pdTRUE) {
-        tud_cdc_n_write_flush(0);
-        xSemaphoreGive(g_log_mtx);
-    } else {
-        // If we do not get instantly we ask for a flush. 
-        // TinyUSB handle it in a safe way (hopefully).
-        tud_cdc_n_write_flush(0);
-    }
+    // Done by the USB task: usb_serial_drain() sends the partial packet
+    g_flush_req = true;
 }
 
 bool usb_serial_connected(void){
     return cdc0_ready();
 }
 
-int usb_serial_print(const char *s) {
-    if (!s) {
+int usb_serial_write(const void *data, size_t n) {
+    if (!data) {
         return -1;
     }
-    if ( !tud_mounted() || !tud_cdc_connected()) 
+    if (!g_log_lock || !cdc0_ready() || n == 0)
         return 0;
-    
-    if (xSemaphoreTake(g_log_mtx, wait) != pdTRUE) 
+
+    uint32_t save = spin_lock_blocking(g_log_lock);
+    uint32_t start = g_log_reserve;
+    if (n > USB_SERIAL_LOG_SIZE - (start - g_log_tail)) {
+        // No room: drop the whole message rather than block or split it
+        g_log_dropped += n;
+        spin_unlock(g_log_lock, save);
         return 0;
+    }
+    g_log_reserve = start + n;
+    g_log_writers++;
+    spin_unlock(g_log_lock, save);
+
+    uint32_t off = start & LOG_MASK;
+    size_t first = USB_SERIAL_LOG_SIZE - off;
+    if (first > n) first = n;
+    memcpy(&g_log_buf[off], data, first);
+    memcpy(g_log_buf, (const uint8_t *)data + first, n - first);
+
+    save = spin_lock_blocking(g_log_lock);
+    if (--g_log_writers == 0) {
+        g_log_commit = g_log_reserve;
+    }
+    spin_unlock(g_log_lock, save);
+
+    return (int)n;
+}
+
+int usb_serial_print(const char *s) {
+    if (!s) {
+        return -1;
+    }
+    return usb_serial_write(s, strlen(s));
+}
+
+uint32_t usb_serial_dropped(void) {
+    return g_log_dropped;
+}
+
+void usb_serial_drain(void) {
+    data_drain();
+    if (!g_log_lock) return;
 
-    size_t initial, n = strlen(s);
-
-    TickType_t deadline = xTaskGetTickCount() + io_timeout;
-
-    while (n) {
-        uint32_t avail = tud_cdc_write_available();
-        if (avail) {
-            uint32_t chunk = (n < avail) ? (uint32_t)n : avail;
-            tud_cdc_write(s, chunk);
-            tud_cdc_write_flush();
-            s += chunk; 
-            n -= chunk;
-        } 
-        else {
-            if (io_timeout == 0 || (int32_t)(xTaskGetTickCount() - deadline) >= 0) {
-                xSemaphoreGive(g_log_mtx);
-                return false; // give up to avoid blocking too long
-            }
-            vTaskDelay(pdMS_TO_TICKS(1));
+    uint32_t commit = g_log_commit;
+    uint32_t tail = g_log_tail;
+    __dmb();    // read the data only after seeing the commit
+
+    if (!cdc0_ready()) {
+        // Nobody listening: discard what was queued before the port closed
+        if (tail != commit) {
+            uint32_t save = spin_lock_blocking(g_log_lock);
+            g_log_dropped += commit - tail;
+            g_log_tail = commit;
+            spin_unlock(g_log_lock, save);
         }
+        g_flush_req = false;
+        return;
     }
-    xSemaphoreGive(g_log_mtx);
-    return initial-n;
-}
\ No newline at end of file
+
+    // Straight from the ring into the CDC FIFO. TinyUSB starts a transfer
+    // every time the FIFO holds a full 64-byte packet.
+    bool wrote = false;
+    while (tail != commit) {
+        uint32_t avail = tud_cdc_n_write_available(0);
+        if (avail == 0) break;
+
+        uint32_t off = tail & LOG_MASK;
+        uint32_t n = commit - tail;
+        if (n > USB_SERIAL_LOG_SIZE - off) n = USB_SERIAL_LOG_SIZE - off;
+        if (n > avail) n = avail;
+
+        n = tud_cdc_n_write(0, &g_log_buf[off], n);
+        if (n == 0) break;
+        tail += n;
+        wrote = true;
+    }
+
+    __dmb();    // done reading before the space is handed back
+    g_log_tail = tail;
+
+    // Short packet only when the ring has run dry, so bursts go out full
+    if (tail == commit && (wrote || g_flush_req)) {
+        tud_cdc_n_write_flush(0);
+        g_flush_req = false;
+    }
+}
+
+// CDC1 writes, counted for the deferred flush in usb_serial_drain()
+static volatile uint32_t g_data_writes;
+static uint32_t g_data_flushed;
+static uint32_t g_data_seen;
+
+static inline void data_written(void) {
+#if USB_SERIAL_DATA_FLUSH_EACH
+    tud_cdc_n_write_flush(1);
+#else
+    // Full packets already went out; the USB task sends the rest when
+    // the writer pauses
+    g_data_writes++;
+#endif
+}
+
+static void data_drain(void) {
+#if !USB_SERIAL_DATA_FLUSH_EACH
+    // Flush once a whole drain period has passed without new data
+    uint32_t w = g_data_writes;
+    if (w != g_data_flushed && w == g_data_seen) {
+        tud_cdc_n_write_flush(1);
+        g_data_flushed = w;
+    }
+    g_data_seen = w;
+#endif
+}
+
+bool usb_serial_data_write(const uint8_t *data, size_t len, void *ctx) {
+    (void)ctx;
+    if (!tud_mounted() || !tud_cdc_n_connected(1)) return false;
+
+    // All or nothing: a partial frame would corrupt the next one too
+    if (tud_cdc_n_write_available(1) < len) return false;
+    tud_cdc_n_write(1, data, (uint32_t)len);
+    data_written();
+    return true;
+}
+
+size_t usb_serial_data_send(const void *data, size_t len) {
+    if (!tud_mounted() || !tud_cdc_n_connected(1)) return 0;
+
+    uint32_t n = tud_cdc_n_write_available(1);
+    if (n == 0) return 0;
+    if (n > len) n = (uint32_t)len;
+    n = tud_cdc_n_write(1, data, n);
+    if (n) data_written();
+    return n;
+}
+
+// Received bytes per CDC interface. A stream buffer allows one writer at a
+// time: normally the USB task, but the reader also tops the buffer up after
+// it has made room, so writers take g_rx_mtx.
+static StreamBufferHandle_t g_rx[CFG_TUD_CDC];
+static SemaphoreHandle_t g_rx_mtx[CFG_TUD_CDC];
+
+bool usb_serial_rx_init(uint8_t itf, size_t size) {
+    if (itf >= CFG_TUD_CDC) return false;
+    if (!g_rx_mtx[itf]) g_rx_mtx[itf] = xSemaphoreCreateMutex();
+    if (!g_rx[itf]) g_rx[itf] = xStreamBufferCreate(size, 1);
+    return g_rx[itf] != NULL && g_rx_mtx[itf] != NULL;
+}
+
+void usb_serial_rx_cb(uint8_t itf) {
+    if (itf >= CFG_TUD_CDC) return;
+
+    uint8_t pkt[CFG_TUD_CDC_EP_BUFSIZE];
+    if (!g_rx[itf]) {
+        // Nobody reads this interface: drop the data, otherwise it would stall
+        while (tud_cdc_n_read(itf, pkt, sizeof(pkt)) > 0) {}
+        return;
+    }
+
+    xSemaphoreTake(g_rx_mtx[itf], portMAX_DELAY);
+    while (tud_cdc_n_available(itf)) {
+        // Leave what does not fit in TinyUSB; the host is NAKed until the
+        // reader makes room and pulls the rest
+        size_t space = xStreamBufferSpacesAvailable(g_rx[itf]);
+        if (space == 0) break;
+        uint32_t n = tud_cdc_n_read(itf, pkt, space < sizeof(pkt) ? (uint32_t)space : sizeof(pkt));
+        if (n == 0) break;
+        xStreamBufferSend(g_rx[itf], pkt, n, 0);
+    }
+    xSemaphoreGive(g_rx_mtx[itf]);
+}
+
+size_t usb_serial_rx_read(uint8_t itf, void *buf, size_t max, uint32_t timeout_ms) {
+    if (itf >= CFG_TUD_CDC || !g_rx[itf]) return 0;
+
+    size_t n = xStreamBufferReceive(g_rx[itf], buf, max, pdMS_TO_TICKS(timeout_ms));
+    if (n && tud_cdc_n_available(itf)) {
+        // Pull whatever was left behind while the buffer was full
+        usb_serial_rx_cb(itf);
+    }
+    return n;
+}
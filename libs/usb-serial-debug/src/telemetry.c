@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include "usbSerialDebug/telemetry.h"
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+// Scaled float to int16 with rounding and saturation
+static int16_t to_i16(float v, float scale) {
+    float x = v * scale;
+    x += (x < 0.0f) ? -0.5f : 0.5f;
+    if (x > 32767.0f)  return 32767;
+    if (x < -32768.0f) return -32768;
+    return (int16_t)x;
+}
+
+static uint16_t to_u16(float v, float scale) {
+    float x = v * scale + 0.5f;
+    if (x > 65535.0f) return 65535;
+    if (x < 0.0f)     return 0;
+    return (uint16_t)x;
+}
+
+uint16_t telemetry_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+size_t telemetry_cobs_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t code_pos = 0, o = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        } else {
+            out[o++] = in[i];
+            if (++code == 0xFF) {
+                out[code_pos] = code;
+                code_pos = o++;
+                code = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    return o;
+}
+
+size_t telemetry_cobs_decode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t i = 0, o = 0;
+
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) return 0;
+        for (uint8_t k = 1; k < code; k++) {
+            if (in[i] == 0) return 0;
+            out[o++] = in[i++];
+        }
+        if (code != 0xFF && i < len) out[o++] = 0;
+    }
+    return o;
+}
+
+void telemetry_init(telemetry_t *tm, telemetry_sink_t sink, void *ctx) {
+    memset(tm, 0, sizeof(*tm));
+    tm->sink = sink;
+    tm->ctx = ctx;
+}
+
+void telemetry_flush(telemetry_t *tm) {
+    if (tm->len <= TELEMETRY_HEADER_SIZE) return;
+
+    put_u16(&tm->frame[tm->len], telemetry_crc16(tm->frame, tm->len));
+    tm->len += TELEMETRY_CRC_SIZE;
+
+    uint8_t out[TELEMETRY_ENCODED_MAX];
+    size_t n = telemetry_cobs_encode(tm->frame, tm->len, out);
+    out[n++] = 0;
+
+    // The sequence number advances even if the sink refuses the frame, so
+    // the receiver sees the loss as a gap
+    if (tm->sink && tm->sink(out, n, tm->ctx)) tm->frames_sent++;
+    else                                       tm->frames_dropped++;
+
+    tm->seq++;
+    tm->len = 0;
+}
+
+bool telemetry_add(telemetry_t *tm, uint8_t type, uint32_t t_ms, const void *payload, uint8_t len) {
+    size_t need = TELEMETRY_RECORD_HEADER + len;
+    if (TELEMETRY_HEADER_SIZE + need + TELEMETRY_CRC_SIZE > TELEMETRY_FRAME_MAX) return false;
+
+    if (tm->len) {
+        uint32_t dt = t_ms - tm->t_ms;
+        if (tm->len + need + TELEMETRY_CRC_SIZE > TELEMETRY_FRAME_MAX || dt > 0xFFFF) {
+            telemetry_flush(tm);
+        }
+    }
+
+    if (tm->len == 0) {
+        tm->frame[0] = TELEMETRY_VERSION;
+        put_u16(&tm->frame[1], tm->seq);
+        put_u32(&tm->frame[3], t_ms);
+        tm->t_ms = t_ms;
+        tm->len = TELEMETRY_HEADER_SIZE;
+    }
+
+    uint8_t *p = &tm->frame[tm->len];
+    p[0] = type;
+    p[1] = len;
+    put_u16(&p[2], (uint16_t)(t_ms - tm->t_ms));
+    memcpy(&p[TELEMETRY_RECORD_HEADER], payload, len);
+    tm->len += need;
+    return true;
+}
+
+bool telemetry_add_imu(telemetry_t *tm, uint32_t t_ms, float ax, float ay, float az,
+                       float gx, float gy, float gz, float temp) {
+    uint8_t p[TELEMETRY_IMU_SIZE];
+    put_u16(&p[0],  (uint16_t)to_i16(ax, 1000.0f));
+    put_u16(&p[2],  (uint16_t)to_i16(ay, 1000.0f));
+    put_u16(&p[4],  (uint16_t)to_i16(az, 1000.0f));
+    put_u16(&p[6],  (uint16_t)to_i16(gx, 10.0f));
+    put_u16(&p[8],  (uint16_t)to_i16(gy, 10.0f));
+    put_u16(&p[10], (uint16_t)to_i16(gz, 10.0f));
+    put_u16(&p[12], (uint16_t)to_i16(temp, 100.0f));
+    return telemetry_add(tm, TELEMETRY_IMU, t_ms, p, sizeof(p));
+}
+
+bool telemetry_add_light(telemetry_t *tm, uint32_t t_ms, uint32_t lux) {
+    uint8_t p[TELEMETRY_LIGHT_SIZE];
+    put_u32(p, lux);
+    return telemetry_add(tm, TELEMETRY_LIGHT, t_ms, p, sizeof(p));
+}
+
+bool telemetry_add_env(telemetry_t *tm, uint32_t t_ms, float temp, float humidity) {
+    uint8_t p[TELEMETRY_ENV_SIZE];
+    put_u16(&p[0], (uint16_t)to_i16(temp, 100.0f));
+    put_u16(&p[2], to_u16(humidity, 100.0f));
+    return telemetry_add(tm, TELEMETRY_ENV, t_ms, p, sizeof(p));
+}
+
+bool telemetry_add_audio(telemetry_t *tm, uint32_t t_ms, uint16_t rms, uint16_t peak,
+                         uint16_t zcr_hz, const uint16_t band_rms[4]) {
+    uint8_t p[TELEMETRY_AUDIO_SIZE];
+    put_u16(&p[0], rms);
+    put_u16(&p[2], peak);
+    put_u16(&p[4], zcr_hz);
+    for (int i = 0; i < 4; i++) put_u16(&p[6 + 2 * i], band_rms ? band_rms[i] : 0);
+    return telemetry_add(tm, TELEMETRY_AUDIO, t_ms, p, sizeof(p));
+}
@@ -0,0 +1,182 @@
+/*
+ * USB Audio Class 2 microphone (optional, USB_SERIAL_AUDIO).
+ * The descriptor is TinyUSB's TUD_AUDIO_MIC_ONE_CH_DESCRIPTOR, see usb_descriptors.c.
+ * This file answers the class requests for it and queues the PCM blocks.
+ */
+
+#include "tusb.h"
+
+#if CFG_TUD_AUDIO
+
+#include <math.h>
+#include <string.h>
+
+#include "usbSerialDebug/usb_audio.h"
+
+// Entity IDs used by TUD_AUDIO_MIC_ONE_CH_DESCRIPTOR
+#define UAC2_ENTITY_INPUT_TERMINAL  0x01
+#define UAC2_ENTITY_FEATURE_UNIT    0x02
+#define UAC2_ENTITY_OUTPUT_TERMINAL 0x03
+#define UAC2_ENTITY_CLOCK           0x04
+
+// Volume is in 1/256 dB steps (UAC2)
+#define VOLUME_MIN_DB       (-60)
+#define VOLUME_RES          256
+
+static uint32_t sample_rate = 8000;
+static volatile bool streaming;
+static volatile bool preroll;
+static volatile bool muted;
+static volatile int16_t volume = 0;            // host value, 1/256 dB
+static volatile int32_t gain_q15 = 32768;      // same as linear gain, 32768 = 0 dB
+static volatile uint32_t dropped;
+
+static const int16_t silence[64];
+
+void usb_audio_mic_init(uint32_t rate) {
+    sample_rate = rate;
+}
+
+bool usb_audio_mic_streaming(void) {
+    return streaming;
+}
+
+uint32_t usb_audio_mic_dropped(void) {
+    return dropped;
+}
+
+static void write_silence(size_t count) {
+    while (count > 0) {
+        size_t n = count < TU_ARRAY_SIZE(silence) ? count : TU_ARRAY_SIZE(silence);
+        tud_audio_write(silence, (uint16_t)(n * sizeof(int16_t)));
+        count -= n;
+    }
+}
+
+size_t usb_audio_mic_write(int16_t *samples, size_t count) {
+    if (!streaming || count == 0) return 0;
+
+    uint16_t bytes = (uint16_t)(count * sizeof(int16_t));
+    // One block of silence ahead of the first real one, so the endpoint
+    // still has data while the next block is being filtered
+    uint16_t need = preroll ? 2 * bytes : bytes;
+    if (tu_fifo_remaining(tud_audio_get_ep_in_ff()) < need) {
+        dropped++;
+        return 0;
+    }
+    if (preroll) {
+        write_silence(count);
+        preroll = false;
+    }
+
+    if (muted) {
+        write_silence(count);
+        return count;
+    }
+    int32_t g = gain_q15;
+    if (g < 32768) {
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = (int16_t)((samples[i] * g) >> 15);
+        }
+    }
+    tud_audio_write(samples, bytes);
+    return count;
+}
+
+//--------------------------------------------------------------------
+// TinyUSB audio callbacks (run in the USB task)
+//--------------------------------------------------------------------
+
+// Host opened (alt 1) or closed (alt 0) the streaming interface
+bool tud_audio_set_itf_cb(uint8_t rhport, tusb_control_request_t const *p_request) {
+    (void)rhport;
+    uint8_t alt = tu_u16_low(p_request->wValue);
+    if (alt != 0) {
+        tud_audio_clear_ep_in_ff();
+        preroll = true;
+    }
+    streaming = alt != 0;
+    return true;
+}
+
+bool tud_audio_set_itf_close_EP_cb(uint8_t rhport, tusb_control_request_t const *p_request) {
+    (void)rhport;
+    (void)p_request;
+    streaming = false;
+    return true;
+}
+
+bool tud_audio_get_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request) {
+    uint8_t ctrl   = tu_u16_high(p_request->wValue);
+    uint8_t entity = tu_u16_high(p_request->wIndex);
+
+    if (entity == UAC2_ENTITY_CLOCK) {
+        if (ctrl == AUDIO_CS_CTRL_SAM_FREQ && p_request->bRequest == AUDIO_CS_REQ_CUR) {
+            audio_control_cur_4_t cur = { .bCur = (int32_t)tu_htole32(sample_rate) };
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &cur, sizeof(cur));
+        }
+        if (ctrl == AUDIO_CS_CTRL_SAM_FREQ && p_request->bRequest == AUDIO_CS_REQ_RANGE) {
+            // Only the rate of the microphone profile
+            audio_control_range_4_n_t(1) range = {
+                .wNumSubRanges = tu_htole16(1),
+                .subrange[0] = { .bMin = (int32_t)sample_rate, .bMax = (int32_t)sample_rate, .bRes = 0 },
+            };
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &range, sizeof(range));
+        }
+        if (ctrl == AUDIO_CS_CTRL_CLK_VALID && p_request->bRequest == AUDIO_CS_REQ_CUR) {
+            audio_control_cur_1_t valid = { .bCur = 1 };
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &valid, sizeof(valid));
+        }
+        return false;
+    }
+
+    if (entity == UAC2_ENTITY_FEATURE_UNIT) {
+        if (ctrl == AUDIO_FU_CTRL_MUTE && p_request->bRequest == AUDIO_CS_REQ_CUR) {
+            audio_control_cur_1_t mute = { .bCur = muted };
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &mute, sizeof(mute));
+        }
+        if (ctrl == AUDIO_FU_CTRL_VOLUME && p_request->bRequest == AUDIO_CS_REQ_CUR) {
+            audio_control_cur_2_t vol = { .bCur = (int16_t)tu_htole16(volume) };
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &vol, sizeof(vol));
+        }
+        if (ctrl == AUDIO_FU_CTRL_VOLUME && p_request->bRequest == AUDIO_CS_REQ_RANGE) {
+            audio_control_range_2_n_t(1) range = {
+                .wNumSubRanges = tu_htole16(1),
+                .subrange[0] = { .bMin = VOLUME_MIN_DB * VOLUME_RES, .bMax = 0, .bRes = VOLUME_RES },
+            };
+            return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &range, sizeof(range));
+        }
+        return false;
+    }
+
+    if (entity == UAC2_ENTITY_INPUT_TERMINAL && ctrl == AUDIO_TE_CTRL_CONNECTOR) {
+        audio_desc_channel_cluster_t cluster = { .bNrChannels = 1, .bmChannelConfig = 0, .iChannelNames = 0 };
+        return tud_audio_buffer_and_schedule_control_xfer(rhport, p_request, &cluster, sizeof(cluster));
+    }
+    return false;
+}
+
+bool tud_audio_set_req_entity_cb(uint8_t rhport, tusb_control_request_t const *p_request, uint8_t *buf) {
+    (void)rhport;
+    uint8_t ctrl   = tu_u16_high(p_request->wValue);
+    uint8_t entity = tu_u16_high(p_request->wIndex);
+
+    if (entity != UAC2_ENTITY_FEATURE_UNIT || p_request->bRequest != AUDIO_CS_REQ_CUR) return false;
+
+    if (ctrl == AUDIO_FU_CTRL_MUTE) {
+        muted = ((audio_control_cur_1_t const *)buf)->bCur != 0;
+        return true;
+    }
+    if (ctrl == AUDIO_FU_CTRL_VOLUME) {
+        int16_t v = (int16_t)tu_le16toh(((audio_control_cur_2_t const *)buf)->bCur);
+        if (v > 0) v = 0;
+        if (v < VOLUME_MIN_DB * VOLUME_RES) v = VOLUME_MIN_DB * VOLUME_RES;
+        volume = v;
+        // Only on a host request, so the soft-float powf does not matter
+        gain_q15 = (int32_t)(32768.0f * powf(10.0f, (float)v / (20.0f * VOLUME_RES)));
+        return true;
+    }
+    return false;
+}
+
+#endif // CFG_TUD_AUDIO
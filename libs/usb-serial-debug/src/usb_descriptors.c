@@ -3,6 +3,8 @@
  * Creates TWO separate CDC interfaces:
  * - CDC0: For printf/debug output
  * - CDC1: For communication messages  
+ * With USB_SERIAL_AUDIO also a USB Audio Class 2 microphone:
+ * - AUDIO: PDM microphone as a standard mono 16-bit input
  * 
  */
 
@@ -16,7 +18,8 @@
 #define _PID_MAP(itf, n)  ( (CFG_TUD_##itf) << (n) )
 #define CDC_EXAMPLE_VID     0xCafe                  // If problem use 0x2E8A (Raspberry pi)
 // use _PID_MAP to generate unique PID for each interface
-#define CDC_EXAMPLE_PID     (0x4000 | _PID_MAP(CDC, 0))  //If using Raspberry Pi VID 0x000A
+// (a different PID with audio, so the host does not reuse a cached CDC-only driver setup)
+#define CDC_EXAMPLE_PID     (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(AUDIO, 2))  //If using Raspberry Pi VID 0x000A
 // set USB 2.0
 #define CDC_BCD     0x0200  
 
@@ -53,6 +56,10 @@ enum {
     ITF_NUM_CDC_0_DATA,
     ITF_NUM_CDC_1,
     ITF_NUM_CDC_1_DATA,
+#if CFG_TUD_AUDIO
+    ITF_NUM_AUDIO_CONTROL,
+    ITF_NUM_AUDIO_STREAMING,
+#endif
     ITF_NUM_TOTAL
 };
 
@@ -61,8 +68,12 @@ enum {
 // This creates a composite device with TWO CDC interfaces
 //--------------------------------------------------------------------
 
-// Calculate total length: config + 2 CDC interfaces
+// Calculate total length: config + 2 CDC interfaces (+ audio microphone)
+#if CFG_TUD_AUDIO
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_CDC_DESC_LEN + TUD_AUDIO_MIC_ONE_CH_DESC_LEN)
+#else
 #define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_CDC_DESC_LEN)
+#endif
 
 // Endpoint numbers for first CDC interface (CDC0 - Debug/Printf)
 #define EPNUM_CDC0_NOTIF 0x81    // CDC0 notification endpoint
@@ -74,6 +85,9 @@ enum {
 #define EPNUM_CDC1_OUT   0x04    // CDC1 data out endpoint
 #define EPNUM_CDC1_IN    0x84    // CDC1 data in endpoint
 
+// Endpoint for the microphone (isochronous, device->host)
+#define EPNUM_AUDIO_IN   0x85    // Audio streaming in endpoint
+
 // configure descriptor (for 2 CDC interfaces)
 uint8_t const desc_configuration[] = {
     // config descriptor | how much power in mA, count of interfaces, ...
@@ -102,6 +116,15 @@ uint8_t const desc_configuration[] = {
                                    EPNUM_CDC1_IN, 
                                    CFG_TUD_CDC_EP_BUFSIZE),
 
+#if CFG_TUD_AUDIO
+    // Audio: control + streaming interface (IAD included in the template)
+    TUD_AUDIO_MIC_ONE_CH_DESCRIPTOR(ITF_NUM_AUDIO_CONTROL,                        // First interface number
+                                   6,                                             // String index
+                                   CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX,    // Bytes per sample
+                                   CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX * 8,// Bits used per sample
+                                   EPNUM_AUDIO_IN,                                // iso IN endpoint address
+                                   CFG_TUD_AUDIO_EP_SZ_IN),                       // iso max packet size
+#endif
 };
 
 // called when host requests to get configuration descriptor
@@ -138,6 +161,7 @@ enum {
     STRID_SERIAL,       // 3: Serials
     STRID_CDC_0,        // 4: CDC Interface 0
     STRID_CDC_1,        // 5: CDC Interface 1
+    STRID_AUDIO,        // 6: Audio microphone
 };
 
 
@@ -148,6 +172,7 @@ char const* string_desc_arr [] = {
     "123456",                        // 3: Serial number (overwritten with unique ID)
     "Stdout CDC",                    // 4: CDC0 Interface (Debug/Printf)
     "Communication CDC",             // 5: CDC1 Interface (Messages)
+    "TKJHAT Microphone",             // 6: Audio Interface (only with USB_SERIAL_AUDIO)
     //"Reset"                          // 6: Reset interface (not added)
 };
 
@@ -0,0 +1,25 @@
+#ifndef SIM_HARDWARE_I2C_H
+#define SIM_HARDWARE_I2C_H
+
+#include <stddef.h>
+
+#include "pico/types.h"
+
+// Transfers go to the simulated devices (sim/src/devices.c) by address;
+// an address without a device is not acknowledged (PICO_ERROR_GENERIC).
+typedef struct i2c_inst {
+    uint index;
+    uint baudrate;
+} i2c_inst_t;
+
+extern i2c_inst_t i2c0_inst, i2c1_inst;
+#define i2c0        (&i2c0_inst)
+#define i2c1        (&i2c1_inst)
+#define i2c_default i2c0
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+void i2c_deinit(i2c_inst_t *i2c);
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef SIM_HARDWARE_IRQ_H
+#define SIM_HARDWARE_IRQ_H
+
+#include "pico/types.h"
+
+// RP2040 numbers, used as labels only (event trace)
+#define IO_IRQ_BANK0 13
+
+// Interrupts are simulated by sim_task; nothing to configure
+static inline void irq_set_enabled(uint num, bool enabled) { (void)num; (void)enabled; }
+
+#endif
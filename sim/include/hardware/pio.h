@@ -0,0 +1,15 @@
+#ifndef SIM_HARDWARE_PIO_H
+#define SIM_HARDWARE_PIO_H
+
+#include "pico/types.h"
+
+// Only the type is needed (struct pdm_microphone_config); the microphone
+// is simulated in sim/src/pdm_sim.c
+typedef struct pio_hw { int unused; } pio_hw_t;
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t sim_pio0, sim_pio1;
+#define pio0 (&sim_pio0)
+#define pio1 (&sim_pio1)
+
+#endif
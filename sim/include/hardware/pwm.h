@@ -0,0 +1,56 @@
+#ifndef SIM_HARDWARE_PWM_H
+#define SIM_HARDWARE_PWM_H
+
+#include "pico/types.h"
+
+#define NUM_PWM_SLICES 8
+
+enum pwm_chan { PWM_CHAN_A = 0, PWM_CHAN_B = 1 };
+
+typedef struct {
+    uint32_t csr;
+    uint32_t div;       // 8.4 fixed point
+    uint32_t top;
+} pwm_config;
+
+// Only the enable register is modelled
+typedef struct {
+    volatile uint32_t en;
+} pwm_hw_t;
+
+extern pwm_hw_t sim_pwm_hw;
+#define pwm_hw (&sim_pwm_hw)
+
+static inline void hw_set_bits(volatile uint32_t *addr, uint32_t mask) { *addr |= mask; }
+static inline void hw_clear_bits(volatile uint32_t *addr, uint32_t mask) { *addr &= ~mask; }
+
+static inline uint pwm_gpio_to_slice_num(uint gpio) { return (gpio >> 1u) & 7u; }
+static inline uint pwm_gpio_to_channel(uint gpio) { return gpio & 1u; }
+
+static inline pwm_config pwm_get_default_config(void) {
+    pwm_config c = { 0, 1u << 4, 0xffffu };
+    return c;
+}
+static inline void pwm_config_set_clkdiv(pwm_config *c, float div) { c->div = (uint32_t)(div * 16.0f); }
+static inline void pwm_config_set_clkdiv_int(pwm_config *c, uint div) { c->div = div << 4; }
+static inline void pwm_config_set_clkdiv_int_frac(pwm_config *c, uint8_t integer, uint8_t fract) {
+    c->div = ((uint32_t)integer << 4) | (fract & 0xfu);
+}
+static inline void pwm_config_set_wrap(pwm_config *c, uint16_t wrap) { c->top = wrap; }
+static inline void pwm_config_set_output_polarity(pwm_config *c, bool a, bool b) {
+    c->csr = (c->csr & ~0xcu) | ((uint32_t)a << 2) | ((uint32_t)b << 3);
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start);
+void pwm_set_enabled(uint slice_num, bool enabled);
+void pwm_set_wrap(uint slice_num, uint16_t wrap);
+void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract);
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level);
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b);
+uint16_t pwm_get_counter(uint slice_num);
+
+static inline void pwm_set_gpio_level(uint gpio, uint16_t level) {
+    pwm_set_chan_level(pwm_gpio_to_slice_num(gpio), pwm_gpio_to_channel(gpio), level);
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include <stdint.h>
+
+uint32_t save_and_disable_interrupts(void);
+void restore_interrupts(uint32_t status);
+
+// Idle hook: sleeps on the host until the next tick (pico_sim.c)
+void __wfi(void);
+static inline void __sev(void) {}
+static inline void __dmb(void) {}
+
+// The simulation runs on one core
+static inline unsigned int get_core_num(void) { return 0; }
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef SIM_HARDWARE_TIMER_H
+#define SIM_HARDWARE_TIMER_H
+
+#include <stdint.h>
+
+// Microseconds since the simulator started (host monotonic clock)
+uint64_t time_us_64(void);
+
+static inline uint32_t time_us_32(void) { return (uint32_t)time_us_64(); }
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef SIM_PICO_STDIO_H
+#define SIM_PICO_STDIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Output goes to the host stdout. Input comes from "cmd" lines of the trace.
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+int puts_raw(const char *s);
+void stdio_set_chars_available_callback(void (*fn)(void *), void *param);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SIM_PICO_STDIO_USB_H
+#define SIM_PICO_STDIO_USB_H
+
+#include "pico/stdio.h"
+
+// The simulator behaves like stdio over USB (LIB_PICO_STDIO_USB=1), so the
+// application uses the same callback driven input path as on the board.
+typedef struct stdio_driver {
+    int (*in_chars)(char *buf, int len);
+} stdio_driver_t;
+
+extern stdio_driver_t stdio_usb;
+
+bool stdio_usb_connected(void);
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * Host simulation (sim/): the subset of the Pico SDK that the application
+ * and TKJHAT use. Same names and signatures as the SDK; implemented in
+ * sim/src/pico_sim.c on top of the FreeRTOS POSIX port.
+ */
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pico/time.h"
+#include "pico/stdio.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+
+#ifndef PICO_ERROR_NONE
+#define PICO_OK                 0
+#define PICO_ERROR_NONE         0
+#define PICO_ERROR_GENERIC      (-1)
+#define PICO_ERROR_TIMEOUT      (-2)
+#endif
+
+static inline void tight_loop_contents(void) {}
+
+#endif
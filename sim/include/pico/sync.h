@@ -0,0 +1,20 @@
+#ifndef SIM_PICO_SYNC_H
+#define SIM_PICO_SYNC_H
+
+#include <stdbool.h>
+
+// Critical sections keep out both the other tasks and the simulated
+// interrupts, like on the board (FreeRTOS critical section on the host).
+typedef struct {
+    bool initialized;
+} critical_section_t;
+
+void critical_section_init(critical_section_t *crit_sec);
+void critical_section_enter_blocking(critical_section_t *crit_sec);
+void critical_section_exit(critical_section_t *crit_sec);
+
+static inline bool critical_section_is_initialized(critical_section_t *crit_sec) {
+    return crit_sec->initialized;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+
+#include "pico/types.h"
+#include "hardware/timer.h"
+
+// Alarms and repeating timers run in the simulator's interrupt context
+// (sim_task, scheduler suspended). Resolution is one FreeRTOS tick.
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer {
+    int64_t delay_us;
+    void *pool;
+    alarm_id_t alarm_id;
+    repeating_timer_callback_t callback;
+    void *user_data;
+};
+
+static inline absolute_time_t get_absolute_time(void) { return time_us_64(); }
+static inline uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000u); }
+static inline uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) { return time_us_64() + ms * 1000ull; }
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void busy_wait_us(uint64_t us);
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+#endif
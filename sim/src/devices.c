@@ -0,0 +1,326 @@
+/*
+ * I2C devices of the HAT for the host simulation. Register level models,
+ * just enough for the driver code in libs/TKJHAT/src/sdk.c and ssd1306.c
+ * to run unchanged:
+ *
+ *   ICM-42670   0x69  WHO_AM_I, configuration, data registers scaled by the
+ *                     full scale range, wake-on-motion with INT1 pulses
+ *   VEML6030    0x10  configuration and ALS registers
+ *   HDC2021     0x40  temperature and humidity registers
+ *   SSD1306     0x3C  command parser and display RAM (horizontal addressing)
+ *
+ * Calls come from i2c_*_blocking() inside a critical section and from the
+ * trace runner in the interrupt context, never concurrently.
+ */
+#include <math.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "tkjhat/pins.h"
+#include "tkjhat/sdk.h"
+
+#include "sim.h"
+
+/* ---- ICM-42670 ---- */
+
+static struct {
+    uint8_t reg[128];
+    uint8_t mreg1[128];
+    uint8_t pointer;
+    float accel[3], gyro[3];
+    float temp_c;
+} imu;
+
+static void imu_reset(void) {
+    memset(imu.reg, 0, sizeof(imu.reg));
+    memset(imu.mreg1, 0, sizeof(imu.mreg1));
+    imu.reg[ICM42670_REG_WHO_AM_I] = ICM42670_WHO_AM_I_RESPONSE;
+    imu.reg[ICM42670_ACCEL_CONFIG0_REG] = 0x06;     // 16 g, 800 Hz
+    imu.reg[ICM42670_GYRO_CONFIG0_REG] = 0x06;      // 2000 dps, 800 Hz
+}
+
+static int16_t scaled(float value, float full_scale) {
+    float v = value * 32768.0f / full_scale;
+    if (v > 32767.0f) v = 32767.0f;
+    if (v < -32768.0f) v = -32768.0f;
+    return (int16_t)lrintf(v);
+}
+
+static void put16(uint8_t *p, int16_t v) {
+    p[0] = (uint8_t)((uint16_t)v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+// Data registers from the current sample; an axis that is off reads -32768
+static void imu_update_data(void) {
+    uint8_t pwr = imu.reg[ICM42670_PWR_MGMT0_REG];
+    bool accel_on = (pwr & 0x03) != 0, gyro_on = (pwr & 0x0C) != 0;
+    float accel_fs = (float)(16 >> ((imu.reg[ICM42670_ACCEL_CONFIG0_REG] >> 5) & 3));
+    float gyro_fs = (float)(2000 >> ((imu.reg[ICM42670_GYRO_CONFIG0_REG] >> 5) & 3));
+    uint8_t *d = &imu.reg[ICM42670_SENSOR_DATA_START_REG];
+
+    put16(d, accel_on || gyro_on ? scaled(imu.temp_c - 25.0f, 256.0f) : INT16_MIN);
+    for (int i = 0; i < 3; i++) {
+        put16(d + 2 + 2 * i, accel_on ? scaled(imu.accel[i], accel_fs) : INT16_MIN);
+        put16(d + 8 + 2 * i, gyro_on ? scaled(imu.gyro[i], gyro_fs) : INT16_MIN);
+    }
+}
+
+static void imu_write(const uint8_t *src, size_t len) {
+    imu.pointer = src[0] & 0x7F;
+    for (size_t i = 1; i < len; i++) {
+        uint8_t r = imu.pointer++ & 0x7F, v = src[i];
+        if (r == ICM42670_REG_SIGNAL_PATH_RESET && (v & ICM42670_RESET_CONFIG_BITS)) {
+            imu_reset();
+            continue;
+        }
+        if (r == ICM42670_M_W_REG && imu.reg[ICM42670_BLK_SEL_W_REG] == 0) {
+            imu.mreg1[imu.reg[ICM42670_MADDR_W_REG] & 0x7F] = v;
+        }
+        imu.reg[r] = v;
+    }
+}
+
+static void imu_read(uint8_t *dst, size_t len) {
+    imu_update_data();
+    for (size_t i = 0; i < len; i++) {
+        uint8_t r = imu.pointer++ & 0x7F;
+        dst[i] = imu.reg[r];
+        if (r == ICM42670_INT_STATUS2_REG) imu.reg[r] = 0;     // clear on read
+    }
+}
+
+// Wake-on-motion in "compare to previous sample" mode: an axis that moved
+// more than its threshold (1 LSB = 1/256 g) sets INT_STATUS2 and pulses INT1
+static void imu_wake_on_motion(const float before[3]) {
+    if (!(imu.reg[ICM42670_WOM_CONFIG_REG] & ICM42670_WOM_EN)) return;
+    if ((imu.reg[ICM42670_PWR_MGMT0_REG] & 0x03) == 0) return;
+
+    uint8_t status = 0;
+    for (int i = 0; i < 3; i++) {
+        float threshold = imu.mreg1[ICM42670_MREG1_ACCEL_WOM_X_THR + i] / 256.0f;
+        if (fabsf(imu.accel[i] - before[i]) > threshold) status |= (uint8_t)(1u << i);
+    }
+    status &= imu.reg[ICM42670_INT_SOURCE1_REG] & ICM42670_WOM_XYZ_INT1_EN;
+    if (status == 0) return;
+
+    imu.reg[ICM42670_INT_STATUS2_REG] |= status;
+    // INT1 active low, pulsed (INT_CONFIG written by init_ICM42670)
+    sim_gpio_input(ICM42670_INT, true);
+    sim_gpio_input(ICM42670_INT, false);
+    sim_gpio_input(ICM42670_INT, true);
+}
+
+void sim_imu_set(const float accel_g[3], const float gyro_dps[3]) {
+    float before[3] = { imu.accel[0], imu.accel[1], imu.accel[2] };
+    for (int i = 0; i < 3; i++) {
+        imu.accel[i] = accel_g[i];
+        imu.gyro[i] = gyro_dps ? gyro_dps[i] : 0.0f;
+    }
+    imu_wake_on_motion(before);
+}
+
+/* ---- VEML6030 ---- */
+
+static struct {
+    uint16_t reg[8];
+    uint8_t pointer;
+    float lux;
+} light = { .reg = { 0x0001 }, .lux = 100.0f };
+
+static void light_write(const uint8_t *src, size_t len) {
+    light.pointer = src[0] & 7;
+    if (len >= 3) light.reg[light.pointer] = (uint16_t)(src[1] | (src[2] << 8));
+}
+
+static void light_read(uint8_t *dst, size_t len) {
+    // ALS counts at gain 1/8, 100 ms (0.5376 lux per count); nothing while shut down
+    bool on = !(light.reg[VEML6030_CONFIG_REG] & 1);
+    float counts = on ? light.lux / 0.5376f : 0.0f;
+    light.reg[VEML6030_ALS_REG] = counts > 65535.0f ? 0xFFFF : (uint16_t)counts;
+
+    uint16_t v = light.reg[light.pointer];
+    for (size_t i = 0; i < len; i++) dst[i] = i == 0 ? (uint8_t)v : i == 1 ? (uint8_t)(v >> 8) : 0;
+}
+
+void sim_light_set(float lux) {
+    light.lux = lux < 0.0f ? 0.0f : lux;
+}
+
+/* ---- HDC2021 ---- */
+
+static struct {
+    uint8_t reg[256];
+    uint8_t pointer;
+    float temp_c, humidity;
+} climate = { .temp_c = 22.0f, .humidity = 40.0f };
+
+static void climate_reset(void) {
+    memset(climate.reg, 0, sizeof(climate.reg));
+    climate.reg[0xFC] = 0x49;       // manufacturer ID (TI)
+    climate.reg[0xFD] = 0x54;
+    climate.reg[0xFE] = 0xD0;       // device ID
+    climate.reg[0xFF] = 0x07;
+}
+
+static void climate_update(void) {
+    uint16_t t = (uint16_t)fminf(65535.0f, fmaxf(0.0f, (climate.temp_c + 40.0f) * 65536.0f / 165.0f));
+    uint16_t rh = (uint16_t)fminf(65535.0f, fmaxf(0.0f, climate.humidity * 65536.0f / 100.0f));
+    climate.reg[HDC2021_TEMP_LOW] = (uint8_t)t;
+    climate.reg[HDC2021_TEMP_HIGH] = (uint8_t)(t >> 8);
+    climate.reg[HDC2021_HUMIDITY_LOW] = (uint8_t)rh;
+    climate.reg[HDC2021_HUMIDITY_HIGH] = (uint8_t)(rh >> 8);
+}
+
+static void climate_write(const uint8_t *src, size_t len) {
+    climate.pointer = src[0];
+    for (size_t i = 1; i < len; i++) {
+        uint8_t r = climate.pointer++;
+        if (r == HDC2021_CONFIG && (src[i] & 0x80)) {
+            climate_reset();
+            continue;
+        }
+        // Triggering a measurement completes at once
+        climate.reg[r] = r == HDC2021_MEASUREMENT_CONFIG ? (uint8_t)(src[i] & ~1u) : src[i];
+    }
+}
+
+static void climate_read(uint8_t *dst, size_t len) {
+    climate_update();
+    for (size_t i = 0; i < len; i++) dst[i] = climate.reg[climate.pointer++];
+}
+
+void sim_climate_set(float temp_c, float humidity) {
+    climate.temp_c = temp_c;
+    climate.humidity = humidity;
+    imu.temp_c = temp_c;
+}
+
+/* ---- SSD1306 ---- */
+
+#define DISPLAY_WIDTH   128
+#define DISPLAY_PAGES   8
+
+static struct {
+    uint8_t ram[DISPLAY_PAGES][DISPLAY_WIDTH];
+    bool on;
+    uint8_t command;        // waiting for arguments of this command
+    uint8_t args[2];
+    uint8_t n_args, need;
+    uint8_t col_start, col_end, page_start, page_end;
+    uint8_t col, page;
+} oled = { .col_end = DISPLAY_WIDTH - 1, .page_end = DISPLAY_PAGES - 1 };
+
+static uint8_t command_args(uint8_t c) {
+    switch (c) {
+    case 0x21: case 0x22:
+        return 2;
+    case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static void oled_command(uint8_t b) {
+    if (oled.need > 0) {
+        oled.args[oled.n_args++] = b;
+        if (oled.n_args < oled.need) return;
+        oled.need = 0;
+        if (oled.command == 0x21) {
+            oled.col_start = oled.col = oled.args[0] & 0x7F;
+            oled.col_end = oled.args[1] & 0x7F;
+        } else if (oled.command == 0x22) {
+            oled.page_start = oled.page = oled.args[0] & 7;
+            oled.page_end = oled.args[1] & 7;
+        }
+        return;
+    }
+    if ((b & 0xFE) == 0xAE) {
+        oled.on = b & 1;
+        return;
+    }
+    oled.command = b;
+    oled.need = command_args(b);
+    oled.n_args = 0;
+}
+
+static void oled_data(uint8_t b) {
+    oled.ram[oled.page][oled.col] = b;
+    if (oled.col++ >= oled.col_end) {
+        oled.col = oled.col_start;
+        if (oled.page++ >= oled.page_end) oled.page = oled.page_start;
+    }
+}
+
+static void oled_write(const uint8_t *src, size_t len) {
+    // Control byte: Co = 0, D/C# selects commands (0x00) or data (0x40)
+    bool data = src[0] & 0x40;
+    for (size_t i = 1; i < len; i++) {
+        if (data) oled_data(src[i]);
+        else oled_command(src[i]);
+    }
+}
+
+static bool pixel(int x, int y) {
+    return oled.ram[y / 8][x] & (1u << (y % 8));
+}
+
+bool sim_display_dump(const char *path) {
+    if (strcmp(path, "-") == 0) {
+        char line[DISPLAY_WIDTH / 2 + 1];
+        sim_log("display %s", oled.on ? "on" : "off");
+        // Two pixels per character horizontally, two rows per line
+        for (int y = 0; y < DISPLAY_PAGES * 8; y += 2) {
+            for (int x = 0; x < DISPLAY_WIDTH; x += 2) {
+                bool top = pixel(x, y) || pixel(x + 1, y), bottom = pixel(x, y + 1) || pixel(x + 1, y + 1);
+                line[x / 2] = top && bottom ? '#' : top ? '"' : bottom ? '_' : ' ';
+            }
+            line[DISPLAY_WIDTH / 2] = '\0';
+            sim_log("|%s|", line);
+        }
+        return true;
+    }
+
+    FILE *f = fopen(path, "w");
+    if (f == NULL) return false;
+    fprintf(f, "P1\n%d %d\n", DISPLAY_WIDTH, DISPLAY_PAGES * 8);
+    for (int y = 0; y < DISPLAY_PAGES * 8; y++) {
+        for (int x = 0; x < DISPLAY_WIDTH; x++) fputc(oled.on && pixel(x, y) ? '1' : '0', f);
+        fputc('\n', f);
+    }
+    fclose(f);
+    return true;
+}
+
+/* ---- bus ---- */
+
+int sim_i2c_write(uint8_t addr, const uint8_t *src, size_t len) {
+    if (len == 0) return PICO_ERROR_GENERIC;
+    switch (addr) {
+    case ICM42670_I2C_ADDRESS: imu_write(src, len); break;
+    case VEML6030_I2C_ADDR:    light_write(src, len); break;
+    case HDC2021_I2C_ADDRESS:  climate_write(src, len); break;
+    case SSD1306_I2C_ADDRESS:  oled_write(src, len); break;
+    default:                   return PICO_ERROR_GENERIC;
+    }
+    return (int)len;
+}
+
+int sim_i2c_read(uint8_t addr, uint8_t *dst, size_t len) {
+    switch (addr) {
+    case ICM42670_I2C_ADDRESS: imu_read(dst, len); break;
+    case VEML6030_I2C_ADDR:    light_read(dst, len); break;
+    case HDC2021_I2C_ADDRESS:  climate_read(dst, len); break;
+    default:                   return PICO_ERROR_GENERIC;
+    }
+    return (int)len;
+}
+
+__attribute__((constructor)) static void devices_init(void) {
+    imu_reset();
+    climate_reset();
+    imu.accel[2] = 1.0f;     // flat on the table
+    imu.temp_c = climate.temp_c;
+}
@@ -0,0 +1,237 @@
+/*
+ * Microphone for the host simulation: the pdm_microphone.h API without PIO,
+ * DMA or the PDM filter. A repeating timer produces one PCM block per block
+ * period in the interrupt context (tone + noise + playback from the trace)
+ * and calls the samples-ready handler, like the DMA handler on the board.
+ * The block ring and the acquire/release rules are the driver's.
+ */
+#include <math.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include <tkjhat/pdm_microphone.h>
+
+#include "sim.h"
+
+#define PDM_PCM_BUFFER_COUNT    3
+#define PDM_SIM_MAX_SAMPLES     512
+
+static struct {
+    struct pdm_microphone_config config;
+    uint decimation;
+    bool initialized;
+    volatile bool running;
+    repeating_timer_t timer;
+    int16_t pcm_buffer[PDM_PCM_BUFFER_COUNT][PDM_SIM_MAX_SAMPLES];
+    volatile uint32_t pcm_produced;
+    volatile uint32_t pcm_consumed;
+    volatile bool pcm_lent;
+    uint32_t pcm_overruns;
+    uint32_t filter_us_last, filter_us_max, filter_blocks;
+    uint64_t filter_us_total;
+    uint16_t filter_volume;
+    pdm_samples_ready_handler_t samples_ready_handler;
+} pdm_mic;
+
+// Signal; written by trace events, read by the timer, both in the interrupt context
+static struct {
+    float tone_hz, tone_amplitude, phase;
+    uint64_t tone_until_us;
+    float noise_amplitude;
+    uint32_t noise_state;
+    const int16_t *play;
+    size_t play_left;
+} signal = { .noise_state = 0x12345678u };
+
+void sim_mic_tone(float hz, float amplitude, uint32_t ms) {
+    signal.tone_hz = hz;
+    signal.tone_amplitude = amplitude;
+    signal.tone_until_us = time_us_64() + (uint64_t)ms * 1000u;
+}
+
+void sim_mic_noise(float amplitude) {
+    signal.noise_amplitude = amplitude;
+}
+
+void sim_mic_play(const int16_t *samples, size_t count) {
+    signal.play = samples;
+    signal.play_left = count;
+}
+
+// xorshift32: rand() takes a host lock
+static float noise(void) {
+    uint32_t x = signal.noise_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    signal.noise_state = x;
+    return (float)(int32_t)x / 2147483648.0f;
+}
+
+static void generate(int16_t *out, uint samples) {
+    float step = 2.0f * (float)M_PI * signal.tone_hz / (float)pdm_mic.config.sample_rate;
+    bool tone = time_us_64() < signal.tone_until_us;
+
+    for (uint i = 0; i < samples; i++) {
+        float v = 0.0f;
+        if (tone) {
+            v += signal.tone_amplitude * sinf(signal.phase);
+            signal.phase += step;
+            if (signal.phase > 2.0f * (float)M_PI) signal.phase -= 2.0f * (float)M_PI;
+        }
+        if (signal.noise_amplitude > 0.0f) v += signal.noise_amplitude * noise();
+        if (v > 1.0f) v = 1.0f;
+        if (v < -1.0f) v = -1.0f;
+
+        int32_t s = (int32_t)(v * 32767.0f);
+        if (signal.play_left > 0) {
+            s += *signal.play++;
+            signal.play_left--;
+            if (s > 32767) s = 32767;
+            if (s < -32768) s = -32768;
+        }
+        out[i] = (int16_t)s;
+    }
+}
+
+static bool block_timer(repeating_timer_t *rt) {
+    (void)rt;
+    if (!pdm_mic.running) return false;
+
+    uint32_t produced = pdm_mic.pcm_produced;
+    if (produced - pdm_mic.pcm_consumed >= PDM_PCM_BUFFER_COUNT) {
+        pdm_mic.pcm_overruns++;
+        return true;
+    }
+
+    uint32_t start = time_us_32();
+    generate(pdm_mic.pcm_buffer[produced % PDM_PCM_BUFFER_COUNT], pdm_mic.config.sample_buffer_size);
+    uint32_t elapsed = time_us_32() - start;
+
+    pdm_mic.filter_us_last = elapsed;
+    if (elapsed > pdm_mic.filter_us_max) pdm_mic.filter_us_max = elapsed;
+    pdm_mic.filter_us_total += elapsed;
+    pdm_mic.filter_blocks++;
+
+    pdm_mic.pcm_produced = produced + 1;
+    if (pdm_mic.samples_ready_handler) pdm_mic.samples_ready_handler();
+    return true;
+}
+
+int pdm_microphone_init(const struct pdm_microphone_config *config) {
+    if (config->sample_buffer_size == 0 || config->sample_buffer_size > PDM_SIM_MAX_SAMPLES ||
+        config->sample_rate == 0) {
+        return -1;
+    }
+    memset(&pdm_mic, 0, sizeof(pdm_mic));
+    pdm_mic.config = *config;
+    pdm_mic.decimation = config->decimation ? config->decimation : 64;
+    pdm_mic.filter_volume = 64;
+    pdm_mic.initialized = true;
+    return 0;
+}
+
+void pdm_microphone_deinit() {
+    pdm_microphone_stop();
+    pdm_mic.initialized = false;
+}
+
+int pdm_microphone_start() {
+    if (!pdm_mic.initialized) return -1;
+    pdm_mic.pcm_produced = 0;
+    pdm_mic.pcm_consumed = 0;
+    pdm_mic.pcm_lent = false;
+    pdm_mic.running = true;
+
+    int64_t period_us = (int64_t)pdm_mic.config.sample_buffer_size * 1000000 / pdm_mic.config.sample_rate;
+    return add_repeating_timer_us(-period_us, block_timer, NULL, &pdm_mic.timer) ? 0 : -1;
+}
+
+void pdm_microphone_stop() {
+    if (!pdm_mic.running) return;
+    pdm_mic.running = false;
+    cancel_repeating_timer(&pdm_mic.timer);
+    pdm_mic.pcm_consumed = pdm_mic.pcm_produced;
+    pdm_mic.pcm_lent = false;
+}
+
+int pdm_microphone_set_profile(uint sample_rate, uint decimation, uint sample_buffer_size) {
+    if (pdm_mic.running || !pdm_mic.initialized) return -1;
+    if (sample_rate == 0 || sample_rate % 1000 || (decimation != 64 && decimation != 128) ||
+        sample_buffer_size == 0 || sample_buffer_size > PDM_SIM_MAX_SAMPLES ||
+        sample_buffer_size % (sample_rate / 1000)) {
+        return -1;
+    }
+    pdm_mic.config.sample_rate = sample_rate;
+    pdm_mic.config.sample_buffer_size = sample_buffer_size;
+    pdm_mic.config.decimation = decimation;
+    pdm_mic.decimation = decimation;
+    pdm_mic.filter_us_last = pdm_mic.filter_us_max = pdm_mic.filter_blocks = 0;
+    pdm_mic.filter_us_total = 0;
+    return 0;
+}
+
+void pdm_microphone_get_stats(struct pdm_microphone_stats *stats) {
+    stats->sample_rate = pdm_mic.config.sample_rate;
+    stats->decimation = pdm_mic.decimation;
+    stats->sample_buffer_size = pdm_mic.config.sample_buffer_size;
+    // What the driver would allocate: two raw PDM blocks and the PCM blocks
+    stats->buffer_bytes = 2u * pdm_mic.config.sample_buffer_size * pdm_mic.decimation / 8u +
+                          PDM_PCM_BUFFER_COUNT * pdm_mic.config.sample_buffer_size * sizeof(int16_t);
+    stats->block_period_us = pdm_mic.config.sample_rate ?
+        (uint32_t)((uint64_t)pdm_mic.config.sample_buffer_size * 1000000u / pdm_mic.config.sample_rate) : 0;
+    stats->filter_us_last = pdm_mic.filter_us_last;
+    stats->filter_us_max = pdm_mic.filter_us_max;
+    stats->filter_blocks = pdm_mic.filter_blocks;
+    stats->filter_us_avg = pdm_mic.filter_blocks ? (uint32_t)(pdm_mic.filter_us_total / pdm_mic.filter_blocks) : 0;
+    stats->overruns = pdm_mic.pcm_overruns;
+}
+
+void pdm_microphone_set_samples_ready_handler(pdm_samples_ready_handler_t handler) {
+    pdm_mic.samples_ready_handler = handler;
+}
+
+void pdm_microphone_set_filter_max_volume(uint8_t max_volume) {
+    (void)max_volume;
+}
+
+void pdm_microphone_set_filter_gain(uint8_t gain) {
+    (void)gain;
+}
+
+void pdm_microphone_set_filter_volume(uint16_t volume) {
+    pdm_mic.filter_volume = volume;
+}
+
+int16_t *pdm_microphone_acquire(size_t *samples) {
+    if (pdm_mic.pcm_lent || pdm_mic.pcm_consumed == pdm_mic.pcm_produced) {
+        if (samples) *samples = 0;
+        return NULL;
+    }
+    pdm_mic.pcm_lent = true;
+    if (samples) *samples = pdm_mic.config.sample_buffer_size;
+    return pdm_mic.pcm_buffer[pdm_mic.pcm_consumed % PDM_PCM_BUFFER_COUNT];
+}
+
+void pdm_microphone_release(int16_t *buffer) {
+    if (!pdm_mic.pcm_lent || buffer != pdm_mic.pcm_buffer[pdm_mic.pcm_consumed % PDM_PCM_BUFFER_COUNT]) {
+        return;
+    }
+    pdm_mic.pcm_lent = false;
+    pdm_mic.pcm_consumed = pdm_mic.pcm_consumed + 1;
+}
+
+uint32_t pdm_microphone_get_overruns() {
+    return pdm_mic.pcm_overruns;
+}
+
+int pdm_microphone_read(int16_t *buffer, size_t samples) {
+    size_t available;
+    int16_t *block = pdm_microphone_acquire(&available);
+    if (block == NULL) return 0;
+    if (samples > available) samples = available;
+    memcpy(buffer, block, samples * sizeof(int16_t));
+    pdm_microphone_release(block);
+    return (int)samples;
+}
@@ -0,0 +1,543 @@
+/*
+ * Pico SDK shim for the host simulation: time, alarms, critical sections,
+ * GPIO, PWM (buzzer and LED observed into the event log), I2C (routed to
+ * devices.c) and stdio over "USB".
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "pico/stdlib.h"
+#include "pico/stdio_usb.h"
+#include "pico/sync.h"
+#include "hardware/i2c.h"
+#include "hardware/pio.h"
+#include "hardware/pwm.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+
+#include "tkjhat/pins.h"
+
+#include "sim.h"
+
+#define SIM_MAX_ALARMS      16
+#define SIM_LOG_ENTRIES     256
+#define SIM_LOG_TEXT        88
+#define SIM_INPUT_SIZE      1024
+
+#ifndef PICO_ERROR_NO_DATA
+#define PICO_ERROR_NO_DATA  (-3)
+#endif
+
+FILE *sim_log_file;
+uint64_t sim_start_us;
+
+/* ---- time ---- */
+
+static struct timespec clock_zero;
+
+__attribute__((constructor)) static void clock_start(void) {
+    clock_gettime(CLOCK_MONOTONIC, &clock_zero);
+}
+
+uint64_t time_us_64(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    int64_t us = (int64_t)(t.tv_sec - clock_zero.tv_sec) * 1000000 + (t.tv_nsec - clock_zero.tv_nsec) / 1000;
+    return (uint64_t)us;
+}
+
+/* ---- interrupt context ---- */
+
+static volatile bool in_irq;
+
+static bool rtos_started(void) {
+    return xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED;
+}
+
+// Keeps out the other tasks and sim_task, like disabling interrupts
+static void lock(void) {
+    if (rtos_started()) taskENTER_CRITICAL();
+}
+
+static void unlock(void) {
+    if (rtos_started()) taskEXIT_CRITICAL();
+}
+
+void sim_irq_enter(void) {
+    vTaskSuspendAll();
+    in_irq = true;
+}
+
+void sim_irq_exit(void) {
+    in_irq = false;
+    xTaskResumeAll();
+}
+
+bool sim_in_irq(void) {
+    return in_irq;
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    lock();
+    return 0;
+}
+
+void restore_interrupts(uint32_t status) {
+    (void)status;
+    unlock();
+}
+
+void critical_section_init(critical_section_t *crit_sec) {
+    crit_sec->initialized = true;
+}
+
+void critical_section_enter_blocking(critical_section_t *crit_sec) {
+    (void)crit_sec;
+    lock();
+}
+
+void critical_section_exit(critical_section_t *crit_sec) {
+    (void)crit_sec;
+    unlock();
+}
+
+/* ---- sleeping ---- */
+
+void busy_wait_us(uint64_t us) {
+    uint64_t end = time_us_64() + us;
+    while (time_us_64() < end) {
+    }
+}
+
+// In a task like the SDK's FreeRTOS time interop: whole ticks block the
+// task, the rest is busy waited. Before the scheduler: host sleep.
+void sleep_us(uint64_t us) {
+    if (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING && !in_irq) {
+        uint64_t end = time_us_64() + us;
+        if (us >= 1000) vTaskDelay(pdMS_TO_TICKS(us / 1000));
+        while (time_us_64() < end) {
+        }
+        return;
+    }
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+void sleep_ms(uint32_t ms) {
+    sleep_us((uint64_t)ms * 1000u);
+}
+
+// The idle task would otherwise keep one host core busy
+void __wfi(void) {
+    struct timespec ts = { 0, 1000000 };
+    nanosleep(&ts, NULL);
+}
+
+/* ---- alarms and repeating timers ---- */
+
+typedef struct {
+    alarm_id_t id;              // 0 = free
+    uint64_t at;
+    alarm_callback_t callback;
+    void *user_data;
+    repeating_timer_t *timer;   // repeating timer, callback unused
+} sim_alarm_t;
+
+static sim_alarm_t alarms[SIM_MAX_ALARMS];
+static alarm_id_t next_alarm_id;
+
+static alarm_id_t alarm_set(alarm_id_t id, uint64_t at, alarm_callback_t callback, void *user_data,
+                            repeating_timer_t *timer) {
+    lock();
+    sim_alarm_t *a = NULL;
+    for (int i = 0; i < SIM_MAX_ALARMS && a == NULL; i++) {
+        if (alarms[i].id == 0) a = &alarms[i];
+    }
+    if (a != NULL) {
+        if (id <= 0) {
+            if (++next_alarm_id <= 0) next_alarm_id = 1;
+            id = next_alarm_id;
+        }
+        a->id = id;
+        a->at = at;
+        a->callback = callback;
+        a->user_data = user_data;
+        a->timer = timer;
+    }
+    unlock();
+    if (a == NULL) return -1;
+    if (!in_irq) sim_wake();
+    return id;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    (void)fire_if_past;     // a past time simply fires on the next pass of sim_task
+    return alarm_set(0, time_us_64() + us, callback, user_data, NULL);
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return add_alarm_in_us((uint64_t)ms * 1000u, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id) {
+    bool found = false;
+    lock();
+    for (int i = 0; i < SIM_MAX_ALARMS; i++) {
+        if (alarm_id > 0 && alarms[i].id == alarm_id) {
+            alarms[i].id = 0;
+            found = true;
+        }
+    }
+    unlock();
+    return found;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out) {
+    out->delay_us = delay_us;
+    out->pool = NULL;
+    out->callback = callback;
+    out->user_data = user_data;
+    uint64_t period = (uint64_t)(delay_us < 0 ? -delay_us : delay_us);
+    out->alarm_id = alarm_set(0, time_us_64() + period, NULL, NULL, out);
+    return out->alarm_id > 0;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out) {
+    return add_repeating_timer_us((int64_t)delay_ms * 1000, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+    alarm_id_t id = timer->alarm_id;
+    timer->alarm_id = 0;
+    return cancel_alarm(id);
+}
+
+uint64_t sim_alarms_run(uint64_t now_us) {
+    for (;;) {
+        sim_alarm_t due = { 0 };
+        uint64_t next = UINT64_MAX;
+
+        lock();
+        int first = -1;
+        for (int i = 0; i < SIM_MAX_ALARMS; i++) {
+            if (alarms[i].id == 0) continue;
+            if (first < 0 || alarms[i].at < alarms[first].at) first = i;
+        }
+        if (first >= 0 && alarms[first].at <= now_us) {
+            due = alarms[first];
+            alarms[first].id = 0;
+        } else if (first >= 0) {
+            next = alarms[first].at;
+        }
+        unlock();
+        if (due.id == 0) return next;
+
+        // Reschedule as the SDK does: a negative delay or return value counts
+        // from the previous target (no drift), a positive one from now
+        if (due.timer != NULL) {
+            repeating_timer_t *t = due.timer;
+            if (t->callback(t) && t->alarm_id == due.id) {
+                uint64_t at = t->delay_us < 0 ? due.at + (uint64_t)(-t->delay_us)
+                                              : time_us_64() + (uint64_t)t->delay_us;
+                alarm_set(due.id, at, NULL, NULL, t);
+            }
+        } else {
+            int64_t again = due.callback(due.id, due.user_data);
+            if (again < 0) {
+                alarm_set(due.id, due.at + (uint64_t)(-again), due.callback, due.user_data, NULL);
+            } else if (again > 0) {
+                alarm_set(due.id, time_us_64() + (uint64_t)again, due.callback, due.user_data, NULL);
+            }
+        }
+    }
+}
+
+/* ---- event log ---- */
+
+typedef struct {
+    uint64_t us;
+    char text[SIM_LOG_TEXT];
+} log_entry_t;
+
+static log_entry_t log_ring[SIM_LOG_ENTRIES];
+static uint32_t log_head, log_tail, log_dropped;
+
+void sim_log(const char *fmt, ...) {
+    uint64_t now = time_us_64();
+    lock();
+    if (log_head - log_tail < SIM_LOG_ENTRIES) {
+        log_entry_t *e = &log_ring[log_head % SIM_LOG_ENTRIES];
+        e->us = now;
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(e->text, sizeof(e->text), fmt, ap);
+        va_end(ap);
+        log_head++;
+    } else {
+        log_dropped++;
+    }
+    unlock();
+}
+
+void sim_log_flush(void) {
+    FILE *out = sim_log_file ? sim_log_file : stderr;
+    for (;;) {
+        log_entry_t e;
+        uint32_t dropped;
+        lock();
+        bool empty = log_tail == log_head;
+        if (!empty) e = log_ring[log_tail++ % SIM_LOG_ENTRIES];
+        dropped = log_dropped;
+        log_dropped = 0;
+        unlock();
+
+        if (dropped) fprintf(out, "sim: %lu events dropped\n", (unsigned long)dropped);
+        if (empty) break;
+        uint64_t t = e.us > sim_start_us ? e.us - sim_start_us : 0;
+        fprintf(out, "%8lu.%03lu %s\n", (unsigned long)(t / 1000000u), (unsigned long)(t / 1000u % 1000u), e.text);
+    }
+    fflush(out);
+}
+
+/* ---- GPIO ---- */
+
+typedef struct {
+    uint8_t function;
+    bool out;
+    bool out_level;
+    bool in_level;
+    uint32_t irq_mask;
+} sim_pin_t;
+
+static sim_pin_t pins[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpio_callback;
+
+void gpio_init(uint gpio) {
+    pins[gpio].function = GPIO_FUNC_SIO;
+    pins[gpio].out = false;
+    pins[gpio].out_level = false;
+}
+
+void gpio_deinit(uint gpio) {
+    pins[gpio].function = GPIO_FUNC_NULL;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    pins[gpio].function = (uint8_t)fn;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    pins[gpio].out = out;
+}
+
+void gpio_put(uint gpio, bool value) {
+    bool changed = pins[gpio].out_level != value;
+    pins[gpio].out_level = value;
+    if (changed && gpio == RED_LED_PIN && pins[gpio].function == GPIO_FUNC_SIO) {
+        sim_log("led %s", value ? "on" : "off");
+    }
+}
+
+bool gpio_get(uint gpio) {
+    return pins[gpio].out ? pins[gpio].out_level : pins[gpio].in_level;
+}
+
+void gpio_set_pulls(uint gpio, bool up, bool down) {
+    (void)down;
+    // An input without a driver reads as its pull
+    if (!pins[gpio].out) pins[gpio].in_level = up;
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+    if (enabled) pins[gpio].irq_mask |= event_mask;
+    else pins[gpio].irq_mask &= ~event_mask;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled,
+                                        gpio_irq_callback_t callback) {
+    gpio_set_irq_enabled(gpio, event_mask, enabled);
+    if (enabled) gpio_callback = callback;
+}
+
+void sim_gpio_input(uint gpio, bool level) {
+    bool was = pins[gpio].in_level;
+    pins[gpio].in_level = level;
+
+    uint32_t events = level ? GPIO_IRQ_LEVEL_HIGH : GPIO_IRQ_LEVEL_LOW;
+    if (level && !was) events |= GPIO_IRQ_EDGE_RISE;
+    if (!level && was) events |= GPIO_IRQ_EDGE_FALL;
+    events &= pins[gpio].irq_mask;
+    if (events && gpio_callback != NULL) gpio_callback(gpio, events);
+}
+
+/* ---- PWM ---- */
+
+pwm_hw_t sim_pwm_hw;
+
+typedef struct {
+    uint32_t div16;
+    uint16_t top;
+    uint16_t level[2];
+} sim_slice_t;
+
+static sim_slice_t slices[NUM_PWM_SLICES];
+static uint32_t buzzer_hz;
+
+// Buzzer tones and the red LED are what a user would notice: log changes
+static void pwm_observe(uint slice, uint chan, uint16_t before, uint16_t after) {
+    uint gpio = slice * 2u + chan;
+    if (gpio == BUZZER_PIN) {
+        if (after == 0) {
+            if (before != 0) sim_log("buzzer off");
+            buzzer_hz = 0;
+            return;
+        }
+        uint32_t hz = (uint32_t)((uint64_t)clock_get_hz(clk_sys) * 16u /
+                                 ((uint64_t)slices[slice].div16 * (slices[slice].top + 1u)));
+        if (before == 0 || hz != buzzer_hz) sim_log("buzzer %lu Hz", (unsigned long)hz);
+        buzzer_hz = hz;
+    } else if (gpio == RED_LED_PIN && (before == 0) != (after == 0)) {
+        sim_log("led %s", after ? "on" : "off");
+    }
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start) {
+    slices[slice_num].div16 = c->div ? c->div : 16u;
+    slices[slice_num].top = (uint16_t)c->top;
+    pwm_set_enabled(slice_num, start);
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled) {
+    if (enabled) hw_set_bits(&sim_pwm_hw.en, 1u << slice_num);
+    else hw_clear_bits(&sim_pwm_hw.en, 1u << slice_num);
+}
+
+void pwm_set_wrap(uint slice_num, uint16_t wrap) {
+    slices[slice_num].top = wrap;
+}
+
+void pwm_set_clkdiv_int_frac(uint slice_num, uint8_t integer, uint8_t fract) {
+    slices[slice_num].div16 = ((uint32_t)integer << 4) | (fract & 0xFu);
+}
+
+void pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) {
+    uint16_t before = slices[slice_num].level[chan & 1u];
+    slices[slice_num].level[chan & 1u] = level;
+    pwm_observe(slice_num, chan & 1u, before, level);
+}
+
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b) {
+    pwm_set_chan_level(slice_num, PWM_CHAN_A, level_a);
+    pwm_set_chan_level(slice_num, PWM_CHAN_B, level_b);
+}
+
+uint16_t pwm_get_counter(uint slice_num) {
+    (void)slice_num;
+    return 0;
+}
+
+/* ---- I2C ---- */
+
+i2c_inst_t i2c0_inst = { 0, 0 }, i2c1_inst = { 1, 0 };
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    i2c->baudrate = baudrate;
+    return baudrate;
+}
+
+void i2c_deinit(i2c_inst_t *i2c) {
+    i2c->baudrate = 0;
+}
+
+// The transfer blocks for as long as it would take on the bus (9 clocks per
+// byte plus the address), so display updates cost the same time as on the board
+static void bus_time(const i2c_inst_t *i2c, size_t len) {
+    uint baud = i2c->baudrate ? i2c->baudrate : 100000u;
+    busy_wait_us((uint64_t)(len + 1u) * 9u * 1000000u / baud);
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    (void)nostop;
+    lock();
+    int rc = sim_i2c_write(addr, src, len);
+    unlock();
+    bus_time(i2c, len);
+    return rc;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    (void)nostop;
+    lock();
+    int rc = sim_i2c_read(addr, dst, len);
+    unlock();
+    bus_time(i2c, len);
+    return rc;
+}
+
+/* ---- PIO (type only) ---- */
+
+pio_hw_t sim_pio0, sim_pio1;
+
+/* ---- stdio ---- */
+
+static char input[SIM_INPUT_SIZE];
+static uint32_t input_head, input_tail;
+static void (*chars_callback)(void *);
+static void *chars_param;
+
+static int usb_in_chars(char *buf, int len) {
+    int n = 0;
+    lock();
+    while (n < len && input_tail != input_head) {
+        buf[n++] = input[input_tail++ % SIM_INPUT_SIZE];
+    }
+    unlock();
+    return n ? n : PICO_ERROR_NO_DATA;
+}
+
+stdio_driver_t stdio_usb = { usb_in_chars };
+
+bool stdio_init_all(void) {
+    // Partial lines ("." and "-" of the gestures) show up at once
+    setvbuf(stdout, NULL, _IONBF, 0);
+    return true;
+}
+
+bool stdio_usb_connected(void) {
+    return true;
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    char c;
+    uint64_t end = time_us_64() + timeout_us;
+    for (;;) {
+        if (usb_in_chars(&c, 1) == 1) return (unsigned char)c;
+        if (time_us_64() >= end) return PICO_ERROR_TIMEOUT;
+        sleep_ms(1);
+    }
+}
+
+int puts_raw(const char *s) {
+    return puts(s);
+}
+
+void stdio_set_chars_available_callback(void (*fn)(void *), void *param) {
+    chars_callback = fn;
+    chars_param = param;
+}
+
+void sim_stdio_push(const char *line) {
+    size_t n = strlen(line);
+    for (size_t i = 0; i <= n; i++) {
+        if (input_head - input_tail >= SIM_INPUT_SIZE) break;     // full: the rest is lost, like an overrun
+        input[input_head++ % SIM_INPUT_SIZE] = i < n ? line[i] : '\n';
+    }
+    if (chars_callback != NULL) chars_callback(chars_param);
+}
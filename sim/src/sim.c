@@ -0,0 +1,258 @@
+/*
+ * Host simulation of the HAT application: runs src/main.c unchanged on the
+ * FreeRTOS POSIX port, with the Pico SDK and the HAT's devices simulated
+ * (pico_sim.c, devices.c, pdm_sim.c). Sensor input comes from a trace file;
+ * the serial output goes to stdout and the actuators (buzzer, LED,
+ * display) to the event log.
+ *
+ * Usage: tkjhat_sim [--trace file] [--sensor-trace file.strace] [--log file]
+ *                   [--display file.pbm]
+ *
+ * Trace lines are "<ms> <event> [args]", ms from the start of the
+ * simulation, in time order; '#' starts a comment:
+ *
+ *   imu ax ay az [gx gy gz]    IMU sample in g and dps, held until the next
+ *   press 1|2                  button press (released after 100 ms)
+ *   cmd <line>                 line to the serial port
+ *   tone hz amplitude ms       sine tone into the microphone (amplitude 0-1)
+ *   noise amplitude            microphone background noise from now on
+ *   mic file.raw               plays 16-bit little-endian mono samples
+ *                              (relative paths from the trace's directory)
+ *   lux value                  ambient light
+ *   climate temp_c rh          temperature and humidity
+ *   display file.pbm|-         dumps the display (into the log with -)
+ *   quit                       ends the simulation (exit status 0)
+ *
+ * Without a trace the simulation runs until interrupted, the IMU flat on
+ * the table. --display writes the display on quit.
+ *
+ * --sensor-trace replays a recording from the device (tools/sensor_trace
+ * capture) through the SDK read functions, record by record, so the
+ * application sees the same input as on the device
+ * (tkjhat/sensor_trace.h). Types not in the recording come from the
+ * simulated devices and the trace file.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+#include "pico/stdlib.h"
+#include "tkjhat/pins.h"
+#include "tkjhat/sensor_trace.h"
+
+#include "sim.h"
+
+#define MAX_LINE            256
+#define BUTTON_PRESS_US     100000
+#define MAX_WAIT_MS         50      // the event log is written at least this often
+
+// src/main.c, built with main renamed (sim/CMakeLists.txt)
+int app_main(void);
+
+typedef struct {
+    uint32_t ms;
+    char event[12];
+    char args[MAX_LINE];
+    int16_t *samples;       // mic
+    size_t count;
+} trace_event_t;
+
+static trace_event_t *trace;
+static size_t trace_len, trace_next;
+static const char *display_path;
+static TaskHandle_t sim_handle;
+
+void sim_wake(void) {
+    if (sim_handle != NULL) xTaskNotifyGive(sim_handle);
+}
+
+static int16_t *load_samples(const char *trace_path, const char *file, size_t *count) {
+    char path[512];
+    const char *slash = strrchr(trace_path, '/');
+    if (file[0] == '/' || slash == NULL) snprintf(path, sizeof(path), "%s", file);
+    else snprintf(path, sizeof(path), "%.*s/%s", (int)(slash - trace_path), trace_path, file);
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    long bytes = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    int16_t *s = malloc(bytes > 0 ? (size_t)bytes : 1);
+    if (s == NULL) exit(1);
+    *count = fread(s, sizeof(int16_t), (size_t)bytes / sizeof(int16_t), f);
+    fclose(f);
+    return s;
+}
+
+static void load_trace(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    char line[MAX_LINE + 32];
+    size_t cap = 0;
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *hash = strchr(line, '#');
+        if (hash != NULL && strncmp(line + strspn(line, " \t0123456789"), "cmd", 3) != 0) *hash = '\0';
+
+        trace_event_t e = { 0 };
+        int used = 0;
+        if (sscanf(line, "%u %11s %n", &e.ms, e.event, &used) < 2) continue;
+        snprintf(e.args, sizeof(e.args), "%s", line + used);
+        if (trace_len > 0 && e.ms < trace[trace_len - 1].ms) {
+            fprintf(stderr, "%s:%d: events out of time order\n", path, lineno);
+            exit(1);
+        }
+        if (strcmp(e.event, "mic") == 0) e.samples = load_samples(path, e.args, &e.count);
+
+        if (trace_len == cap) {
+            cap = cap ? cap * 2 : 64;
+            trace = realloc(trace, cap * sizeof(*trace));
+            if (trace == NULL) exit(1);
+        }
+        trace[trace_len++] = e;
+    }
+    fclose(f);
+}
+
+// The replay reads the records in place: the buffer is never freed
+static void load_sensor_trace(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fseek(f, 0, SEEK_END);
+    long bytes = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(bytes > 0 ? (size_t)bytes : 1);
+    if (data == NULL) exit(1);
+    size_t len = fread(data, 1, bytes > 0 ? (size_t)bytes : 0, f);
+    fclose(f);
+
+    if (sensor_trace_replay(data, len, SENSOR_TRACE_ALL) < 0) {
+        fprintf(stderr, "%s: malformed sensor trace\n", path);
+        exit(1);
+    }
+}
+
+static int64_t button_release(alarm_id_t id, void *user_data) {
+    (void)id;
+    sim_gpio_input((uint)(uintptr_t)user_data, false);
+    return 0;
+}
+
+static void quit(void) {
+    sim_log("quit");
+    sim_log_flush();
+    if (display_path != NULL) sim_display_dump(display_path);
+    fflush(stdout);
+    exit(0);
+}
+
+// Events that feed the hardware run in the interrupt context
+static void run_irq_event(const trace_event_t *e) {
+    float v[6] = { 0 };
+    if (strcmp(e->event, "imu") == 0) {
+        int n = sscanf(e->args, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+        if (n >= 3) sim_imu_set(v, v + 3);
+    } else if (strcmp(e->event, "press") == 0) {
+        uint pin = atoi(e->args) == 2 ? BUTTON2 : BUTTON1;
+        sim_log("press %d", atoi(e->args) == 2 ? 2 : 1);
+        sim_gpio_input(pin, true);
+        add_alarm_in_us(BUTTON_PRESS_US, button_release, (void *)(uintptr_t)pin, true);
+    } else if (strcmp(e->event, "cmd") == 0) {
+        sim_log("> %s", e->args);
+        sim_stdio_push(e->args);
+    } else if (strcmp(e->event, "tone") == 0) {
+        if (sscanf(e->args, "%f %f %f", &v[0], &v[1], &v[2]) == 3) sim_mic_tone(v[0], v[1], (uint32_t)v[2]);
+    } else if (strcmp(e->event, "noise") == 0) {
+        sim_mic_noise((float)atof(e->args));
+    } else if (strcmp(e->event, "mic") == 0) {
+        sim_mic_play(e->samples, e->count);
+    } else if (strcmp(e->event, "lux") == 0) {
+        sim_light_set((float)atof(e->args));
+    } else if (strcmp(e->event, "climate") == 0) {
+        if (sscanf(e->args, "%f %f", &v[0], &v[1]) == 2) sim_climate_set(v[0], v[1]);
+    } else {
+        sim_log("unknown trace event '%s'", e->event);
+    }
+}
+
+static void run_event(const trace_event_t *e) {
+    if (strcmp(e->event, "quit") == 0) {
+        quit();
+    } else if (strcmp(e->event, "display") == 0) {
+        if (!sim_display_dump(e->args[0] ? e->args : "-")) sim_log("display: cannot write %s", e->args);
+    } else {
+        sim_irq_enter();
+        run_irq_event(e);
+        sim_irq_exit();
+    }
+}
+
+// The "interrupt controller": trace events and alarms at their time
+static void sim_task(void *arg) {
+    (void)arg;
+    sim_start_us = time_us_64();
+    sim_log("start");
+
+    for (;;) {
+        uint64_t now = time_us_64();
+        while (trace_next < trace_len && sim_start_us + trace[trace_next].ms * 1000ull <= now) {
+            run_event(&trace[trace_next++]);
+        }
+
+        sim_irq_enter();
+        uint64_t next = sim_alarms_run(time_us_64());
+        sim_irq_exit();
+        sim_log_flush();
+
+        if (trace_next < trace_len) {
+            uint64_t at = sim_start_us + trace[trace_next].ms * 1000ull;
+            if (at < next) next = at;
+        }
+        now = time_us_64();
+        uint64_t wait_ms = next <= now ? 0 : (next - now + 999) / 1000;
+        if (wait_ms > MAX_WAIT_MS) wait_ms = MAX_WAIT_MS;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait_ms));
+    }
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            load_trace(argv[++i]);
+        } else if (strcmp(argv[i], "--sensor-trace") == 0 && i + 1 < argc) {
+            load_sensor_trace(argv[++i]);
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            sim_log_file = fopen(argv[++i], "w");
+            if (sim_log_file == NULL) {
+                perror(argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--display") == 0 && i + 1 < argc) {
+            display_path = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [--trace file] [--sensor-trace file] [--log file] [--display file.pbm]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Above every task of the application, like an interrupt
+    if (xTaskCreate(sim_task, "sim", TASK_STACK_MIN, NULL, configMAX_PRIORITIES - 1, &sim_handle) != pdPASS) {
+        fprintf(stderr, "sim task creation failed\n");
+        return 1;
+    }
+    return app_main();
+}
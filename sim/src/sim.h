@@ -0,0 +1,87 @@
+/*
+ * Host simulation of the HAT application (sim/). Internal interface between
+ * the Pico SDK shim (pico_sim.c), the I2C device models (devices.c), the
+ * microphone (pdm_sim.c) and the trace runner (sim.c).
+ *
+ * Interrupts are simulated by one FreeRTOS task at the highest priority
+ * (sim_task). Alarm callbacks, GPIO callbacks, microphone blocks and trace
+ * events run between sim_irq_enter() and sim_irq_exit() with the scheduler
+ * suspended: no task can run in the middle, *FromISR calls work, and a
+ * yield requested by a callback happens at sim_irq_exit(), like at the end
+ * of an ISR on the board.
+ *
+ * Nothing that can block on a host lock (printf, malloc) may run in the
+ * interrupt context: a preempted task may hold the lock. Events are
+ * therefore logged with sim_log(), which only copies into a ring buffer.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pico/types.h"
+
+/* ---- interrupt context and timing (pico_sim.c) ---- */
+
+void sim_irq_enter(void);
+void sim_irq_exit(void);
+bool sim_in_irq(void);
+
+// Runs the alarms that are due; returns the time of the next one (or UINT64_MAX)
+uint64_t sim_alarms_run(uint64_t now_us);
+
+// sim_task computes its next wakeup again (an alarm was added)
+void sim_wake(void);
+
+// Timestamped event line ("buzzer 4000 Hz"), safe from the interrupt context
+void sim_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Writes the logged events to the log file; only from sim_task outside the
+// interrupt context
+void sim_log_flush(void);
+
+// Event log destination, stderr when NULL (--log)
+extern FILE *sim_log_file;
+
+// Time of the first trace event, the trace and the log count from here
+extern uint64_t sim_start_us;
+
+/* ---- GPIO and stdio input (pico_sim.c) ---- */
+
+// Drives an input pin; calls the GPIO callback on an enabled edge (interrupt context)
+void sim_gpio_input(uint gpio, bool level);
+
+// Queues a line for stdio input and calls the chars-available callback (interrupt context)
+void sim_stdio_push(const char *line);
+
+/* ---- I2C devices (devices.c) ---- */
+
+// Return the number of bytes transferred, or PICO_ERROR_GENERIC (no device)
+int sim_i2c_write(uint8_t addr, const uint8_t *src, size_t len);
+int sim_i2c_read(uint8_t addr, uint8_t *dst, size_t len);
+
+// New IMU sample (g and dps); may raise the wake-on-motion interrupt
+void sim_imu_set(const float accel_g[3], const float gyro_dps[3]);
+void sim_light_set(float lux);
+void sim_climate_set(float temp_c, float humidity);
+
+// Writes the display RAM as a PBM image, or as text into the event log when
+// path is "-". Not from the interrupt context.
+bool sim_display_dump(const char *path);
+
+/* ---- microphone (pdm_sim.c) ---- */
+
+// Sine tone added to the microphone signal for ms milliseconds
+void sim_mic_tone(float hz, float amplitude, uint32_t ms);
+
+// Background noise level (0-1) from now on
+void sim_mic_noise(float amplitude);
+
+// Plays samples recorded at the current sample rate (the trace loads the
+// file when it is read, so nothing is allocated here)
+void sim_mic_play(const int16_t *samples, size_t count);
+
+#endif
@@ -1,20 +1,56 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include <pico/stdlib.h>
+#include <pico/stdio_usb.h>
 
 #include <FreeRTOS.h>
 #include <queue.h>
 #include <task.h>
 
 #include "tkjhat/sdk.h"
+#include "tkjhat/buzzer_sequencer.h"
+#include "tkjhat/dlog.h"
+#include "tkjhat/command.h"
+#include "tkjhat/sensor_trace.h"
+#include "tkjhat/base64.h"
+#include "tkjhat/event_trace.h"
+
+#include "morse.h"
+#include "morse_audio.h"
+#include "power.h"
+#include "rtos_stats.h"
+#include "task_plan.h"
 
-#define DEFAULT_STACK_SIZE 2048
 #define CDC_ITF_TX      1
 #define DEBOUNCE_TIME 250
 #define INPUT_BUFFER_SIZE 256
 
+// Akustinen morsevastaanotin: kuunneltava taajuus ja yhden lohkon aikabudjetti
+// (neljäsosa lohkon kestosta, 256 näytettä @ 8 kHz = 32 ms -> 8 ms)
+#define AUDIO_MORSE_TONE_HZ     MORSE_AUDIO_DEFAULT_TONE_HZ
+#define AUDIO_BLOCK_BUDGET_US   ((MEMS_BUFFER_SIZE * 1000000u) / MEMS_SAMPLING_FREQUENCY / 4)
+
+// Ytimet: tunnistus ja signaalinkäsittely yhdellä, näyttö, USB ja loki
+// toisella. USB:n keskeytys ajetaan ytimellä 0 (stdio_init_all), joten
+// I/O on siellä. Ks. tasks[] main():ssa.
+#ifndef CORE_SENSE
+#define CORE_SENSE              1
+#endif
+#ifndef CORE_IO
+#define CORE_IO                 0
+#endif
+#define TASK_PRIO_BASE          1
+
+// Pinomittaus (cmake -DSTACK_USAGE=ON): stack_profile_task ajaa käsikirjoitetun
+// kuorman oikeiden taskien läpi ja tulostaa jokaisen taskin pinon käytön.
+// tools/stack_report yhdistää tuloksen kääntäjän -fstack-usage-analyysiin.
+#ifndef STACK_PROFILE
+#define STACK_PROFILE           0
+#endif
+
 
 // Funktioiden prototyypit
 static void btn_fxn(uint gpio, uint32_t eventMask);
@@ -22,40 +58,11 @@ static void print_task(void *arg);
 static void sensor_task(void *arg);
 static void morse_task(void *arg);
 static void receive_task(void *arg);
-char decode_morse_letter(const char *morse);
-void decode_morse_message(char *morse_input, char *output, size_t output_size);
-
-
-// Morsekooditaulukko
-static const char *morse_table[] = {
-    ".-",      // A
-    "-...",    // B
-    "-.-.",    // C
-    "-..",     // D
-    ".",       // E
-    "..-.",    // F
-    "--.",     // G
-    "....",    // H
-    "..",      // I
-    ".---",    // J
-    "-.-",     // K
-    ".-..",    // L
-    "--",      // M
-    "-.",      // N
-    "---",     // O
-    ".--.",    // P
-    "--.-",    // Q
-    ".-.",     // R
-    "...",     // S
-    "-",       // T
-    "..-",     // U
-    "...-",    // V
-    ".--",     // W
-    "-..-",    // X
-    "-.--",    // Y
-    "--..",    // Z
-    NULL       // Lopetus
-};
+static void mic_task(void *arg);
+#if DLOG_DEFERRED
+static void dlog_task(void *arg);
+#endif
+static void trace_task(void *arg);
 
 
 // Tilakone morsetukselle
@@ -72,13 +79,62 @@ volatile float pos_x = 0.0, pos_y = 0.0, pos_z = 1.0;
 volatile float accel_x = 0.0, accel_y = 0.0, accel_z = 0.0;
 char translate[INPUT_BUFFER_SIZE];
 char temp_morse[INPUT_BUFFER_SIZE];
+static bool morse_append(const char *symbol);
+static void morse_letter_gap(void);
+
+// Morsevastaanottimen tila. Näytteet luetaan suoraan kirjaston puskureista.
+static TaskHandle_t hMicTask = NULL;
+static TaskHandle_t hMorseTask = NULL;
+static TaskHandle_t hPrintTask = NULL;
+static morse_audio_t morse_rx;
+volatile uint32_t mic_block_max_us = 0;     // pisin mitattu lohkon käsittely
+
+// Komennoilla (receive_task) muutettavat asetukset. Arvot otetaan käyttöön
+// omistavassa taskissa, ettei esim. I2C-väylää tai vastaanotinta käytetä
+// kahdesta taskista yhtä aikaa.
+static volatile uint32_t sensor_period_ms = 500;
+static volatile bool imu_stream = false;
+static volatile uint32_t pending_wpm = 0;       // 0 = ei muutosta
+static volatile uint32_t pending_tone_hz = 0;
+static TaskHandle_t hReceiveTask = NULL;
+static TaskHandle_t hLoadTask = NULL;
+static TaskHandle_t hTraceTask = NULL;
+static volatile bool trace_streaming = false;   // trace_task lähettää tietueet heti
+
+// Eleestä palautteeseen -viive: IMU-lukuhetkestä siihen, kun LED ja summeri
+// on käynnistetty. "lat"-komento tulostaa, "load" lisää kuormaa.
+static volatile uint32_t imu_sample_us = 0;
+static volatile uint32_t lat_max_us = 0, lat_sum_us = 0, lat_count = 0;
+static volatile uint32_t load_percent = 0;
+static volatile bool display_update = false;    // morse_task pyytää print_taskia päivittämään näytön
+
+#if STACK_PROFILE
+// Kuorman syötteet: komentorivi receive_taskille ja asento sensor_taskille
+static const char *volatile profile_line = NULL;
+static volatile bool profile_pose = false;
+static volatile float profile_x = 0.0f, profile_z = 1.0f;
+#endif
 
 
 // Ongelma: nappia painaessa välilyöntejä tuli useampi, duck.ai hakukoneen esimerkistä mallia
 // ottaen luotu yksinkertainen debouncaus käyttäen <time.h> kirjastoa. 
+// Sama käsittelijä saa myös IMU:n liikeherätyksen (INT1), koska GPIO-keskeytyksillä
+// on yksi yhteinen callback.
 static void btn_fxn(uint gpio, uint32_t eventMask) {
     static uint32_t last_press_time = 0;
     uint32_t current_time = to_ms_since_boot(get_absolute_time());
+    BaseType_t woken = pdFALSE;
+
+    // RP2040-portti ei merkitse keskeytyksiä tapahtumajäljitykseen itse
+    EVENT_TRACE_ISR_ENTER(IO_IRQ_BANK0);
+    if (gpio == ICM42670_INT) {
+        power_activity_from_isr(POWER_WAKE_MOTION, &woken);
+        EVENT_TRACE_ISR_EXIT(IO_IRQ_BANK0);
+        portYIELD_FROM_ISR(woken);
+        return;
+    }
+    power_activity_from_isr(POWER_WAKE_BUTTON, &woken);
+    sensor_trace_button(gpio, eventMask);
 
     // Käsitellään vain ylösreuna ja suodatetaan bounce tällä yksinkertaisella debouncella
     if (gpio == SW2_PIN && (eventMask & GPIO_IRQ_EDGE_RISE)) {
@@ -93,6 +149,10 @@ static void btn_fxn(uint gpio, uint32_t eventMask) {
             printState = BUTTON1_PRESSED;
         }
     }
+    // print_task odottaa ilman aikakatkaisua
+    if (hPrintTask != NULL) vTaskNotifyGiveFromISR(hPrintTask, &woken);
+    EVENT_TRACE_ISR_EXIT(IO_IRQ_BANK0);
+    portYIELD_FROM_ISR(woken);
 }
 
 
@@ -108,53 +168,91 @@ static void sensor_task(void *arg){
     // Luetaan dataa ikuisessa loopissa
     for(;;){
         ICM42670_read_sensor_data(&px, &py, &pz, &ax, &ay, &az, &t);
+        uint32_t sampled = time_us_32();
+#if STACK_PROFILE
+        // Pinomittauksen eleet: anturi luetaan silti, mutta asento tulee kuormalta
+        if (profile_pose) {
+            px = profile_x;
+            pz = profile_z;
+        }
+#endif
 
         // Tallennetaan uusin data globaaleihin muuttujiin
         // Poistetu turhat muuttujat, käytetään vain x ja z akselia
         pos_x = px;
         pos_z = pz;
+        imu_sample_us = sampled;
+        power_motion(px, py, pz);
+
+        // Uusi asento: morse_task tarkistaa sen heti eikä vasta pollatessa
+        if (hMorseTask != NULL) xTaskNotifyGive(hMorseTask);
 
-        // Kuinka monta kertaa sekunnissa dataa luetaan, atm kahdesti sekunnissa
-        vTaskDelay(pdMS_TO_TICKS(500));
+        if (imu_stream) {
+            DLOG("IMU %.2f %.2f %.2f\n", px, py, pz);
+        }
+
+        // Kuinka monta kertaa sekunnissa dataa luetaan, oletuksena kahdesti
+        // sekunnissa ("odr"-komento muuttaa). Ilman toimintaa IMU menee
+        // LP-tilaan ja taski odottaa liikettä, nappia tai komentoa (power.h).
+        power_sensor_wait(sensor_period_ms);
     }
 }
 
 
 // Funktio tutkii kiihtyvyysanturin dataa ja muokkaa tilakonetta sekä palauttaa käyttäjälle
 // feedbackia LED:illä ja summerilla. Printtaa myös pisteet ja viivat serial monitoriin.
+static void record_latency(uint32_t sampled){
+    uint32_t us = time_us_32() - sampled;
+    if (us > lat_max_us) lat_max_us = us;
+    lat_sum_us += us;
+    lat_count++;
+}
+
+// Näyttö (write_text nukkuu) päivitetään print_taskissa I/O-ytimellä, jotta
+// palaute seuraaviin eleisiin ei odota sitä.
+static void request_display_update(void){
+    display_update = true;
+    if (hPrintTask != NULL) xTaskNotifyGive(hPrintTask);
+}
+
 static void morse_task(void *arg){
     (void)arg;
 
     for(;;){
+        // Herätys sensor_taskilta jokaisen lukukerran jälkeen. Ei aikakatkaisua:
+        // IMU:n nukkuessa ei ole uutta asentoa tutkittavaksi.
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
         float px = pos_x;
         float pz = pos_z;
+        uint32_t sampled = imu_sample_us;
 
         // Tarkista oikea käännös: x ~= 1 ja z ~= 0
         if (programState == LISTEN) {
 
             // Tarkista vasen käännös: x ~= -1 ja z ~= 0
             if (px > -1.5 && px < -0.5 && pz < 0.5 && pz > -0.5) {
-                printf(".");
                 toggle_led();
-                buzzer_play_tone(4000, 100);
+                buzzer_seq_tone(4000, 100, 0, BUZZER_PRIO_FEEDBACK);   // ei odoteta, asentoa luetaan koko ajan
+                record_latency(sampled);
+                printf(".");
 
                 // Lisätään globaaliinmerkkijonoon piste, käännetään myöhemmin
-                strcat(translate, ".");
-                strcat(temp_morse, ".");
-                write_text(temp_morse);
+                morse_append(".");
+                request_display_update();
 
                 programState = WAIT_FOR_RESETTING;
 
             // Tarkista oikea käännös: x ~= 1 ja z ~= 0
             } else if (px < 1.5 && px > 0.5 && pz < 0.5 && pz > -0.5) {
-                printf("-");
                 toggle_led();
-                buzzer_play_tone(1000, 500);
+                buzzer_seq_tone(1000, 500, 0, BUZZER_PRIO_FEEDBACK);
+                record_latency(sampled);
+                printf("-");
 
                 // Lisätään globaali merkkijonoon viiva, käännetään myöhemmin
-                strcat(translate, "-");
-                strcat(temp_morse, "-");
-                write_text(temp_morse);
+                morse_append("-");
+                request_display_update();
 
                 programState = WAIT_FOR_RESETTING;
             }
@@ -166,43 +264,103 @@ static void morse_task(void *arg){
                 toggle_led();
             }
         }
+    }
+}
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+
+// Merkkijonoihin kirjoittavat morse_task ja mic_task (samalla ytimellä, mic_task
+// korkeammalla prioriteetilla) sekä print_task toisella ytimellä. Jokainen
+// käsittely tehdään kriittisellä osalla; se on lyhyt, pelkkiä kopioita.
+static bool morse_append(const char *symbol){
+    bool added = false;
+    taskENTER_CRITICAL();
+    // Jätetään tilaa merkille ja lopetusmerkille
+    if (strlen(translate) < INPUT_BUFFER_SIZE - 2) {
+        strcat(translate, symbol);
+        if (strlen(temp_morse) < INPUT_BUFFER_SIZE - 2) strcat(temp_morse, symbol);
+        added = true;
     }
+    taskEXIT_CRITICAL();
+    return added;
 }
 
+static void morse_letter_gap(void){
+    taskENTER_CRITICAL();
+    if (strlen(translate) < INPUT_BUFFER_SIZE - 2) strcat(translate, " ");
+    temp_morse[0] = '\0';
+    taskEXIT_CRITICAL();
+}
 
-// AI: Claude Sonnet 4.5
-// Prompt: Luo funktio joka kääntää konsolesta annetun morse-koodin takaisin kirjaimiksi
-// Lisätty kommentteja selventämään toimintaa
-// Funktio on apufunktio decode_morse_message funktiolle, decoodaa yhden yksittäisen kirjaimen
-char decode_morse_letter(const char *morse) {
-    // Tarkista kirjaimet A-Z ja vertaa niitä morse-koodiin
-    for (int i = 0; i < 26; i++) {
-        if (strcmp(morse, morse_table[i]) == 0) {
-            // Jos löydetään pari, palautetaan vastaava kirjain ('A' = 65)
-            // Esim B kirjaimella, i=1, palautetaan 'A' + 1 = 'B'
-            return 'A' + i;
-        }
+
+// Mikrofonikirjaston callback (DMA-keskeytys): uusi lohko valmiina, herätetään mic_task
+static void on_sound_buffer_ready(void) {
+    BaseType_t woken = pdFALSE;
+    if (hMicTask != NULL) {
+        vTaskNotifyGiveFromISR(hMicTask, &woken);
     }
-    return '?';  // Tuntematon morsekoodi
+    portYIELD_FROM_ISR(woken);
 }
 
 
-// Funktio luotu ylläolevan promptin yhteydessä
-// 
-// Muokkaa suoraan syötettä (ei kopioi)
-void decode_morse_message(char *morse_input, char *output, size_t output_size) {
-    size_t out_idx = 0;
-    char *token = strtok(morse_input, " ");  // Muokkaa SUORAAN morse_input:ia
-    
-    while (token != NULL && out_idx < output_size - 1) {
-        char decoded = decode_morse_letter(token);
-        output[out_idx++] = decoded;
-        token = strtok(NULL, " ");
+// Morsevastaanotin antaa symbolit tänne. Lisätään ne samoihin merkkijonoihin
+// kuin asentoliikkeillä annetut, jolloin SW1 dekoodaa molemmat samalla tavalla.
+static void on_morse_symbol(char symbol, void *ctx) {
+    (void)ctx;
+
+    if (symbol == MORSE_AUDIO_DOT || symbol == MORSE_AUDIO_DASH) {
+        char s[2] = { symbol, '\0' };
+        if (morse_append(s)) printf("%s", s);
+    } else if (symbol == MORSE_AUDIO_LETTER_GAP) {
+        printf(" ");
+        morse_letter_gap();
+    }
+    // Sanaväliä (MORSE_AUDIO_WORD_GAP) ei tarvita, dekooderi erottelee vain kirjaimet
+}
+
+
+// Kuuntelee mikrofonia ja syöttää jokaisen 256 näytteen lohkon morsevastaanottimelle.
+// Näytöllä ei päivitetä tässä, koska write_text nukkuu 800 ms ja lohkoja tulisi välistä.
+static void mic_task(void *arg){
+    (void)arg;
+
+    morse_audio_init(&morse_rx, get_microphone_sample_rate(), AUDIO_MORSE_TONE_HZ, 0, on_morse_symbol, NULL);
+
+    if (init_microphone_sampling() < 0) {
+        printf("Microphone sampling could not be started\n");
+        vTaskDelete(NULL);
+    }
+
+    bool budget_warned = false;
+    for(;;){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Komennoilla pyydetyt muutokset vastaanottimeen
+        if (pending_wpm) {
+            morse_audio_set_wpm(&morse_rx, pending_wpm);
+            pending_wpm = 0;
+        }
+        if (pending_tone_hz) {
+            morse_audio_set_tone(&morse_rx, pending_tone_hz);
+            pending_tone_hz = 0;
+        }
+
+        // Käsitellään kaikki valmiit lohkot paikallaan, ilman kopiointia
+        size_t count;
+        int16_t *block;
+        while ((block = acquire_microphone_samples(&count)) != NULL) {
+            uint32_t start = time_us_32();
+            morse_audio_process(&morse_rx, block, count);
+            uint32_t elapsed = time_us_32() - start;
+
+            release_microphone_samples(block);
+
+            if (elapsed > mic_block_max_us) mic_block_max_us = elapsed;
+            if (elapsed > AUDIO_BLOCK_BUDGET_US && !budget_warned) {
+                DLOG("Audio block took %lu us (budget %u us)\n", (unsigned long)elapsed, AUDIO_BLOCK_BUDGET_US);
+                budget_warned = true;
+            }
+        }
     }
-    
-    output[out_idx] = '\0';
 }
 
 
@@ -211,89 +369,561 @@ void decode_morse_message(char *morse_input, char *output, size_t output_size) {
 static void print_task(void *arg){
     (void)arg;
     char decoded_message[INPUT_BUFFER_SIZE];
+    char message[INPUT_BUFFER_SIZE];
 
     for(;;){
         if (printState == BUTTON1_PRESSED) {
-            buzzer_play_tone(1000, 50);
+            buzzer_seq_tone(1000, 50, 0, BUZZER_PRIO_FEEDBACK);
             clear_display();
 
-            if (translate[0] != '\0') {
-                decode_morse_message(translate, decoded_message, INPUT_BUFFER_SIZE);
-                printf("\nDecoded message: %s\n", decoded_message);
+            // Otetaan viesti talteen ja tyhjennetään globaali merkkijono
+            taskENTER_CRITICAL();
+            strcpy(message, translate);
+            translate[0] = '\0';
+            taskEXIT_CRITICAL();
+
+            if (message[0] != '\0') {
+                decode_morse_message(message, decoded_message, INPUT_BUFFER_SIZE);
+                DLOG("\nDecoded message: %s\n", decoded_message);
                 write_text(decoded_message);
             } else {
-                printf("Resetting, clearing display.\n");
+                DLOG("Resetting, clearing display.\n");
             }
 
-            // Tyhjennetään globaali merkkijono
-            translate[0] = '\0';
-
             printState = LISTEN_PRINT;
         } else if (printState == BUTTON2_PRESSED) {
             printf(" ");
-            buzzer_play_tone(1000, 50);
+            buzzer_seq_tone(1000, 50, 0, BUZZER_PRIO_FEEDBACK);
 
             // Lisätään globaaliin merkkijonoon välilyönti kirjainten erottamiseksi
-            strcat(translate, " ");
-            temp_morse[0] = '\0'; // Tyhjennetään väliaikainen morse-merkkijono
+            // ja tyhjennetään väliaikainen morse-merkkijono
+            morse_letter_gap();
             clear_display();
 
             printState = LISTEN_PRINT;
+        } else if (display_update) {
+            // morse_task lisäsi merkin: näytetään keskeneräinen kirjain
+            display_update = false;
+            taskENTER_CRITICAL();
+            strcpy(message, temp_morse);
+            taskEXIT_CRITICAL();
+            write_text(message);
+        }
+        // Herätys morse_taskilta tai nappien keskeytykseltä
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+
+// Rivi, joka ei ole komento, on morseviesti: dekoodataan ja näytetään
+static void on_morse_line(char *line, void *ctx){
+    (void)ctx;
+    char decoded_message[INPUT_BUFFER_SIZE];
+    decode_morse_message(line, decoded_message, INPUT_BUFFER_SIZE);
+
+    // Tulosta debug
+    DLOG("Morse: \"%s\" → \"%s\"\n", line, decoded_message);
+    clear_display();
+    write_text(decoded_message); // Show the morse code on the display
+
+    // Indicate message received: kaksi piippausta, ohittaa palauteäänet
+    static const buzzer_note_t received_beeps[] = {
+        { 2000, 50000, 50000 },
+        { 2000, 50000, 0 },
+    };
+    buzzer_seq_play(received_beeps, 2, BUZZER_PRIO_NORMAL);
+}
+
+static void command_reply(const char *text, void *ctx){
+    (void)ctx;
+    printf("%s", text);
+}
+
+static bool parse_u32(const char *s, uint32_t min, uint32_t max, uint32_t *out){
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (*s == '\0' || *end != '\0' || v < min || v > max) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+
+// wpm <5-40>: vastaanottimen nopeusarvion lähtöarvo
+static int cmd_wpm(int argc, char **argv, void *ctx){
+    (void)ctx;
+    uint32_t v;
+    if (argc != 2 || !parse_u32(argv[1], 5, 40, &v)) return COMMAND_USAGE;
+    pending_wpm = v;
+    return COMMAND_OK;
+}
+
+// tone <hz>: kuunneltava taajuus
+static int cmd_tone(int argc, char **argv, void *ctx){
+    (void)ctx;
+    uint32_t v;
+    if (argc != 2 || !parse_u32(argv[1], 200, 3000, &v)) return COMMAND_USAGE;
+    pending_tone_hz = v;
+    return COMMAND_OK;
+}
+
+// odr <1-100>: IMU:n lukutaajuus (Hz)
+static int cmd_odr(int argc, char **argv, void *ctx){
+    (void)ctx;
+    uint32_t v;
+    if (argc != 2 || !parse_u32(argv[1], 1, 100, &v)) return COMMAND_USAGE;
+    sensor_period_ms = 1000 / v;
+    return COMMAND_OK;
+}
+
+// stream on|off: IMU-arvot sarjaporttiin jokaisella lukukerralla
+static int cmd_stream(int argc, char **argv, void *ctx){
+    (void)ctx;
+    if (argc != 2) return COMMAND_USAGE;
+    if (strcmp(argv[1], "on") == 0)       imu_stream = true;
+    else if (strcmp(argv[1], "off") == 0) imu_stream = false;
+    else return COMMAND_USAGE;
+    return COMMAND_OK;
+}
+
+// stats: taskien CPU-kuorma, joutoaika, pinot ja keko edellisestä stats-komennosta
+static int cmd_stats(int argc, char **argv, void *ctx){
+    (void)argv;
+    (void)ctx;
+    if (argc != 1) return COMMAND_USAGE;
+    static rtos_stats_t stats;
+    rtos_stats_sample(&stats);
+    rtos_stats_print(&stats);
+    return COMMAND_OK;
+}
+
+// lat [reset]: eleestä palautteeseen -viive (pahin ja keskiarvo)
+static int cmd_lat(int argc, char **argv, void *ctx){
+    (void)ctx;
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+        lat_max_us = lat_sum_us = lat_count = 0;
+        return COMMAND_OK;
+    }
+    if (argc != 1) return COMMAND_USAGE;
+    uint32_t n = lat_count;
+    printf("gestures %lu max %lu us avg %lu us load %lu%% placement %d\n",
+           (unsigned long)n, (unsigned long)lat_max_us,
+           (unsigned long)(n ? lat_sum_us / n : 0), (unsigned long)load_percent, TASK_PLACEMENT);
+    return COMMAND_OK;
+}
+
+// load <0-100>: kuormataskit varaavat prosenttiosuuden suoritinajasta
+static int cmd_load(int argc, char **argv, void *ctx){
+    (void)ctx;
+    uint32_t v;
+    if (argc != 2 || !parse_u32(argv[1], 0, 100, &v)) return COMMAND_USAGE;
+    load_percent = v;
+    if (hLoadTask != NULL) xTaskNotifyGive(hLoadTask);
+    return COMMAND_OK;
+}
+
+// power [low|off|on]: virranhallinnan tila ja herätykset sekunnissa edellisestä
+// power-komennosta. low/off pakottaa tilan heti (mittauksiin).
+static int cmd_power(int argc, char **argv, void *ctx){
+    (void)ctx;
+    if (argc == 2) {
+        if (strcmp(argv[1], "low") == 0)      power_request(POWER_LOW);
+        else if (strcmp(argv[1], "off") == 0) power_request(POWER_OFF);
+        else if (strcmp(argv[1], "on") == 0)  power_request(POWER_ACTIVE);
+        else return COMMAND_USAGE;
+        return COMMAND_OK;
+    }
+    if (argc != 1) return COMMAND_USAGE;
+    static power_stats_t stats;
+    power_sample(&stats);
+    power_print(&stats);
+    return COMMAND_OK;
+}
+
+static bool parse_trace_types(int argc, char **argv, uint32_t *mask){
+    static const char *const names[SENSOR_TRACE_TYPES] = {
+        [SENSOR_TRACE_IMU] = "imu", [SENSOR_TRACE_LIGHT] = "light", [SENSOR_TRACE_TEMP] = "temp",
+        [SENSOR_TRACE_HUMIDITY] = "hum", [SENSOR_TRACE_BUTTON] = "btn", [SENSOR_TRACE_MIC] = "mic",
+    };
+    *mask = argc == 0 ? SENSOR_TRACE_ALL : 0;
+    for (int i = 0; i < argc; i++) {
+        int t = SENSOR_TRACE_IMU;
+        while (t < SENSOR_TRACE_TYPES && strcmp(argv[i], names[t]) != 0) t++;
+        if (t == SENSOR_TRACE_TYPES) return false;
+        *mask |= SENSOR_TRACE_MASK(t);
+    }
+    return true;
+}
+
+// trace rec ring|stream [tyypit] | stop | dump | clear | put <base64> |
+// replay [tyypit]: anturisyötteen tallennus ja toisto (tkjhat/sensor_trace.h).
+// Tiedostoksi ja takaisin laitteelle: tools/sensor_trace
+static int cmd_trace(int argc, char **argv, void *ctx){
+    (void)ctx;
+    uint32_t mask;
+    if (argc == 1) {
+        static const char *const states[] = { "idle", "recording", "replaying" };
+        sensor_trace_stats_t st;
+        sensor_trace_get_stats(&st);
+        printf("trace %s records %lu dropped %lu buffered %lu\n", states[st.state],
+               (unsigned long)st.records, (unsigned long)st.dropped, (unsigned long)st.buffered);
+        return COMMAND_OK;
+    }
+    if (strcmp(argv[1], "rec") == 0 && argc >= 3) {
+        bool ring = strcmp(argv[2], "ring") == 0;
+        if (!ring && strcmp(argv[2], "stream") != 0) return COMMAND_USAGE;
+        if (!parse_trace_types(argc - 3, argv + 3, &mask)) return COMMAND_USAGE;
+        sensor_trace_record(ring ? SENSOR_TRACE_RING : SENSOR_TRACE_STREAM, mask);
+        trace_streaming = !ring;
+    } else if (strcmp(argv[1], "stop") == 0 && argc == 2) {
+        sensor_trace_stop();
+        trace_streaming = false;
+    } else if (strcmp(argv[1], "dump") == 0 && argc == 2) {
+        // Pysäytetään, ettei rengas kierrä purkamisen aikana
+        sensor_trace_stop();
+        trace_streaming = false;
+    } else if (strcmp(argv[1], "clear") == 0 && argc == 2) {
+        sensor_trace_clear();
+        trace_streaming = false;
+    } else if (strcmp(argv[1], "put") == 0 && argc == 3) {
+        // Rivin pituus rajaa palan, tools/sensor_trace lähettää 144 tavua kerrallaan
+        uint8_t chunk[(COMMAND_LINE_MAX / 4) * 3];
+        int n = base64_decode(argv[2], chunk, sizeof(chunk));
+        if (n < 0) return COMMAND_USAGE;
+        if (!sensor_trace_load(chunk, (size_t)n)) {
+            printf("trace buffer full\n");
+            return COMMAND_OK;
         }
-        vTaskDelay(pdMS_TO_TICKS(100));
+    } else if (strcmp(argv[1], "replay") == 0) {
+        if (!parse_trace_types(argc - 2, argv + 2, &mask)) return COMMAND_USAGE;
+        trace_streaming = false;
+        int n = sensor_trace_replay(NULL, 0, mask);
+        if (n < 0) printf("trace malformed\n");
+        else printf("trace replay %d records\n", n);
+        return COMMAND_OK;
+    } else {
+        return COMMAND_USAGE;
+    }
+    if (hTraceTask != NULL) xTaskNotifyGive(hTraceTask);
+    return COMMAND_OK;
+}
+
+#if EVENT_TRACE
+static void trace_line(const char *line, void *ctx);
+
+// evtrace start|stop|dump: tehtävävaihdot, keskeytykset ja ajurien vaiheet
+// (tkjhat/event_trace.h). Perfetto-tiedostoksi: tools/event_trace
+static int cmd_evtrace(int argc, char **argv, void *ctx){
+    (void)ctx;
+    if (argc == 1) {
+        printf("evtrace %s\n", event_trace_running() ? "recording" : "stopped");
+    } else if (argc == 2 && strcmp(argv[1], "start") == 0) {
+        event_trace_start();
+    } else if (argc == 2 && strcmp(argv[1], "stop") == 0) {
+        event_trace_stop();
+    } else if (argc == 2 && strcmp(argv[1], "dump") == 0) {
+        // Puskuri ei saa kiertää purkamisen aikana
+        event_trace_stop();
+        unsigned lines = event_trace_dump(trace_line, NULL);
+        printf("evtrace %u lines\n", lines);
+    } else {
+        return COMMAND_USAGE;
     }
+    return COMMAND_OK;
 }
+#endif
+
+static int cmd_tasks(int argc, char **argv, void *ctx);
+
+static const command_t commands[] = {
+    { "wpm",    cmd_wpm,    "wpm <5-40>       set audio receiver speed" },
+    { "tone",   cmd_tone,   "tone <200-3000>  set audio receiver tone (Hz)" },
+    { "odr",    cmd_odr,    "odr <1-100>      set IMU read rate (Hz)" },
+    { "stream", cmd_stream, "stream on|off    print IMU values" },
+    { "stats",  cmd_stats,  "stats            CPU, stack and heap use per task" },
+    { "tasks",  cmd_tasks,  "tasks            task placement (core, deadline, priority)" },
+    { "lat",    cmd_lat,    "lat [reset]      gesture to feedback latency" },
+    { "load",   cmd_load,   "load <0-100>     busy load on the I/O tasks' core" },
+    { "power",  cmd_power,  "power [low|off|on] power mode and CPU wakeups per second" },
+    { "trace",  cmd_trace,  "trace [rec ring|stream|stop|dump|clear|put|replay] sensor trace" },
+#if EVENT_TRACE
+    { "evtrace", cmd_evtrace, "evtrace [start|stop|dump] task and interrupt timeline" },
+#endif
+};
 
+#if LIB_PICO_STDIO_USB
+// USB-pinon ilmoitus: merkkejä saatavilla. Herätetään receive_task.
+static void on_stdio_chars(void *param){
+    (void)param;
+    BaseType_t woken = pdFALSE;
+    if (hReceiveTask != NULL) {
+        vTaskNotifyGiveFromISR(hReceiveTask, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+#endif
 
+// Lukee sarjaportin kokonaisina paloina heti kun dataa tulee ja syöttää ne
+// komentotulkille. Rivit, jotka eivät ole komentoja, ovat morseviestejä.
 static void receive_task(void *arg){
     (void)arg;
-    char line[INPUT_BUFFER_SIZE];
-    size_t index = 0;
-    
+    static command_parser_t parser;
+    command_parser_init(&parser, commands, sizeof(commands) / sizeof(commands[0]), on_morse_line, NULL);
+    command_parser_set_output(&parser, command_reply);
+
+#if LIB_PICO_STDIO_USB
+    stdio_set_chars_available_callback(on_stdio_chars, NULL);
+#endif
+
     for(;;){
-        //OPTION 1
-        // Using getchar_timeout_us https://www.raspberrypi.com/documentation/pico-sdk/runtime.html#group_pico_stdio_1ga5d24f1a711eba3e0084b6310f6478c1a
-        // take one char per time and store it in line array, until reeceived the \n
-        // The application should instead play a sound, or blink a LED. 
-        int c = getchar_timeout_us(0);
-        if (c != PICO_ERROR_TIMEOUT){// I have received a character
-            if (c == '\r') continue; // ignore CR, wait for LF if (ch == '\n') { line[len] = '\0';
-            if (c == '\n'){
-                // terminate and process the collected line
-                line[index] = '\0'; 
-                // DEKOODAA morse-viesti
-                char decoded_message[INPUT_BUFFER_SIZE];
-                decode_morse_message(line, decoded_message, INPUT_BUFFER_SIZE);
-                
-                // Tulosta debug
-                printf("Morse: \"%s\" → \"%s\"\n", line, decoded_message);
-                clear_display();
-                write_text(decoded_message); // Show the morse code on the display
-
-                buzzer_play_tone(2000, 50); // Indicate message received
-                vTaskDelay(pdMS_TO_TICKS(50));
-                buzzer_play_tone(2000, 50);
-
-                index = 0;
-                vTaskDelay(pdMS_TO_TICKS(100)); // Wait for new message
-            }
-            else if(index < INPUT_BUFFER_SIZE - 1){
-                line[index++] = (char)c;
-            }
-            else { //Overflow: print and restart the buffer with the new character. 
-                line[INPUT_BUFFER_SIZE - 1] = '\0';
-                printf("Morsed: %s\n", line);
-                index = 0; 
-                line[index++] = (char)c; 
-            }
+        // Odotetaan ilmoitusta; aikakatkaisu varmistaa, ettei mitään jää jumiin
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+
+#if STACK_PROFILE
+        if (profile_line != NULL) {
+            char line[INPUT_BUFFER_SIZE];
+            snprintf(line, sizeof(line), "%s\n", profile_line);
+            command_parser_feed(&parser, line, strlen(line));
+            profile_line = NULL;
+        }
+#endif
+
+        int n;
+#if LIB_PICO_STDIO_USB
+        char buf[64];
+        while ((n = stdio_usb.in_chars(buf, sizeof(buf))) > 0) {
+            power_activity(POWER_WAKE_SERIAL);
+            command_parser_feed(&parser, buf, (size_t)n);
         }
-        else {
-            vTaskDelay(pdMS_TO_TICKS(100)); // Wait for new message
+#else
+        while ((n = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+            char c = (char)n;
+            power_activity(POWER_WAKE_SERIAL);
+            command_parser_feed(&parser, &c, 1);
         }
+#endif
     }
 }
 
 
+#if DLOG_DEFERRED
+// Siirtää DLOG-tietueet USB:lle matalalla prioriteetilla. Muotoilu tehdään
+// koneella: tools/dlog_format <elf> <portti>
+static void dlog_task(void *arg){
+    (void)arg;
+    for(;;){
+        dlog_drain();
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+}
+#endif
+
+
+// Anturitallenteen tietueet sarjaporttiin: tallennuksen aikana 50 ms välein,
+// muuten vain "trace"-komennon herättämänä (dump)
+static void trace_line(const char *line, void *ctx){
+    (void)ctx;
+    puts_raw(line);
+}
+
+static void trace_task(void *arg){
+    (void)arg;
+    for(;;){
+        ulTaskNotifyTake(pdTRUE, trace_streaming ? pdMS_TO_TICKS(50) : portMAX_DELAY);
+        sensor_trace_drain(trace_line, NULL);
+    }
+}
+
+// Toistetut napinpainallukset samaan käsittelijään kuin oikeat
+static void trace_button(uint32_t gpio, uint32_t events){
+    btn_fxn((uint)gpio, events);
+}
+
+
+// Keinotekoinen kuorma viivemittausta varten: pyörii load_percent osan
+// jokaisesta 10 ms jaksosta. Sijoitettu kuin näyttö/USB-työ, joten
+// sijoitustaulukon kanssa se kilpailee vain I/O-ytimestä.
+static void load_task(void *arg){
+    (void)arg;
+    for(;;){
+        // Ilman kuormaa ei herätä 10 ms välein, "load" herättää
+        if (load_percent == 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        uint32_t busy_us = load_percent * 100u;
+        uint32_t start = time_us_32();
+        while (time_us_32() - start < busy_us) {
+            tight_loop_contents();
+        }
+        vTaskDelay(pdMS_TO_TICKS(10 - busy_us / 1000));
+    }
+}
+
+
+#if STACK_PROFILE
+// Syöttää rivin receive_taskille ja odottaa, että se on käsitelty
+static void profile_command(const char *line){
+    profile_line = line;
+    xTaskNotifyGive(hReceiveTask);
+    while (profile_line != NULL) vTaskDelay(pdMS_TO_TICKS(10));
+    vTaskDelay(pdMS_TO_TICKS(200));
+}
+
+static void profile_gesture(float x, float z){
+    profile_x = x;
+    profile_z = z;
+    vTaskDelay(pdMS_TO_TICKS(3 * sensor_period_ms));
+}
+
+static void profile_button(enum printState button){
+    printState = button;
+    xTaskNotifyGive(hPrintTask);
+    vTaskDelay(pdMS_TO_TICKS(1500));    // write_text nukkuu 800 ms
+}
+
+static const task_plan_t *find_plan(const char *name);
+
+// Käsikirjoitettu kuorma: jokainen taski käy läpi raskaimmat polkunsa
+// (komennot ja printf, eleet ja palaute, napit ja näyttö). Mikrofoni
+// kuuntelee koko ajan. Lopuksi tulostetaan rivit
+//   STACK <taski> <koko> <käytetty> <vapaa>      (tavuja)
+// joista tools/stack_report tekee raportin.
+static void stack_profile_task(void *arg){
+    (void)arg;
+    static const char *const lines[] = {
+        "help", "stats", "tasks", "lat", "wpm 20", "tone 700", "odr 50",
+        "stream on", "... --- ...", ".- -... -.-. -.. . ..-. --. .... .. .--- -.-",
+        "stream off", "load 50", "load 0", "odr 2", "lat reset",
+    };
+
+    vTaskDelay(pdMS_TO_TICKS(3000));
+    printf("STACK_PROFILE start\n");
+
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        profile_command(lines[i]);
+    }
+
+    profile_pose = true;
+    for (int i = 0; i < 4; i++) {
+        profile_gesture(-1.0f, 0.0f);   // vasen: piste
+        profile_gesture(0.0f, 1.0f);
+        profile_gesture(1.0f, 0.0f);    // oikea: viiva
+        profile_gesture(0.0f, 1.0f);
+    }
+    profile_pose = false;
+
+    profile_button(BUTTON2_PRESSED);
+    profile_button(BUTTON1_PRESSED);
+    profile_button(BUTTON1_PRESSED);
+
+    static rtos_stats_t stats;
+    rtos_stats_sample(&stats);
+    for (uint8_t i = 0; i < stats.n_tasks; i++) {
+        const rtos_task_stat_t *t = &stats.tasks[i];
+        const task_plan_t *plan = find_plan(t->name);
+        // Kernelin omien taskien kokoa ei ole taulukossa
+        uint32_t size = plan ? plan->stack * sizeof(StackType_t) : 0;
+        printf("STACK %s %lu %lu %lu\n", t->name, (unsigned long)size,
+               (unsigned long)(size ? size - t->stack_free : 0), (unsigned long)t->stack_free);
+    }
+    printf("STACK_PROFILE end\n");
+    vTaskDelete(NULL);
+}
+
+// Ylivuototarkistus (configCHECK_FOR_STACK_OVERFLOW 2) on päällä mittauksessa
+void vApplicationStackOverflowHook(TaskHandle_t task, char *name){
+    (void)task;
+    printf("STACK_OVERFLOW %s\n", name);
+    for(;;) tight_loop_contents();
+}
+#endif
+
+// Pinojen koot sanoina (4 tavua). Staattisen käännöksen (STATIC_ALLOCATION)
+// koot on arvioitu taskien omista puskureista (print/receive: 256 tavun
+// merkkijonot ja printf), EI vielä mitattu. Mitoitus: laitteella
+// STACK_USAGE-käännös ja sen tuloste tools/stack_reportille, sen
+// "suggest"-sarake tähän ja raportin päiväys ja käännös tähän kommenttiin.
+// Siihen asti tavallinen käännös pitää kaikilla 2048 sanaa, ja staattisessa
+// tarkista "stats"-komennon stack_free: vähintään kolmannes pinosta pitää
+// jäädä vapaaksi.
+#if configSUPPORT_STATIC_ALLOCATION
+#define STACK_MIC               1024
+#define STACK_SENSOR            768
+#define STACK_MORSE             768
+#define STACK_PRINT             1024
+#define STACK_RECEIVE           1024
+#define STACK_LOAD              256
+#define STACK_DLOG              512
+#define STACK_TRACE             256
+#define STACK_PROFILER          1024
+#else
+#define STACK_DEFAULT           2048
+#define STACK_MIC               STACK_DEFAULT
+#define STACK_SENSOR            STACK_DEFAULT
+#define STACK_MORSE             STACK_DEFAULT
+#define STACK_PRINT             STACK_DEFAULT
+#define STACK_RECEIVE           STACK_DEFAULT
+#define STACK_LOAD              STACK_DEFAULT
+#define STACK_DLOG              STACK_DEFAULT
+#define STACK_TRACE             STACK_DEFAULT
+#define STACK_PROFILER          STACK_DEFAULT
+#endif
+
+TASK_STATIC_MEMORY(mic, STACK_MIC);
+TASK_STATIC_MEMORY(sensor, STACK_SENSOR);
+TASK_STATIC_MEMORY(morse, STACK_MORSE);
+TASK_STATIC_MEMORY(print, STACK_PRINT);
+TASK_STATIC_MEMORY(receive, STACK_RECEIVE);
+TASK_STATIC_MEMORY(load, STACK_LOAD);
+TASK_STATIC_MEMORY(trace, STACK_TRACE);
+#if DLOG_DEFERRED
+TASK_STATIC_MEMORY(dlog, STACK_DLOG);
+#endif
+#if STACK_PROFILE
+TASK_STATIC_MEMORY(stack_profile, STACK_PROFILER);
+#endif
+
+// Taskien sijoitus. Määräaika (ms) määrää prioriteetin, ks. task_plan.h:
+//   mic     lohko valmis 32 ms välein (8 kHz, 256 näytettä)
+//   sensor  IMU luetaan enintään 100 Hz ("odr")
+//   morse   palaute eleeseen
+//   print   napit ja näyttö
+//   receive komennot sarjaportista
+//   trace   anturitallenne sarjaporttiin, ei kiirettä
+static task_plan_t tasks[] = {
+    { mic_task,     "mic",     STACK_MIC,     32,   CORE_SENSE, &hMicTask,     TASK_MEMORY(mic) },
+    { sensor_task,  "sensor",  STACK_SENSOR,  10,   CORE_SENSE, NULL,          TASK_MEMORY(sensor) },
+    { morse_task,   "morse",   STACK_MORSE,   50,   CORE_SENSE, &hMorseTask,   TASK_MEMORY(morse) },
+    { print_task,   "print",   STACK_PRINT,   100,  CORE_IO,    &hPrintTask,   TASK_MEMORY(print) },
+    { receive_task, "receive", STACK_RECEIVE, 200,  CORE_IO,    &hReceiveTask, TASK_MEMORY(receive) },
+    { load_task,    "load",    STACK_LOAD,    100,  CORE_IO,    &hLoadTask,    TASK_MEMORY(load) },
+    { trace_task,   "trace",   STACK_TRACE,   1000, CORE_IO,    &hTraceTask,   TASK_MEMORY(trace) },
+#if DLOG_DEFERRED
+    { dlog_task,    "dlog",    STACK_DLOG,    1000, CORE_IO,    NULL,          TASK_MEMORY(dlog) },
+#endif
+#if STACK_PROFILE
+    { stack_profile_task, "stack_profile", STACK_PROFILER, 1000, CORE_IO, NULL, TASK_MEMORY(stack_profile) },
+#endif
+};
+#define TASK_COUNT (sizeof(tasks) / sizeof(tasks[0]))
+
+#if STACK_PROFILE
+static const task_plan_t *find_plan(const char *name){
+    for (size_t i = 0; i < TASK_COUNT; i++) {
+        if (tasks[i].fn != NULL && strcmp(tasks[i].name, name) == 0) return &tasks[i];
+    }
+    return NULL;
+}
+#endif
+
+static int cmd_tasks(int argc, char **argv, void *ctx){
+    (void)argv;
+    (void)ctx;
+    if (argc != 1) return COMMAND_USAGE;
+    task_plan_print(tasks, TASK_COUNT, TASK_PRIO_BASE);
+    return COMMAND_OK;
+}
+
+
 // AI: Claude Sonnet 4.5
 // Prompt: Analysoi koodi main.c ja muokkaa main funktio toimivaksi. Älä luo uutta, muokkaa olemassa olevaa.
 // Lisätty buzzerin alustus ja init_hat_sdk jonka AI poisti.
@@ -316,34 +946,31 @@ int main() {
     init_display();
     clear_display();
 
+    // Mikrofoni on valinnainen: jos alustus epäonnistuu, muu sovellus toimii silti
+    bool mic_ok = init_pdm_microphone() == 0;
+    if (mic_ok) {
+        pdm_microphone_set_callback(on_sound_buffer_ready);
+    } else {
+        printf("PDM microphone initialization failed\n");
+    }
+
     // Asetetaan keskeytyksen käsittelijät
     gpio_set_irq_enabled_with_callback(SW1_PIN, GPIO_IRQ_EDGE_RISE, true, btn_fxn);
     gpio_set_irq_enabled_with_callback(SW2_PIN, GPIO_IRQ_EDGE_RISE, true, btn_fxn);
 
-    TaskHandle_t hSensorTask, hMorseTask, hPrintTask, hReceiveTask = NULL;
-
-    // Luodaan taskit pyörimään taustalle ja tarkistetaan onnistuiko
-    BaseType_t result = xTaskCreate(sensor_task, "sensor", DEFAULT_STACK_SIZE, NULL, 2, &hSensorTask);
-    if(result != pdPASS) {
-        printf("Sensor task creation failed\n");
-        return 0;
-    }
+    // IMU:n INT1 (push-pull, aktiivinen alhaalla): liikeherätys LP-tilassa
+    gpio_init(ICM42670_INT);
+    gpio_set_dir(ICM42670_INT, GPIO_IN);
+    gpio_set_irq_enabled_with_callback(ICM42670_INT, GPIO_IRQ_EDGE_FALL, true, btn_fxn);
+    sensor_trace_set_button_handler(trace_button);
 
-    result = xTaskCreate(morse_task, "morse", DEFAULT_STACK_SIZE, NULL, 2, &hMorseTask);
-    if(result != pdPASS) {
-        printf("Morse Task creation failed\n");
-        return 0;
-    }
-
-    result = xTaskCreate(print_task, "print", DEFAULT_STACK_SIZE, NULL, 2, &hPrintTask);
-    if(result != pdPASS) {
-        printf("Print Task (CMD) creation failed\n");
-        return 0;
+    // Mikrofonitaskia ei luoda ilman mikrofonia
+    for (size_t i = 0; i < TASK_COUNT; i++) {
+        if (tasks[i].fn == mic_task && !mic_ok) tasks[i].fn = NULL;
     }
 
-    result = xTaskCreate(receive_task, "receive", DEFAULT_STACK_SIZE, NULL, 2, &hReceiveTask);
-    if(result != pdPASS) {
-        printf("Receive Task creation failed\n");
+    // Luodaan taskit sijoitustaulukon mukaan ja tarkistetaan onnistuiko
+    if (task_plan_start(tasks, TASK_COUNT, TASK_PRIO_BASE) < 0) {
         return 0;
     }
 
@@ -0,0 +1,69 @@
+#include <string.h>
+
+#include "morse.h"
+
+
+// Morsekooditaulukko
+static const char *morse_table[] = {
+    ".-",      // A
+    "-...",    // B
+    "-.-.",    // C
+    "-..",     // D
+    ".",       // E
+    "..-.",    // F
+    "--.",     // G
+    "....",    // H
+    "..",      // I
+    ".---",    // J
+    "-.-",     // K
+    ".-..",    // L
+    "--",      // M
+    "-.",      // N
+    "---",     // O
+    ".--.",    // P
+    "--.-",    // Q
+    ".-.",     // R
+    "...",     // S
+    "-",       // T
+    "..-",     // U
+    "...-",    // V
+    ".--",     // W
+    "-..-",    // X
+    "-.--",    // Y
+    "--..",    // Z
+    NULL       // Lopetus
+};
+
+
+// AI: Claude Sonnet 4.5
+// Prompt: Luo funktio joka kääntää konsolesta annetun morse-koodin takaisin kirjaimiksi
+// Lisätty kommentteja selventämään toimintaa
+// Funktio on apufunktio decode_morse_message funktiolle, decoodaa yhden yksittäisen kirjaimen
+char decode_morse_letter(const char *morse) {
+    // Tarkista kirjaimet A-Z ja vertaa niitä morse-koodiin
+    for (int i = 0; i < 26; i++) {
+        if (strcmp(morse, morse_table[i]) == 0) {
+            // Jos löydetään pari, palautetaan vastaava kirjain ('A' = 65)
+            // Esim B kirjaimella, i=1, palautetaan 'A' + 1 = 'B'
+            return 'A' + i;
+        }
+    }
+    return '?';  // Tuntematon morsekoodi
+}
+
+
+// Funktio luotu ylläolevan promptin yhteydessä
+//
+// Muokkaa suoraan syötettä (ei kopioi)
+void decode_morse_message(char *morse_input, char *output, size_t output_size) {
+    size_t out_idx = 0;
+    char *token = strtok(morse_input, " ");  // Muokkaa SUORAAN morse_input:ia
+
+    while (token != NULL && out_idx < output_size - 1) {
+        char decoded = decode_morse_letter(token);
+        output[out_idx++] = decoded;
+        token = strtok(NULL, " ");
+    }
+
+    output[out_idx] = '\0';
+}
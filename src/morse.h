@@ -0,0 +1,15 @@
+#ifndef MORSE_H
+#define MORSE_H
+
+#include <stddef.h>
+
+// Morsekoodin dekoodaus. Ei riipu Pico SDK:sta, joten tiedoston voi kääntää
+// myös tietokoneella (ks. tools/morse_wav).
+
+// Dekoodaa yhden kirjaimen, esim. ".-" -> 'A'. Tuntematon koodi -> '?'.
+char decode_morse_letter(const char *morse);
+
+// Dekoodaa välilyönneillä erotellun viestin. Muokkaa suoraan syötettä (strtok).
+void decode_morse_message(char *morse_input, char *output, size_t output_size);
+
+#endif
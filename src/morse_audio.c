@@ -0,0 +1,220 @@
+#include <math.h>
+
+#include "morse_audio.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Pisteen pituuden rajat (WPM), ettei arvio karkaa kohinan takia
+#define MORSE_AUDIO_MIN_WPM     5
+#define MORSE_AUDIO_MAX_WPM     40
+
+// Kynnys vaatii vähintään tämän eron huipun ja kohinan välillä (amplitudi)
+// sekä huipun vähintään MIN_SNR-kertaisena kohinaan nähden (12 dB)
+#define MORSE_AUDIO_MIN_CONTRAST 40
+#define MORSE_AUDIO_MIN_SNR      4
+
+
+// Kokonaislukuneliöjuuri, bitti kerrallaan (32 kierrosta)
+static uint32_t isqrt64(uint64_t v) {
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > v) bit >>= 2;
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+// Pisteen pituus ikkunoina (Q8) annetulla nopeudella. Piste = 1200 / WPM ms.
+static uint32_t dot_q8_from_wpm(const morse_audio_t *d, uint32_t wpm) {
+    uint64_t num = (uint64_t)1200 * 256 * d->sample_rate;
+    uint64_t den = (uint64_t)wpm * d->window_len * 1000;
+    return (uint32_t)(num / den);
+}
+
+static void emit(morse_audio_t *d, char symbol) {
+    if (d->handler) d->handler(symbol, d->ctx);
+}
+
+void morse_audio_set_tone(morse_audio_t *d, uint32_t tone_hz) {
+    if (tone_hz == 0) tone_hz = MORSE_AUDIO_DEFAULT_TONE_HZ;
+    d->tone_hz = tone_hz;
+
+    double w = 2.0 * M_PI * (double)tone_hz / (double)d->sample_rate;
+    d->coeff_q14 = (int32_t)lround(2.0 * cos(w) * 16384.0);
+
+    d->s1 = d->s2 = 0;
+    d->n = 0;
+}
+
+void morse_audio_set_wpm(morse_audio_t *d, uint32_t wpm) {
+    if (wpm < MORSE_AUDIO_MIN_WPM) wpm = MORSE_AUDIO_MIN_WPM;
+    if (wpm > MORSE_AUDIO_MAX_WPM) wpm = MORSE_AUDIO_MAX_WPM;
+    d->dot_q8 = dot_q8_from_wpm(d, wpm);
+    d->dash_q8 = 3 * d->dot_q8;
+}
+
+void morse_audio_init(morse_audio_t *d, uint32_t sample_rate, uint32_t tone_hz,
+                      uint16_t window_len, morse_symbol_handler_t handler, void *ctx) {
+    d->sample_rate = sample_rate;
+    d->window_len = window_len ? window_len : MORSE_AUDIO_DEFAULT_WINDOW;
+    d->handler = handler;
+    d->ctx = ctx;
+
+    d->envelope = 0;
+    d->noise = 0;
+    d->peak = 0;
+    d->key_down = false;
+    d->primed = false;
+
+    d->run = 0;
+    morse_audio_set_wpm(d, MORSE_AUDIO_DEFAULT_WPM);
+    d->letter_open = false;
+    d->word_open = false;
+
+    morse_audio_set_tone(d, tone_hz);
+}
+
+// Yksikön (pisteen) pituusarvio: keskiarvo pisteistä ja viivoista (viiva = 3 yksikköä)
+static uint32_t unit_q8(const morse_audio_t *d) {
+    return (d->dot_q8 + d->dash_q8 / 3) / 2;
+}
+
+// Merkki loppui: piste vai viiva? Raja on pisteen ja viivan arvioiden
+// geometrinen keskiarvo, ja arviot päivitetään puolen painolla, jotta
+// nopeuden vaihdos opitaan muutamassa merkissä.
+static void mark_ended(morse_audio_t *d, uint32_t len) {
+    uint32_t len_q8 = len << 8;
+
+    // Liian lyhyt pulssi on todennäköisesti naksahdus
+    if (len_q8 < d->dot_q8 / 3) return;
+
+    uint32_t min_dot = dot_q8_from_wpm(d, MORSE_AUDIO_MAX_WPM);
+    uint32_t max_dot = dot_q8_from_wpm(d, MORSE_AUDIO_MIN_WPM);
+
+    // Paljon arvioitua pidempi merkki: nopeus on pudonnut niin paljon, että
+    // "viivat" olivatkin pisteitä. Siirretään luokat kerralla kohdalleen.
+    if (len_q8 > 2 * d->dash_q8) {
+        d->dot_q8 = d->dash_q8;
+        d->dash_q8 = len_q8;
+    }
+
+    // Viiva pidetään 2..4 pisteen mittaisena, muuten luokat sekoittuvat.
+    // Päivitetty arvio vetää toista perässään.
+    if ((uint64_t)len_q8 * len_q8 < (uint64_t)d->dot_q8 * d->dash_q8) {
+        emit(d, MORSE_AUDIO_DOT);
+        d->dot_q8 = (d->dot_q8 + len_q8) / 2;
+        if (d->dot_q8 < min_dot) d->dot_q8 = min_dot;
+        if (d->dot_q8 > max_dot) d->dot_q8 = max_dot;
+        if (d->dash_q8 < 2 * d->dot_q8) d->dash_q8 = 2 * d->dot_q8;
+        if (d->dash_q8 > 4 * d->dot_q8) d->dash_q8 = 4 * d->dot_q8;
+    } else {
+        emit(d, MORSE_AUDIO_DASH);
+        d->dash_q8 = (d->dash_q8 + len_q8) / 2;
+        if (d->dash_q8 < 3 * min_dot) d->dash_q8 = 3 * min_dot;
+        if (d->dash_q8 > 3 * max_dot) d->dash_q8 = 3 * max_dot;
+        if (d->dot_q8 < d->dash_q8 / 4) d->dot_q8 = d->dash_q8 / 4;
+        if (d->dot_q8 > d->dash_q8 / 2) d->dot_q8 = d->dash_q8 / 2;
+    }
+
+    d->letter_open = true;
+    d->word_open = true;
+}
+
+// Tauko jatkuu: kirjainväli on 3 yksikköä ja sanaväli 7. Rajat puolivälissä.
+static void space_tick(morse_audio_t *d) {
+    uint32_t run_q8 = d->run << 8;
+    uint32_t unit = unit_q8(d);
+
+    if (d->letter_open && run_q8 >= 2 * unit) {
+        emit(d, MORSE_AUDIO_LETTER_GAP);
+        d->letter_open = false;
+    }
+    if (d->word_open && run_q8 >= 5 * unit) {
+        emit(d, MORSE_AUDIO_WORD_GAP);
+        d->word_open = false;
+    }
+}
+
+// Yksi Goertzel-ikkuna valmis: amplitudi -> kynnys -> ajoitus
+static void window_done(morse_audio_t *d) {
+    int64_t s1 = d->s1, s2 = d->s2;
+    int64_t power = s1 * s1 + s2 * s2 - ((d->coeff_q14 * s1 * s2) >> 14);
+    if (power < 0) power = 0;
+
+    // Skaalataan ikkunan pituudella, jolloin arvo on suunnilleen sävelen amplitudi
+    uint32_t mag = (uint32_t)(((uint64_t)isqrt64((uint64_t)power) * 2) / d->window_len);
+
+    // Verhokäyrä: nopea nousu, hitaampi lasku
+    if (mag > d->envelope) d->envelope = mag;
+    else                   d->envelope = (d->envelope + mag) / 2;
+    uint32_t env = d->envelope;
+
+    // Ensimmäinen ikkuna asettaa kohinatason, muuten alun kohina laukaisisi
+    if (!d->primed) {
+        d->noise = d->peak = env;
+        d->primed = true;
+    }
+
+    // Huippu vaimenee noin puolessa sekunnissa. Kohinataso seuraa minimiä ja
+    // nousee vain tauon aikana, ettei pitkä viiva nosta sitä signaalin tasolle.
+    if (env > d->peak) d->peak = env;
+    else               d->peak -= d->peak >> 6;
+    if (env < d->noise)    d->noise = (3 * d->noise + env) / 4;
+    else if (!d->key_down) d->noise += (env - d->noise) >> 7;
+
+    uint32_t span = d->peak > d->noise ? d->peak - d->noise : 0;
+    bool contrast = span > MORSE_AUDIO_MIN_CONTRAST && d->peak > MORSE_AUDIO_MIN_SNR * d->noise;
+
+    // Hystereesi: päälle 5/8, pois 3/8 huipun ja kohinan välistä
+    bool key = d->key_down;
+    if (!contrast)                                key = false;
+    else if (env > d->noise + (span * 5) / 8)     key = true;
+    else if (env < d->noise + (span * 3) / 8)     key = false;
+
+    if (key != d->key_down) {
+        if (d->key_down) mark_ended(d, d->run);
+        d->key_down = key;
+        d->run = 0;
+    }
+    d->run++;
+
+    if (!d->key_down) space_tick(d);
+}
+
+void morse_audio_process(morse_audio_t *d, const int16_t *samples, size_t count) {
+    int32_t s1 = d->s1, s2 = d->s2;
+    const int64_t coeff = d->coeff_q14;
+
+    for (size_t i = 0; i < count; i++) {
+        int32_t s0 = samples[i] + (int32_t)((coeff * s1) >> 14) - s2;
+        s2 = s1;
+        s1 = s0;
+
+        if (++d->n == d->window_len) {
+            d->s1 = s1;
+            d->s2 = s2;
+            window_done(d);
+            s1 = s2 = 0;
+            d->n = 0;
+        }
+    }
+
+    d->s1 = s1;
+    d->s2 = s2;
+}
+
+uint32_t morse_audio_wpm(const morse_audio_t *d) {
+    uint64_t num = (uint64_t)1200 * 256 * d->sample_rate;
+    uint64_t den = (uint64_t)unit_q8(d) * d->window_len * 1000;
+    return den ? (uint32_t)(num / den) : 0;
+}
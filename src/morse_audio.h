@@ -0,0 +1,78 @@
+#ifndef MORSE_AUDIO_H
+#define MORSE_AUDIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Akustinen morsevastaanotin PDM-mikrofonille.
+//
+// Ketju: Goertzel-suodin (yksi taajuus) -> verhokäyrä -> mukautuva kynnys
+// -> ajoituksen palautus (pisteen pituus ja WPM-arvio) -> symbolit.
+// Kaikki laskenta on kokonaislukuja lukuun ottamatta kertoimen laskemista
+// alustuksessa, joten lohkon käsittelyaika on rajattu: yksi 64-bittinen
+// kertolasku per näyte ja yksi neliöjuuri per Goertzel-ikkuna.
+//
+// Moduuli ei käytä Pico SDK:ta, joten sen voi ajaa tietokoneella WAV-
+// tiedostoja vasten (tools/morse_wav).
+
+#define MORSE_AUDIO_DEFAULT_TONE_HZ     600
+#define MORSE_AUDIO_DEFAULT_WINDOW      64      // näytettä, 8 ms @ 8 kHz
+#define MORSE_AUDIO_DEFAULT_WPM         15
+
+// Symbolit joita käsittelijä saa
+#define MORSE_AUDIO_DOT                 '.'
+#define MORSE_AUDIO_DASH                '-'
+#define MORSE_AUDIO_LETTER_GAP          ' '
+#define MORSE_AUDIO_WORD_GAP            '/'
+
+typedef void (*morse_symbol_handler_t)(char symbol, void *ctx);
+
+typedef struct {
+    // Asetukset
+    uint32_t sample_rate;
+    uint32_t tone_hz;
+    uint16_t window_len;
+    int32_t coeff_q14;          // 2*cos(w) Q14-muodossa
+
+    // Goertzelin tila
+    int32_t s1, s2;
+    uint16_t n;
+
+    // Verhokäyrä ja mukautuva kynnys
+    uint32_t envelope;
+    uint32_t noise;
+    uint32_t peak;
+    bool key_down;
+    bool primed;                // kohinataso alustettu ensimmäisestä ikkunasta
+
+    // Ajoitus (yksikkönä Goertzel-ikkuna)
+    uint32_t run;               // nykyisen merkin tai tauon pituus
+    uint32_t dot_q8;            // pisteen pituusarvio, Q8
+    uint32_t dash_q8;           // viivan pituusarvio, Q8
+    bool letter_open;           // kirjain kesken, väliä ei vielä lähetetty
+    bool word_open;             // sana kesken
+
+    morse_symbol_handler_t handler;
+    void *ctx;
+} morse_audio_t;
+
+// Alustaa ilmaisimen. tone_hz = 0 tai window_len = 0 -> oletusarvo.
+void morse_audio_init(morse_audio_t *d, uint32_t sample_rate, uint32_t tone_hz,
+                      uint16_t window_len, morse_symbol_handler_t handler, void *ctx);
+
+// Vaihtaa kuunneltavan taajuuden (nollaa suodattimen tilan, ei ajoitusta).
+void morse_audio_set_tone(morse_audio_t *d, uint32_t tone_hz);
+
+// Asettaa nopeusarvion lähtöarvon (oletus MORSE_AUDIO_DEFAULT_WPM). Arvio
+// mukautuu vastaanotettuun nopeuteen muutamassa merkissä.
+void morse_audio_set_wpm(morse_audio_t *d, uint32_t wpm);
+
+// Käsittelee lohkon näytteitä. Lohkon pituus voi olla mitä tahansa, ikkunat
+// jatkuvat lohkojen yli. Kutsuu käsittelijää jokaisesta löydetystä symbolista.
+void morse_audio_process(morse_audio_t *d, const int16_t *samples, size_t count);
+
+// Nykyinen nopeusarvio (sanaa minuutissa, PARIS-normi).
+uint32_t morse_audio_wpm(const morse_audio_t *d);
+
+#endif
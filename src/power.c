@@ -0,0 +1,180 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <pico/stdlib.h>
+#include <hardware/sync.h>
+
+#include "tkjhat/sdk.h"
+#include "tkjhat/dlog.h"
+
+#include "power.h"
+
+static volatile power_mode_t mode = POWER_ACTIVE;
+static volatile power_mode_t requested = POWER_ACTIVE;     // POWER_ACTIVE = automaattinen
+static volatile uint32_t last_activity_ms;
+static volatile uint32_t wakes[POWER_WAKE_SOURCES];
+static volatile uint32_t cpu_wakeups;
+static TaskHandle_t sensor_task = NULL;
+
+static uint32_t mode_ms[POWER_MODES];
+static uint32_t mode_since_ms;
+static float last_ax, last_ay, last_az;
+
+static uint32_t prev_sample_ms;
+static uint32_t prev_wakeups;
+
+static const char *const mode_names[POWER_MODES] = { "active", "low", "off" };
+
+static uint32_t now_ms(void) {
+    return to_ms_since_boot(get_absolute_time());
+}
+
+void power_activity(power_wake_t source) {
+    last_activity_ms = now_ms();
+    if (mode != POWER_ACTIVE) {
+        wakes[source]++;
+        if (sensor_task != NULL) xTaskNotifyGive(sensor_task);
+    }
+}
+
+void power_activity_from_isr(power_wake_t source, BaseType_t *woken) {
+    last_activity_ms = now_ms();
+    if (mode != POWER_ACTIVE) {
+        wakes[source]++;
+        if (sensor_task != NULL) vTaskNotifyGiveFromISR(sensor_task, woken);
+    }
+}
+
+void power_motion(float ax, float ay, float az) {
+    if (fabsf(ax - last_ax) > POWER_MOTION_G || fabsf(ay - last_ay) > POWER_MOTION_G ||
+        fabsf(az - last_az) > POWER_MOTION_G) {
+        last_activity_ms = now_ms();
+    }
+    last_ax = ax;
+    last_ay = ay;
+    last_az = az;
+}
+
+// Vaihtaa IMU:n tilan; kutsutaan vain sensor_taskista
+static void enter(power_mode_t next) {
+    uint32_t now = now_ms();
+    mode_ms[mode] += now - mode_since_ms;
+    mode_since_ms = now;
+
+    switch (next) {
+    case POWER_ACTIVE:
+        if (mode == POWER_LOW) ICM42670_disable_wake_on_motion();
+        ICM42670_start_with_default_values();
+        last_activity_ms = now;
+        break;
+    case POWER_LOW:
+        if (ICM42670_enable_wake_on_motion(POWER_WOM_THRESHOLD_MG) != 0) {
+            printf("IMU wake-on-motion could not be enabled\n");
+        }
+        break;
+    case POWER_OFF:
+        ICM42670_disable_wake_on_motion();
+        ICM42670_power_down();
+        break;
+    default:
+        return;
+    }
+    mode = next;
+    DLOG("power %s\n", mode_names[next]);
+}
+
+void power_sensor_wait(uint32_t period_ms) {
+    sensor_task = xTaskGetCurrentTaskHandle();
+
+    if (mode == POWER_ACTIVE) {
+        uint32_t idle = now_ms() - last_activity_ms;
+        if (requested == POWER_ACTIVE && idle < POWER_LOW_AFTER_MS) {
+            vTaskDelay(pdMS_TO_TICKS(period_ms));
+            return;
+        }
+        // IMU:n uudelleenasetus kestää yli 50 ms, ja sillä aikaa mode on vielä
+        // POWER_ACTIVE, jolloin herätykset eivät ilmoita. Niiden jälki jää
+        // last_activity_ms:ään: jos se muuttui, palataan heti aktiiviseksi.
+        uint32_t seen = last_activity_ms;
+        enter(requested == POWER_OFF ? POWER_OFF : POWER_LOW);
+        requested = POWER_ACTIVE;
+        // Ennen tilan vaihtoa tulleet herätykset eivät koske uutta tilaa
+        ulTaskNotifyTake(pdTRUE, 0);
+        if (last_activity_ms != seen) {
+            enter(POWER_ACTIVE);
+            return;
+        }
+    }
+
+    for (;;) {
+        TickType_t timeout = portMAX_DELAY;
+        if (mode == POWER_LOW) {
+            uint32_t idle = now_ms() - last_activity_ms;
+            timeout = idle < POWER_OFF_AFTER_MS ? pdMS_TO_TICKS(POWER_OFF_AFTER_MS - idle) : 0;
+        }
+        if (ulTaskNotifyTake(pdTRUE, timeout) > 0) {
+            enter(POWER_ACTIVE);
+            return;
+        }
+        if (mode == POWER_LOW) enter(POWER_OFF);
+    }
+}
+
+void power_request(power_mode_t next) {
+    if (next == POWER_ACTIVE) {
+        power_activity(POWER_WAKE_SERIAL);
+    } else {
+        requested = next;
+    }
+}
+
+power_mode_t power_mode(void) {
+    return mode;
+}
+
+void power_note_wakeup(void) {
+    cpu_wakeups++;
+}
+
+#if configUSE_IDLE_HOOK && !configUSE_TICKLESS_IDLE
+// Ilman tickless idleä joutotaski nukkuu seuraavaan keskeytykseen asti
+// (tick, USB, napit, DMA), eikä pyöri tyhjää.
+void vApplicationIdleHook(void) {
+    __wfi();
+    power_note_wakeup();
+}
+#endif
+
+void power_sample(power_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    uint32_t now = now_ms();
+
+    out->mode = mode;
+    out->idle_ms = now - last_activity_ms;
+    for (int i = 0; i < POWER_MODES; i++) out->mode_ms[i] = mode_ms[i];
+    out->mode_ms[mode] += now - mode_since_ms;
+    for (int i = 0; i < POWER_WAKE_SOURCES; i++) out->wakes[i] = wakes[i];
+
+    uint32_t w = cpu_wakeups;
+    out->period_ms = now - prev_sample_ms;
+    out->cpu_wakeups = w - prev_wakeups;
+    prev_sample_ms = now;
+    prev_wakeups = w;
+}
+
+void power_print(const power_stats_t *s) {
+    printf("power %s, idle %lu s (low after %u s, off after %u s)\n", mode_names[s->mode],
+           (unsigned long)(s->idle_ms / 1000), POWER_LOW_AFTER_MS / 1000, POWER_OFF_AFTER_MS / 1000);
+    printf("time active %lu s low %lu s off %lu s\n", (unsigned long)(s->mode_ms[POWER_ACTIVE] / 1000),
+           (unsigned long)(s->mode_ms[POWER_LOW] / 1000), (unsigned long)(s->mode_ms[POWER_OFF] / 1000));
+    printf("woken by button %lu motion %lu serial %lu\n", (unsigned long)s->wakes[POWER_WAKE_BUTTON],
+           (unsigned long)s->wakes[POWER_WAKE_MOTION], (unsigned long)s->wakes[POWER_WAKE_SERIAL]);
+#if configUSE_TICKLESS_IDLE || configUSE_IDLE_HOOK
+    uint32_t per_10s = s->period_ms ? (uint32_t)((uint64_t)s->cpu_wakeups * 10000u / s->period_ms) : 0;
+    printf("cpu wakeups %lu.%lu/s over %lu s (tickless %d)\n", (unsigned long)(per_10s / 10),
+           (unsigned long)(per_10s % 10), (unsigned long)(s->period_ms / 1000), configUSE_TICKLESS_IDLE);
+#else
+    printf("cpu wakeups not measured (idle hook off)\n");
+#endif
+}
@@ -0,0 +1,76 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+// Virranhallinta: IMU:n tila käytön mukaan ja herätysten mittaus.
+//
+//   POWER_ACTIVE  IMU LN-tilassa, sensor_task lukee sitä sensor_period_ms välein
+//   POWER_LOW     ei toimintaa POWER_LOW_AFTER_MS aikaan: IMU:n kiihtyvyysanturi
+//                 LP-tilassa liikeherätyksellä (wake-on-motion), gyro pois,
+//                 sensor_task odottaa herätystä
+//   POWER_OFF     ei toimintaa POWER_OFF_AFTER_MS aikaan: IMU pois päältä,
+//                 vain napit ja sarjaportti herättävät
+//
+// Toimintaa ovat napit, sarjaportin data ja IMU:n asennon muutos. Herätys
+// palauttaa aina POWER_ACTIVE-tilaan. IMU:n tilaa vaihtaa vain sensor_task
+// (power_sensor_wait), joten I2C-väylää ei käytetä kahdesta taskista.
+//
+// Herätykset lasketaan joutotaskista: tickless idle -käännöksessä
+// (configUSE_TICKLESS_IDLE) jokaisesta unesta, muuten idle hook nukkuu
+// (WFI) seuraavaan keskeytykseen asti, eli myös jokainen tick on herätys.
+
+#ifndef POWER_LOW_AFTER_MS
+#define POWER_LOW_AFTER_MS      30000
+#endif
+#ifndef POWER_OFF_AFTER_MS
+#define POWER_OFF_AFTER_MS      300000
+#endif
+#ifndef POWER_WOM_THRESHOLD_MG
+#define POWER_WOM_THRESHOLD_MG  ICM42670_WOM_THRESHOLD_DEFAULT_MG
+#endif
+#define POWER_MOTION_G          0.1f    // asennon muutos, joka lasketaan toiminnaksi
+
+typedef enum { POWER_ACTIVE = 0, POWER_LOW, POWER_OFF, POWER_MODES } power_mode_t;
+
+typedef enum { POWER_WAKE_BUTTON = 0, POWER_WAKE_MOTION, POWER_WAKE_SERIAL, POWER_WAKE_SOURCES } power_wake_t;
+
+typedef struct {
+    power_mode_t mode;
+    uint32_t idle_ms;                       // edellisestä toiminnasta
+    uint32_t mode_ms[POWER_MODES];          // aika kussakin tilassa käynnistyksestä
+    uint32_t wakes[POWER_WAKE_SOURCES];     // herätykset lähteittäin
+    uint32_t period_ms;                     // edellisestä power_sample-kutsusta
+    uint32_t cpu_wakeups;                   // suorittimen herätykset jaksolla
+} power_stats_t;
+
+// Toimintaa taskista (esim. komento). Herättää IMU:n, jos se nukkuu.
+void power_activity(power_wake_t source);
+
+// Toimintaa keskeytyksestä (nappi, IMU:n INT1)
+void power_activity_from_isr(power_wake_t source, BaseType_t *woken);
+
+// sensor_task: uusi kiihtyvyysnäyte, liike lasketaan toiminnaksi
+void power_motion(float ax, float ay, float az);
+
+// sensor_task: korvaa lukujen välisen vTaskDelayn. POWER_ACTIVE-tilassa
+// odottaa period_ms, muuten vaihtaa IMU:n tilan ja odottaa herätystä.
+void power_sensor_wait(uint32_t period_ms);
+
+// Pakottaa tilan seuraavalla power_sensor_wait-kutsulla (mittauksiin)
+void power_request(power_mode_t mode);
+
+power_mode_t power_mode(void);
+
+// Joutotaskista jokaisen unen jälkeen
+void power_note_wakeup(void);
+
+// Tilastot; herätykset edellisestä power_sample-kutsusta
+void power_sample(power_stats_t *out);
+void power_print(const power_stats_t *s);
+
+#endif
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <pico/stdlib.h>
+
+#include "rtos_stats.h"
+
+// Ilman ajoaikatilastoja (configGENERATE_RUN_TIME_STATS 0) taulukko näyttää
+// vain pinot ja keon; kuormat jäävät nolliksi.
+
+// Edellisen näytteen ajoaikalaskurit taskeittain ja koko järjestelmälle
+typedef struct {
+    TaskHandle_t handle;
+    configRUN_TIME_COUNTER_TYPE run_time;
+} prev_t;
+
+static prev_t prev[RTOS_STATS_MAX_TASKS];
+static uint8_t n_prev;
+static uint64_t prev_us;
+
+static TaskStatus_t status[RTOS_STATS_MAX_TASKS];
+
+static configRUN_TIME_COUNTER_TYPE previous_run_time(TaskHandle_t h) {
+    for (uint8_t i = 0; i < n_prev; i++) {
+        if (prev[i].handle == h) return prev[i].run_time;
+    }
+    return 0;   // uusi taski: koko ajoaika kuuluu tälle jaksolle
+}
+
+static uint16_t permille(uint64_t part, uint64_t whole) {
+    if (whole == 0) return 0;
+    uint64_t v = part * 1000u / whole;
+    return v > 1000 ? 1000 : (uint16_t)v;
+}
+
+void rtos_stats_sample(rtos_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+
+#if configGENERATE_RUN_TIME_STATS
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t n = uxTaskGetSystemState(status, RTOS_STATS_MAX_TASKS, &total);
+#else
+    UBaseType_t n = uxTaskGetSystemState(status, RTOS_STATS_MAX_TASKS, NULL);
+#endif
+    uint64_t now = time_us_64();
+    uint64_t period = now - prev_us;
+    out->period_us = (uint32_t)period;
+
+    TaskHandle_t idle[configNUMBER_OF_CORES];
+#if configNUMBER_OF_CORES > 1
+    for (BaseType_t c = 0; c < configNUMBER_OF_CORES; c++) idle[c] = xTaskGetIdleTaskHandleForCore(c);
+#else
+    idle[0] = xTaskGetIdleTaskHandle();
+#endif
+
+    prev_t next[RTOS_STATS_MAX_TASKS];
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *t = &status[i];
+#if configGENERATE_RUN_TIME_STATS
+        configRUN_TIME_COUNTER_TYPE run_time = t->ulRunTimeCounter;
+#else
+        configRUN_TIME_COUNTER_TYPE run_time = 0;
+#endif
+        configRUN_TIME_COUNTER_TYPE delta = run_time - previous_run_time(t->xHandle);
+        next[i].handle = t->xHandle;
+        next[i].run_time = run_time;
+
+        for (int c = 0; c < configNUMBER_OF_CORES; c++) {
+            if (t->xHandle == idle[c]) out->idle_permille[c] = permille(delta, period);
+        }
+
+        rtos_task_stat_t *s = &out->tasks[out->n_tasks++];
+        strncpy(s->name, t->pcTaskName, sizeof(s->name) - 1);
+        s->priority = t->uxCurrentPriority;
+#if configUSE_CORE_AFFINITY && configNUMBER_OF_CORES > 1
+        s->affinity = (uint32_t)t->uxCoreAffinityMask & ((1u << configNUMBER_OF_CORES) - 1);
+#endif
+        s->cpu_permille = permille(delta, period);
+        s->stack_free = (uint32_t)t->usStackHighWaterMark * sizeof(StackType_t);
+    }
+
+    memcpy(prev, next, n * sizeof(prev_t));
+    n_prev = (uint8_t)n;
+    prev_us = now;
+
+#if configSUPPORT_DYNAMIC_ALLOCATION
+    out->heap_free = xPortGetFreeHeapSize();
+    out->heap_min_free = xPortGetMinimumEverFreeHeapSize();
+#endif
+}
+
+void rtos_stats_print(const rtos_stats_t *s) {
+    if (s->n_tasks == 0) {
+        // uxTaskGetSystemState ei palauta mitään, jos taulukko on liian pieni
+        printf("more than %d tasks, increase RTOS_STATS_MAX_TASKS\n", RTOS_STATS_MAX_TASKS);
+        return;
+    }
+    printf("%-*s prio core  cpu%%  stack_free\n", configMAX_TASK_NAME_LEN, "task");
+    for (uint8_t i = 0; i < s->n_tasks; i++) {
+        const rtos_task_stat_t *t = &s->tasks[i];
+        char core[4] = "any";
+        // Yhteen ytimeen sidottu taski näytetään ytimen numerolla
+        if (t->affinity == 1u) strcpy(core, "0");
+        else if (t->affinity == 2u) strcpy(core, "1");
+        printf("%-*s %4u %4s %3u.%u %11lu\n", configMAX_TASK_NAME_LEN, t->name,
+               (unsigned)t->priority, core, t->cpu_permille / 10, t->cpu_permille % 10,
+               (unsigned long)t->stack_free);
+    }
+#if !configGENERATE_RUN_TIME_STATS
+    printf("cpu%% and idle not measured (configGENERATE_RUN_TIME_STATS 0)\n");
+#endif
+    for (int c = 0; c < configNUMBER_OF_CORES; c++) {
+        printf("idle core%d %u.%u%%\n", c, s->idle_permille[c] / 10, s->idle_permille[c] % 10);
+    }
+#if configSUPPORT_DYNAMIC_ALLOCATION
+    printf("heap free %u min %u of %u, period %lu ms\n",
+           (unsigned)s->heap_free, (unsigned)s->heap_min_free, (unsigned)configTOTAL_HEAP_SIZE,
+           (unsigned long)(s->period_us / 1000));
+#else
+    // Staattinen muistinvaraus: FreeRTOS-kekoa ei ole, kaikki näkyy .map-tiedostossa
+    printf("no heap (static allocation), period %lu ms\n", (unsigned long)(s->period_us / 1000));
+#endif
+}
@@ -0,0 +1,43 @@
+#ifndef RTOS_STATS_H
+#define RTOS_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+// FreeRTOS-ajoaikatilastot: taskien CPU-kuorma, ytimien joutoaika, pinojen
+// ja keon pienin vapaa tila.
+//
+// Ajoaika lasketaan RP2040:n 1 MHz ajastimella (configGENERATE_RUN_TIME_STATS,
+// ks. config/FreeRTOSConfig.h). Kuormat ovat aina edellisestä
+// rtos_stats_sample()-kutsusta, ensimmäisellä kerralla käynnistyksestä.
+// Kutsu vain yhdestä taskista.
+
+#define RTOS_STATS_MAX_TASKS    16
+
+typedef struct {
+    char name[configMAX_TASK_NAME_LEN];
+    UBaseType_t priority;
+    uint32_t affinity;          // sallitut ytimet bitteinä (0 = ei rajoitusta)
+    uint16_t cpu_permille;      // osuus yhden ytimen ajasta, 0.1 %
+    uint32_t stack_free;        // pienin vapaa pino koskaan, tavuja
+} rtos_task_stat_t;
+
+typedef struct {
+    uint32_t period_us;                         // mittausjakson pituus
+    uint16_t idle_permille[configNUMBER_OF_CORES];
+    size_t heap_free;                           // nyt vapaana (0 ilman kekoa)
+    size_t heap_min_free;                       // pienin vapaa koskaan
+    uint8_t n_tasks;
+    rtos_task_stat_t tasks[RTOS_STATS_MAX_TASKS];
+} rtos_stats_t;
+
+// Ottaa tilastot edellisen kutsun jälkeiseltä ajalta
+void rtos_stats_sample(rtos_stats_t *out);
+
+// Tulostaa tilastot taulukkona printf:llä
+void rtos_stats_print(const rtos_stats_t *s);
+
+#endif
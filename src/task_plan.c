@@ -0,0 +1,69 @@
+#include <stdio.h>
+
+#include "task_plan.h"
+
+UBaseType_t task_plan_priority(const task_plan_t *plan, size_t n, size_t i, UBaseType_t base) {
+#if TASK_PLACEMENT
+    // Yksi porras jokaista erilaista pidempää määräaikaa kohden
+    UBaseType_t steps = 0;
+    for (size_t j = 0; j < n; j++) {
+        if (plan[j].fn == NULL || plan[j].deadline_ms <= plan[i].deadline_ms) continue;
+        bool seen = false;
+        for (size_t k = 0; k < j; k++) {
+            if (plan[k].fn != NULL && plan[k].deadline_ms == plan[j].deadline_ms) seen = true;
+        }
+        if (!seen) steps++;
+    }
+    UBaseType_t prio = base + steps;
+    // Ajastintaski (configTIMER_TASK_PRIORITY) pysyy korkeimpana
+    return prio < configTIMER_TASK_PRIORITY ? prio : configTIMER_TASK_PRIORITY - 1;
+#else
+    (void)plan;
+    (void)n;
+    (void)i;
+    return base;
+#endif
+}
+
+int task_plan_start(const task_plan_t *plan, size_t n, UBaseType_t base) {
+    for (size_t i = 0; i < n; i++) {
+        const task_plan_t *t = &plan[i];
+        if (t->fn == NULL) continue;
+
+        UBaseType_t prio = task_plan_priority(plan, n, i, base);
+        TaskHandle_t h = NULL;
+#if configSUPPORT_STATIC_ALLOCATION
+        if (t->stack_mem != NULL && t->tcb != NULL) {
+            h = xTaskCreateStatic(t->fn, t->name, t->stack, NULL, prio, t->stack_mem, t->tcb);
+        }
+#endif
+#if configSUPPORT_DYNAMIC_ALLOCATION
+        if (h == NULL && t->stack_mem == NULL) {
+            uint32_t words = t->stack < TASK_STACK_MIN ? TASK_STACK_MIN : t->stack;
+            xTaskCreate(t->fn, t->name, words, NULL, prio, &h);
+        }
+#endif
+        if (h == NULL) {
+            printf("%s task creation failed\n", t->name);
+            return -1;
+        }
+#if TASK_PLACEMENT && configUSE_CORE_AFFINITY && configNUMBER_OF_CORES > 1
+        if (t->core != TASK_CORE_ANY) {
+            vTaskCoreAffinitySet(h, 1u << t->core);
+        }
+#endif
+        if (t->handle) *t->handle = h;
+    }
+    return 0;
+}
+
+void task_plan_print(const task_plan_t *plan, size_t n, UBaseType_t base) {
+    printf("task     core deadline prio\n");
+    for (size_t i = 0; i < n; i++) {
+        const task_plan_t *t = &plan[i];
+        if (t->fn == NULL) continue;
+        int core = TASK_PLACEMENT ? t->core : TASK_CORE_ANY;
+        printf("%-8s %4s %6lu ms %4u\n", t->name, core == 0 ? "0" : core == 1 ? "1" : "any",
+               (unsigned long)t->deadline_ms, (unsigned)task_plan_priority(plan, n, i, base));
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <FreeRTOS.h>
+#include <task.h>
+
+// Taskien sijoitustaulukko: ydin ja määräaika jokaiselle taskille.
+//
+// Prioriteetit johdetaan määräajoista (deadline monotonic): mitä lyhyempi
+// määräaika, sitä korkeampi prioriteetti. Samalla määräajalla on sama
+// prioriteetti. Näin taulukkoon lisätty taski ei vaadi muiden
+// prioriteettien käsin muuttamista.
+//
+// Staattisessa muistinvarauksessa (configSUPPORT_STATIC_ALLOCATION) taskin
+// pino ja TCB annetaan taulukossa, jolloin ne näkyvät .map-tiedostossa
+// omina muuttujinaan eikä keosta varata mitään.
+//
+// TASK_PLACEMENT 0 ohittaa taulukon ytimet ja prioriteetit: kaikki taskit
+// ajetaan prioriteetilla base ilman ydinsidontaa (vanha käytös, vertailuun).
+
+#ifndef TASK_PLACEMENT
+#define TASK_PLACEMENT      1
+#endif
+
+#define TASK_CORE_ANY       (-1)
+
+// Pienin pino sanoina. Isäntäkoneen simulaatiossa (sim/) jokainen taski on
+// pthread, jonka pino ei voi olla PTHREAD_STACK_MIN-kokoa pienempi.
+#ifndef TASK_STACK_MIN
+#define TASK_STACK_MIN      0
+#endif
+
+typedef struct {
+    TaskFunction_t fn;          // NULL = taskia ei luoda
+    const char *name;
+    uint32_t stack;             // sanoina, kuten xTaskCreate
+    uint32_t deadline_ms;       // kuinka nopeasti taskin on reagoitava
+    int8_t core;                // 0, 1 tai TASK_CORE_ANY
+    TaskHandle_t *handle;       // voi olla NULL
+    StackType_t *stack_mem;     // stack sanaa, NULL = varataan keosta
+    StaticTask_t *tcb;
+} task_plan_t;
+
+// Taskin pino ja TCB staattisina muuttujina (<nimi>_stack, <nimi>_tcb).
+// TASK_MEMORY(nimi) antaa ne taulukon kahteen viimeiseen kenttään.
+#if configSUPPORT_STATIC_ALLOCATION
+#define TASK_STATIC_MEMORY(name, words) \
+    static StackType_t name##_stack[words]; \
+    static StaticTask_t name##_tcb
+#define TASK_MEMORY(name)   name##_stack, &name##_tcb
+#else
+#define TASK_STATIC_MEMORY(name, words) \
+    typedef int name##_no_static_memory
+#define TASK_MEMORY(name)   NULL, NULL
+#endif
+
+// Prioriteetti, jonka taulukon i:s taski saa
+UBaseType_t task_plan_priority(const task_plan_t *plan, size_t n, size_t i, UBaseType_t base);
+
+// Luo taulukon taskit. Palauttaa 0 tai -1, jos jonkin luonti epäonnistui.
+int task_plan_start(const task_plan_t *plan, size_t n, UBaseType_t base);
+
+// Tulostaa taulukon (nimi, ydin, määräaika, prioriteetti)
+void task_plan_print(const task_plan_t *plan, size_t n, UBaseType_t base);
+
+#endif
@@ -0,0 +1,210 @@
+/*
+ * Host-side reader for examples/cdc_throughput.
+ *
+ * Reads the CDC1 stream from a serial port, a capture file or stdin and
+ * checks that it is the expected pattern: consecutive 32-bit little-endian
+ * counters. The reader locks on after three consecutive words, so it does
+ * not matter where in the stream it starts.
+ *
+ * Once per second (and at the end) stderr gets the received rate, the
+ * average rate, and the errors: words that broke the sequence, words lost
+ * in gaps and times the reader lost sync (bytes dropped or inserted).
+ *
+ * Usage: cdc_throughput [device|file|-] [--seconds N] [--selftest]
+ *   --seconds N  stop after N seconds (default: until end of input)
+ *   --selftest   feed a synthetic stream with a gap, a corrupted word and a
+ *                dropped byte and check that exactly those are reported
+ *
+ * Exit status is 1 if any error was seen.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#define HAVE_TERMIOS 1
+#endif
+
+#define SYNC_WORDS      3
+#define MAX_GAP_WORDS   (1u << 20)  // larger jumps are treated as garbage
+
+typedef struct {
+    unsigned long long bytes;
+    unsigned long words;
+    unsigned long errors;
+    unsigned long lost;
+    unsigned long resyncs;
+    int synced;
+    int bad_run;
+    uint32_t expected;
+    uint8_t win[4 * SYNC_WORDS];
+    size_t win_len;
+    uint8_t acc[4];
+    size_t acc_len;
+} verify_t;
+
+static verify_t v;
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void check_word(uint32_t w) {
+    v.words++;
+    if (w == v.expected) {
+        v.expected++;
+        v.bad_run = 0;
+        return;
+    }
+    v.errors++;
+    if (++v.bad_run >= 2) {
+        // Two bad words in a row: the byte alignment is gone, search again
+        v.synced = 0;
+        v.win_len = 0;
+        v.resyncs++;
+        return;
+    }
+    if (w - v.expected < MAX_GAP_WORDS) {
+        // Whole words missing: continue after the gap
+        v.lost += w - v.expected;
+        v.expected = w + 1;
+    } else {
+        // A corrupted word: keep expecting the next one in sequence
+        v.expected++;
+    }
+}
+
+static void feed_byte(uint8_t b) {
+    v.bytes++;
+    if (v.synced) {
+        v.acc[v.acc_len++] = b;
+        if (v.acc_len == 4) {
+            check_word(get_u32(v.acc));
+            v.acc_len = 0;
+        }
+        return;
+    }
+
+    // Sliding window until SYNC_WORDS consecutive counters line up
+    if (v.win_len == sizeof(v.win)) {
+        memmove(v.win, v.win + 1, sizeof(v.win) - 1);
+        v.win_len--;
+    }
+    v.win[v.win_len++] = b;
+    if (v.win_len < sizeof(v.win)) return;
+
+    for (int i = 1; i < SYNC_WORDS; i++) {
+        if (get_u32(v.win + 4 * i) != get_u32(v.win + 4 * (i - 1)) + 1) return;
+    }
+    v.synced = 1;
+    v.bad_run = 0;
+    v.acc_len = 0;
+    v.words += SYNC_WORDS;
+    v.expected = get_u32(v.win + 4 * (SYNC_WORDS - 1)) + 1;
+}
+
+static void feed(const uint8_t *buf, size_t n) {
+    for (size_t i = 0; i < n; i++) feed_byte(buf[i]);
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_stats(double elapsed, double period, unsigned long long period_bytes) {
+    fprintf(stderr, "%.0f s: rate %.1f kB/s, avg %.1f kB/s, bytes %llu, words %lu, "
+            "errors %lu, lost %lu, resyncs %lu%s\n",
+            elapsed, period > 0 ? period_bytes / period / 1000.0 : 0.0,
+            elapsed > 0 ? v.bytes / elapsed / 1000.0 : 0.0,
+            v.bytes, v.words, v.errors, v.lost, v.resyncs, v.synced ? "" : " (not synced)");
+}
+
+static void put_u32(uint8_t *p, uint32_t w) {
+    p[0] = (uint8_t)w;
+    p[1] = (uint8_t)(w >> 8);
+    p[2] = (uint8_t)(w >> 16);
+    p[3] = (uint8_t)(w >> 24);
+}
+
+static int selftest(void) {
+    static uint8_t stream[4 * 4096];
+    size_t len = 0;
+    uint32_t w = 0;
+
+    // 2 stray bytes before the stream, as if the reader started mid-word
+    stream[len++] = 0xAA;
+    stream[len++] = 0x55;
+    for (int i = 0; i < 1000; i++) { put_u32(stream + len, w++); len += 4; }
+    w += 10;                                            // gap: 10 words lost
+    for (int i = 0; i < 1000; i++) { put_u32(stream + len, w++); len += 4; }
+    put_u32(stream + len, 0xDEADBEEF); len += 4; w++;   // corrupted word
+    for (int i = 0; i < 1000; i++) { put_u32(stream + len, w++); len += 4; }
+    put_u32(stream + len, w++); len += 3;               // one byte dropped
+    for (int i = 0; i < 1000; i++) { put_u32(stream + len, w++); len += 4; }
+
+    memset(&v, 0, sizeof(v));
+    feed(stream, len);
+
+    // The gap and the corruption are one error each; the dropped byte
+    // shifts the alignment, which gives two errors and one resync
+    int ok = v.synced && v.lost == 10 && v.errors == 4 && v.resyncs == 1;
+    print_stats(0, 0, 0);
+    fprintf(stderr, "selftest %s\n", ok ? "passed" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    const char *path = "-";
+    double seconds = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--selftest") == 0) return selftest();
+        if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) seconds = atof(argv[++i]);
+        else path = argv[i];
+    }
+
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+
+#ifdef HAVE_TERMIOS
+    // Serial device: raw mode so no byte is translated or swallowed
+    if (isatty(fileno(in))) {
+        struct termios tio;
+        if (tcgetattr(fileno(in), &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(fileno(in), TCSANOW, &tio);
+        }
+    }
+#endif
+
+    double start = now_s(), last = start;
+    unsigned long long last_bytes = 0;
+    uint8_t buf[16384];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        feed(buf, n);
+        double now = now_s();
+        if (now - last >= 1.0) {
+            print_stats(now - start, now - last, v.bytes - last_bytes);
+            last = now;
+            last_bytes = v.bytes;
+        }
+        if (seconds > 0 && now - start >= seconds) break;
+    }
+
+    double now = now_s();
+    print_stats(now - start, now - last, v.bytes - last_bytes);
+    if (in != stdin) fclose(in);
+    return (v.errors || v.resyncs) ? 1 : 0;
+}
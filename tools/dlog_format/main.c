@@ -0,0 +1,222 @@
+/*
+ * Host-side formatter for deferred log records (DLOG).
+ *
+ * Reads the device output from a serial port, a capture file or stdin.
+ * Lines that start with DLOG_LINE_MARK carry a base64 record: the address
+ * of the format string, a timestamp and the raw arguments. The format string
+ * is read from the firmware ELF (the one that is flashed) and the record is
+ * printed as printf would have printed it. Everything else is copied through
+ * unchanged.
+ *
+ * Usage: dlog_format <firmware.elf> [device|file|-] [-t]
+ *   -t  prefix each formatted record with the device time in ms
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <termios.h>
+#include <unistd.h>
+#define HAVE_TERMIOS 1
+#endif
+
+#include <tkjhat/base64.h>
+
+#define LINE_MARK0      0x1E
+#define LINE_MARK1      'D'
+#define MAX_LINE        512
+#define MAX_STR         64
+
+/* ---- ELF ---- */
+
+typedef struct {
+    uint64_t addr, size, offset;
+} section_t;
+
+static uint8_t *elf;
+static size_t elf_size;
+static section_t sections[256];
+static int section_count;
+
+static uint64_t rd(const uint8_t *p, int n) {
+    uint64_t v = 0;
+    for (int i = n - 1; i >= 0; i--) v = (v << 8) | p[i];
+    return v;
+}
+
+// Loads the allocated PROGBITS sections of a little-endian ELF32/ELF64 file
+static int load_elf(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return -1; }
+    fseek(f, 0, SEEK_END);
+    elf_size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    elf = malloc(elf_size);
+    if (!elf || fread(elf, 1, elf_size, f) != elf_size) { fclose(f); return -1; }
+    fclose(f);
+
+    if (elf_size < 52 || memcmp(elf, "\x7f" "ELF", 4) != 0 || elf[5] != 1) {
+        fprintf(stderr, "%s: not a little-endian ELF file\n", path);
+        return -1;
+    }
+    int is64 = elf[4] == 2;
+    uint64_t shoff = is64 ? rd(elf + 0x28, 8) : rd(elf + 0x20, 4);
+    unsigned shentsize = (unsigned)rd(elf + (is64 ? 0x3A : 0x2E), 2);
+    unsigned shnum = (unsigned)rd(elf + (is64 ? 0x3C : 0x30), 2);
+
+    for (unsigned i = 0; i < shnum && section_count < 256; i++) {
+        const uint8_t *sh = elf + shoff + (uint64_t)i * shentsize;
+        if (sh + shentsize > elf + elf_size) break;
+        uint32_t type = (uint32_t)rd(sh + 4, 4);
+        uint64_t flags = is64 ? rd(sh + 8, 8) : rd(sh + 8, 4);
+        if (type != 1 /* PROGBITS */ || !(flags & 2 /* ALLOC */)) continue;
+
+        section_t *s = &sections[section_count++];
+        s->addr   = is64 ? rd(sh + 0x10, 8) : rd(sh + 0x0C, 4);
+        s->offset = is64 ? rd(sh + 0x18, 8) : rd(sh + 0x10, 4);
+        s->size   = is64 ? rd(sh + 0x20, 8) : rd(sh + 0x14, 4);
+    }
+    return 0;
+}
+
+// Format string at a device address, or NULL
+static const char *elf_string(uint32_t addr) {
+    for (int i = 0; i < section_count; i++) {
+        const section_t *s = &sections[i];
+        // Only the low 32 bits are recorded
+        uint64_t base = s->addr & 0xFFFFFFFFu;
+        if (addr < base || addr >= base + s->size) continue;
+        uint64_t off = s->offset + (addr - base);
+        if (off >= elf_size) return NULL;
+        if (!memchr(elf + off, 0, elf_size - off)) return NULL;
+        return (const char *)elf + off;
+    }
+    return NULL;
+}
+
+/* ---- records ---- */
+
+// printf the record; returns -1 if it does not match its format string
+static int format_record(const uint8_t *rec, size_t n, int timestamps, FILE *out) {
+    if (n < 8) return -1;
+    uint32_t fmt_addr = (uint32_t)rd(rec, 4);
+    uint32_t t_us = (uint32_t)rd(rec + 4, 4);
+    const char *fmt = elf_string(fmt_addr);
+    if (!fmt) return -1;
+
+    size_t i = 8;
+    if (timestamps) fprintf(out, "[%10.3f] ", t_us / 1000.0);
+
+    for (const char *p = fmt; *p; p++) {
+        if (*p != '%') { fputc(*p, out); continue; }
+        if (p[1] == '%') { fputc('%', out); p++; continue; }
+
+        // %[flags][width][.precision][length]conversion
+        char spec[32];
+        size_t k = 0;
+        spec[k++] = *p++;
+        while (*p && strchr("-+ #0", *p) && k < 20) spec[k++] = *p++;
+        while (*p && ((*p >= '0' && *p <= '9') || *p == '.') && k < 28) spec[k++] = *p++;
+        while (*p && strchr("hlLqjzt", *p)) p++;     // every value is 32 bits
+        if (!*p) break;
+        char conv = *p;
+
+        if (strchr("diouxXc", conv)) {
+            if (i + 4 > n) return -1;
+            uint32_t v = (uint32_t)rd(rec + i, 4);
+            i += 4;
+            spec[k++] = conv;
+            spec[k] = '\0';
+            if (conv == 'd' || conv == 'i' || conv == 'c') fprintf(out, spec, (int)(int32_t)v);
+            else                                          fprintf(out, spec, (unsigned)v);
+        } else if (strchr("fFeEgGaA", conv)) {
+            if (i + 4 > n) return -1;
+            uint32_t bits = (uint32_t)rd(rec + i, 4);
+            float f;
+            memcpy(&f, &bits, 4);
+            i += 4;
+            spec[k++] = conv;
+            spec[k] = '\0';
+            fprintf(out, spec, (double)f);
+        } else if (conv == 's') {
+            if (i + 1 > n) return -1;
+            size_t len = rec[i++];
+            if (i + len > n || len > MAX_STR) return -1;
+            char s[MAX_STR + 1];
+            memcpy(s, rec + i, len);
+            s[len] = '\0';
+            i += len;
+            spec[k++] = 's';
+            spec[k] = '\0';
+            fprintf(out, spec, s);
+        } else if (conv == 'p') {
+            if (i + 4 > n) return -1;
+            fprintf(out, "0x%08lx", (unsigned long)rd(rec + i, 4));
+            i += 4;
+        } else {
+            fputc('%', out);
+            fputc(conv, out);
+        }
+    }
+    return i == n ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+    const char *elf_path = NULL, *in_path = "-";
+    int timestamps = 0;
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-t") == 0) timestamps = 1;
+        else if (!elf_path) elf_path = argv[a];
+        else in_path = argv[a];
+    }
+    if (!elf_path) {
+        fprintf(stderr, "usage: %s <firmware.elf> [device|file|-] [-t]\n", argv[0]);
+        return 2;
+    }
+    if (load_elf(elf_path) < 0) return 1;
+
+    FILE *in = strcmp(in_path, "-") == 0 ? stdin : fopen(in_path, "rb");
+    if (!in) {
+        perror(in_path);
+        return 1;
+    }
+
+#ifdef HAVE_TERMIOS
+    if (isatty(fileno(in))) {
+        struct termios tio;
+        if (tcgetattr(fileno(in), &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(fileno(in), TCSANOW, &tio);
+        }
+    }
+#endif
+
+    char line[MAX_LINE];
+    unsigned long records = 0, bad = 0;
+    while (fgets(line, sizeof(line), in)) {
+        if ((unsigned char)line[0] != LINE_MARK0 || line[1] != LINE_MARK1) {
+            fputs(line, stdout);
+            fflush(stdout);
+            continue;
+        }
+
+        uint8_t rec[MAX_LINE];
+        int n = base64_decode(line + 2, rec, sizeof(rec));
+        if (n < 0 || format_record(rec, (size_t)n, timestamps, stdout) < 0) {
+            // Wrong ELF, or the line was damaged
+            fprintf(stdout, "\n[dlog_format] undecodable record (%d bytes)\n", n);
+            bad++;
+        } else {
+            records++;
+        }
+        fflush(stdout);
+    }
+
+    fprintf(stderr, "dlog_format: %lu records, %lu undecodable\n", records, bad);
+    if (in != stdin) fclose(in);
+    return 0;
+}
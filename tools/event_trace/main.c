@@ -0,0 +1,404 @@
+/*
+ * Host-side converter for event traces (libs/TKJHAT/include/tkjhat/event_trace.h).
+ *
+ * Reads the device output from a serial port, a capture file or stdin.
+ * Lines that start with EVENT_TRACE_LINE_MARK carry one base64 chunk of an
+ * "evtrace dump"; everything else is copied to stdout. At the end of the
+ * input (or on Ctrl-C) the last complete dump is written as a Chrome trace
+ * JSON file, which Perfetto (ui.perfetto.dev) and chrome://tracing open:
+ *
+ *   core N      the running task as slices, interrupts nested in them
+ *   task tracks driver spans (I2C, display, filter) and queue / notify
+ *               instants of that task; in an interrupt they go on the core
+ *
+ * Usage: event_trace <device|file|-> <out.json>
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <termios.h>
+#include <unistd.h>
+#define HAVE_TERMIOS 1
+#endif
+
+#include <tkjhat/base64.h>
+#include <tkjhat/event_trace.h>
+
+#define CHUNK_INFO      0
+#define CHUNK_NAME      1
+#define CHUNK_EVENTS    2
+
+#define MAX_CHUNK       512
+#define MAX_LINE        (MAX_CHUNK * 2)
+#define MAX_DEPTH       16
+
+typedef struct {
+    uint8_t category;
+    uint32_t id;
+    char name[32];
+} name_t;
+
+typedef struct {
+    uint32_t tid;
+    int depth;                      // open B events
+    unsigned long long last;        // time of the last event on the track
+} track_t;
+
+static struct {
+    event_trace_event_t *ev;
+    size_t count, cap;
+    uint32_t overwritten;
+} cores[EVENT_TRACE_CORES];
+
+static name_t *names;
+static size_t name_count, name_cap;
+static track_t *tracks;
+static size_t track_count, track_cap;
+static int have_info;
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void set_raw(FILE *f) {
+#ifdef HAVE_TERMIOS
+    if (isatty(fileno(f))) {
+        struct termios tio;
+        if (tcgetattr(fileno(f), &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(fileno(f), TCSANOW, &tio);
+        }
+    }
+#else
+    (void)f;
+#endif
+}
+
+static void *grow(void *p, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) return p;
+    size_t n = *cap ? *cap * 2 : 64;
+    while (n < need) n *= 2;
+    p = realloc(p, n * size);
+    if (!p) { perror("event_trace"); exit(1); }
+    *cap = n;
+    return p;
+}
+
+static uint16_t u16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t u32(const uint8_t *p) { return u16(p) | ((uint32_t)u16(p + 2) << 16); }
+
+// A new dump replaces whatever came before it
+static void reset(void) {
+    for (int c = 0; c < EVENT_TRACE_CORES; c++) {
+        cores[c].count = 0;
+        cores[c].overwritten = 0;
+    }
+    name_count = 0;
+    have_info = 1;
+}
+
+static void add_name(uint8_t category, uint32_t id, const uint8_t *s, size_t len) {
+    size_t i = 0;
+    while (i < name_count && !(names[i].category == category && names[i].id == id)) i++;
+    if (i == name_count) {
+        names = grow(names, &name_cap, name_count + 1, sizeof(*names));
+        name_count++;
+    }
+    if (len >= sizeof(names[i].name)) len = sizeof(names[i].name) - 1;
+    names[i].category = category;
+    names[i].id = id;
+    memcpy(names[i].name, s, len);
+    names[i].name[len] = '\0';
+}
+
+static int chunk(const uint8_t *p, size_t n) {
+    if (n < 1) return 0;
+    switch (p[0]) {
+    case CHUNK_INFO:
+        if (n < 4 || p[1] != EVENT_TRACE_VERSION) return 0;
+        reset();
+        for (int c = 0; c < p[2] && c < EVENT_TRACE_CORES && 4 + 4 * (size_t)c + 4 <= n; c++) {
+            cores[c].overwritten = u32(&p[4 + 4 * c]);
+        }
+        return 1;
+    case CHUNK_NAME:
+        if (n < 6 || !have_info) return 0;
+        add_name(p[1], u32(&p[2]), &p[6], n - 6);
+        return 1;
+    case CHUNK_EVENTS: {
+        if (n < 4 || !have_info || p[1] >= EVENT_TRACE_CORES) return 0;
+        size_t count = p[2];
+        if (n != 4 + count * sizeof(event_trace_event_t)) return 0;
+        int c = p[1];
+        cores[c].ev = grow(cores[c].ev, &cores[c].cap, cores[c].count + count, sizeof(event_trace_event_t));
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t *e = &p[4 + i * sizeof(event_trace_event_t)];
+            event_trace_event_t *d = &cores[c].ev[cores[c].count++];
+            d->t_us = u32(e);
+            d->type = e[4];
+            d->reserved = 0;
+            d->arg = u16(&e[6]);
+            d->id = u32(&e[8]);
+        }
+        return 1;
+    }
+    }
+    return 0;
+}
+
+static const char *lookup(uint8_t category, uint32_t id) {
+    for (size_t i = 0; i < name_count; i++) {
+        if (names[i].category == category && names[i].id == id) return names[i].name;
+    }
+    return NULL;
+}
+
+// RP2040 interrupt numbers of the handlers that mark themselves
+static const char *irq_name(uint32_t irq, char *buf, size_t len) {
+    static const char *const known[] = {
+        [0] = "TIMER_IRQ_0", [1] = "TIMER_IRQ_1", [2] = "TIMER_IRQ_2", [3] = "TIMER_IRQ_3",
+        [5] = "USBCTRL_IRQ", [11] = "DMA_IRQ_0", [12] = "DMA_IRQ_1", [13] = "IO_IRQ_BANK0",
+    };
+    const char *s = lookup(EVENT_TRACE_NAME_IRQ, irq);
+    if (s) return s;
+    if (irq < sizeof(known) / sizeof(known[0]) && known[irq]) return known[irq];
+    snprintf(buf, len, "IRQ %lu", (unsigned long)irq);
+    return buf;
+}
+
+static const char *named(uint8_t category, uint32_t id, const char *what, char *buf, size_t len) {
+    const char *s = lookup(category, id);
+    if (s) return s;
+    snprintf(buf, len, "%s 0x%08lx", what, (unsigned long)id);
+    return buf;
+}
+
+static void json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') fprintf(out, "\\%c", ch);
+        else if (ch < 0x20) fprintf(out, "\\u%04x", ch);
+        else fputc(ch, out);
+    }
+    fputc('"', out);
+}
+
+static track_t *track(uint32_t tid, unsigned long long ts) {
+    size_t i = 0;
+    while (i < track_count && tracks[i].tid != tid) i++;
+    if (i == track_count) {
+        tracks = grow(tracks, &track_cap, track_count + 1, sizeof(*tracks));
+        tracks[i].tid = tid;
+        tracks[i].depth = 0;
+        track_count++;
+    }
+    tracks[i].last = ts;
+    return &tracks[i];
+}
+
+static int first;
+
+static void begin_event(FILE *out, char ph, uint32_t tid, unsigned long long ts, const char *cat) {
+    fprintf(out, "%s\n{\"ph\":\"%c\",\"pid\":1,\"tid\":%lu,\"ts\":%llu,\"cat\":\"%s\"",
+            first ? "" : ",", ph, (unsigned long)tid, ts, cat);
+    first = 0;
+}
+
+static void name_event(FILE *out, const char *name) {
+    fputs(",\"name\":", out);
+    json_string(out, name);
+}
+
+static void metadata(FILE *out, uint32_t tid, const char *key, const char *value, int sort) {
+    fprintf(out, "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"name\":\"%s\",\"args\":{\"name\":",
+            first ? "" : ",", (unsigned long)tid, key);
+    json_string(out, value);
+    fputs("}}", out);
+    first = 0;
+    if (sort >= 0) {
+        fprintf(out, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"name\":\"thread_sort_index\","
+                "\"args\":{\"sort_index\":%d}}", (unsigned long)tid, sort);
+    }
+}
+
+// Timestamps are the low 32 bits of the microsecond timer: each core is
+// unwrapped from the oldest first event of the dump
+static int write_json(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) { perror(path); return 1; }
+
+    uint32_t origin = 0;
+    int have_origin = 0;
+    for (int c = 0; c < EVENT_TRACE_CORES; c++) {
+        if (cores[c].count == 0) continue;
+        uint32_t t = cores[c].ev[0].t_us;
+        if (!have_origin || (int32_t)(t - origin) < 0) origin = t;
+        have_origin = 1;
+    }
+
+    first = 1;
+    fputs("{\"traceEvents\":[", out);
+    metadata(out, 0, "process_name", "RP2040", -1);
+
+    char buf[48], buf2[48], title[96];
+    size_t events = 0;
+    for (int c = 0; c < EVENT_TRACE_CORES; c++) {
+        snprintf(title, sizeof(title), "core %d", c);
+        metadata(out, (uint32_t)c, "thread_name", title, c);
+        if (cores[c].count == 0) continue;
+
+        unsigned long long ts = 0, task_start = 0;
+        uint32_t prev = origin, task = 0;
+        int isr = 0;
+        for (size_t i = 0; i < cores[c].count; i++) {
+            const event_trace_event_t *e = &cores[c].ev[i];
+            ts += (uint32_t)(e->t_us - prev);
+            prev = e->t_us;
+            events++;
+
+            // Spans and instants belong to the task, or to the core in an interrupt
+            uint32_t tid = isr == 0 && task != 0 ? task : (uint32_t)c;
+            track_t *tr;
+            switch (e->type) {
+            case EVENT_TRACE_EV_TASK_IN:
+                if (task != 0) {
+                    begin_event(out, 'X', (uint32_t)c, task_start, "task");
+                    name_event(out, named(EVENT_TRACE_NAME_TASK, task, "task", buf, sizeof(buf)));
+                    fprintf(out, ",\"dur\":%llu}", ts - task_start);
+                }
+                task = e->id;
+                task_start = ts;
+                break;
+            case EVENT_TRACE_EV_ISR_ENTER:
+                if (isr >= MAX_DEPTH) break;
+                isr++;
+                track((uint32_t)c, ts)->depth++;
+                begin_event(out, 'B', (uint32_t)c, ts, "irq");
+                name_event(out, irq_name(e->arg, buf, sizeof(buf)));
+                fputs("}", out);
+                break;
+            case EVENT_TRACE_EV_ISR_EXIT:
+                // The recording may start inside a handler
+                tr = track((uint32_t)c, ts);
+                if (isr == 0 || tr->depth == 0) break;
+                isr--;
+                tr->depth--;
+                begin_event(out, 'E', (uint32_t)c, ts, "irq");
+                fputs("}", out);
+                break;
+            case EVENT_TRACE_EV_SPAN_BEGIN:
+                tr = track(tid, ts);
+                if (tr->depth >= MAX_DEPTH) break;
+                tr->depth++;
+                begin_event(out, 'B', tid, ts, "span");
+                name_event(out, named(EVENT_TRACE_NAME_SPAN, e->arg, "span", buf, sizeof(buf)));
+                fputs("}", out);
+                break;
+            case EVENT_TRACE_EV_SPAN_END:
+                tr = track(tid, ts);
+                if (tr->depth == 0) break;
+                tr->depth--;
+                begin_event(out, 'E', tid, ts, "span");
+                fputs("}", out);
+                break;
+            case EVENT_TRACE_EV_QUEUE_SEND:
+            case EVENT_TRACE_EV_QUEUE_RECEIVE:
+            case EVENT_TRACE_EV_QUEUE_BLOCK: {
+                const char *op = e->type == EVENT_TRACE_EV_QUEUE_SEND ? "send"
+                               : e->type == EVENT_TRACE_EV_QUEUE_RECEIVE ? "receive"
+                               : e->arg ? "block on send" : "block on receive";
+                snprintf(title, sizeof(title), "%s %s", op,
+                         named(EVENT_TRACE_NAME_QUEUE, e->id, "queue", buf, sizeof(buf)));
+                track(tid, ts);
+                begin_event(out, 'i', tid, ts, "queue");
+                name_event(out, title);
+                if (e->type == EVENT_TRACE_EV_QUEUE_BLOCK) fputs(",\"s\":\"t\"}", out);
+                else fprintf(out, ",\"s\":\"t\",\"args\":{\"waiting\":%u}}", e->arg);
+                break;
+            }
+            case EVENT_TRACE_EV_NOTIFY:
+                snprintf(title, sizeof(title), "notify %s",
+                         named(EVENT_TRACE_NAME_TASK, e->id, "task", buf2, sizeof(buf2)));
+                track(tid, ts);
+                begin_event(out, 'i', tid, ts, "notify");
+                name_event(out, title);
+                fputs(",\"s\":\"t\"}", out);
+                break;
+            default:
+                events--;
+                break;
+            }
+        }
+
+        // The task still running at the end of the recording
+        if (task != 0) {
+            begin_event(out, 'X', (uint32_t)c, task_start, "task");
+            name_event(out, named(EVENT_TRACE_NAME_TASK, task, "task", buf, sizeof(buf)));
+            fprintf(out, ",\"dur\":%llu}", ts - task_start);
+        }
+    }
+
+    // Spans and interrupts still open
+    for (size_t i = 0; i < track_count; i++) {
+        for (; tracks[i].depth > 0; tracks[i].depth--) {
+            begin_event(out, 'E', tracks[i].tid, tracks[i].last, "span");
+            fputs("}", out);
+        }
+    }
+    for (size_t i = 0; i < track_count; i++) {
+        if (tracks[i].tid < EVENT_TRACE_CORES) continue;
+        metadata(out, tracks[i].tid, "thread_name",
+                 named(EVENT_TRACE_NAME_TASK, tracks[i].tid, "task", buf, sizeof(buf)), 10 + (int)i);
+    }
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", out);
+    fclose(out);
+
+    fprintf(stderr, "event_trace: %zu events", events);
+    for (int c = 0; c < EVENT_TRACE_CORES; c++) {
+        if (cores[c].overwritten) fprintf(stderr, ", core %d lost %lu oldest", c, (unsigned long)cores[c].overwritten);
+    }
+    fprintf(stderr, " -> %s\n", path);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <device|file|-> <out.json>\n", argv[0]);
+        return 2;
+    }
+    FILE *in = strcmp(argv[1], "-") == 0 ? stdin : fopen(argv[1], "rb");
+    if (!in) { perror(argv[1]); return 1; }
+    set_raw(in);
+    signal(SIGINT, on_signal);
+
+    const size_t mark = sizeof(EVENT_TRACE_LINE_MARK) - 1;
+    char line[MAX_LINE];
+    unsigned long bad = 0;
+    while (!stop && fgets(line, sizeof(line), in)) {
+        if (strncmp(line, EVENT_TRACE_LINE_MARK, mark) != 0) {
+            fputs(line, stdout);
+            fflush(stdout);
+            continue;
+        }
+        uint8_t p[MAX_CHUNK];
+        int n = base64_decode(line + mark, p, sizeof(p));
+        if (n < 0 || !chunk(p, (size_t)n)) bad++;
+    }
+    if (in != stdin) fclose(in);
+
+    if (bad) fprintf(stderr, "event_trace: %lu damaged lines\n", bad);
+    if (!have_info) {
+        fprintf(stderr, "event_trace: no dump in the input (\"evtrace dump\" on the device)\n");
+        return 1;
+    }
+    return write_json(argv[2]);
+}
@@ -0,0 +1,151 @@
+/*
+ * Host-side runner for the acoustic Morse receiver.
+ *
+ * Reads a 16-bit PCM WAV file (mono, or the first channel of a multi-channel
+ * file), feeds it to morse_audio_process() in MEMS_BUFFER_SIZE blocks exactly
+ * like the firmware does, and prints the symbol stream, the decoded text, the
+ * final WPM estimate and the worst per-block processing time on this host.
+ *
+ * Usage: morse_wav <file.wav> [tone_hz] [window]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "morse.h"
+#include "morse_audio.h"
+
+#define BLOCK_SIZE      256     // same as MEMS_BUFFER_SIZE on the device
+#define MAX_SYMBOLS     4096
+
+static char symbols[MAX_SYMBOLS];
+static size_t symbol_count = 0;
+
+static void on_symbol(char symbol, void *ctx) {
+    (void)ctx;
+    if (symbol_count < MAX_SYMBOLS - 1) {
+        symbols[symbol_count++] = symbol;
+        symbols[symbol_count] = '\0';
+    }
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t read_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+// Minimal RIFF parser: finds "fmt " and "data", skips anything else.
+static int16_t *load_wav(const char *path, uint32_t *rate, size_t *frames) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+
+    uint8_t hdr[12];
+    if (fread(hdr, 1, 12, f) != 12 || memcmp(hdr, "RIFF", 4) || memcmp(hdr + 8, "WAVE", 4)) {
+        fprintf(stderr, "%s: not a RIFF/WAVE file\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    uint16_t channels = 0, bits = 0, format = 0;
+    int16_t *out = NULL;
+
+    uint8_t chunk[8];
+    while (fread(chunk, 1, 8, f) == 8) {
+        uint32_t size = read_u32(chunk + 4);
+
+        if (!memcmp(chunk, "fmt ", 4)) {
+            uint8_t fmt[16];
+            if (size < 16 || fread(fmt, 1, 16, f) != 16) break;
+            format = read_u16(fmt);
+            channels = read_u16(fmt + 2);
+            *rate = read_u32(fmt + 4);
+            bits = read_u16(fmt + 14);
+            fseek(f, (long)(size - 16 + (size & 1)), SEEK_CUR);
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (format != 1 || bits != 16 || channels == 0) {
+                fprintf(stderr, "%s: only 16-bit PCM is supported\n", path);
+                break;
+            }
+            size_t total = size / 2;
+            int16_t *raw = malloc(total * sizeof(int16_t));
+            if (!raw) break;
+            total = fread(raw, sizeof(int16_t), total, f);
+
+            // Keep only the first channel
+            *frames = total / channels;
+            for (size_t i = 0; i < *frames; i++) raw[i] = raw[i * channels];
+            out = raw;
+            break;
+        } else {
+            fseek(f, (long)(size + (size & 1)), SEEK_CUR);
+        }
+    }
+
+    fclose(f);
+    if (!out) fprintf(stderr, "%s: no usable data chunk\n", path);
+    return out;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <file.wav> [tone_hz] [window]\n", argv[0]);
+        return 2;
+    }
+
+    uint32_t tone = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : MORSE_AUDIO_DEFAULT_TONE_HZ;
+    uint16_t window = argc > 3 ? (uint16_t)strtoul(argv[3], NULL, 10) : MORSE_AUDIO_DEFAULT_WINDOW;
+
+    uint32_t rate = 0;
+    size_t frames = 0;
+    int16_t *pcm = load_wav(argv[1], &rate, &frames);
+    if (!pcm) return 1;
+
+    morse_audio_t det;
+    morse_audio_init(&det, rate, tone, window, on_symbol, NULL);
+
+    double worst_us = 0.0;
+    for (size_t pos = 0; pos < frames; pos += BLOCK_SIZE) {
+        size_t n = frames - pos < BLOCK_SIZE ? frames - pos : BLOCK_SIZE;
+
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        morse_audio_process(&det, pcm + pos, n);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+
+        double us = (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+        if (us > worst_us) worst_us = us;
+    }
+
+    // Flush the trailing gap so the last letter is emitted
+    int16_t silence[BLOCK_SIZE] = {0};
+    for (int i = 0; i < 64; i++) morse_audio_process(&det, silence, BLOCK_SIZE);
+
+    // The firmware decoder expects space separated letters
+    char morse[MAX_SYMBOLS];
+    size_t m = 0;
+    for (size_t i = 0; i < symbol_count; i++) {
+        morse[m++] = symbols[i] == MORSE_AUDIO_WORD_GAP ? ' ' : symbols[i];
+    }
+    morse[m] = '\0';
+
+    char text[MAX_SYMBOLS];
+    decode_morse_message(morse, text, sizeof(text));
+
+    printf("file:     %s (%u Hz, %zu samples)\n", argv[1], rate, frames);
+    printf("tone:     %u Hz, window %u samples\n", tone, window);
+    printf("symbols:  %s\n", symbols);
+    printf("text:     %s\n", text);
+    printf("wpm:      %u\n", morse_audio_wpm(&det));
+    printf("worst:    %.1f us per %d-sample block\n", worst_us, BLOCK_SIZE);
+
+    free(pcm);
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Replays PDM bitstreams through both filter paths of the microphone driver:
+ *
+ *   byte path  - Open_PDM_Filter_64/128 on bytes, as stored by the original
+ *                8-bit PIO push + DMA_SIZE_8
+ *   word path  - Open_PDM_Filter_64_Words/128_Words on 32-bit words, as
+ *                stored by the 32-bit PIO push + DMA_SIZE_32 (first bit in
+ *                bit 31, little-endian words)
+ *
+ * and checks that the PCM output is bit-identical. Input files are raw PDM
+ * bitstreams, first bit in the MSB of the first byte. Without files, a
+ * sigma-delta modulated test signal is generated for every profile.
+ *
+ * Usage: pdm_replay [-r sample_rate] [-d decimation] [file.pdm ...]
+ * Exit status is 1 if any stream differs.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "OpenPDMFilter.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SYNTH_SECONDS   2
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Driver defaults, see pdm_microphone_init()
+static void filter_setup(TPDMFilter_InitStruct *f, unsigned rate, unsigned decimation) {
+    memset(f, 0, sizeof(*f));
+    f->Fs = rate;
+    f->LP_HZ = rate / 2;
+    f->HP_HZ = 10;
+    f->In_MicChannels = 1;
+    f->Out_MicChannels = 1;
+    f->Decimation = decimation;
+    f->MaxVolume = 64;
+    f->Gain = 16;
+    Open_PDM_Filter_Init(f);
+}
+
+// Second-order sigma-delta modulator: a two-tone signal as a PDM bitstream
+static uint8_t *synth_stream(unsigned rate, unsigned decimation, size_t *bytes) {
+    double pdm_rate = (double)rate * decimation;
+    size_t bits = (size_t)(pdm_rate * SYNTH_SECONDS);
+    *bytes = bits / 8;
+
+    uint8_t *out = calloc(*bytes, 1);
+    if (!out) return NULL;
+
+    double i1 = 0.0, i2 = 0.0, fb = 0.0;
+    for (size_t n = 0; n < bits; n++) {
+        double t = n / pdm_rate;
+        double x = 0.02 * sin(2 * M_PI * 440.0 * t) + 0.01 * sin(2 * M_PI * 1800.0 * t);
+        i1 += x - fb;
+        i2 += i1 - fb;
+        int bit = i2 >= 0.0;
+        fb = bit ? 1.0 : -1.0;
+        if (bit) out[n / 8] |= (uint8_t)(0x80 >> (n % 8));
+    }
+    return out;
+}
+
+static uint8_t *load_stream(const char *path, size_t *bytes) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    uint8_t *buf = len > 0 ? malloc((size_t)len) : NULL;
+    if (!buf || fread(buf, 1, (size_t)len, f) != (size_t)len) {
+        fprintf(stderr, "%s: cannot read\n", path);
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    *bytes = (size_t)len;
+    return buf;
+}
+
+// Returns 0 if both paths match
+static int replay(const char *name, const uint8_t *stream, size_t bytes,
+                  unsigned rate, unsigned decimation) {
+    const size_t stride = rate / 1000;                  // PCM samples per filter call
+    const size_t chunk = stride * decimation / 8;       // PDM bytes per filter call
+    const size_t chunks = bytes / chunk;
+
+    // Pack exactly like the PIO: first bit at bit 31 of each native word
+    size_t words = chunks * chunk / 4;
+    uint32_t *packed = malloc(words * sizeof(uint32_t));
+    int16_t *pcm_b = malloc(chunks * stride * sizeof(int16_t));
+    int16_t *pcm_w = malloc(chunks * stride * sizeof(int16_t));
+    if (!packed || !pcm_b || !pcm_w) {
+        fprintf(stderr, "out of memory\n");
+        free(packed); free(pcm_b); free(pcm_w);
+        return 1;
+    }
+    for (size_t i = 0; i < words; i++) {
+        const uint8_t *p = stream + 4 * i;
+        packed[i] = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+
+    TPDMFilter_InitStruct fb, fw;
+
+    filter_setup(&fb, rate, decimation);
+    double t0 = now_us();
+    for (size_t c = 0; c < chunks; c++) {
+        uint8_t *in = (uint8_t *)stream + c * chunk;
+        uint16_t *out = (uint16_t *)pcm_b + c * stride;
+        if (decimation == 128) Open_PDM_Filter_128(in, out, fb.MaxVolume, &fb);
+        else                   Open_PDM_Filter_64(in, out, fb.MaxVolume, &fb);
+    }
+    double t_byte = now_us() - t0;
+
+    filter_setup(&fw, rate, decimation);
+    t0 = now_us();
+    for (size_t c = 0; c < chunks; c++) {
+        const uint32_t *in = packed + c * chunk / 4;
+        uint16_t *out = (uint16_t *)pcm_w + c * stride;
+        if (decimation == 128) Open_PDM_Filter_128_Words(in, out, fw.MaxVolume, &fw);
+        else                   Open_PDM_Filter_64_Words(in, out, fw.MaxVolume, &fw);
+    }
+    double t_word = now_us() - t0;
+
+    // Peak skips the first 100 ms, where the filters are still settling
+    size_t samples = chunks * stride, mismatches = 0, first = 0;
+    int32_t peak = 0;
+    for (size_t i = 0; i < samples; i++) {
+        if (pcm_b[i] != pcm_w[i] && mismatches++ == 0) first = i;
+        int32_t a = abs(pcm_b[i]);
+        if (i >= rate / 10 && a > peak) peak = a;
+    }
+
+    printf("%-24s %5u Hz dec %3u  %7zu samples  peak %5d  byte %8.0f us  word %8.0f us  %s",
+           name, rate, decimation, samples, (int)peak, t_byte, t_word,
+           mismatches ? "MISMATCH" : "match");
+    if (mismatches) printf(" (%zu samples, first at %zu)", mismatches, first);
+    printf("\n");
+
+    free(packed);
+    free(pcm_b);
+    free(pcm_w);
+    return mismatches != 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned rate = 8000, decimation = 64;
+    int first_file = argc;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            rate = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+            decimation = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+
+    if (rate == 0 || rate % 1000 || (decimation != 64 && decimation != 128)) {
+        fprintf(stderr, "sample rate must be a multiple of 1000 Hz and decimation 64 or 128\n");
+        return 2;
+    }
+
+    int failed = 0;
+
+    if (first_file == argc) {
+        static const unsigned profiles[][2] = { { 8000, 64 }, { 16000, 64 }, { 16000, 128 } };
+        for (size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); p++) {
+            size_t bytes;
+            uint8_t *s = synth_stream(profiles[p][0], profiles[p][1], &bytes);
+            if (!s) return 1;
+            failed |= replay("synthetic", s, bytes, profiles[p][0], profiles[p][1]);
+            free(s);
+        }
+    } else {
+        for (int i = first_file; i < argc; i++) {
+            size_t bytes;
+            uint8_t *s = load_stream(argv[i], &bytes);
+            if (!s) {
+                failed = 1;
+                continue;
+            }
+            failed |= replay(argv[i], s, bytes, rate, decimation);
+            free(s);
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,250 @@
+/*
+ * Host-side tool for sensor traces (libs/TKJHAT/include/tkjhat/sensor_trace.h).
+ *
+ * capture: reads the device output from a serial port, a capture file or
+ *          stdin. Lines that start with SENSOR_TRACE_LINE_MARK carry one
+ *          base64 record; the records are written back to back into the
+ *          trace file, everything else is copied to stdout. Stops at the end
+ *          of the input or on Ctrl-C.
+ * print:   one line of text per record, IMU in g / dps at the default full
+ *          scale ranges (-a/-g to change them).
+ * send:    writes the "trace" commands that load a trace into the device
+ *          and start the replay (to a serial port or stdout).
+ *
+ * Usage: sensor_trace capture <device|file|-> <out.strace>
+ *        sensor_trace print <in.strace> [-a g] [-g dps]
+ *        sensor_trace send <in.strace> [device] [types...]
+ *
+ * On the host the simulation replays a trace: tkjhat_sim --sensor-trace
+ */
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <termios.h>
+#include <unistd.h>
+#define HAVE_TERMIOS 1
+#endif
+
+#include <tkjhat/base64.h>
+#include <tkjhat/sensor_trace.h>
+
+#define MAX_RECORD      (SENSOR_TRACE_HEADER_SIZE + SENSOR_TRACE_MAX_PAYLOAD)
+#define MAX_LINE        (MAX_RECORD * 2)
+#define SEND_CHUNK      144     // bytes per "trace put", fits COMMAND_LINE_MAX
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void set_raw(FILE *f) {
+#ifdef HAVE_TERMIOS
+    if (isatty(fileno(f))) {
+        struct termios tio;
+        if (tcgetattr(fileno(f), &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(fileno(f), TCSANOW, &tio);
+        }
+    }
+#else
+    (void)f;
+#endif
+}
+
+static uint16_t u16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static uint32_t u32(const uint8_t *p) { return u16(p) | ((uint32_t)u16(p + 2) << 16); }
+static int16_t be16(const uint8_t *p) { return (int16_t)((p[0] << 8) | p[1]); }
+
+static uint8_t *load_file(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) { perror(path); return NULL; }
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(n > 0 ? (size_t)n : 1);
+    if (!data || fread(data, 1, n > 0 ? (size_t)n : 0, f) != (size_t)(n > 0 ? n : 0)) {
+        fclose(f);
+        free(data);
+        return NULL;
+    }
+    fclose(f);
+    *len = (size_t)n;
+    return data;
+}
+
+// Checks the record structure, returns the record count or -1
+static long check(const uint8_t *t, size_t len, const char *path) {
+    long count = 0;
+    for (size_t pos = 0; pos < len; count++) {
+        if (len - pos < SENSOR_TRACE_HEADER_SIZE || t[pos] >= SENSOR_TRACE_TYPES ||
+            len - pos < SENSOR_TRACE_HEADER_SIZE + (size_t)u16(&t[pos + 1])) {
+            fprintf(stderr, "%s: malformed record at byte %zu\n", path, pos);
+            return -1;
+        }
+        pos += SENSOR_TRACE_HEADER_SIZE + u16(&t[pos + 1]);
+    }
+    return count;
+}
+
+static int capture(const char *in_path, const char *out_path) {
+    FILE *in = strcmp(in_path, "-") == 0 ? stdin : fopen(in_path, "rb");
+    if (!in) { perror(in_path); return 1; }
+    FILE *out = fopen(out_path, "wb");
+    if (!out) { perror(out_path); return 1; }
+    set_raw(in);
+    signal(SIGINT, on_signal);
+
+    const size_t mark = sizeof(SENSOR_TRACE_LINE_MARK) - 1;
+    char line[MAX_LINE];
+    unsigned long records = 0, bad = 0;
+    while (!stop && fgets(line, sizeof(line), in)) {
+        if (strncmp(line, SENSOR_TRACE_LINE_MARK, mark) != 0) {
+            fputs(line, stdout);
+            fflush(stdout);
+            continue;
+        }
+        uint8_t rec[MAX_RECORD];
+        int n = base64_decode(line + mark, rec, sizeof(rec));
+        if (n < SENSOR_TRACE_HEADER_SIZE || n != SENSOR_TRACE_HEADER_SIZE + u16(&rec[1])) {
+            bad++;
+            continue;
+        }
+        fwrite(rec, 1, (size_t)n, out);
+        fflush(out);
+        records++;
+    }
+
+    fprintf(stderr, "sensor_trace: %lu records, %lu damaged lines\n", records, bad);
+    fclose(out);
+    if (in != stdin) fclose(in);
+    return 0;
+}
+
+static int print(const char *path, float accel_g, float gyro_dps) {
+    size_t len;
+    uint8_t *t = load_file(path, &len);
+    if (!t || check(t, len, path) < 0) return 1;
+
+    static const char *const names[SENSOR_TRACE_TYPES] = {
+        "info", "imu", "light", "temp", "hum", "btn", "mic",
+    };
+    for (size_t pos = 0; pos < len; ) {
+        const uint8_t *p = &t[pos + SENSOR_TRACE_HEADER_SIZE];
+        uint8_t type = t[pos];
+        size_t n = u16(&t[pos + 1]);
+        printf("%10.3f %-5s", u32(&t[pos + 3]) / 1000.0, names[type]);
+
+        switch (type) {
+        case SENSOR_TRACE_INFO:
+            if (n >= 2) printf(" version %u mask 0x%02x", p[0], p[1]);
+            break;
+        case SENSOR_TRACE_IMU:
+            // Same conversion as ICM42670_read_sensor_data()
+            if (n >= 14) {
+                printf(" a %7.3f %7.3f %7.3f g  w %8.2f %8.2f %8.2f dps  t %5.1f C",
+                       be16(p + 2) * accel_g / 32768.0f, be16(p + 4) * accel_g / 32768.0f,
+                       be16(p + 6) * accel_g / 32768.0f, be16(p + 8) * gyro_dps / 32768.0f,
+                       be16(p + 10) * gyro_dps / 32768.0f, be16(p + 12) * gyro_dps / 32768.0f,
+                       be16(p) / 128.0f + 25.0f);
+            }
+            break;
+        case SENSOR_TRACE_LIGHT:
+            if (n >= 2) printf(" %.1f lux", u16(p) * 0.5376);
+            break;
+        case SENSOR_TRACE_TEMP:
+            if (n >= 2) printf(" %.2f C", u16(p) * 165.0f / 65536.0f - 40.0f);
+            break;
+        case SENSOR_TRACE_HUMIDITY:
+            if (n >= 2) printf(" %.1f %%RH", u16(p) * 100.0f / 65536.0f);
+            break;
+        case SENSOR_TRACE_BUTTON:
+            if (n >= 6) printf(" gpio %u events 0x%lx", p[0], (unsigned long)u32(p + 2));
+            break;
+        case SENSOR_TRACE_MIC: {
+            int32_t peak = 0;
+            for (size_t i = 0; i + 1 < n; i += 2) {
+                int32_t v = (int16_t)u16(p + i);
+                if (v < 0) v = -v;
+                if (v > peak) peak = v;
+            }
+            printf(" %zu samples peak %ld", n / 2, (long)peak);
+            break;
+        }
+        }
+        putchar('\n');
+        pos += SENSOR_TRACE_HEADER_SIZE + n;
+    }
+    free(t);
+    return 0;
+}
+
+static int send(const char *path, const char *dev, int ntypes, char **types) {
+    size_t len;
+    uint8_t *t = load_file(path, &len);
+    if (!t || check(t, len, path) < 0) return 1;
+    if (len > SENSOR_TRACE_BUFFER_SIZE) {
+        fprintf(stderr, "%s: %zu bytes, the device holds %d\n", path, len, SENSOR_TRACE_BUFFER_SIZE);
+        return 1;
+    }
+
+    FILE *out = dev ? fopen(dev, "wb") : stdout;
+    if (!out) { perror(dev); return 1; }
+    set_raw(out);
+
+    char b64[(SEND_CHUNK + 2) / 3 * 4 + 1];
+    fprintf(out, "trace clear\n");
+    for (size_t pos = 0; pos < len; pos += SEND_CHUNK) {
+        size_t n = len - pos < SEND_CHUNK ? len - pos : SEND_CHUNK;
+        b64[base64_encode(t + pos, n, b64)] = '\0';
+        fprintf(out, "trace put %s\n", b64);
+        fflush(out);
+#ifdef HAVE_TERMIOS
+        // The device parses one line at a time
+        if (dev) usleep(5000);
+#endif
+    }
+    fprintf(out, "trace replay");
+    for (int i = 0; i < ntypes; i++) fprintf(out, " %s", types[i]);
+    fprintf(out, "\n");
+
+    if (out != stdout) fclose(out);
+    free(t);
+    return 0;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s capture <device|file|-> <out.strace>\n"
+            "       %s print <in.strace> [-a g] [-g dps]\n"
+            "       %s send <in.strace> [device] [imu|light|temp|hum|btn|mic ...]\n",
+            argv0, argv0, argv0);
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 4 && strcmp(argv[1], "capture") == 0) {
+        return capture(argv[2], argv[3]);
+    }
+    if (argc >= 3 && strcmp(argv[1], "print") == 0) {
+        float accel_g = 4.0f, gyro_dps = 250.0f;     // ICM42670_*_FSR_DEFAULT
+        for (int a = 3; a + 1 < argc; a += 2) {
+            if (strcmp(argv[a], "-a") == 0) accel_g = (float)atof(argv[a + 1]);
+            else if (strcmp(argv[a], "-g") == 0) gyro_dps = (float)atof(argv[a + 1]);
+        }
+        return print(argv[2], accel_g, gyro_dps);
+    }
+    if (argc >= 3 && strcmp(argv[1], "send") == 0) {
+        // A device path contains a '/', type names do not
+        const char *dev = argc >= 4 && strchr(argv[3], '/') ? argv[3] : NULL;
+        int first = dev ? 4 : 3;
+        return send(argv[2], dev, argc - first, argv + first);
+    }
+    usage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,304 @@
+/*
+ * Host-side stack report for the STACK_USAGE build.
+ *
+ * Combines two sources into one table per task:
+ *   - static analysis: the call graph files (*.ci) that GCC writes with
+ *     -fstack-usage -fcallgraph-info=su. The worst-case stack of a task is
+ *     the deepest path from its entry function <task>_task.
+ *   - measurement: the "STACK <task> <size> <used> <free>" lines that the
+ *     firmware prints after its scripted workload (captured from the serial
+ *     port into a file, or read straight from the port).
+ *
+ * The static figure is exact only if every function on the path was
+ * compiled with the flags. Calls through function pointers, recursion,
+ * dynamic stack (VLA/alloca) and functions without call graph data (libc,
+ * ROM) are marked with '+': the true worst case is higher. The suggested
+ * size is the larger of the two figures plus 25 % and the exception frame,
+ * rounded to 16 words.
+ *
+ * Usage: stack_report <build dir> [measured.log|device|-] [--paths]
+ *   --paths  also print the worst-case call path of every task
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 700
+
+#include <ftw.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <termios.h>
+#include <unistd.h>
+#define HAVE_TERMIOS 1
+#endif
+
+#define MAX_NAME        128
+#define MAX_TASKS       32
+#define EXCEPTION_FRAME 96      // context saved on the task stack by the port
+#define MARGIN_PCT      25
+
+/* ---- call graph ---- */
+
+typedef struct {
+    char name[MAX_NAME];
+    long frame;             // own stack in bytes, -1 = no data
+    int dynamic;            // frame is not static
+    int *callees;
+    int n_callees, cap_callees;
+    // worst-case search
+    int state;              // 0 new, 1 on the current path, 2 done
+    long worst;
+    int incomplete;
+    int next;               // callee on the worst path, -1 = leaf
+} func_t;
+
+static func_t *funcs;
+static int n_funcs, cap_funcs;
+static int files_read;
+
+static int find_func(const char *name, int create) {
+    for (int i = 0; i < n_funcs; i++) {
+        if (strcmp(funcs[i].name, name) == 0) return i;
+    }
+    if (!create) return -1;
+    if (n_funcs == cap_funcs) {
+        cap_funcs = cap_funcs ? cap_funcs * 2 : 256;
+        funcs = realloc(funcs, (size_t)cap_funcs * sizeof(func_t));
+        if (!funcs) { perror("realloc"); exit(1); }
+    }
+    func_t *f = &funcs[n_funcs];
+    memset(f, 0, sizeof(*f));
+    snprintf(f->name, sizeof(f->name), "%s", name);
+    f->frame = -1;
+    f->next = -1;
+    return n_funcs++;
+}
+
+static void add_call(int from, int to) {
+    func_t *f = &funcs[from];
+    for (int i = 0; i < f->n_callees; i++) {
+        if (f->callees[i] == to) return;
+    }
+    if (f->n_callees == f->cap_callees) {
+        f->cap_callees = f->cap_callees ? f->cap_callees * 2 : 8;
+        f->callees = realloc(f->callees, (size_t)f->cap_callees * sizeof(int));
+        if (!f->callees) { perror("realloc"); exit(1); }
+    }
+    f->callees[f->n_callees++] = to;
+}
+
+// Copies the quoted value after key ("title: \"...\"") into out
+static int get_field(const char *line, const char *key, char *out, size_t max) {
+    const char *p = strstr(line, key);
+    if (!p) return 0;
+    p = strchr(p + strlen(key), '"');
+    if (!p) return 0;
+    p++;
+    size_t n = 0;
+    while (*p && *p != '"' && n + 1 < max) {
+        if (*p == '\\' && p[1]) {       // keep escapes as two characters
+            out[n++] = *p++;
+            if (n + 1 >= max) break;
+        }
+        out[n++] = *p++;
+    }
+    out[n] = '\0';
+    return 1;
+}
+
+static void parse_ci(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+    files_read++;
+
+    char line[4096], title[MAX_NAME], label[1024], src[MAX_NAME], dst[MAX_NAME];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "node:", 5) == 0 && get_field(line, "title:", title, sizeof(title))) {
+            int i = find_func(title, 1);
+            // Label lines: name \n location \n "<n> bytes (static|dynamic|dynamic,bounded)"
+            if (get_field(line, "label:", label, sizeof(label))) {
+                for (char *p = strstr(label, "\\n"); p; p = strstr(p + 2, "\\n")) {
+                    long bytes;
+                    char kind[32];
+                    if (sscanf(p + 2, "%ld bytes (%31[^)])", &bytes, kind) == 2) {
+                        funcs[i].frame = bytes;
+                        funcs[i].dynamic = strcmp(kind, "static") != 0;
+                        break;
+                    }
+                }
+            }
+        } else if (strncmp(line, "edge:", 5) == 0 &&
+                   get_field(line, "sourcename:", src, sizeof(src)) &&
+                   get_field(line, "targetname:", dst, sizeof(dst))) {
+            add_call(find_func(src, 1), find_func(dst, 1));
+        }
+    }
+    fclose(f);
+}
+
+static int visit(const char *path, const struct stat *sb, int type, struct FTW *ftw) {
+    (void)sb;
+    (void)ftw;
+    size_t n = strlen(path);
+    if (type == FTW_F && n > 3 && strcmp(path + n - 3, ".ci") == 0) parse_ci(path);
+    return 0;
+}
+
+// Deepest path from f; recursion and missing data set incomplete
+static long worst_case(int i) {
+    func_t *f = &funcs[i];
+    if (f->state == 2) return f->worst;
+    if (f->state == 1) {
+        return 0;       // recursion: the caller is marked below
+    }
+    f->state = 1;
+
+    long deepest = 0;
+    int incomplete = f->frame < 0 || f->dynamic || strcmp(f->name, "__indirect_call") == 0;
+    for (int k = 0; k < f->n_callees; k++) {
+        int c = f->callees[k];
+        if (funcs[c].state == 1) {
+            incomplete = 1;
+            continue;
+        }
+        long w = worst_case(c);
+        if (funcs[c].incomplete) incomplete = 1;
+        if (w > deepest || f->next < 0) {
+            if (w >= deepest) f->next = c;
+            if (w > deepest) deepest = w;
+        }
+    }
+
+    f->worst = (f->frame > 0 ? f->frame : 0) + deepest;
+    f->incomplete = incomplete;
+    f->state = 2;
+    return f->worst;
+}
+
+/* ---- measurement ---- */
+
+typedef struct {
+    char name[MAX_NAME];
+    long size, used, free;
+} measured_t;
+
+static measured_t tasks[MAX_TASKS];
+static int n_tasks;
+
+static void read_measurement(FILE *in) {
+    char line[512];
+    int started = 0;
+    while (fgets(line, sizeof(line), in)) {
+        if (strstr(line, "STACK_PROFILE start")) started = 1;
+        if (strstr(line, "STACK_PROFILE end")) break;
+        if (strstr(line, "STACK_OVERFLOW")) fprintf(stderr, "warning: %s", line);
+
+        measured_t m;
+        const char *p = strstr(line, "STACK ");
+        if (!started || !p) continue;
+        if (sscanf(p, "STACK %127s %ld %ld %ld", m.name, &m.size, &m.used, &m.free) != 4) continue;
+        if (n_tasks < MAX_TASKS) tasks[n_tasks++] = m;
+    }
+}
+
+static long suggest(long bytes) {
+    long v = bytes + bytes * MARGIN_PCT / 100 + EXCEPTION_FRAME;
+    long words = (v + 3) / 4;
+    return (words + 15) / 16 * 16;
+}
+
+static void print_path(int i) {
+    printf("   ");
+    for (int depth = 0; i >= 0 && depth < 64; depth++) {
+        const func_t *f = &funcs[i];
+        if (f->frame < 0) printf(" %s(?)", f->name);
+        else printf(" %s(%ld%s)", f->name, f->frame, f->dynamic ? "+" : "");
+        i = f->next;
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    const char *build = NULL, *log = NULL;
+    int paths = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--paths") == 0) paths = 1;
+        else if (!build) build = argv[i];
+        else log = argv[i];
+    }
+    if (!build) {
+        fprintf(stderr, "usage: stack_report <build dir> [measured.log|device|-] [--paths]\n");
+        return 1;
+    }
+
+    nftw(build, visit, 16, FTW_PHYS);
+    if (files_read == 0) {
+        fprintf(stderr, "%s: no .ci files, configure with -DSTACK_USAGE=ON and build first\n", build);
+    }
+
+    if (log) {
+        FILE *in = strcmp(log, "-") == 0 ? stdin : fopen(log, "r");
+        if (!in) {
+            perror(log);
+            return 1;
+        }
+#ifdef HAVE_TERMIOS
+        // Serial device: raw mode, the report is read line by line
+        if (isatty(fileno(in))) {
+            struct termios tio;
+            if (tcgetattr(fileno(in), &tio) == 0) {
+                cfmakeraw(&tio);
+                tcsetattr(fileno(in), TCSANOW, &tio);
+            }
+        }
+#endif
+        read_measurement(in);
+        if (in != stdin) fclose(in);
+    }
+
+    // Without a measurement, report every *_task function found
+    if (n_tasks == 0) {
+        for (int i = 0; i < n_funcs && n_tasks < MAX_TASKS; i++) {
+            size_t n = strlen(funcs[i].name);
+            if (n > 5 && strcmp(funcs[i].name + n - 5, "_task") == 0 && funcs[i].frame >= 0) {
+                snprintf(tasks[n_tasks].name, MAX_NAME, "%.*s", (int)(n - 5), funcs[i].name);
+                tasks[n_tasks].size = tasks[n_tasks].used = tasks[n_tasks].free = -1;
+                n_tasks++;
+            }
+        }
+    }
+
+    printf("%d call graph files, %d functions\n\n", files_read, n_funcs);
+    printf("%-16s %10s %10s %10s %10s\n", "task", "static", "measured", "size", "suggest");
+    printf("%-16s %10s %10s %10s %10s\n", "", "bytes", "bytes", "bytes", "words");
+    for (int t = 0; t < n_tasks; t++) {
+        const measured_t *m = &tasks[t];
+        char entry[MAX_NAME + 8];
+        snprintf(entry, sizeof(entry), "%s_task", m->name);
+        int f = find_func(entry, 0);
+
+        char st[24] = "-", me[24] = "-", sz[24] = "-", sg[24] = "-";
+        long need = m->used > 0 ? m->used : 0;
+        if (f >= 0) {
+            long w = worst_case(f);
+            snprintf(st, sizeof(st), "%ld%s", w, funcs[f].incomplete ? "+" : "");
+            if (w > need) need = w;
+        }
+        if (m->used >= 0) snprintf(me, sizeof(me), "%ld", m->used);
+        if (m->size > 0) snprintf(sz, sizeof(sz), "%ld", m->size);
+        if (need > 0) snprintf(sg, sizeof(sg), "%ld", suggest(need));
+        // Kernel tasks (IDLE, Tmr Svc) have neither an entry nor a size here
+        if (f < 0 && m->size <= 0) continue;
+        printf("%-16s %10s %10s %10s %10s\n", m->name, st, me, sz, sg);
+        if (paths && f >= 0) print_path(f);
+    }
+
+    printf("\n'+': lower bound (indirect call, recursion, dynamic stack or a function\n"
+           "without call graph data on the path). Suggested = max(static, measured)\n"
+           "+ %d %% + %d bytes exception frame, in words rounded to 16.\n",
+           MARGIN_PCT, EXCEPTION_FRAME);
+    return 0;
+}
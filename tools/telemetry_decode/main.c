@@ -0,0 +1,235 @@
+/*
+ * Host-side decoder for the binary telemetry stream.
+ *
+ * Reads COBS frames from a serial port, a capture file or stdin, checks the
+ * CRC and the sequence numbers, and prints every record as a CSV line:
+ *
+ *   t_ms,type,values...
+ *
+ * Statistics (frames, records, CRC/format errors, frames lost from sequence
+ * gaps, throughput) go to stderr every few seconds and at the end.
+ *
+ * Usage: telemetry_decode [device|file|-] [--selftest]
+ *   --selftest  encode a synthetic stream with dropped and corrupted frames
+ *               and check that the decoder reports exactly those
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+#define HAVE_TERMIOS 1
+#endif
+
+#include "usbSerialDebug/telemetry.h"
+
+#define STATS_PERIOD_S  5
+
+typedef struct {
+    unsigned long frames;
+    unsigned long records;
+    unsigned long bad_crc;
+    unsigned long bad_format;
+    unsigned long lost;
+    unsigned long bytes;
+    int have_seq;
+    uint16_t next_seq;
+} stats_t;
+
+static stats_t st;
+static FILE *csv;
+
+static uint16_t get_u16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static int16_t  get_i16(const uint8_t *p) { return (int16_t)get_u16(p); }
+static uint32_t get_u32(const uint8_t *p) { return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16); }
+
+static void print_record(uint32_t t, uint8_t type, const uint8_t *p, uint8_t len) {
+    switch (type) {
+    case TELEMETRY_IMU:
+        if (len < TELEMETRY_IMU_SIZE) break;
+        fprintf(csv, "%lu,imu,%.3f,%.3f,%.3f,%.1f,%.1f,%.1f,%.2f\n", (unsigned long)t,
+                get_i16(p) / 1000.0, get_i16(p + 2) / 1000.0, get_i16(p + 4) / 1000.0,
+                get_i16(p + 6) / 10.0, get_i16(p + 8) / 10.0, get_i16(p + 10) / 10.0,
+                get_i16(p + 12) / 100.0);
+        return;
+    case TELEMETRY_LIGHT:
+        if (len < TELEMETRY_LIGHT_SIZE) break;
+        fprintf(csv, "%lu,light,%lu\n", (unsigned long)t, (unsigned long)get_u32(p));
+        return;
+    case TELEMETRY_ENV:
+        if (len < TELEMETRY_ENV_SIZE) break;
+        fprintf(csv, "%lu,env,%.2f,%.2f\n", (unsigned long)t, get_i16(p) / 100.0, get_u16(p + 2) / 100.0);
+        return;
+    case TELEMETRY_AUDIO:
+        if (len < TELEMETRY_AUDIO_SIZE) break;
+        fprintf(csv, "%lu,audio,%u,%u,%u,%u,%u,%u,%u\n", (unsigned long)t,
+                get_u16(p), get_u16(p + 2), get_u16(p + 4),
+                get_u16(p + 6), get_u16(p + 8), get_u16(p + 10), get_u16(p + 12));
+        return;
+    default:
+        break;
+    }
+    fprintf(csv, "%lu,type%u,len%u\n", (unsigned long)t, type, len);
+}
+
+// One frame between delimiters (still COBS encoded)
+static void handle_frame(const uint8_t *enc, size_t enc_len) {
+    uint8_t f[TELEMETRY_FRAME_MAX + 8];
+    if (enc_len == 0) return;
+    if (enc_len > TELEMETRY_ENCODED_MAX) { st.bad_format++; return; }
+
+    size_t n = telemetry_cobs_decode(enc, enc_len, f);
+    if (n < TELEMETRY_HEADER_SIZE + TELEMETRY_CRC_SIZE) { st.bad_format++; return; }
+    if (telemetry_crc16(f, n - 2) != get_u16(&f[n - 2])) { st.bad_crc++; return; }
+    if (f[0] != TELEMETRY_VERSION) { st.bad_format++; return; }
+
+    uint16_t seq = get_u16(&f[1]);
+    if (st.have_seq) st.lost += (uint16_t)(seq - st.next_seq);
+    st.next_seq = (uint16_t)(seq + 1);
+    st.have_seq = 1;
+    st.frames++;
+
+    uint32_t t0 = get_u32(&f[3]);
+    size_t i = TELEMETRY_HEADER_SIZE, end = n - TELEMETRY_CRC_SIZE;
+    while (i + TELEMETRY_RECORD_HEADER <= end) {
+        uint8_t type = f[i], len = f[i + 1];
+        uint16_t dt = get_u16(&f[i + 2]);
+        if (i + TELEMETRY_RECORD_HEADER + len > end) { st.bad_format++; break; }
+        print_record(t0 + dt, type, &f[i + TELEMETRY_RECORD_HEADER], len);
+        st.records++;
+        i += TELEMETRY_RECORD_HEADER + len;
+    }
+}
+
+// Stream decoder: collects bytes up to each 0x00
+static uint8_t acc[TELEMETRY_ENCODED_MAX + 1];
+static size_t acc_len;
+static int acc_overflow;
+
+static void feed(const uint8_t *data, size_t n) {
+    st.bytes += n;
+    for (size_t i = 0; i < n; i++) {
+        if (data[i] == 0) {
+            if (acc_overflow) st.bad_format++;
+            else              handle_frame(acc, acc_len);
+            acc_len = 0;
+            acc_overflow = 0;
+        } else if (acc_len < sizeof(acc)) {
+            acc[acc_len++] = data[i];
+        } else {
+            acc_overflow = 1;
+        }
+    }
+}
+
+static void print_stats(double seconds) {
+    fprintf(stderr, "frames %lu  records %lu  lost %lu  crc %lu  format %lu",
+            st.frames, st.records, st.lost, st.bad_crc, st.bad_format);
+    if (seconds > 0) fprintf(stderr, "  %.1f kB/s", st.bytes / seconds / 1000.0);
+    fprintf(stderr, "\n");
+}
+
+/* ---- self test ---- */
+
+typedef struct {
+    uint8_t buf[1 << 16];
+    size_t len;
+    unsigned n;
+} capture_t;
+
+static bool capture_sink(const uint8_t *data, size_t len, void *ctx) {
+    capture_t *c = ctx;
+    c->n++;
+    if (c->n % 10 == 0) return false;               // dropped by the "USB buffer"
+    memcpy(&c->buf[c->len], data, len);
+    if (c->n % 17 == 0) c->buf[c->len + len / 2] ^= 0x40;   // corrupted on the wire
+    c->len += len;
+    return true;
+}
+
+static int selftest(void) {
+    static capture_t cap;
+    static telemetry_t tm;
+    telemetry_init(&tm, capture_sink, &cap);
+
+    const uint16_t bands[4] = { 1, 2, 3, 4 };
+    unsigned records = 0;
+    for (uint32_t t = 0; t < 2000; t += 2) {
+        telemetry_add_imu(&tm, t, 0.01f * (t % 100), -1.0f, 0.98f, 12.3f, -4.5f, 0.0f, 25.5f);
+        records++;
+        if (t % 10 == 0) { telemetry_add_env(&tm, t, 21.37f, 40.0f); records++; }
+        if (t % 20 == 0) { telemetry_add_light(&tm, t, t * 3); records++; }
+        if (t % 50 == 0) { telemetry_add_audio(&tm, t, 100, 2000, 600, bands); records++; }
+    }
+    telemetry_flush(&tm);
+
+    FILE *null = fopen("/dev/null", "w");
+    csv = null ? null : stdout;
+    feed(cap.buf, cap.len);
+    if (null) fclose(null);
+
+    // Frames that should arrive intact; a dropped or corrupted frame only
+    // counts as lost once a later good frame reveals the gap
+    unsigned frames = cap.n, good = 0, last_good = 0, corrupted = 0;
+    for (unsigned k = 1; k <= frames; k++) {
+        if (k % 10 == 0) continue;
+        if (k % 17 == 0) { corrupted++; continue; }
+        good++;
+        last_good = k;
+    }
+    unsigned expect_lost = last_good - good;
+    print_stats(0);
+    printf("selftest: %u frames, %u records, %.1f records/frame, %zu bytes\n",
+           frames, records, (double)records / frames, cap.len);
+
+    // A flipped bit may turn into a stray delimiter and split a frame in two
+    int ok = st.frames == good && st.bad_crc + st.bad_format >= corrupted &&
+             st.lost == expect_lost;
+    printf("selftest: %s\n", ok ? "OK" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--selftest") == 0) return selftest();
+
+    const char *path = argc > 1 ? argv[1] : "-";
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+    csv = stdout;
+
+#ifdef HAVE_TERMIOS
+    // Serial device: raw mode so no byte is translated or swallowed
+    if (isatty(fileno(in))) {
+        struct termios tio;
+        if (tcgetattr(fileno(in), &tio) == 0) {
+            cfmakeraw(&tio);
+            tcsetattr(fileno(in), TCSANOW, &tio);
+        }
+    }
+#endif
+
+    time_t start = time(NULL), last = start;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        feed(buf, n);
+        time_t now = time(NULL);
+        if (now - last >= STATS_PERIOD_S) {
+            fflush(csv);
+            print_stats((double)(now - start));
+            last = now;
+        }
+    }
+
+    print_stats((double)(time(NULL) - start));
+    if (in != stdin) fclose(in);
+    return 0;
+}